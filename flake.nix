@@ -62,6 +62,23 @@
             '';
           };
 
+          oeuf-kv1toparquet = stdenv.mkDerivation {
+            name = "oeuf-kv1toparquet";
+            src = ./.;
+
+            nativeBuildInputs = with pkgs; [ gcc13 ];
+            buildInputs = with pkgs; [ arrow-cpp oeuf-libtmi8 ];
+            buildPhase = ''
+              cd src/kv1toparquet
+              make kv1toparquet
+            '';
+
+            installPhase = ''
+              mkdir -p $out/bin
+              cp kv1toparquet $out/bin/oeuf-kv1toparquet
+            '';
+          };
+
           oeuf-bundleparquet = stdenv.mkDerivation {
             name = "oeuf-bundleparquet";
             src = ./.;
@@ -84,7 +101,7 @@
             src = ./.;
 
             nativeBuildInputs = with pkgs; [ gcc13 ];
-            buildInputs = with pkgs; [ oeuf-libtmi8 boostPkg ];
+            buildInputs = with pkgs; [ oeuf-libtmi8 boostPkg nlohmann_json ];
             buildPhase = ''
               cd src/querykv1
               make querykv1
@@ -125,6 +142,7 @@
           packages.oeuf-synckv6 = oeuf-synckv6;
           packages.oeuf-filterkv6 = oeuf-filterkv6;
           packages.oeuf-bundleparquet = oeuf-bundleparquet;
+          packages.oeuf-kv1toparquet = oeuf-kv1toparquet;
           packages.oeuf-querykv1 = oeuf-querykv1;
           packages.oeuf-recvkv6 = oeuf-recvkv6;
 
@@ -0,0 +1,168 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#ifndef OEUF_LIBTMI8_KV1_COLUMNS_HPP
+#define OEUF_LIBTMI8_KV1_COLUMNS_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <tmi8/kv1_types.hpp>
+
+// Columnar (structure of arrays) copies of the largest KV1 tables, for scans
+// that only look at a few fields of every record. Entry i of every column of a
+// table belongs to record i of the respective table in Kv1Records.
+//
+// Strings are interned, enumerations are single bytes, times and durations
+// are whole seconds, and references to other records are row numbers in the
+// respective tables of Kv1Records. Free-text descriptions are left out. Once
+// built, the columns do not refer to the records, so the bulk tables of the
+// records can be cleared to save memory. The columns of a single table can
+// also be built on their own, for scans that only need that table; either way,
+// the records should have been linked by kv1LinkRecords().
+
+// Row number that stands for a null reference
+constexpr uint32_t KV1_NO_ROW = UINT32_MAX;
+// Stands for an absent time or duration
+constexpr int32_t KV1_NO_TIME = INT32_MIN;
+// Stands for an absent color; present colors are stored as 0xRRGGBB
+constexpr uint32_t KV1_NO_COLOR = UINT32_MAX;
+// Stands for an absent value of an enumeration
+constexpr uint8_t KV1_NO_ENUM = UINT8_MAX;
+
+struct Kv1PublicJourneyPassingTimesColumns {
+  Kv1PublicJourneyPassingTimesColumns() = default;
+  explicit Kv1PublicJourneyPassingTimesColumns(const Kv1Records &records);
+
+  std::vector<Kv1Symbol> data_owner_code;
+  std::vector<Kv1Symbol> organizational_unit_code;
+  std::vector<Kv1Symbol> schedule_code;
+  std::vector<Kv1Symbol> schedule_type_code;
+  std::vector<Kv1Symbol> line_planning_number;
+  std::vector<int32_t>   journey_number;
+  std::vector<int16_t>   stop_order;
+  std::vector<Kv1Symbol> journey_pattern_code;
+  std::vector<Kv1Symbol> user_stop_code;
+  // Seconds since midnight, or KV1_NO_TIME
+  std::vector<int32_t>   target_arrival_time_s;
+  std::vector<int32_t>   target_departure_time_s;
+  std::vector<Kv1WheelchairAccessibility> wheelchair_accessible;
+  std::vector<uint8_t>   data_owner_is_operator;
+  std::vector<uint8_t>   planned_monitored;
+  // -1 if absent
+  std::vector<int16_t>   product_formula_type;
+  // Kv1ShowFlexibleTrip, or KV1_NO_ENUM if absent
+  std::vector<uint8_t>   show_flexible_trip;
+
+  std::vector<uint32_t>  organizational_unit_row;
+  std::vector<uint32_t>  schedule_version_row;
+  std::vector<uint32_t>  line_row;
+  std::vector<uint32_t>  journey_pattern_row;
+  std::vector<uint32_t>  user_stop_row;
+
+  size_t size() const { return journey_number.size(); }
+};
+
+struct Kv1JourneyPatternTimingLinkColumns {
+  Kv1JourneyPatternTimingLinkColumns() = default;
+  explicit Kv1JourneyPatternTimingLinkColumns(const Kv1Records &records);
+
+  std::vector<Kv1Symbol> data_owner_code;
+  std::vector<Kv1Symbol> line_planning_number;
+  std::vector<Kv1Symbol> journey_pattern_code;
+  std::vector<int16_t>   timing_link_order;
+  std::vector<Kv1Symbol> user_stop_code_begin;
+  std::vector<Kv1Symbol> user_stop_code_end;
+  std::vector<Kv1Symbol> con_fin_rel_code;
+  std::vector<Kv1Symbol> dest_code;
+  std::vector<uint8_t>   is_timing_stop;
+  std::vector<Kv1Symbol> display_public_line;
+  // -1 if absent
+  std::vector<int16_t>   product_formula_type;
+  std::vector<uint8_t>   get_in;
+  std::vector<uint8_t>   get_out;
+  // Kv1ShowFlexibleTrip, or KV1_NO_ENUM if absent
+  std::vector<uint8_t>   show_flexible_trip;
+  // -1 if absent
+  std::vector<int16_t>   line_dest_icon;
+  // 0xRRGGBB, or KV1_NO_COLOR
+  std::vector<uint32_t>  line_dest_color;
+  std::vector<uint32_t>  line_dest_text_color;
+
+  std::vector<uint32_t>  line_row;
+  std::vector<uint32_t>  journey_pattern_row;
+  std::vector<uint32_t>  user_stop_begin_row;
+  std::vector<uint32_t>  user_stop_end_row;
+  std::vector<uint32_t>  con_fin_rel_row;
+  std::vector<uint32_t>  dest_row;
+  std::vector<uint32_t>  line_dest_icon_row;
+
+  size_t size() const { return timing_link_order.size(); }
+};
+
+struct Kv1PointOnLinkColumns {
+  Kv1PointOnLinkColumns() = default;
+  explicit Kv1PointOnLinkColumns(const Kv1Records &records);
+
+  std::vector<Kv1Symbol> data_owner_code;
+  std::vector<Kv1Symbol> user_stop_code_begin;
+  std::vector<Kv1Symbol> user_stop_code_end;
+  std::vector<Kv1Symbol> point_data_owner_code;
+  std::vector<Kv1Symbol> point_code;
+  std::vector<Kv1Symbol> transport_type;
+  std::vector<double>    distance_since_start_of_link;
+  // NaN if absent
+  std::vector<double>    segment_speed_mps;
+  std::vector<double>    local_point_speed_mps;
+
+  std::vector<uint32_t>  user_stop_begin_row;
+  std::vector<uint32_t>  user_stop_end_row;
+  std::vector<uint32_t>  point_row;
+
+  size_t size() const { return distance_since_start_of_link.size(); }
+};
+
+struct Kv1TimeDemandGroupRunTimeColumns {
+  Kv1TimeDemandGroupRunTimeColumns() = default;
+  explicit Kv1TimeDemandGroupRunTimeColumns(const Kv1Records &records);
+
+  std::vector<Kv1Symbol> data_owner_code;
+  std::vector<Kv1Symbol> line_planning_number;
+  std::vector<Kv1Symbol> journey_pattern_code;
+  std::vector<Kv1Symbol> time_demand_group_code;
+  std::vector<int16_t>   timing_link_order;
+  std::vector<Kv1Symbol> user_stop_code_begin;
+  std::vector<Kv1Symbol> user_stop_code_end;
+  // In seconds; the optional ones are KV1_NO_TIME if absent
+  std::vector<int32_t>   total_drive_time_s;
+  std::vector<int32_t>   drive_time_s;
+  std::vector<int32_t>   expected_delay_s;
+  std::vector<int32_t>   layover_time_s;
+  std::vector<int32_t>   stop_wait_time_s;
+  std::vector<int32_t>   minimum_stop_time_s;
+
+  std::vector<uint32_t>  line_row;
+  std::vector<uint32_t>  user_stop_begin_row;
+  std::vector<uint32_t>  user_stop_end_row;
+  std::vector<uint32_t>  journey_pattern_row;
+  std::vector<uint32_t>  time_demand_group_row;
+  std::vector<uint32_t>  journey_pattern_timing_link_row;
+
+  size_t size() const { return timing_link_order.size(); }
+};
+
+struct Kv1Columns {
+  // The records should have been linked by kv1LinkRecords().
+  explicit Kv1Columns(const Kv1Records &records);
+
+  Kv1PublicJourneyPassingTimesColumns public_journey_passing_times;
+  Kv1JourneyPatternTimingLinkColumns  journey_pattern_timing_links;
+  Kv1PointOnLinkColumns               point_on_links;
+  Kv1TimeDemandGroupRunTimeColumns    time_demand_group_run_times;
+
+  // In bytes
+  size_t memoryUsage() const;
+};
+
+#endif // OEUF_LIBTMI8_KV1_COLUMNS_HPP
@@ -0,0 +1,64 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#ifndef OEUF_LIBTMI8_KV1_DIFF_HPP
+#define OEUF_LIBTMI8_KV1_DIFF_HPP
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <tmi8/kv1_fields.hpp>
+#include <tmi8/kv1_index.hpp>
+#include <tmi8/kv1_types.hpp>
+
+// How the records of a table differ between an old and a new version of the
+// KV1 data. Records are matched by key, and a matched record has changed if
+// any of its other fields differs. References to other records (the p_*
+// fields) are not compared, because they follow from the keys. Notice
+// assignments have no key, so they are matched on all of their fields, and
+// are only ever added or removed.
+struct Kv1TableDiff {
+  // Rows in the new table of records that are not in the old table
+  std::vector<size_t> added;
+  // Rows in the old table of records that are not in the new table
+  std::vector<size_t> removed;
+  // Rows in the old and in the new table of records that have changed
+  std::vector<std::pair<size_t, size_t>> changed;
+
+  size_t size() const { return added.size() + removed.size() + changed.size(); }
+};
+
+struct Kv1Diff {
+#define X(type, table) Kv1TableDiff table;
+  KV1_TABLES
+#undef X
+
+  // Total number of added, removed and changed records
+  size_t size() const;
+};
+
+// Compares the records of old_index with new_records, of which the keys are
+// looked up in old_index. The new records need not be indexed or linked.
+Kv1Diff kv1Diff(const Kv1Index &old_index, const Kv1Records &new_records);
+
+// Applies diff, made by kv1Diff(index, new_records), to the index and its
+// records, taking the added and changed records from new_records. Afterwards
+// the index holds the same records as new_records, indexed and linked, though
+// not necessarily in the same order: removed records are left out, changed
+// records are updated in place, and added records go to the end of their
+// tables.
+//
+// Only what is affected by the diff is updated. Tables to which no records
+// were added or from which none were removed are not moved, so pointers to
+// their records stay valid, and their index tables are not built again.
+// Records are only linked again if they were added or changed, or if they
+// refer to a table of which records were added or removed. The secondary
+// indexes are dropped, and anything else derived from the records (e.g.
+// Kv1Columns) has to be made again.
+//
+// Nothing may use the index or its records while the diff is applied.
+void kv1ApplyDiff(Kv1Index &index, Kv1Records &&new_records, const Kv1Diff &diff);
+
+#endif // OEUF_LIBTMI8_KV1_DIFF_HPP
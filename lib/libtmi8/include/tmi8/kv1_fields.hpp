@@ -0,0 +1,497 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#ifndef OEUF_LIBTMI8_KV1_FIELDS_HPP
+#define OEUF_LIBTMI8_KV1_FIELDS_HPP
+
+#include <concepts>
+#include <cstddef>
+#include <type_traits>
+
+#include <tmi8/kv1_types.hpp>
+
+// All tables that are indexed in Kv1Index, by record type and by name in
+// Kv1Records (and Kv1Index).
+#define KV1_INDEXED_TABLES \
+  X(Kv1OrganizationalUnit,         organizational_units) \
+  X(Kv1HigherOrganizationalUnit,   higher_organizational_units) \
+  X(Kv1UserStopPoint,              user_stop_points) \
+  X(Kv1UserStopArea,               user_stop_areas) \
+  X(Kv1TimingLink,                 timing_links) \
+  X(Kv1Link,                       links) \
+  X(Kv1Line,                       lines) \
+  X(Kv1Destination,                destinations) \
+  X(Kv1JourneyPattern,             journey_patterns) \
+  X(Kv1ConcessionFinancerRelation, concession_financer_relations) \
+  X(Kv1ConcessionArea,             concession_areas) \
+  X(Kv1Financer,                   financers) \
+  X(Kv1JourneyPatternTimingLink,   journey_pattern_timing_links) \
+  X(Kv1Point,                      points) \
+  X(Kv1PointOnLink,                point_on_links) \
+  X(Kv1Icon,                       icons) \
+  X(Kv1Notice,                     notices) \
+  X(Kv1TimeDemandGroup,            time_demand_groups) \
+  X(Kv1TimeDemandGroupRunTime,     time_demand_group_run_times) \
+  X(Kv1PeriodGroup,                period_groups) \
+  X(Kv1SpecificDay,                specific_days) \
+  X(Kv1TimetableVersion,           timetable_versions) \
+  X(Kv1PublicJourney,              public_journeys) \
+  X(Kv1PeriodGroupValidity,        period_group_validities) \
+  X(Kv1ExceptionalOperatingDay,    exceptional_operating_days) \
+  X(Kv1ScheduleVersion,            schedule_versions) \
+  X(Kv1PublicJourneyPassingTimes,  public_journey_passing_times) \
+  X(Kv1OperatingDay,               operating_days)
+
+// All tables. Notice assignments are the only records without a key, and so
+// the only ones that are not indexed.
+#define KV1_TABLES \
+  KV1_INDEXED_TABLES \
+  X(Kv1NoticeAssignment,           notice_assignments)
+
+#define X(type, table) +1
+constexpr size_t KV1_N_TABLES = 0 KV1_TABLES;
+#undef X
+
+// The position of the table of records of type T in KV1_TABLES
+template<typename T>
+constexpr size_t kv1TableNumber() {
+  size_t i = 0, number = 0;
+#define X(type, table) if (std::is_same_v<T, type>) number = i; i++;
+  KV1_TABLES
+#undef X
+  return number;
+}
+
+// Converts to an empty value of any type that has one, such that the key of
+// a record can be made without knowing the types of its fields.
+struct Kv1Blank {
+  template<typename T> requires std::is_default_constructible_v<T>
+  operator T() const { return T{}; }
+};
+
+template<typename Key, typename... Blanks>
+Key kv1EmptyKey(Blanks... blanks) {
+  if constexpr (std::is_constructible_v<Key, Blanks...>) return Key(blanks...);
+  else return kv1EmptyKey<Key>(blanks..., Kv1Blank{});
+}
+
+// A record of which all fields are empty, e.g. to be read into, or to find
+// out the types of the fields with kv1Fields()
+template<typename T>
+T kv1EmptyRecord() {
+  if constexpr (requires { typename T::Key; }) return T{ kv1EmptyKey<typename T::Key>() };
+  else return T{};
+}
+
+// kv1Fields(io, record) calls io(name, field) for every field of the record,
+// always in the same order: first the fields of the key, then the other
+// fields, and then the references to other records (the p_* fields). The name
+// is that of the member, without "key."; Parquet files use it as the column
+// name.
+// This is for code that treats all fields alike, such as snapshots, diffs and
+// Parquet files.
+
+// A record of type T that may or may not be const, such that the same field
+// list can be used for reading and writing records.
+template<typename R, typename T>
+concept Kv1RecordOf = std::same_as<std::remove_const_t<R>, T>;
+
+template<typename Io, Kv1RecordOf<Kv1OrganizationalUnit> R>
+void kv1Fields(Io &io, R &orun) {
+  io("data_owner_code", orun.key.data_owner_code);
+  io("organizational_unit_code", orun.key.organizational_unit_code);
+  io("name", orun.name);
+  io("organizational_unit_type", orun.organizational_unit_type);
+  io("description", orun.description);
+}
+
+template<typename Io, Kv1RecordOf<Kv1HigherOrganizationalUnit> R>
+void kv1Fields(Io &io, R &orunorun) {
+  io("data_owner_code", orunorun.key.data_owner_code);
+  io("organizational_unit_code_parent", orunorun.key.organizational_unit_code_parent);
+  io("organizational_unit_code_child", orunorun.key.organizational_unit_code_child);
+  io("valid_from", orunorun.key.valid_from);
+  io("p_organizational_unit_parent", orunorun.p_organizational_unit_parent);
+  io("p_organizational_unit_child", orunorun.p_organizational_unit_child);
+}
+
+template<typename Io, Kv1RecordOf<Kv1UserStopPoint> R>
+void kv1Fields(Io &io, R &usrstop) {
+  io("data_owner_code", usrstop.key.data_owner_code);
+  io("user_stop_code", usrstop.key.user_stop_code);
+  io("timing_point_code", usrstop.timing_point_code);
+  io("get_in", usrstop.get_in);
+  io("get_out", usrstop.get_out);
+  io("name", usrstop.name);
+  io("town", usrstop.town);
+  io("user_stop_area_code", usrstop.user_stop_area_code);
+  io("stop_side_code", usrstop.stop_side_code);
+  io("minimal_stop_time_s", usrstop.minimal_stop_time_s);
+  io("stop_side_length", usrstop.stop_side_length);
+  io("description", usrstop.description);
+  io("user_stop_type", usrstop.user_stop_type);
+  io("quay_code", usrstop.quay_code);
+  io("p_user_stop_area", usrstop.p_user_stop_area);
+  io("p_point", usrstop.p_point);
+}
+
+template<typename Io, Kv1RecordOf<Kv1UserStopArea> R>
+void kv1Fields(Io &io, R &usrstar) {
+  io("data_owner_code", usrstar.key.data_owner_code);
+  io("user_stop_area_code", usrstar.key.user_stop_area_code);
+  io("name", usrstar.name);
+  io("town", usrstar.town);
+  io("description", usrstar.description);
+}
+
+template<typename Io, Kv1RecordOf<Kv1TimingLink> R>
+void kv1Fields(Io &io, R &tili) {
+  io("data_owner_code", tili.key.data_owner_code);
+  io("user_stop_code_begin", tili.key.user_stop_code_begin);
+  io("user_stop_code_end", tili.key.user_stop_code_end);
+  io("minimal_drive_time_s", tili.minimal_drive_time_s);
+  io("description", tili.description);
+  io("p_user_stop_begin", tili.p_user_stop_begin);
+  io("p_user_stop_end", tili.p_user_stop_end);
+}
+
+template<typename Io, Kv1RecordOf<Kv1Link> R>
+void kv1Fields(Io &io, R &link) {
+  io("data_owner_code", link.key.data_owner_code);
+  io("user_stop_code_begin", link.key.user_stop_code_begin);
+  io("user_stop_code_end", link.key.user_stop_code_end);
+  io("transport_type", link.key.transport_type);
+  io("distance", link.distance);
+  io("description", link.description);
+  io("p_user_stop_begin", link.p_user_stop_begin);
+  io("p_user_stop_end", link.p_user_stop_end);
+}
+
+template<typename Io, Kv1RecordOf<Kv1Line> R>
+void kv1Fields(Io &io, R &line) {
+  io("data_owner_code", line.key.data_owner_code);
+  io("line_planning_number", line.key.line_planning_number);
+  io("line_public_number", line.line_public_number);
+  io("line_name", line.line_name);
+  io("line_ve_tag_number", line.line_ve_tag_number);
+  io("description", line.description);
+  io("transport_type", line.transport_type);
+  io("line_icon", line.line_icon);
+  io("line_color", line.line_color);
+  io("line_text_color", line.line_text_color);
+  io("p_line_icon", line.p_line_icon);
+}
+
+template<typename Io, Kv1RecordOf<Kv1Destination> R>
+void kv1Fields(Io &io, R &dest) {
+  io("data_owner_code", dest.key.data_owner_code);
+  io("dest_code", dest.key.dest_code);
+  io("dest_name_full", dest.dest_name_full);
+  io("dest_name_main", dest.dest_name_main);
+  io("dest_name_detail", dest.dest_name_detail);
+  io("relevant_dest_name_detail", dest.relevant_dest_name_detail);
+  io("dest_name_main_21", dest.dest_name_main_21);
+  io("dest_name_detail_21", dest.dest_name_detail_21);
+  io("dest_name_main_19", dest.dest_name_main_19);
+  io("dest_name_detail_19", dest.dest_name_detail_19);
+  io("dest_name_main_16", dest.dest_name_main_16);
+  io("dest_name_detail_16", dest.dest_name_detail_16);
+  io("dest_icon", dest.dest_icon);
+  io("dest_color", dest.dest_color);
+  io("dest_text_color", dest.dest_text_color);
+}
+
+template<typename Io, Kv1RecordOf<Kv1JourneyPattern> R>
+void kv1Fields(Io &io, R &jopa) {
+  io("data_owner_code", jopa.key.data_owner_code);
+  io("line_planning_number", jopa.key.line_planning_number);
+  io("journey_pattern_code", jopa.key.journey_pattern_code);
+  io("journey_pattern_type", jopa.journey_pattern_type);
+  io("direction", jopa.direction);
+  io("description", jopa.description);
+  io("p_line", jopa.p_line);
+}
+
+template<typename Io, Kv1RecordOf<Kv1ConcessionFinancerRelation> R>
+void kv1Fields(Io &io, R &confinrel) {
+  io("data_owner_code", confinrel.key.data_owner_code);
+  io("con_fin_rel_code", confinrel.key.con_fin_rel_code);
+  io("concession_area_code", confinrel.concession_area_code);
+  io("financer_code", confinrel.financer_code);
+  io("p_concession_area", confinrel.p_concession_area);
+  io("p_financer", confinrel.p_financer);
+}
+
+template<typename Io, Kv1RecordOf<Kv1ConcessionArea> R>
+void kv1Fields(Io &io, R &conarea) {
+  io("data_owner_code", conarea.key.data_owner_code);
+  io("concession_area_code", conarea.key.concession_area_code);
+  io("description", conarea.description);
+}
+
+template<typename Io, Kv1RecordOf<Kv1Financer> R>
+void kv1Fields(Io &io, R &financer) {
+  io("data_owner_code", financer.key.data_owner_code);
+  io("financer_code", financer.key.financer_code);
+  io("description", financer.description);
+}
+
+template<typename Io, Kv1RecordOf<Kv1JourneyPatternTimingLink> R>
+void kv1Fields(Io &io, R &jopatili) {
+  io("data_owner_code", jopatili.key.data_owner_code);
+  io("line_planning_number", jopatili.key.line_planning_number);
+  io("journey_pattern_code", jopatili.key.journey_pattern_code);
+  io("timing_link_order", jopatili.key.timing_link_order);
+  io("user_stop_code_begin", jopatili.user_stop_code_begin);
+  io("user_stop_code_end", jopatili.user_stop_code_end);
+  io("con_fin_rel_code", jopatili.con_fin_rel_code);
+  io("dest_code", jopatili.dest_code);
+  io("is_timing_stop", jopatili.is_timing_stop);
+  io("display_public_line", jopatili.display_public_line);
+  io("product_formula_type", jopatili.product_formula_type);
+  io("get_in", jopatili.get_in);
+  io("get_out", jopatili.get_out);
+  io("show_flexible_trip", jopatili.show_flexible_trip);
+  io("line_dest_icon", jopatili.line_dest_icon);
+  io("line_dest_color", jopatili.line_dest_color);
+  io("line_dest_text_color", jopatili.line_dest_text_color);
+  io("p_line", jopatili.p_line);
+  io("p_journey_pattern", jopatili.p_journey_pattern);
+  io("p_user_stop_begin", jopatili.p_user_stop_begin);
+  io("p_user_stop_end", jopatili.p_user_stop_end);
+  io("p_con_fin_rel", jopatili.p_con_fin_rel);
+  io("p_dest", jopatili.p_dest);
+  io("p_line_dest_icon", jopatili.p_line_dest_icon);
+}
+
+template<typename Io, Kv1RecordOf<Kv1Point> R>
+void kv1Fields(Io &io, R &point) {
+  io("data_owner_code", point.key.data_owner_code);
+  io("point_code", point.key.point_code);
+  io("point_type", point.point_type);
+  io("coordinate_system_type", point.coordinate_system_type);
+  io("location_x_ew", point.location_x_ew);
+  io("location_y_ns", point.location_y_ns);
+  io("location_z", point.location_z);
+  io("description", point.description);
+}
+
+template<typename Io, Kv1RecordOf<Kv1PointOnLink> R>
+void kv1Fields(Io &io, R &pool) {
+  io("data_owner_code", pool.key.data_owner_code);
+  io("user_stop_code_begin", pool.key.user_stop_code_begin);
+  io("user_stop_code_end", pool.key.user_stop_code_end);
+  io("point_data_owner_code", pool.key.point_data_owner_code);
+  io("point_code", pool.key.point_code);
+  io("transport_type", pool.key.transport_type);
+  io("distance_since_start_of_link", pool.distance_since_start_of_link);
+  io("segment_speed_mps", pool.segment_speed_mps);
+  io("local_point_speed_mps", pool.local_point_speed_mps);
+  io("description", pool.description);
+  io("p_user_stop_begin", pool.p_user_stop_begin);
+  io("p_user_stop_end", pool.p_user_stop_end);
+  io("p_point", pool.p_point);
+}
+
+template<typename Io, Kv1RecordOf<Kv1Icon> R>
+void kv1Fields(Io &io, R &icon) {
+  io("data_owner_code", icon.key.data_owner_code);
+  io("icon_number", icon.key.icon_number);
+  io("icon_uri", icon.icon_uri);
+}
+
+template<typename Io, Kv1RecordOf<Kv1Notice> R>
+void kv1Fields(Io &io, R &notice) {
+  io("data_owner_code", notice.key.data_owner_code);
+  io("notice_code", notice.key.notice_code);
+  io("notice_content", notice.notice_content);
+}
+
+template<typename Io, Kv1RecordOf<Kv1NoticeAssignment> R>
+void kv1Fields(Io &io, R &ntcassgnm) {
+  io("data_owner_code", ntcassgnm.data_owner_code);
+  io("notice_code", ntcassgnm.notice_code);
+  io("assigned_object", ntcassgnm.assigned_object);
+  io("timetable_version_code", ntcassgnm.timetable_version_code);
+  io("organizational_unit_code", ntcassgnm.organizational_unit_code);
+  io("schedule_code", ntcassgnm.schedule_code);
+  io("schedule_type_code", ntcassgnm.schedule_type_code);
+  io("period_group_code", ntcassgnm.period_group_code);
+  io("specific_day_code", ntcassgnm.specific_day_code);
+  io("day_type", ntcassgnm.day_type);
+  io("line_planning_number", ntcassgnm.line_planning_number);
+  io("journey_number", ntcassgnm.journey_number);
+  io("stop_order", ntcassgnm.stop_order);
+  io("journey_pattern_code", ntcassgnm.journey_pattern_code);
+  io("timing_link_order", ntcassgnm.timing_link_order);
+  io("user_stop_code", ntcassgnm.user_stop_code);
+  io("p_notice", ntcassgnm.p_notice);
+}
+
+template<typename Io, Kv1RecordOf<Kv1TimeDemandGroup> R>
+void kv1Fields(Io &io, R &timdemgrp) {
+  io("data_owner_code", timdemgrp.key.data_owner_code);
+  io("line_planning_number", timdemgrp.key.line_planning_number);
+  io("journey_pattern_code", timdemgrp.key.journey_pattern_code);
+  io("time_demand_group_code", timdemgrp.key.time_demand_group_code);
+  io("p_line", timdemgrp.p_line);
+  io("p_journey_pattern", timdemgrp.p_journey_pattern);
+}
+
+template<typename Io, Kv1RecordOf<Kv1TimeDemandGroupRunTime> R>
+void kv1Fields(Io &io, R &timdemrnt) {
+  io("data_owner_code", timdemrnt.key.data_owner_code);
+  io("line_planning_number", timdemrnt.key.line_planning_number);
+  io("journey_pattern_code", timdemrnt.key.journey_pattern_code);
+  io("time_demand_group_code", timdemrnt.key.time_demand_group_code);
+  io("timing_link_order", timdemrnt.key.timing_link_order);
+  io("user_stop_code_begin", timdemrnt.user_stop_code_begin);
+  io("user_stop_code_end", timdemrnt.user_stop_code_end);
+  io("total_drive_time_s", timdemrnt.total_drive_time_s);
+  io("drive_time_s", timdemrnt.drive_time_s);
+  io("expected_delay_s", timdemrnt.expected_delay_s);
+  io("layover_time", timdemrnt.layover_time);
+  io("stop_wait_time", timdemrnt.stop_wait_time);
+  io("minimum_stop_time", timdemrnt.minimum_stop_time);
+  io("p_line", timdemrnt.p_line);
+  io("p_user_stop_begin", timdemrnt.p_user_stop_begin);
+  io("p_user_stop_end", timdemrnt.p_user_stop_end);
+  io("p_journey_pattern", timdemrnt.p_journey_pattern);
+  io("p_time_demand_group", timdemrnt.p_time_demand_group);
+  io("p_journey_pattern_timing_link", timdemrnt.p_journey_pattern_timing_link);
+}
+
+template<typename Io, Kv1RecordOf<Kv1PeriodGroup> R>
+void kv1Fields(Io &io, R &pegr) {
+  io("data_owner_code", pegr.key.data_owner_code);
+  io("period_group_code", pegr.key.period_group_code);
+  io("description", pegr.description);
+}
+
+template<typename Io, Kv1RecordOf<Kv1SpecificDay> R>
+void kv1Fields(Io &io, R &specday) {
+  io("data_owner_code", specday.key.data_owner_code);
+  io("specific_day_code", specday.key.specific_day_code);
+  io("name", specday.name);
+  io("description", specday.description);
+}
+
+template<typename Io, Kv1RecordOf<Kv1TimetableVersion> R>
+void kv1Fields(Io &io, R &tive) {
+  io("data_owner_code", tive.key.data_owner_code);
+  io("organizational_unit_code", tive.key.organizational_unit_code);
+  io("timetable_version_code", tive.key.timetable_version_code);
+  io("period_group_code", tive.key.period_group_code);
+  io("specific_day_code", tive.key.specific_day_code);
+  io("valid_from", tive.valid_from);
+  io("timetable_version_type", tive.timetable_version_type);
+  io("valid_thru", tive.valid_thru);
+  io("description", tive.description);
+  io("p_organizational_unit", tive.p_organizational_unit);
+  io("p_period_group", tive.p_period_group);
+  io("p_specific_day", tive.p_specific_day);
+}
+
+template<typename Io, Kv1RecordOf<Kv1PublicJourney> R>
+void kv1Fields(Io &io, R &pujo) {
+  io("data_owner_code", pujo.key.data_owner_code);
+  io("timetable_version_code", pujo.key.timetable_version_code);
+  io("organizational_unit_code", pujo.key.organizational_unit_code);
+  io("period_group_code", pujo.key.period_group_code);
+  io("specific_day_code", pujo.key.specific_day_code);
+  io("day_type", pujo.key.day_type);
+  io("line_planning_number", pujo.key.line_planning_number);
+  io("journey_number", pujo.key.journey_number);
+  io("time_demand_group_code", pujo.time_demand_group_code);
+  io("journey_pattern_code", pujo.journey_pattern_code);
+  io("departure_time", pujo.departure_time);
+  io("wheelchair_accessible", pujo.wheelchair_accessible);
+  io("data_owner_is_operator", pujo.data_owner_is_operator);
+  io("planned_monitored", pujo.planned_monitored);
+  io("product_formula_type", pujo.product_formula_type);
+  io("show_flexible_trip", pujo.show_flexible_trip);
+  io("p_timetable_version", pujo.p_timetable_version);
+  io("p_organizational_unit", pujo.p_organizational_unit);
+  io("p_period_group", pujo.p_period_group);
+  io("p_specific_day", pujo.p_specific_day);
+  io("p_line", pujo.p_line);
+  io("p_time_demand_group", pujo.p_time_demand_group);
+  io("p_journey_pattern", pujo.p_journey_pattern);
+}
+
+template<typename Io, Kv1RecordOf<Kv1PeriodGroupValidity> R>
+void kv1Fields(Io &io, R &pegrval) {
+  io("data_owner_code", pegrval.key.data_owner_code);
+  io("organizational_unit_code", pegrval.key.organizational_unit_code);
+  io("period_group_code", pegrval.key.period_group_code);
+  io("valid_from", pegrval.key.valid_from);
+  io("valid_thru", pegrval.valid_thru);
+  io("p_organizational_unit", pegrval.p_organizational_unit);
+  io("p_period_group", pegrval.p_period_group);
+}
+
+template<typename Io, Kv1RecordOf<Kv1ExceptionalOperatingDay> R>
+void kv1Fields(Io &io, R &excopday) {
+  io("data_owner_code", excopday.key.data_owner_code);
+  io("organizational_unit_code", excopday.key.organizational_unit_code);
+  io("valid_date", excopday.key.valid_date);
+  io("day_type_as_on", excopday.day_type_as_on);
+  io("specific_day_code", excopday.specific_day_code);
+  io("period_group_code", excopday.period_group_code);
+  io("description", excopday.description);
+  io("p_organizational_unit", excopday.p_organizational_unit);
+  io("p_specific_day", excopday.p_specific_day);
+  io("p_period_group", excopday.p_period_group);
+}
+
+template<typename Io, Kv1RecordOf<Kv1ScheduleVersion> R>
+void kv1Fields(Io &io, R &schedvers) {
+  io("data_owner_code", schedvers.key.data_owner_code);
+  io("organizational_unit_code", schedvers.key.organizational_unit_code);
+  io("schedule_code", schedvers.key.schedule_code);
+  io("schedule_type_code", schedvers.key.schedule_type_code);
+  io("valid_from", schedvers.valid_from);
+  io("valid_thru", schedvers.valid_thru);
+  io("description", schedvers.description);
+  io("p_organizational_unit", schedvers.p_organizational_unit);
+}
+
+template<typename Io, Kv1RecordOf<Kv1PublicJourneyPassingTimes> R>
+void kv1Fields(Io &io, R &pujopass) {
+  io("data_owner_code", pujopass.key.data_owner_code);
+  io("organizational_unit_code", pujopass.key.organizational_unit_code);
+  io("schedule_code", pujopass.key.schedule_code);
+  io("schedule_type_code", pujopass.key.schedule_type_code);
+  io("line_planning_number", pujopass.key.line_planning_number);
+  io("journey_number", pujopass.key.journey_number);
+  io("stop_order", pujopass.key.stop_order);
+  io("journey_pattern_code", pujopass.journey_pattern_code);
+  io("user_stop_code", pujopass.user_stop_code);
+  io("target_arrival_time", pujopass.target_arrival_time);
+  io("target_departure_time", pujopass.target_departure_time);
+  io("wheelchair_accessible", pujopass.wheelchair_accessible);
+  io("data_owner_is_operator", pujopass.data_owner_is_operator);
+  io("planned_monitored", pujopass.planned_monitored);
+  io("product_formula_type", pujopass.product_formula_type);
+  io("show_flexible_trip", pujopass.show_flexible_trip);
+  io("p_organizational_unit", pujopass.p_organizational_unit);
+  io("p_schedule_version", pujopass.p_schedule_version);
+  io("p_line", pujopass.p_line);
+  io("p_journey_pattern", pujopass.p_journey_pattern);
+  io("p_user_stop", pujopass.p_user_stop);
+}
+
+template<typename Io, Kv1RecordOf<Kv1OperatingDay> R>
+void kv1Fields(Io &io, R &operday) {
+  io("data_owner_code", operday.key.data_owner_code);
+  io("organizational_unit_code", operday.key.organizational_unit_code);
+  io("schedule_code", operday.key.schedule_code);
+  io("schedule_type_code", operday.key.schedule_type_code);
+  io("valid_date", operday.key.valid_date);
+  io("description", operday.description);
+  io("p_organizational_unit", operday.p_organizational_unit);
+  io("p_schedule_version", operday.p_schedule_version);
+}
+
+#endif // OEUF_LIBTMI8_KV1_FIELDS_HPP
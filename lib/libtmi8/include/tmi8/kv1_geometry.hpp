@@ -0,0 +1,54 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#ifndef OEUF_LIBTMI8_KV1_GEOMETRY_HPP
+#define OEUF_LIBTMI8_KV1_GEOMETRY_HPP
+
+#include <span>
+#include <vector>
+
+#include <tmi8/kv1_index.hpp>
+#include <tmi8/kv1_types.hpp>
+
+// The route of every journey pattern: the user stops that it passes (in
+// timing link order) and all points along the way (user stops and points on
+// links), each with its distance since the start of the journey. Everything is
+// stored in flat arrays, where the journey pattern records.journey_patterns[i]
+// owns the stops in [stop_offsets[i], stop_offsets[i + 1]) and the points in
+// [point_offsets[i], point_offsets[i + 1]).
+//
+// Must be built after kv1LinkRecords(). Points into the records, and hence
+// cannot outlive them.
+struct Kv1JourneyPatternGeometry {
+  struct Stop {
+    // The timing link starting at this stop, or (only for the last stop of the
+    // journey pattern) the timing link ending at this stop.
+    const Kv1JourneyPatternTimingLink *jopatili = nullptr;
+    const Kv1UserStopPoint *user_stop = nullptr;
+    double distance_since_start_of_journey = 0;
+  };
+
+  struct Point {
+    bool is_stop = false;
+    const Kv1JourneyPatternTimingLink *jopatili = nullptr;
+    // Null if the link is not present in the KV1 data.
+    const Kv1Link *link = nullptr;
+    const Kv1Point *point = nullptr;
+    double distance_since_start_of_link = 0;
+    double distance_since_start_of_journey = 0;
+  };
+
+  explicit Kv1JourneyPatternGeometry(const Kv1Records &records, const Kv1Index &index);
+
+  std::span<const Stop> stopsOf(const Kv1JourneyPattern *jopa) const;
+  std::span<const Point> pointsOf(const Kv1JourneyPattern *jopa) const;
+
+  const Kv1Records *records;
+  std::vector<size_t> stop_offsets;
+  std::vector<Stop>   stops;
+  std::vector<size_t> point_offsets;
+  std::vector<Point>  points;
+};
+
+#endif // OEUF_LIBTMI8_KV1_GEOMETRY_HPP
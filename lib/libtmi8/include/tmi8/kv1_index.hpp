@@ -5,133 +5,206 @@
 #ifndef OEUF_LIBTMI8_KV1_INDEX_HPP
 #define OEUF_LIBTMI8_KV1_INDEX_HPP
 
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <thread>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <boost/container_hash/hash.hpp>
 
 #include <tmi8/kv1_types.hpp>
 
+// A hash table from the keys of the records of a table to the records
+// themselves. Keys are not copied: the table only stores pointers to the
+// records, and compares the keys of those records when looking up a key.
+//
+// The layout follows Swiss tables: besides the array of slots there is an
+// array of control bytes, one per slot, holding either EMPTY or 7 bits of the
+// hash of the key in the slot. A lookup compares the control bytes of a group
+// of 8 slots at once, and only compares keys for slots of which the hash bits
+// match. Records can only be added by build(), so there are no tombstones.
+template<typename T>
+class Kv1IndexTable {
+ public:
+  using Key = typename T::Key;
+
+  // Indexes all records. Of records with the same key, the last one wins.
+  void build(std::vector<T> &records) {
+    // Keep the load factor at most 7/8, so that every probe sequence ends
+    size_t n_groups = 1;
+    while (n_groups * GROUP_SIZE * 7 < (records.size() + 1) * 8)
+      n_groups *= 2;
+    ctrl.assign(n_groups * GROUP_SIZE, EMPTY);
+    slots.assign(n_groups * GROUP_SIZE, nullptr);
+    count = 0;
+    for (T &record : records) {
+      uint64_t hash = mix(hash_value(record.key));
+      size_t i = probe(record.key, hash);
+      if (!slots[i]) {
+        ctrl[i] = static_cast<uint8_t>(hash & 0x7f);
+        count++;
+      }
+      slots[i] = &record;
+    }
+  }
+
+  // Returns nullptr if there is no record with this key.
+  T *find(const Key &key) const {
+    if (slots.empty()) return nullptr;
+    return slots[probe(key, mix(hash_value(key)))];
+  }
+
+  size_t size() const { return count; }
+  size_t memoryUsage() const { return ctrl.capacity() * sizeof(uint8_t) + slots.capacity() * sizeof(T *); }
+
+ private:
+  static constexpr size_t GROUP_SIZE = 8;
+  static constexpr uint8_t EMPTY = 0x80;
+  static constexpr uint64_t LSBS = 0x0101010101010101;
+  static constexpr uint64_t MSBS = 0x8080808080808080;
+
+  // The hashes of the keys are combined with boost::hash_combine, which does
+  // not mix the bits very well; this is the finalizer of SplitMix64.
+  static uint64_t mix(uint64_t hash) {
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111eb;
+    return hash ^ (hash >> 31);
+  }
+
+  // Returns the slot holding the record with this key, or otherwise the empty
+  // slot where it would go.
+  size_t probe(const Key &key, uint64_t hash) const {
+    const uint8_t h2 = static_cast<uint8_t>(hash & 0x7f);
+    const size_t mask = ctrl.size() / GROUP_SIZE - 1;
+    for (size_t group = (hash >> 7) & mask;; group = (group + 1) & mask) {
+      uint64_t word;
+      memcpy(&word, ctrl.data() + group * GROUP_SIZE, GROUP_SIZE);
+      if constexpr (std::endian::native == std::endian::big)
+        word = std::byteswap(word);
+      // Sets the high bit of bytes that are equal to h2, and possibly of some
+      // others, which are filtered out by checking the control byte again.
+      uint64_t x = word ^ (h2 * LSBS);
+      for (uint64_t matches = (x - LSBS) & ~x & MSBS; matches; matches &= matches - 1) {
+        size_t i = group * GROUP_SIZE + static_cast<size_t>(std::countr_zero(matches)) / 8;
+        if (ctrl[i] == h2 && slots[i]->key == key) return i;
+      }
+      if (uint64_t empty = word & MSBS)
+        return group * GROUP_SIZE + static_cast<size_t>(std::countr_zero(empty)) / 8;
+    }
+  }
+
+  std::vector<uint8_t> ctrl;
+  std::vector<T *> slots;
+  size_t count = 0;
+};
+
+// Groups records by some other key than their own. Used for the secondary
+// indexes of Kv1Index, which are only built when they are first used.
+template<typename K, typename T>
+struct Kv1MultiIndex {
+  std::once_flag built;
+  std::unordered_map<K, std::vector<T *>, boost::hash<K>> groups;
+
+  std::span<T *const> find(const K &key) const {
+    auto it = groups.find(key);
+    if (it == groups.end()) return {};
+    return it->second;
+  }
+};
+
 struct Kv1Index {
   Kv1Records *records;
 
-  explicit Kv1Index(Kv1Records *records);
-
-  std::unordered_map<
-    Kv1OrganizationalUnit::Key,
-    Kv1OrganizationalUnit *,
-    boost::hash<Kv1OrganizationalUnit::Key>> organizational_units;
-  std::unordered_map<
-    Kv1HigherOrganizationalUnit::Key,
-    Kv1HigherOrganizationalUnit *,
-    boost::hash<Kv1HigherOrganizationalUnit::Key>> higher_organizational_units;
-  std::unordered_map<
-    Kv1UserStopPoint::Key,
-    Kv1UserStopPoint *,
-    boost::hash<Kv1UserStopPoint::Key>> user_stop_points;
-  std::unordered_map<
-    Kv1UserStopArea::Key,
-    Kv1UserStopArea *,
-    boost::hash<Kv1UserStopArea::Key>> user_stop_areas;
-  std::unordered_map<
-    Kv1TimingLink::Key,
-    Kv1TimingLink *,
-    boost::hash<Kv1TimingLink::Key>> timing_links;
-  std::unordered_map<
-    Kv1Link::Key,
-    Kv1Link *,
-    boost::hash<Kv1Link::Key>> links;
-  std::unordered_map<
-    Kv1Line::Key,
-    Kv1Line *,
-    boost::hash<Kv1Line::Key>> lines;
-  std::unordered_map<
-    Kv1Destination::Key,
-    Kv1Destination *,
-    boost::hash<Kv1Destination::Key>> destinations;
-  std::unordered_map<
-    Kv1JourneyPattern::Key,
-    Kv1JourneyPattern *,
-    boost::hash<Kv1JourneyPattern::Key>> journey_patterns;
-  std::unordered_map<
-    Kv1ConcessionFinancerRelation::Key,
-    Kv1ConcessionFinancerRelation *,
-    boost::hash<Kv1ConcessionFinancerRelation::Key>> concession_financer_relations;
-  std::unordered_map<
-    Kv1ConcessionArea::Key,
-    Kv1ConcessionArea *,
-    boost::hash<Kv1ConcessionArea::Key>> concession_areas;
-  std::unordered_map<
-    Kv1Financer::Key,
-    Kv1Financer *,
-    boost::hash<Kv1Financer::Key>> financers;
-  std::unordered_map<
-    Kv1JourneyPatternTimingLink::Key,
-    Kv1JourneyPatternTimingLink *,
-    boost::hash<Kv1JourneyPatternTimingLink::Key>> journey_pattern_timing_links;
-  std::unordered_map<
-    Kv1Point::Key,
-    Kv1Point *,
-    boost::hash<Kv1Point::Key>> points;
-  std::unordered_map<
-    Kv1PointOnLink::Key,
-    Kv1PointOnLink *,
-    boost::hash<Kv1PointOnLink::Key>> point_on_links;
-  std::unordered_map<
-    Kv1Icon::Key,
-    Kv1Icon *,
-    boost::hash<Kv1Icon::Key>> icons;
-  std::unordered_map<
-    Kv1Notice::Key,
-    Kv1Notice *,
-    boost::hash<Kv1Notice::Key>> notices;
-  std::unordered_map<
-    Kv1TimeDemandGroup::Key,
-    Kv1TimeDemandGroup *,
-    boost::hash<Kv1TimeDemandGroup::Key>> time_demand_groups;
-  std::unordered_map<
-    Kv1TimeDemandGroupRunTime::Key,
-    Kv1TimeDemandGroupRunTime *,
-    boost::hash<Kv1TimeDemandGroupRunTime::Key>> time_demand_group_run_times;
-  std::unordered_map<
-    Kv1PeriodGroup::Key,
-    Kv1PeriodGroup *,
-    boost::hash<Kv1PeriodGroup::Key>> period_groups;
-  std::unordered_map<
-    Kv1SpecificDay::Key,
-    Kv1SpecificDay *,
-    boost::hash<Kv1SpecificDay::Key>> specific_days;
-  std::unordered_map<
-    Kv1TimetableVersion::Key,
-    Kv1TimetableVersion *,
-    boost::hash<Kv1TimetableVersion::Key>> timetable_versions;
-  std::unordered_map<
-    Kv1PublicJourney::Key,
-    Kv1PublicJourney *,
-    boost::hash<Kv1PublicJourney::Key>> public_journeys;
-  std::unordered_map<
-    Kv1PeriodGroupValidity::Key,
-    Kv1PeriodGroupValidity *,
-    boost::hash<Kv1PeriodGroupValidity::Key>> period_group_validities;
-  std::unordered_map<
-    Kv1ExceptionalOperatingDay::Key,
-    Kv1ExceptionalOperatingDay *,
-    boost::hash<Kv1ExceptionalOperatingDay::Key>> exceptional_operating_days;
-  std::unordered_map<
-    Kv1ScheduleVersion::Key,
-    Kv1ScheduleVersion *,
-    boost::hash<Kv1ScheduleVersion::Key>> schedule_versions;
-  std::unordered_map<
-    Kv1PublicJourneyPassingTimes::Key,
-    Kv1PublicJourneyPassingTimes *,
-    boost::hash<Kv1PublicJourneyPassingTimes::Key>> public_journey_passing_times;
-  std::unordered_map<
-    Kv1OperatingDay::Key,
-    Kv1OperatingDay *,
-    boost::hash<Kv1OperatingDay::Key>> operating_days;
+  // The tables are built on at most n_threads threads.
+  explicit Kv1Index(Kv1Records *records, unsigned n_threads = std::thread::hardware_concurrency());
+
+  Kv1IndexTable<Kv1OrganizationalUnit>         organizational_units;
+  Kv1IndexTable<Kv1HigherOrganizationalUnit>   higher_organizational_units;
+  Kv1IndexTable<Kv1UserStopPoint>              user_stop_points;
+  Kv1IndexTable<Kv1UserStopArea>               user_stop_areas;
+  Kv1IndexTable<Kv1TimingLink>                 timing_links;
+  Kv1IndexTable<Kv1Link>                       links;
+  Kv1IndexTable<Kv1Line>                       lines;
+  Kv1IndexTable<Kv1Destination>                destinations;
+  Kv1IndexTable<Kv1JourneyPattern>             journey_patterns;
+  Kv1IndexTable<Kv1ConcessionFinancerRelation> concession_financer_relations;
+  Kv1IndexTable<Kv1ConcessionArea>             concession_areas;
+  Kv1IndexTable<Kv1Financer>                   financers;
+  Kv1IndexTable<Kv1JourneyPatternTimingLink>   journey_pattern_timing_links;
+  Kv1IndexTable<Kv1Point>                      points;
+  Kv1IndexTable<Kv1PointOnLink>                point_on_links;
+  Kv1IndexTable<Kv1Icon>                       icons;
+  Kv1IndexTable<Kv1Notice>                     notices;
+  Kv1IndexTable<Kv1TimeDemandGroup>            time_demand_groups;
+  Kv1IndexTable<Kv1TimeDemandGroupRunTime>     time_demand_group_run_times;
+  Kv1IndexTable<Kv1PeriodGroup>                period_groups;
+  Kv1IndexTable<Kv1SpecificDay>                specific_days;
+  Kv1IndexTable<Kv1TimetableVersion>           timetable_versions;
+  Kv1IndexTable<Kv1PublicJourney>              public_journeys;
+  Kv1IndexTable<Kv1PeriodGroupValidity>        period_group_validities;
+  Kv1IndexTable<Kv1ExceptionalOperatingDay>    exceptional_operating_days;
+  Kv1IndexTable<Kv1ScheduleVersion>            schedule_versions;
+  Kv1IndexTable<Kv1PublicJourneyPassingTimes>  public_journey_passing_times;
+  Kv1IndexTable<Kv1OperatingDay>               operating_days;
 
   size_t size() const;
+  // In bytes
+  size_t memoryUsage() const;
+
+  // Secondary indexes. Each is built on its first use, which is safe to do
+  // from multiple threads at once.
+
+  // Public journeys with this line planning number and journey number, of any
+  // data owner.
+  std::span<Kv1PublicJourney *const> publicJourneysByNumber(Kv1Symbol line_planning_number, int journey_number) const;
+  // Timing links of the journey pattern, in timing link order.
+  std::span<Kv1JourneyPatternTimingLink *const> journeyPatternTimingLinksOf(const Kv1JourneyPattern::Key &jopa) const;
+  // Points on the link, in order of distance since the start of the link.
+  std::span<Kv1PointOnLink *const> pointOnLinksOf(const Kv1Link::Key &link) const;
+  // Run times of the time demand group, in timing link order.
+  std::span<Kv1TimeDemandGroupRunTime *const> timeDemandGroupRunTimesOf(const Kv1TimeDemandGroup::Key &timdemgrp) const;
+
+  // Drops the secondary indexes, so that they are built again on their next
+  // use. Must be called after records have been added, removed or changed,
+  // while no other thread uses the index.
+  void resetSecondaryIndexes();
+
+ private:
+  mutable Kv1MultiIndex<std::pair<Kv1Symbol, int>, Kv1PublicJourney>         public_journeys_by_number;
+  mutable Kv1MultiIndex<Kv1JourneyPattern::Key, Kv1JourneyPatternTimingLink> journey_pattern_timing_links_by_jopa;
+  mutable Kv1MultiIndex<Kv1Link::Key, Kv1PointOnLink>                        point_on_links_by_link;
+  mutable Kv1MultiIndex<Kv1TimeDemandGroup::Key, Kv1TimeDemandGroupRunTime>  time_demand_group_run_times_by_timdemgrp;
 };
 
-void kv1LinkRecords(Kv1Index &index);
+// Sets the p_* fields of all records in the index. Runs on at most n_threads
+// threads.
+void kv1LinkRecords(Kv1Index &index, unsigned n_threads = std::thread::hardware_concurrency());
+
+// Sets the p_* fields of a single record. There is an overload for every type
+// of record that refers to other records.
+void kv1LinkRecord(const Kv1Index &index, Kv1HigherOrganizationalUnit &record);
+void kv1LinkRecord(const Kv1Index &index, Kv1UserStopPoint &record);
+void kv1LinkRecord(const Kv1Index &index, Kv1TimingLink &record);
+void kv1LinkRecord(const Kv1Index &index, Kv1Link &record);
+void kv1LinkRecord(const Kv1Index &index, Kv1Line &record);
+void kv1LinkRecord(const Kv1Index &index, Kv1JourneyPattern &record);
+void kv1LinkRecord(const Kv1Index &index, Kv1ConcessionFinancerRelation &record);
+void kv1LinkRecord(const Kv1Index &index, Kv1JourneyPatternTimingLink &record);
+void kv1LinkRecord(const Kv1Index &index, Kv1PointOnLink &record);
+void kv1LinkRecord(const Kv1Index &index, Kv1NoticeAssignment &record);
+void kv1LinkRecord(const Kv1Index &index, Kv1TimeDemandGroup &record);
+void kv1LinkRecord(const Kv1Index &index, Kv1TimeDemandGroupRunTime &record);
+void kv1LinkRecord(const Kv1Index &index, Kv1TimetableVersion &record);
+void kv1LinkRecord(const Kv1Index &index, Kv1PublicJourney &record);
+void kv1LinkRecord(const Kv1Index &index, Kv1PeriodGroupValidity &record);
+void kv1LinkRecord(const Kv1Index &index, Kv1ExceptionalOperatingDay &record);
+void kv1LinkRecord(const Kv1Index &index, Kv1ScheduleVersion &record);
+void kv1LinkRecord(const Kv1Index &index, Kv1PublicJourneyPassingTimes &record);
+void kv1LinkRecord(const Kv1Index &index, Kv1OperatingDay &record);
 
 #endif // OEUF_LIBTMI8_KV1_INDEX_HPP
@@ -0,0 +1,41 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#ifndef OEUF_LIBTMI8_KV1_INPUT_HPP
+#define OEUF_LIBTMI8_KV1_INPUT_HPP
+
+#include <string>
+#include <string_view>
+
+// The contents of a KV1 file, for the lexer to consume. Regular files
+// (including standard input redirected from a file) are memory-mapped, so
+// that they can be lexed while the kernel is still reading them in. Anything
+// else, like a pipe, is read into memory.
+struct Kv1Input {
+  // Reads the file at path, or standard input if path is "-". If this fails,
+  // error describes what went wrong and data() is empty.
+  explicit Kv1Input(const char *path);
+  ~Kv1Input();
+
+  Kv1Input(const Kv1Input &) = delete;
+  Kv1Input &operator=(const Kv1Input &) = delete;
+
+  std::string_view data() const;
+  bool mapped() const;
+
+  std::string error;
+
+ private:
+  // Maps the file from offset up to file_size
+  void map(int fd, size_t offset, size_t file_size);
+  void read(int fd);
+
+  void *map_addr = nullptr;
+  size_t map_size = 0;
+  // Bytes at the start of the mapping that come before the data
+  size_t map_skip = 0;
+  std::string buffer;
+};
+
+#endif // OEUF_LIBTMI8_KV1_INPUT_HPP
@@ -7,8 +7,10 @@
 
 #include <cstdint>
 #include <cstring>
+#include <deque>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <variant>
 
@@ -16,16 +18,30 @@ enum Kv1TokenType {
   KV1_TOKEN_CELL,
   KV1_TOKEN_ROW_END,
 };
-struct Kv1Token { Kv1TokenType type; std::string data; };
+// The data of a cell points into the input of the lexer, or (for quoted cells
+// containing escaped quotes) into storage owned by the lexer. Tokens therefore
+// cannot outlive either of them.
+struct Kv1Token { Kv1TokenType type; std::string_view data; };
 
 struct Kv1Lexer {
   std::vector<std::string> errors;
   std::vector<Kv1Token> tokens;
   
-  explicit Kv1Lexer(std::string_view input);
+  // If input is not the start of a file, but starts at the beginning of some
+  // line in it, it cannot have a header.
+  explicit Kv1Lexer(std::string_view input, bool at_start_of_file = true);
 
+  // Reads the next token. Returns false at the end of the input, or when an
+  // error has occurred (which is then recorded in errors).
+  bool next(Kv1Token &token);
+  // Reads all (remaining) tokens into tokens.
   void lex();
 
+  // The (1-based) line that the lexer is at
+  size_t line() const;
+  // The line at which the row of the last cell read starts
+  size_t rowLine() const;
+
  private:
   // Does not eat newline character.
   void eatRestOfLine();
@@ -34,15 +50,31 @@ struct Kv1Lexer {
   
   static bool isWhitespace(int c);
 
-  void readQuotedColumn();
-  void readUnquotedColumn();
-  void lexRow();
+  void readQuotedColumn(Kv1Token &token);
+  void readUnquotedColumn(Kv1Token &token);
+  // Reads a cell and the delimiter following it.
+  void lexCell(Kv1Token &token);
   // Returns true when a line ending was consumed.
   bool eatWhitespace();
   
+  enum State {
+    START,
+    BETWEEN_ROWS,
+    IN_ROW,
+    // The row ended in a pipe, after which there is an empty cell
+    EMPTY_LAST_CELL,
+    // The last cell of the row has been read, the row end is next
+    ROW_DONE,
+  };
+
+  State state = START;
+  size_t line_number = 1;
+  size_t row_line_number = 1;
   std::string_view input;
   std::string_view slice;
-  std::string colbuf;
+  // Unescaped contents of quoted cells containing "". A deque never moves its
+  // elements, so tokens can safely point into the strings.
+  std::deque<std::string> unescaped;
 };
 
 #endif // OEUF_LIBTMI8_KV1_LEXER_HPP
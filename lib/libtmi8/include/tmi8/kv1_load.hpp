@@ -0,0 +1,23 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#ifndef OEUF_LIBTMI8_KV1_LOAD_HPP
+#define OEUF_LIBTMI8_KV1_LOAD_HPP
+
+#include <thread>
+
+#include <tmi8/kv1_types.hpp>
+
+// Loads the records of the KV1 snapshot at snapshot_path if it is not null,
+// and otherwise parses the KV1 file at kv1_path ('-' for standard input) on
+// n_threads threads. Progress, errors and warnings are reported on standard
+// error. Returns false if the records could not be loaded, or if the parser
+// reported errors.
+//
+// Records from a snapshot have been linked already; parsed records still
+// have to be indexed and linked.
+bool kv1Load(const char *kv1_path, const char *snapshot_path, Kv1Records &into,
+             unsigned n_threads = std::thread::hardware_concurrency());
+
+#endif // OEUF_LIBTMI8_KV1_LOAD_HPP
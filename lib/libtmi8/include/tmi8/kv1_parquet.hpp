@@ -0,0 +1,55 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#ifndef OEUF_LIBTMI8_KV1_PARQUET_HPP
+#define OEUF_LIBTMI8_KV1_PARQUET_HPP
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include <arrow/api.h>
+
+#include <tmi8/kv1_types.hpp>
+#include <tmi8/kv6_parquet.hpp>
+
+// Every KV1 table can be exported as Arrow record batches, e.g. to be written
+// to Parquet with writeArrowRecordsAsParquetFile(). Tables are named after the
+// respective members of Kv1Records (e.g. "public_journey_passing_times"), and
+// have one column per field of their records, the fields of the key coming
+// first. Columns are named after the fields too (the key being flattened), so
+// that planned data can be joined with KV6 data on e.g. data_owner_code,
+// line_planning_number and journey_number.
+//
+// References to other records (the p_* fields) are left out, because the
+// respective keys are already there. Fields are represented as follows:
+//
+//   strings, symbols  utf8
+//   enumerations      utf8, as in KV1 (e.g. "BUS")
+//   day types         utf8, as in KV1 (e.g. "1234500")
+//   RgbColor          utf8, as in KV1 (RRGGBB)
+//   char              utf8, of one character
+//   bool              bool
+//   short, int        int16, int32
+//   double            float64
+//   dates             date32
+//   date-times        timestamp[s], like the KV6 timestamps
+//   times             duration[s] since midnight, which may exceed a day
+//
+// Absent optional values are null.
+
+// Names of all tables, in the order of Kv1Records
+const std::vector<std::string_view> &kv1TableNames();
+
+// The schema of the table, or nullptr if there is no table with that name
+std::shared_ptr<arrow::Schema> kv1ArrowSchema(std::string_view table);
+
+// Reads the records of the table in batches of at most batch_size records.
+// The records must outlive the reader, and may not be modified while it is in
+// use.
+[[nodiscard]]
+arrow::Result<std::shared_ptr<arrow::RecordBatchReader>> kv1ArrowRecordBatches(
+  const Kv1Records &records, std::string_view table, int64_t batch_size = MAX_PARQUET_CHUNK);
+
+#endif // OEUF_LIBTMI8_KV1_PARQUET_HPP
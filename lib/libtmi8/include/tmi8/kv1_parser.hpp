@@ -5,18 +5,85 @@
 #ifndef OEUF_LIBTMI8_KV1_PARSER_HPP
 #define OEUF_LIBTMI8_KV1_PARSER_HPP
 
+#include <array>
+#include <concepts>
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
 #include <tmi8/kv1_lexer.hpp>
 #include <tmi8/kv1_types.hpp>
 
+enum Kv1ParseErrorCode : uint8_t {
+  KV1_ERROR_EXPECTED_CELL_GOT_EOF,
+  KV1_ERROR_EXPECTED_CELL_GOT_ROW_END,
+  KV1_ERROR_EMPTY_STRING,
+  KV1_ERROR_INVALID_UTF8,
+  KV1_ERROR_STRING_TOO_LONG,
+  KV1_ERROR_MISSING_VALUE,
+  KV1_ERROR_BAD_BOOLEAN,
+  KV1_ERROR_BAD_NUMBER,
+  KV1_ERROR_TRAILING_CHARACTERS,
+  KV1_ERROR_TOO_MANY_DIGITS,
+  KV1_ERROR_TOO_FEW_DIGITS,
+  KV1_ERROR_NOT_AN_INTEGER,
+  KV1_ERROR_BAD_RGB_COLOR,
+  KV1_ERROR_RD_COORD_TOO_LONG,
+  KV1_ERROR_NOT_IN_ENUMERATION,
+  KV1_ERROR_BAD_DAY_TYPE,
+  KV1_ERROR_BAD_VALUE,
+  KV1_ERROR_UNPARSED_FIELDS,
+  KV1_ERROR_INVALID,
+  KV1_WARNING_UNKNOWN_RECORD_TYPE,
+  KV1_WARNING_UNKNOWN_TRANSPORT_TYPE,
+};
+
+// An error or warning reported by Kv1Parser, which is only turned into a
+// message when it is actually shown to someone.
+struct Kv1ParseError {
+  Kv1ParseErrorCode code;
+  // The line at which the row starts
+  size_t line = 0;
+  // The field that the error is about (e.g. "PUJO.JourneyNumber"), or for
+  // KV1_ERROR_INVALID the complete message. Always points to a string literal.
+  std::string_view field;
+  // Actual and allowed length or number of digits, for the codes that need it
+  size_t actual = 0;
+  size_t limit = 0;
+  // The bad value or record type, for the codes that need it
+  std::string detail;
+
+  std::string message() const;
+};
+
+// Keeps only the first MAX_RETAINED errors that are added, and counts the
+// rest, so that parsing a completely broken file cannot use up all memory.
+struct Kv1ParseErrors {
+  static constexpr size_t MAX_RETAINED = 1000;
+
+  void add(Kv1ParseError error);
+  // Adds line_offset to the lines of the errors in other.
+  void append(const Kv1ParseErrors &other, size_t line_offset = 0);
+
+  bool empty() const { return count == 0; }
+  size_t size() const { return count; }
+  size_t dropped() const { return count - retained.size(); }
+  std::vector<Kv1ParseError>::const_iterator begin() const { return retained.begin(); }
+  std::vector<Kv1ParseError>::const_iterator end() const { return retained.end(); }
+
+  std::vector<Kv1ParseError> retained;
+  size_t count = 0;
+};
+
 struct Kv1Parser {
-  explicit Kv1Parser(std::vector<Kv1Token> tokens, Kv1Records &parse_into);
-  
+  // Pulls tokens from the lexer while parsing. Errors of the lexer are not
+  // copied into global_errors, so check lexer.errors after parsing.
+  explicit Kv1Parser(Kv1Lexer &lexer, Kv1Records &parse_into);
+
   void parse();
 
  private:
@@ -24,26 +91,53 @@ struct Kv1Parser {
   // 'this'; is not static) that takes no arguments and also does not return
   // anything.
   using ParseFunc = void (Kv1Parser::*)();
-  static const std::unordered_map<std::string_view, ParseFunc> type_parsers;
+  struct TypeParser {
+    std::string_view record_type;
+    ParseFunc parse;
+  };
+  static const std::array<TypeParser, 29> type_parsers;
+  // Returns nullptr if there is no parser for the record type.
+  static ParseFunc findTypeParser(std::string_view record_type);
 
-  bool atEnd() const;
+  bool atEnd();
+  void advance();
   void eatRowEnds();
-  const Kv1Token *cur() const;
-  const std::string *eatCell(std::string_view parsing_what);
-  std::string parseHeader();
+  const Kv1Token *cur();
+  std::optional<std::string_view> eatCell(std::string_view parsing_what);
+  std::string_view parseHeader();
   void eatRestOfRow();
 
+  void recordError(Kv1ParseErrorCode code, std::string_view field, size_t actual = 0, size_t limit = 0,
+                   std::string_view detail = {});
+
   void requireString(std::string_view field, bool mandatory, size_t max_length, std::string_view value);
   std::optional<bool> requireBoolean(std::string_view field, bool mandatory, std::string_view value);
   std::optional<double> requireNumber(std::string_view field, bool mandatory, size_t max_digits, std::string_view value);
+  template<size_t MaxDigits, std::integral T>
+  std::optional<T> requireInt(std::string_view field, bool mandatory, std::string_view value);
   std::optional<RgbColor> requireRgbColor(std::string_view field, bool mandatory, std::string_view value);
   std::optional<double> requireRdCoord(std::string_view field, bool mandatory, size_t min_digits, std::string_view value);
+  // Values of E are numbered from 0 to last, and named by kv1Name().
+  template<typename E>
+  std::optional<E> requireEnumeration(std::string_view field, bool mandatory, E last, std::string_view value);
+  std::optional<Kv1DayType> requireDayType(std::string_view field, bool mandatory, std::string_view value);
 
   std::string eatString(std::string_view field, bool mandatory, size_t max_length);
+  std::string_view eatStringView(std::string_view field, bool mandatory, size_t max_length);
+  // Interns the string, for fields that are repeated in many records
+  Kv1Symbol eatSymbol(std::string_view field, bool mandatory, size_t max_length);
   std::optional<bool> eatBoolean(std::string_view field, bool mandatory);
   std::optional<double> eatNumber(std::string_view field, bool mandatory, size_t max_digits);
+  template<size_t MaxDigits, std::integral T>
+  std::optional<T> eatInt(std::string_view field, bool mandatory);
   std::optional<RgbColor> eatRgbColor(std::string_view field, bool mandatory);
   std::optional<double> eatRdCoord(std::string_view field, bool mandatory, size_t min_digits);
+  template<typename E>
+  std::optional<E> eatEnumeration(std::string_view field, bool mandatory, E last);
+  // Always mandatory. Modalities outside BISON E9 are only warned about, and
+  // kept as they are.
+  Kv1Symbol eatTransportType(std::string_view field);
+  std::optional<Kv1DayType> eatDayType(std::string_view field, bool mandatory);
 
   void parseOrganizationalUnit();
   void parseHigherOrganizationalUnit();
@@ -75,15 +169,49 @@ struct Kv1Parser {
   void parsePublicJourneyPassingTimes();
   void parseOperatingDay();
 
-  size_t pos = 0;
-  std::vector<Kv1Token> tokens;
+  Kv1Lexer &lexer;
+  // The current token, valid if has_token is set
+  Kv1Token token{};
+  bool has_token = false;
+  bool lexer_done = false;
+  // Rows of the same type come in long runs, so we remember the type of the
+  // last row and its parser.
+  std::string_view section_type;
+  ParseFunc section_parser = nullptr;
+  // The line at which the current row starts
+  size_t row_line = 0;
   const std::chrono::time_zone *amsterdam = std::chrono::locate_zone("Europe/Amsterdam");
 
  public:
-  std::vector<std::string> warns;
-  std::vector<std::string> global_errors;
-  std::vector<std::string> record_errors;
+  Kv1ParseErrors warns;
+  Kv1ParseErrors global_errors;
+  // Errors in the current row. Only non-empty after parse() if parsing was
+  // stopped by a bad header.
+  std::vector<Kv1ParseError> record_errors;
+  Kv1Records &records;
+};
+
+// Lexes and parses a KV1 file on multiple threads. The input is split into
+// chunks at line boundaries, which are parsed into separate Kv1Records that
+// are then concatenated in order. The records, errors and warnings are the
+// same as those of Kv1Lexer and Kv1Parser on the whole input.
+struct Kv1ParallelParser {
+  explicit Kv1ParallelParser(std::string_view input, Kv1Records &parse_into,
+                             unsigned n_threads = std::thread::hardware_concurrency());
+
+  void parse();
+
+  std::vector<std::string> lexer_errors;
+  Kv1ParseErrors warns;
+  Kv1ParseErrors global_errors;
+  std::vector<Kv1ParseError> record_errors;
   Kv1Records &records;
+
+ private:
+  void parseSequentially();
+
+  std::string_view input;
+  unsigned n_threads;
 };
 
 #endif // OEUF_LIBTMI8_KV1_PARSER_HPP
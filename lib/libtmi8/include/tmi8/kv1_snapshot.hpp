@@ -0,0 +1,45 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#ifndef OEUF_LIBTMI8_KV1_SNAPSHOT_HPP
+#define OEUF_LIBTMI8_KV1_SNAPSHOT_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <tmi8/kv1_types.hpp>
+
+// A KV1 snapshot is a binary dump of parsed and linked Kv1Records, which can
+// be loaded much faster than the KV1 text export can be lexed, parsed and
+// linked. It consists of a header followed by the body:
+//
+//   header:  magic "OEUFKV1S", u32 version, u32 number of tables, u64 size
+//            of the body, u64 checksum of the body
+//   body:    u64 number of strings, u64 string offsets[number of strings + 1],
+//            the string bytes, u64 record counts[number of tables], and then
+//            every table as a flat array of fixed-size records, in the order
+//            of KV1_TABLES (kv1_fields.hpp)
+//
+// Every string field is stored as the u32 index of a string in the string
+// table, in which all strings are deduplicated. Symbols (Kv1Symbol) are stored
+// the same way, and interned again when the snapshot is loaded. References to
+// other records (the p_* fields) are stored as a u32 index into the referenced
+// table plus one, zero being a null pointer. Enumerations are stored as a u8,
+// and day types as the u8 weekday mask. Integers and doubles are stored in
+// native byte order; snapshots are meant as a cache on the machine that made
+// them, not as an exchange format.
+constexpr uint32_t KV1_SNAPSHOT_VERSION = 4;
+
+// Writes records to a snapshot at path. The records should have been linked
+// by kv1LinkRecords(). Returns an error message, or an empty string on
+// success.
+std::string kv1WriteSnapshot(const Kv1Records &records, const char *path);
+
+// Loads the snapshot in data (e.g. from Kv1Input) into into, which must be
+// empty. The records are linked already; only the index has to be built.
+// Returns an error message, or an empty string on success.
+std::string kv1ReadSnapshot(std::string_view data, Kv1Records &into);
+
+#endif // OEUF_LIBTMI8_KV1_SNAPSHOT_HPP
@@ -0,0 +1,63 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#ifndef OEUF_LIBTMI8_KV1_SYMBOL_HPP
+#define OEUF_LIBTMI8_KV1_SYMBOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// An interned string. Codes like DataOwnerCode, LinePlanningNumber and
+// UserStopCode are repeated in millions of KV1 records, but there are only a
+// few thousand distinct ones. A Kv1Symbol stores only the 32-bit ID of the
+// string in a process-wide symbol table, so comparing and hashing symbols are
+// integer operations.
+//
+// Strings are never removed from the symbol table, and IDs are only valid
+// within the process that made them. Interning is thread-safe, so that
+// Kv1ParallelParser can intern on all its threads.
+class Kv1Symbol {
+ public:
+  // The empty string, which always has ID 0.
+  Kv1Symbol() = default;
+  // These intern the string.
+  Kv1Symbol(std::string_view str);
+  Kv1Symbol(const std::string &str) : Kv1Symbol(std::string_view(str)) {}
+  Kv1Symbol(const char *str) : Kv1Symbol(std::string_view(str)) {}
+
+  // Looks the string up without interning it. If the string has never been
+  // interned, no record can contain it, so this is how untrusted input (such
+  // as a query from a client) should be turned into a symbol.
+  static std::optional<Kv1Symbol> find(std::string_view str);
+
+  uint32_t id() const { return id_; }
+  bool empty() const { return id_ == 0; }
+  const std::string &str() const;
+  const char *c_str() const { return str().c_str(); }
+  size_t size() const { return str().size(); }
+
+  friend bool operator==(Kv1Symbol a, Kv1Symbol b) = default;
+
+ private:
+  uint32_t id_ = 0;
+};
+
+// The number of distinct non-empty strings that have been interned.
+size_t kv1SymbolCount();
+
+inline size_t hash_value(Kv1Symbol sym) { return sym.id(); }
+
+std::ostream &operator<<(std::ostream &os, Kv1Symbol sym);
+
+template<>
+struct std::hash<Kv1Symbol> {
+  size_t operator()(Kv1Symbol sym) const noexcept { return sym.id(); }
+};
+
+#endif // OEUF_LIBTMI8_KV1_SYMBOL_HPP
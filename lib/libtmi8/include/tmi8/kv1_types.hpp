@@ -9,8 +9,11 @@
 #include <cstdint>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <variant>
 
+#include <tmi8/kv1_symbol.hpp>
+
 struct Kv1OrganizationalUnit;
 struct Kv1HigherOrganizationalUnit;
 struct Kv1UserStopPoint;
@@ -73,6 +76,8 @@ struct Kv1Records {
   std::vector<Kv1OperatingDay>               operating_days;
 
   size_t size() const;
+  // Moves all records of other to the end of the respective tables.
+  void append(Kv1Records &&other);
 };
 
 // These definitions implement TMI8, KV1 Dienstregeling (Timetable) version
@@ -94,6 +99,58 @@ struct Kv1Records {
 // under CC BY-ND 3.0. The exact text of this license can be found on
 // https://creativecommons.org/licenses/by-nd/3.0/nl/.
 
+// BISON enumeration E3: wheelchair accessibility of a journey.
+enum Kv1WheelchairAccessibility : uint8_t {
+  KV1_WHEELCHAIR_ACCESSIBLE,
+  KV1_WHEELCHAIR_NOT_ACCESSIBLE,
+  KV1_WHEELCHAIR_UNKNOWN,
+  // Always keep this updated to correspond to the last element of the
+  // enumeration!
+  _KV1_WHEELCHAIR_LAST = KV1_WHEELCHAIR_UNKNOWN,
+};
+
+// BISON enumeration E21: whether a not explicitly planned trip is to be shown
+// on displays.
+enum Kv1ShowFlexibleTrip : uint8_t {
+  // Always
+  KV1_SHOW_FLEXIBLE_TRIP_TRUE,
+  // Never
+  KV1_SHOW_FLEXIBLE_TRIP_FALSE,
+  // Only when the journey is tracked
+  KV1_SHOW_FLEXIBLE_TRIP_REALTIME,
+  // Always keep this updated to correspond to the last element of the
+  // enumeration!
+  _KV1_SHOW_FLEXIBLE_TRIP_LAST = KV1_SHOW_FLEXIBLE_TRIP_REALTIME,
+};
+
+// The value as it appears in KV1, e.g. "BUS" or "NOTACCESSIBLE".
+std::string_view kv1Name(Kv1WheelchairAccessibility wheelchair_accessible);
+std::string_view kv1Name(Kv1ShowFlexibleTrip show_flexible_trip);
+
+// The days of the week on which something applies. In KV1, this is written as
+// [0|1][0|2][0|3][0|4][0|5][0|6][0|7] for Mon, Tue, Wed, Thu, Fri, Sat, Sun;
+// e.g. 1234500 means Mon, Tue, Wed, Thu, Fri but not Sat, Sun.
+//
+// Kv1Parser only accepts this form, always seven characters long. Anything
+// else (e.g. 7 or 0000076) is a record error, so kv1Load() refuses the file:
+// day types are part of keys, and reading other spellings as the same
+// weekdays would make distinct keys equal.
+struct Kv1DayType {
+  // Bit i is set if the day type includes ISO weekday i + 1 (i.e. bit 0 is
+  // Monday and bit 6 is Sunday).
+  uint8_t weekdays = 0;
+
+  bool has(std::chrono::weekday weekday) const {
+    return weekdays & (1 << (weekday.iso_encoding() - 1));
+  }
+  // Formatted as in KV1, e.g. "1234500"
+  std::string str() const;
+
+  friend bool operator==(Kv1DayType, Kv1DayType) = default;
+};
+
+inline size_t hash_value(Kv1DayType day_type) { return day_type.weekdays; }
+
 // KV1 Table 1: Organizational Unit [ORUN] (MANDATORY)
 // 
 // A collection of trips with the same validity features. An organizational
@@ -110,12 +167,12 @@ struct Kv1OrganizationalUnit {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters.
-    std::string organizational_unit_code;
+    Kv1Symbol organizational_unit_code;
 
-    explicit Key(std::string data_owner_code,
-                 std::string organizational_unit_code);
+    explicit Key(Kv1Symbol data_owner_code,
+                 Kv1Symbol organizational_unit_code);
   };
   
   Key key;
@@ -138,19 +195,19 @@ struct Kv1HigherOrganizationalUnit {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters. Parent, higher organizational unit
     // that is referred to.
-    std::string organizational_unit_code_parent;
+    Kv1Symbol organizational_unit_code_parent;
     // Mandatory (key), at most 10 characters. Child, lower organizational unit.
-    std::string organizational_unit_code_child;
+    Kv1Symbol organizational_unit_code_child;
     // Mandatory (key), at most 10 characters. [YYYY-MM-DD] Starting date of the
     // hierarchical relation (can be a fixed value, e.g. 2006-12-31).
     std::chrono::year_month_day valid_from;
 
-    explicit Key(std::string data_owner_code,
-                 std::string organizational_unit_code_parent,
-                 std::string organizational_unit_code_child,
+    explicit Key(Kv1Symbol data_owner_code,
+                 Kv1Symbol organizational_unit_code_parent,
+                 Kv1Symbol organizational_unit_code_child,
                  std::chrono::year_month_day valid_from);
   };
  
@@ -177,12 +234,12 @@ struct Kv1UserStopPoint {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters. Stop number in domain of operator.
-    std::string user_stop_code;
+    Kv1Symbol user_stop_code;
 
-    explicit Key(std::string data_owner_code,
-                 std::string user_stop_code);
+    explicit Key(Kv1Symbol data_owner_code,
+                 Kv1Symbol user_stop_code);
   };
 
   Key key;
@@ -238,12 +295,12 @@ struct Kv1UserStopArea {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters. Code of StopArea following coding
     // of operator, e.g. PlaceCode.
     std::string user_stop_area_code;
 
-    explicit Key(std::string data_owner_code,
+    explicit Key(Kv1Symbol data_owner_code,
                  std::string user_stop_area_code);
   };
 
@@ -268,17 +325,17 @@ struct Kv1TimingLink {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters. Stop number in the domain of
     // DataOwner (here: the operator).
-    std::string user_stop_code_begin;
+    Kv1Symbol user_stop_code_begin;
     // Mandatory (key), at most 10 characters. Stop number in the domain of
     // DataOwner (here: the operator).
-    std::string user_stop_code_end;
+    Kv1Symbol user_stop_code_end;
 
-    explicit Key(std::string data_owner_code,
-                 std::string user_stop_code_begin,
-                 std::string user_stop_code_end);
+    explicit Key(Kv1Symbol data_owner_code,
+                 Kv1Symbol user_stop_code_begin,
+                 Kv1Symbol user_stop_code_end);
   };
 
   Key key;
@@ -302,22 +359,22 @@ struct Kv1Link {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters. Stop code in the domain of
     // DataOwner (here: the operator).
-    std::string user_stop_code_begin;
+    Kv1Symbol user_stop_code_begin;
     // Mandatory (key), at most 10 characters. Stop code in the domain of
     // DataOwner (here: the operator).
-    std::string user_stop_code_end;
+    Kv1Symbol user_stop_code_end;
     // Mandatory (key), at most 5 characters. Modality for which the distance
-    // applies, see BISON enumeration E9.
-    // TODO: Check if BISON enumeration E9 can be put into an enum.
-    std::string transport_type;
-
-    explicit Key(std::string data_owner_code,
-                 std::string user_stop_code_begin,
-                 std::string user_stop_code_end,
-                 std::string transport_type);
+    // applies, see BISON enumeration E9. Not an enumeration, so that values
+    // outside E9 are kept as they are.
+    Kv1Symbol transport_type;
+
+    explicit Key(Kv1Symbol data_owner_code,
+                 Kv1Symbol user_stop_code_begin,
+                 Kv1Symbol user_stop_code_end,
+                 Kv1Symbol transport_type);
   };
 
   Key key;
@@ -345,13 +402,13 @@ struct Kv1Line {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters. Unique system line number in the
     // domain of DataOwner.
-    std::string line_planning_number;
+    Kv1Symbol line_planning_number;
 
-    explicit Key(std::string data_owner_code,
-                 std::string line_planning_number);
+    explicit Key(Kv1Symbol data_owner_code,
+                 Kv1Symbol line_planning_number);
   };
 
   Key key;
@@ -366,9 +423,9 @@ struct Kv1Line {
   short line_ve_tag_number = 0;
   // Optional, at most 255 characters.
   std::string description;
-  // Mandatory, at most 5 characters. Modality, see BISON enumeration E9.
-  // TODO: Check if BISON enumeration E9 can be put into an enum.
-  std::string transport_type;
+  // Mandatory, at most 5 characters. Modality, see BISON enumeration E9. Not
+  // an enumeration, so that values outside E9 are kept as they are.
+  Kv1Symbol transport_type;
   // Optional, at most 4 digits. Symbol / image for the line. Reference to ICON
   // table.
   std::optional<short> line_icon;
@@ -396,11 +453,11 @@ struct Kv1Destination {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters.
     std::string dest_code;
 
-    explicit Key(std::string data_owner_code,
+    explicit Key(Kv1Symbol data_owner_code,
                  std::string dest_code);
   };
 
@@ -458,15 +515,15 @@ struct Kv1JourneyPattern {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters.
-    std::string line_planning_number;
+    Kv1Symbol line_planning_number;
     // Mandatory (key), at most 10 characters.
-    std::string journey_pattern_code;
+    Kv1Symbol journey_pattern_code;
 
-    explicit Key(std::string data_owner_code,
-                 std::string line_planning_number,
-                 std::string journey_pattern_code);
+    explicit Key(Kv1Symbol data_owner_code,
+                 Kv1Symbol line_planning_number,
+                 Kv1Symbol journey_pattern_code);
   };
 
   Key key;
@@ -493,11 +550,11 @@ struct Kv1ConcessionFinancerRelation {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters. Parcel code.
     std::string con_fin_rel_code;
 
-    explicit Key(std::string data_owner_code,
+    explicit Key(Kv1Symbol data_owner_code,
                  std::string con_fin_rel_code);
   };
 
@@ -521,11 +578,11 @@ struct Kv1ConcessionArea {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters. Code of the concession.
     std::string concession_area_code;
 
-    explicit Key(std::string data_owner_code,
+    explicit Key(Kv1Symbol data_owner_code,
                  std::string concession_area_code);
   };
 
@@ -544,11 +601,11 @@ struct Kv1Financer {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters.
     std::string financer_code;
 
-    explicit Key(std::string data_owner_code,
+    explicit Key(Kv1Symbol data_owner_code,
                  std::string financer_code);
   };
 
@@ -590,27 +647,27 @@ struct Kv1JourneyPatternTimingLink {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters.
-    std::string line_planning_number;
+    Kv1Symbol line_planning_number;
     // Mandatory (key), at most 10 characters.
-    std::string journey_pattern_code;
+    Kv1Symbol journey_pattern_code;
     // Mandatory (key), at most 3 digits.
     short timing_link_order = 0;
 
-    explicit Key(std::string data_owner_code,
-                 std::string line_planning_number,
-                 std::string journey_pattern_code,
+    explicit Key(Kv1Symbol data_owner_code,
+                 Kv1Symbol line_planning_number,
+                 Kv1Symbol journey_pattern_code,
                  short timing_link_order);
   };
 
   Key key;
   // Mandatory, at most 10 characters. Stop number in the domain of the
   // DataOwner (here: the transit operator).
-  std::string user_stop_code_begin;
+  Kv1Symbol user_stop_code_begin;
   // Mandatory, at most 10 characters. Stop number in the domain of the
   // DataOwner (here: the transit operator).
-  std::string user_stop_code_end;
+  Kv1Symbol user_stop_code_end;
   // Mandatory, at most 10 characters. Concession financer relation / parcel
   // (smallest unit).
   std::string con_fin_rel_code;
@@ -630,8 +687,8 @@ struct Kv1JourneyPatternTimingLink {
   std::string display_public_line;
   // Optional, at most 4 digits. Enumeration E10 (see section 2.5). A public
   // transit service which distinguishes itself by a set of unique features,
-  // that is offered to the passenger as distinct (a marketing aspect).
-  // TODO: Check if we can turn BISON enumeration E10 into an enum
+  // that is offered to the passenger as distinct (a marketing aspect). E10
+  // is a list of numeric codes to begin with, so the code is kept as is.
   std::optional<short> product_formula_type;
   // Mandatory, at most 5 characters. Boolean indicator whether UserStopBegin
   // is used as a boarding stop in this journey pattern. Usually equal to the
@@ -646,8 +703,7 @@ struct Kv1JourneyPatternTimingLink {
   // reservation such as a 'call bus' (belbus), 'line taxi' (lijntaxi) etc.) to
   // be shown on displays. Values according enumeration E21: TRUE (always),
   // FALSE (never), REALTIME (only when tracking trip).
-  // TODO: Check if we can turn BISON enumeration E21 into an enum
-  std::string show_flexible_trip;
+  std::optional<Kv1ShowFlexibleTrip> show_flexible_trip;
   // Optional, at most 4 digits. Symbol / image for display of the line
   // destination at the journey stop passing. Reference to the ICON table.
   std::optional<short> line_dest_icon;
@@ -682,12 +738,12 @@ struct Kv1Point {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters.
-    std::string point_code;
+    Kv1Symbol point_code;
 
-    explicit Key(std::string data_owner_code,
-                 std::string point_code);
+    explicit Key(Kv1Symbol data_owner_code,
+                 Kv1Symbol point_code);
   };
 
   Key key;
@@ -722,28 +778,29 @@ struct Kv1PointOnLink {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters. Stop number in the domain of the
     // DataOwner (here: transit operator).
-    std::string user_stop_code_begin;
+    Kv1Symbol user_stop_code_begin;
     // Mandatory (key), at most 10 characters. Stop number in the domain of the
     // DataOwner (here: transit operator).
-    std::string user_stop_code_end;
+    Kv1Symbol user_stop_code_end;
     // Mandatory (key), at most 10 characters. Code from the road manager for KAR
     // points. For curve points of the DataOwner (often the transit operator).
-    std::string point_data_owner_code;
+    Kv1Symbol point_data_owner_code;
     // Mandatory (key), at most 10 charcters.
-    std::string point_code;
+    Kv1Symbol point_code;
     // Mandatory (key), at most 5 characters. Modality for which the distance
-    // applies, see BISON enumeration E9.
-    std::string transport_type;
-
-    explicit Key(std::string data_owner_code,
-                 std::string user_stop_code_begin,
-                 std::string user_stop_code_end,
-                 std::string point_data_owner_code,
-                 std::string point_code,
-                 std::string transport_type);
+    // applies, see BISON enumeration E9. Not an enumeration, so that values
+    // outside E9 are kept as they are.
+    Kv1Symbol transport_type;
+
+    explicit Key(Kv1Symbol data_owner_code,
+                 Kv1Symbol user_stop_code_begin,
+                 Kv1Symbol user_stop_code_end,
+                 Kv1Symbol point_data_owner_code,
+                 Kv1Symbol point_code,
+                 Kv1Symbol transport_type);
   };
 
   Key key;
@@ -775,12 +832,12 @@ struct Kv1Icon {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 4 digits. Reference from other tables for the
     // requested image.
     short icon_number = 0;
 
-    explicit Key(std::string data_owner_code,
+    explicit Key(Kv1Symbol data_owner_code,
                  short icon_number);
   };
 
@@ -812,12 +869,12 @@ struct Kv1Notice {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 20 characters. Identification of Notice (remark,
     // clarifying text).
     std::string notice_code;
 
-    explicit Key(std::string data_owner_code,
+    explicit Key(Kv1Symbol data_owner_code,
                  std::string notice_code);
   };
 
@@ -881,7 +938,7 @@ struct Kv1Notice {
 struct Kv1NoticeAssignment {
   // Mandatory, at most 10 characters. Transport operator (from list as
   // defined in BISON enumeration E1).
-  std::string data_owner_code;
+  Kv1Symbol data_owner_code;
   // Mandatory, at most 20 characters. Notice that is assigned.
   std::string notice_code;
   // Mandatory, at most 8 characters. Object type to which Notice is assigned.
@@ -889,7 +946,7 @@ struct Kv1NoticeAssignment {
   // Optional, at most 10 characters. Only relevant for PUJO.
   std::string timetable_version_code;
   // Optional, at most 10 characters. Only relevant for PUJO and PUJOPASS.
-  std::string organizational_unit_code;
+  Kv1Symbol organizational_unit_code;
   // Optional, at most 10 characters. Only relevant for PUJOPASS.
   std::string schedule_code;
   // Optional, at most 10 characters. Only relevant for PUJOPASS.
@@ -901,9 +958,9 @@ struct Kv1NoticeAssignment {
   // Optional, at most 10 characters. Only relevant for PUJO.
   // [0|1][0|2][0|3][0|4][0|5][0|6][0|7] for Mon, Tue, Wed, Thu, Fri, Sat, Sun.
   // E.g. 1234500 means Mon, Tue, Wed, Thu, Fri but not Sat, Sun.
-  std::string day_type;
+  std::optional<Kv1DayType> day_type;
   // Mandatory, at most 10 characters. Mandatory for all object types.
-  std::string line_planning_number;
+  Kv1Symbol line_planning_number;
   // Optional (for all object types except PUJO and PUJOPASS), at most 6
   // digits. Only relevant for PUJO and PUJOPASS. Must be in the range
   // [0-1000000).
@@ -912,12 +969,12 @@ struct Kv1NoticeAssignment {
   std::optional<int> stop_order;
   // Optional (for all object types except JOPATILI), at most 4 digits. Only
   // relevant for JOPATILI.
-  std::string journey_pattern_code;
+  Kv1Symbol journey_pattern_code;
   // Optional (at most 3 digits). Only relevant for JOPATILI.
   std::optional<short> timing_link_order;
   // Optional (at most 10 characters). Only relevant for PUJOPASS and JOPATILI.
   // For JOPATILI, this correspond to the first stop of the link.
-  std::string user_stop_code;
+  Kv1Symbol user_stop_code;
 
   Kv1Notice *p_notice = nullptr;
 };
@@ -932,20 +989,20 @@ struct Kv1TimeDemandGroup {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters.
-    std::string line_planning_number;
+    Kv1Symbol line_planning_number;
     // Mandatory (key), at most 10 characters. Refers to the JOPATILI table.
-    std::string journey_pattern_code;
+    Kv1Symbol journey_pattern_code;
     // Mandatory (key), at most 10 characters. Defines the code for the time
     // demand group. (NOTE: this is not entirely made clear by the specification.
     // This claim must be verified.)
-    std::string time_demand_group_code;
+    Kv1Symbol time_demand_group_code;
 
-    explicit Key(std::string data_owner_code,
-                 std::string line_planning_number,
-                 std::string journey_pattern_code,
-                 std::string time_demand_group_code);
+    explicit Key(Kv1Symbol data_owner_code,
+                 Kv1Symbol line_planning_number,
+                 Kv1Symbol journey_pattern_code,
+                 Kv1Symbol time_demand_group_code);
   };
 
   Key key;
@@ -968,30 +1025,30 @@ struct Kv1TimeDemandGroupRunTime {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters.
-    std::string line_planning_number;
+    Kv1Symbol line_planning_number;
     // Mandatory (key), at most 10 characters. Refers to the JOPATILI table.
-    std::string journey_pattern_code;
+    Kv1Symbol journey_pattern_code;
     // Mandatory (key), at most 10 characters. Refers to the TIMDEMGRP table.
-    std::string time_demand_group_code;
+    Kv1Symbol time_demand_group_code;
     // Mandatory (key), at most 3 digits. Reference number of a link within the
     // journey pattern (a link can occur more than once within a journey
     // pattern).
     short timing_link_order = 0;
 
-    explicit Key(std::string data_owner_code,
-                 std::string line_planning_number,
-                 std::string journey_pattern_code,
-                 std::string time_demand_group_code,
+    explicit Key(Kv1Symbol data_owner_code,
+                 Kv1Symbol line_planning_number,
+                 Kv1Symbol journey_pattern_code,
+                 Kv1Symbol time_demand_group_code,
                  short timing_link_order);
   };
 
   Key key;
   // Mandatory, at most 10 characters. Refers to the first stop of the link.
-  std::string user_stop_code_begin;
+  Kv1Symbol user_stop_code_begin;
   // Mandatory, at most 10 characters. Refers to the last stop of the link.
-  std::string user_stop_code_end;
+  Kv1Symbol user_stop_code_end;
   // Mandatory, at most 5 digits. Planned total run time on link for time
   // demand group: (Departure time end stop - departure time begin stop)
   // corresponding to the time demand group. In seconds.
@@ -1038,11 +1095,11 @@ struct Kv1PeriodGroup {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters.
     std::string period_group_code;
 
-    explicit Key(std::string data_owner_code,
+    explicit Key(Kv1Symbol data_owner_code,
                  std::string period_group_code);
   };
 
@@ -1064,11 +1121,11 @@ struct Kv1SpecificDay {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters. Default: "NORMAL".
     std::string specific_day_code;
 
-    explicit Key(std::string data_owner_code,
+    explicit Key(Kv1Symbol data_owner_code,
                  std::string specific_day_code);
   };
 
@@ -1095,9 +1152,9 @@ struct Kv1TimetableVersion {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters.
-    std::string organizational_unit_code;
+    Kv1Symbol organizational_unit_code;
     // Mandatory (key), at most 10 characters.
     std::string timetable_version_code;
     // Mandatory (key), at most 10 charactes.
@@ -1105,8 +1162,8 @@ struct Kv1TimetableVersion {
     // Mandatory (key), at most 10 characters. Default: "NORMAL".
     std::string specific_day_code;
 
-    explicit Key(std::string data_owner_code,
-                 std::string organizational_unit_code,
+    explicit Key(Kv1Symbol data_owner_code,
+                 Kv1Symbol organizational_unit_code,
                  std::string timetable_version_code,
                  std::string period_group_code,
                  std::string specific_day_code);
@@ -1144,11 +1201,11 @@ struct Kv1PublicJourney {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters.
     std::string timetable_version_code;
     // Mandatory (key), at most 10 characters.
-    std::string organizational_unit_code;
+    Kv1Symbol organizational_unit_code;
     // Mandatory (key), at most 10 characters.
     std::string period_group_code;
     // Mandatory (key), at most 10 characters.
@@ -1156,34 +1213,32 @@ struct Kv1PublicJourney {
     // Mandatory (key), at most 7 characters.
     // [0|1][0|2][0|3][0|4][0|5][0|6][0|7] for Mon, Tue, Wed, Thu, Fri, Sat, Sun.
     // E.g. 1234500 means Mon, Tue, Wed, Thu, Fri but not Sat, Sun.
-    // TODO: See if we can make this into a more concrete type
-    std::string day_type;
+    Kv1DayType day_type;
     // Mandatory (key), at most 10 characters.
-    std::string line_planning_number;
+    Kv1Symbol line_planning_number;
     // Mandatory (key), at most 6 digits. Must be in the range [0-1000000).
     int journey_number = 0;
 
-    explicit Key(std::string data_owner_code,
+    explicit Key(Kv1Symbol data_owner_code,
                  std::string timetable_version_code,
-                 std::string organizational_unit_code,
+                 Kv1Symbol organizational_unit_code,
                  std::string period_group_code,
                  std::string specific_day_code,
-                 std::string day_type,
-                 std::string line_planning_number,
+                 Kv1DayType day_type,
+                 Kv1Symbol line_planning_number,
                  int journey_number);
   };
 
   Key key;
   // Mandatory, at most 10 characters.
-  std::string time_demand_group_code;
+  Kv1Symbol time_demand_group_code;
   // Mandatory, at most 10 characters.
-  std::string journey_pattern_code;
+  Kv1Symbol journey_pattern_code;
   // Mandatory, at most 8 characters. Format: "HH:MM:SS".
   std::chrono::hh_mm_ss<std::chrono::seconds> departure_time;
   // Mandatory, at most 13 characters. Values as in BISON enumeration E3.
   // Allowed are: "ACCESSIBLE", "NOTACCESSIBLE" and "UNKNOWN".
-  // TODO: See if we can fit BISON enumeration E3 into an enum
-  std::string wheelchair_accessible;
+  Kv1WheelchairAccessibility wheelchair_accessible = KV1_WHEELCHAIR_UNKNOWN;
   // Mandatory, at most 5 characters. Boolean. Value "true": journey is
   // operator by DataOwner. Value "false": journey is operator by a different
   // DataOwner. Indicator is meant for a line that is operated jointly by
@@ -1198,16 +1253,15 @@ struct Kv1PublicJourney {
   // corresponding journey ("true" or "false").
   bool planned_monitored = false;
   // Optional, at most 4 digits. BISON enumeration E10. Intended to allow
-  // capturing transit mode features at the journey level.
-  // TODO: See if we can make BISON enumeration E10 into an enum
+  // capturing transit mode features at the journey level. E10 is a list of
+  // numeric codes to begin with, so the code is kept as is.
   std::optional<short> product_formula_type;
   // Optional, at most 8 characters. Indicates whether the transit operator
   // wants that a not-explicitly planned trip (i.e. a journey that only runs on
   // reservation, e.g. 'call bus' (belbus), 'line taxi' (lijntaxi) etc.) to be
   // shown on displays. Values following BISON enumeration E21: TRUE (always),
   // FALSE (never), REALTIME (only when journey is tracked).
-  // TODO: See if we can make BISON enumeration E21 into an enum
-  std::string show_flexible_trip;
+  std::optional<Kv1ShowFlexibleTrip> show_flexible_trip;
 
   Kv1TimetableVersion   *p_timetable_version   = nullptr;
   Kv1OrganizationalUnit *p_organizational_unit = nullptr;
@@ -1227,17 +1281,17 @@ struct Kv1PeriodGroupValidity {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters.
-    std::string organizational_unit_code;
+    Kv1Symbol organizational_unit_code;
     // Mandatory (key), at most 10 characters.
     std::string period_group_code;
     // Mandatory (key), at most 10 characters. Date of the start of the validity
     // period. Format: "YYYY-MM-DD".
     std::chrono::year_month_day valid_from;
 
-    explicit Key(std::string data_owner_code,
-                 std::string organizational_unit_code,
+    explicit Key(Kv1Symbol data_owner_code,
+                 Kv1Symbol organizational_unit_code,
                  std::string period_group_code,
                  std::chrono::year_month_day valid_from);
   };
@@ -1261,16 +1315,16 @@ struct Kv1ExceptionalOperatingDay {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters. Organization unit for which an
     // exceptional day validity applies.
-    std::string organizational_unit_code;
+    Kv1Symbol organizational_unit_code;
     // Mandatory (key), at most 23 characters. Date (+ time) for which the
     // exceptional validity applies. Format: "YYYYMMDDThh:mm:ssTZD".
     std::chrono::sys_seconds valid_date;
 
-    explicit Key(std::string data_owner_code,
-                 std::string organizational_unit_code,
+    explicit Key(Kv1Symbol data_owner_code,
+                 Kv1Symbol organizational_unit_code,
                  std::chrono::sys_seconds valid_date);
   };
 
@@ -1279,8 +1333,7 @@ struct Kv1ExceptionalOperatingDay {
   // a calendar day: [0|1][0|2][0|3][0|4][0|5][0|6][0|7] for Mon, Tue, Wed,
   // Thu, Fri, Sat.
   // E.g. 1234500 means Mon, Tue, Wed, Thu, Fri but not Sat, Sun.
-  // TODO: See if we can make this into a more concrete type
-  std::string day_type_as_on;
+  Kv1DayType day_type_as_on;
   // Mandatory, at most 10 characters. Specific day service level to which the
   // exceptional day validity refers.
   std::string specific_day_code;
@@ -1317,17 +1370,17 @@ struct Kv1ScheduleVersion {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters.
-    std::string organizational_unit_code;
+    Kv1Symbol organizational_unit_code;
     // Mandatory (key), at most 10 characters. A unique code in combination with
     // the ScheduleTypeCode of the package within the ORUN.
     std::string schedule_code;
     // Mandatory (key), at most 10 characters. Code for the Schedule Type (Day Type).
     std::string schedule_type_code;
 
-    explicit Key(std::string data_owner_code,
-                 std::string organizational_unit_code,
+    explicit Key(Kv1Symbol data_owner_code,
+                 Kv1Symbol organizational_unit_code,
                  std::string schedule_code,
                  std::string schedule_type_code);
   };
@@ -1361,9 +1414,9 @@ struct Kv1PublicJourneyPassingTimes {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters.
-    std::string organizational_unit_code;
+    Kv1Symbol organizational_unit_code;
     // Mandatory (key), at most 10 characters. A unique code in combination with
     // the ScheduleTypeCode of the package within the ORUN.
     std::string schedule_code;
@@ -1371,26 +1424,26 @@ struct Kv1PublicJourneyPassingTimes {
     // Day Type).
     std::string schedule_type_code;
     // Mandatory (key), at most 10 characters.
-    std::string line_planning_number;
+    Kv1Symbol line_planning_number;
     // Mandatory (key), at most 6 digits. Must be in the range [0-1000000).
     int journey_number = 0;
     // Mandatory (key), at most 4 digits.
     short stop_order = 0;
 
-    explicit Key(std::string data_owner_code,
-                 std::string organizational_unit_code,
+    explicit Key(Kv1Symbol data_owner_code,
+                 Kv1Symbol organizational_unit_code,
                  std::string schedule_code,
                  std::string schedule_type_code,
-                 std::string line_planning_number,
+                 Kv1Symbol line_planning_number,
                  int journey_number,
                  short stop_order);
   };
 
   Key key;
   // Mandatory, at most 10 characters.
-  std::string journey_pattern_code;
+  Kv1Symbol journey_pattern_code;
   // Mandatory, at most 10 characters.
-  std::string user_stop_code;
+  Kv1Symbol user_stop_code;
   // Mandatory (except for the first stop of a journey), at most 8 digits. Not
   // compulsory for the first stop of a journey. Format: "HH:MM:SS".
   std::optional<std::chrono::hh_mm_ss<std::chrono::seconds>> target_arrival_time;
@@ -1399,8 +1452,7 @@ struct Kv1PublicJourneyPassingTimes {
   std::optional<std::chrono::hh_mm_ss<std::chrono::seconds>> target_departure_time;
   // Mandatory, at most 13 characters. Values as in BISON enumeration E3.
   // Allowed are: "ACCESSIBLE", "NOTACCESSIBLE" and "UNKNOWN".
-  // TODO: See if we can fit BISON enumeration E3 into an enum
-  std::string wheelchair_accessible;
+  Kv1WheelchairAccessibility wheelchair_accessible = KV1_WHEELCHAIR_UNKNOWN;
   // Mandatory, at most 5 characters. Boolean. Value "true": journey is
   // operator by DataOwner. Value "false": journey is operator by a different
   // DataOwner. Indicator is meant for a line that is operated jointly by
@@ -1415,16 +1467,15 @@ struct Kv1PublicJourneyPassingTimes {
   // corresponding journey ("true" or "false").
   bool planned_monitored = false;
   // Optional, at most 4 digits. BISON enumeration E10. Intended to allow
-  // capturing transit mode features at the journey level.
-  // TODO: See if we can make BISON enumeration E10 into an enum
+  // capturing transit mode features at the journey level. E10 is a list of
+  // numeric codes to begin with, so the code is kept as is.
   std::optional<short> product_formula_type;
   // Optional, at most 8 characters. Indicates whether the transit operator
   // wants that a not-explicitly planned trip (i.e. a journey that only runs on
   // reservation, e.g. 'call bus' (belbus), 'line taxi' (lijntaxi) etc.) to be
   // shown on displays. Values following BISON enumeration E21: TRUE (always),
   // FALSE (never), REALTIME (only when journey is tracked).
-  // TODO: See if we can make BISON enumeration E21 into an enum
-  std::string show_flexible_trip;
+  std::optional<Kv1ShowFlexibleTrip> show_flexible_trip;
 
   Kv1OrganizationalUnit *p_organizational_unit = nullptr;
   Kv1ScheduleVersion    *p_schedule_version    = nullptr;
@@ -1443,9 +1494,9 @@ struct Kv1OperatingDay {
   struct Key {
     // Mandatory (key), at most 10 characters. Transport operator (from list as
     // defined in BISON enumeration E1).
-    std::string data_owner_code;
+    Kv1Symbol data_owner_code;
     // Mandatory (key), at most 10 characters.
-    std::string organizational_unit_code;
+    Kv1Symbol organizational_unit_code;
     // Mandatory (key), at most 10 characters.
     std::string schedule_code;
     // Mandatory (key), at most 10 characters.
@@ -1454,8 +1505,8 @@ struct Kv1OperatingDay {
     // (schedule version) applies. Format: "YYYY-MM-DD".
     std::chrono::year_month_day valid_date;
 
-    explicit Key(std::string data_owner_code,
-                 std::string organizational_unit_code,
+    explicit Key(Kv1Symbol data_owner_code,
+                 Kv1Symbol organizational_unit_code,
                  std::string schedule_code,
                  std::string schedule_type_code,
                  std::chrono::year_month_day valid_date);
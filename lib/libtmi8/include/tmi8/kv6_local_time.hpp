@@ -0,0 +1,46 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#ifndef OEUF_LIBTMI8_KV6_LOCAL_TIME_HPP
+#define OEUF_LIBTMI8_KV6_LOCAL_TIME_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <arrow/api.h>
+#include <arrow/compute/api.h>
+
+// UTC offsets of Europe/Amsterdam for some range of time, looked up in the
+// time zone database once so that converting a timestamp to local time only
+// takes integer arithmetic.
+struct AmsterdamOffsetTable {
+  // Covers [begin, end], in seconds since the Unix epoch (UTC).
+  explicit AmsterdamOffsetTable(int64_t begin, int64_t end);
+
+  // Instants (in seconds since the Unix epoch) at which the offset changes.
+  std::vector<int64_t> transitions;
+  // Offsets in seconds, where offsets[i] is in effect from transitions[i-1]
+  // until transitions[i]. Hence there is one more offset than transitions.
+  std::vector<int64_t> offsets;
+
+  int64_t offsetAt(int64_t t) const;
+};
+
+// Name of the compute function registered by registerKv6LocalTimeFunction.
+static constexpr const char *KV6_LOCAL_TIME_FUNCTION = "kv6_local_time";
+
+// Derives local (Europe/Amsterdam) time columns from an array of naive (or
+// UTC) timestamps of any unit. Returns a struct array with the fields
+// iso_day_of_week (int64), date (date32) and local_time (time32[s]), which are
+// null wherever the timestamp is null.
+[[nodiscard]]
+arrow::Result<std::shared_ptr<arrow::StructArray>> kv6LocalTimes(const arrow::TimestampArray &timestamps);
+
+// Registers kv6LocalTimes as the unary scalar function KV6_LOCAL_TIME_FUNCTION,
+// so that it can be used with arrow::compute::CallFunction and in Acero plans.
+[[nodiscard]]
+arrow::Status registerKv6LocalTimeFunction(
+  arrow::compute::FunctionRegistry *registry = arrow::compute::GetFunctionRegistry());
+
+#endif // OEUF_LIBTMI8_KV6_LOCAL_TIME_HPP
@@ -0,0 +1,212 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+#include <tmi8/kv1_columns.hpp>
+
+// Calls f on every column of the table.
+template<typename Columns, typename F>
+static void forEachColumn(Columns &c, F f) {
+  if constexpr (std::is_same_v<std::remove_const_t<Columns>, Kv1PublicJourneyPassingTimesColumns>) {
+    f(c.data_owner_code); f(c.organizational_unit_code); f(c.schedule_code); f(c.schedule_type_code);
+    f(c.line_planning_number); f(c.journey_number); f(c.stop_order); f(c.journey_pattern_code);
+    f(c.user_stop_code); f(c.target_arrival_time_s); f(c.target_departure_time_s);
+    f(c.wheelchair_accessible); f(c.data_owner_is_operator); f(c.planned_monitored);
+    f(c.product_formula_type); f(c.show_flexible_trip);
+    f(c.organizational_unit_row); f(c.schedule_version_row); f(c.line_row);
+    f(c.journey_pattern_row); f(c.user_stop_row);
+  } else if constexpr (std::is_same_v<std::remove_const_t<Columns>, Kv1JourneyPatternTimingLinkColumns>) {
+    f(c.data_owner_code); f(c.line_planning_number); f(c.journey_pattern_code); f(c.timing_link_order);
+    f(c.user_stop_code_begin); f(c.user_stop_code_end); f(c.con_fin_rel_code); f(c.dest_code);
+    f(c.is_timing_stop); f(c.display_public_line); f(c.product_formula_type); f(c.get_in);
+    f(c.get_out); f(c.show_flexible_trip); f(c.line_dest_icon); f(c.line_dest_color);
+    f(c.line_dest_text_color);
+    f(c.line_row); f(c.journey_pattern_row); f(c.user_stop_begin_row); f(c.user_stop_end_row);
+    f(c.con_fin_rel_row); f(c.dest_row); f(c.line_dest_icon_row);
+  } else if constexpr (std::is_same_v<std::remove_const_t<Columns>, Kv1PointOnLinkColumns>) {
+    f(c.data_owner_code); f(c.user_stop_code_begin); f(c.user_stop_code_end);
+    f(c.point_data_owner_code); f(c.point_code); f(c.transport_type);
+    f(c.distance_since_start_of_link); f(c.segment_speed_mps); f(c.local_point_speed_mps);
+    f(c.user_stop_begin_row); f(c.user_stop_end_row); f(c.point_row);
+  } else {
+    static_assert(std::is_same_v<std::remove_const_t<Columns>, Kv1TimeDemandGroupRunTimeColumns>);
+    f(c.data_owner_code); f(c.line_planning_number); f(c.journey_pattern_code);
+    f(c.time_demand_group_code); f(c.timing_link_order); f(c.user_stop_code_begin);
+    f(c.user_stop_code_end); f(c.total_drive_time_s); f(c.drive_time_s); f(c.expected_delay_s);
+    f(c.layover_time_s); f(c.stop_wait_time_s); f(c.minimum_stop_time_s);
+    f(c.line_row); f(c.user_stop_begin_row); f(c.user_stop_end_row); f(c.journey_pattern_row);
+    f(c.time_demand_group_row); f(c.journey_pattern_timing_link_row);
+  }
+}
+
+template<typename Columns>
+static void reserve(Columns &c, size_t n) {
+  forEachColumn(c, [n](auto &column) { column.reserve(n); });
+}
+
+template<typename Columns>
+static size_t memoryUsageOf(const Columns &c) {
+  size_t usage = 0;
+  forEachColumn(c, [&usage](const auto &column) {
+    usage += column.capacity() * sizeof(column[0]);
+  });
+  return usage;
+}
+
+template<typename T>
+static uint32_t rowOf(const std::vector<T> &table, const T *record) {
+  return record ? static_cast<uint32_t>(record - table.data()) : KV1_NO_ROW;
+}
+
+static int32_t secondsOf(const std::optional<std::chrono::hh_mm_ss<std::chrono::seconds>> &time) {
+  return time ? static_cast<int32_t>(time->to_duration().count()) : KV1_NO_TIME;
+}
+
+// Durations in KV1 are whole seconds, even though we parse them as numbers.
+static int32_t secondsOf(double duration_s) {
+  return static_cast<int32_t>(std::lround(duration_s));
+}
+
+static int32_t secondsOf(const std::optional<double> &duration_s) {
+  return duration_s ? secondsOf(*duration_s) : KV1_NO_TIME;
+}
+
+static int16_t valueOr(const std::optional<short> &value, int16_t absent) {
+  return value ? *value : absent;
+}
+
+static uint8_t valueOr(const std::optional<Kv1ShowFlexibleTrip> &value, uint8_t absent) {
+  return value ? *value : absent;
+}
+
+static double valueOrNaN(const std::optional<double> &value) {
+  return value ? *value : std::numeric_limits<double>::quiet_NaN();
+}
+
+static uint32_t colorOf(const std::optional<RgbColor> &color) {
+  if (!color) return KV1_NO_COLOR;
+  return static_cast<uint32_t>(color->r) << 16 | static_cast<uint32_t>(color->g) << 8 | color->b;
+}
+
+Kv1PublicJourneyPassingTimesColumns::Kv1PublicJourneyPassingTimesColumns(const Kv1Records &records) {
+  auto &pujopass = *this;
+  reserve(pujopass, records.public_journey_passing_times.size());
+  for (const auto &r : records.public_journey_passing_times) {
+    pujopass.data_owner_code.push_back(r.key.data_owner_code);
+    pujopass.organizational_unit_code.push_back(r.key.organizational_unit_code);
+    pujopass.schedule_code.push_back(r.key.schedule_code);
+    pujopass.schedule_type_code.push_back(r.key.schedule_type_code);
+    pujopass.line_planning_number.push_back(r.key.line_planning_number);
+    pujopass.journey_number.push_back(r.key.journey_number);
+    pujopass.stop_order.push_back(r.key.stop_order);
+    pujopass.journey_pattern_code.push_back(r.journey_pattern_code);
+    pujopass.user_stop_code.push_back(r.user_stop_code);
+    pujopass.target_arrival_time_s.push_back(secondsOf(r.target_arrival_time));
+    pujopass.target_departure_time_s.push_back(secondsOf(r.target_departure_time));
+    pujopass.wheelchair_accessible.push_back(r.wheelchair_accessible);
+    pujopass.data_owner_is_operator.push_back(r.data_owner_is_operator);
+    pujopass.planned_monitored.push_back(r.planned_monitored);
+    pujopass.product_formula_type.push_back(valueOr(r.product_formula_type, -1));
+    pujopass.show_flexible_trip.push_back(valueOr(r.show_flexible_trip, KV1_NO_ENUM));
+    pujopass.organizational_unit_row.push_back(rowOf(records.organizational_units, r.p_organizational_unit));
+    pujopass.schedule_version_row.push_back(rowOf(records.schedule_versions, r.p_schedule_version));
+    pujopass.line_row.push_back(rowOf(records.lines, r.p_line));
+    pujopass.journey_pattern_row.push_back(rowOf(records.journey_patterns, r.p_journey_pattern));
+    pujopass.user_stop_row.push_back(rowOf(records.user_stop_points, r.p_user_stop));
+  }
+}
+
+Kv1JourneyPatternTimingLinkColumns::Kv1JourneyPatternTimingLinkColumns(const Kv1Records &records) {
+  auto &jopatili = *this;
+  reserve(jopatili, records.journey_pattern_timing_links.size());
+  for (const auto &r : records.journey_pattern_timing_links) {
+    jopatili.data_owner_code.push_back(r.key.data_owner_code);
+    jopatili.line_planning_number.push_back(r.key.line_planning_number);
+    jopatili.journey_pattern_code.push_back(r.key.journey_pattern_code);
+    jopatili.timing_link_order.push_back(r.key.timing_link_order);
+    jopatili.user_stop_code_begin.push_back(r.user_stop_code_begin);
+    jopatili.user_stop_code_end.push_back(r.user_stop_code_end);
+    jopatili.con_fin_rel_code.push_back(r.con_fin_rel_code);
+    jopatili.dest_code.push_back(r.dest_code);
+    jopatili.is_timing_stop.push_back(r.is_timing_stop);
+    jopatili.display_public_line.push_back(r.display_public_line);
+    jopatili.product_formula_type.push_back(valueOr(r.product_formula_type, -1));
+    jopatili.get_in.push_back(r.get_in);
+    jopatili.get_out.push_back(r.get_out);
+    jopatili.show_flexible_trip.push_back(valueOr(r.show_flexible_trip, KV1_NO_ENUM));
+    jopatili.line_dest_icon.push_back(valueOr(r.line_dest_icon, -1));
+    jopatili.line_dest_color.push_back(colorOf(r.line_dest_color));
+    jopatili.line_dest_text_color.push_back(colorOf(r.line_dest_text_color));
+    jopatili.line_row.push_back(rowOf(records.lines, r.p_line));
+    jopatili.journey_pattern_row.push_back(rowOf(records.journey_patterns, r.p_journey_pattern));
+    jopatili.user_stop_begin_row.push_back(rowOf(records.user_stop_points, r.p_user_stop_begin));
+    jopatili.user_stop_end_row.push_back(rowOf(records.user_stop_points, r.p_user_stop_end));
+    jopatili.con_fin_rel_row.push_back(rowOf(records.concession_financer_relations, r.p_con_fin_rel));
+    jopatili.dest_row.push_back(rowOf(records.destinations, r.p_dest));
+    jopatili.line_dest_icon_row.push_back(rowOf(records.icons, r.p_line_dest_icon));
+  }
+}
+
+Kv1PointOnLinkColumns::Kv1PointOnLinkColumns(const Kv1Records &records) {
+  auto &pool = *this;
+  reserve(pool, records.point_on_links.size());
+  for (const auto &r : records.point_on_links) {
+    pool.data_owner_code.push_back(r.key.data_owner_code);
+    pool.user_stop_code_begin.push_back(r.key.user_stop_code_begin);
+    pool.user_stop_code_end.push_back(r.key.user_stop_code_end);
+    pool.point_data_owner_code.push_back(r.key.point_data_owner_code);
+    pool.point_code.push_back(r.key.point_code);
+    pool.transport_type.push_back(r.key.transport_type);
+    pool.distance_since_start_of_link.push_back(r.distance_since_start_of_link);
+    pool.segment_speed_mps.push_back(valueOrNaN(r.segment_speed_mps));
+    pool.local_point_speed_mps.push_back(valueOrNaN(r.local_point_speed_mps));
+    pool.user_stop_begin_row.push_back(rowOf(records.user_stop_points, r.p_user_stop_begin));
+    pool.user_stop_end_row.push_back(rowOf(records.user_stop_points, r.p_user_stop_end));
+    pool.point_row.push_back(rowOf(records.points, r.p_point));
+  }
+}
+
+Kv1TimeDemandGroupRunTimeColumns::Kv1TimeDemandGroupRunTimeColumns(const Kv1Records &records) {
+  auto &timdemrnt = *this;
+  reserve(timdemrnt, records.time_demand_group_run_times.size());
+  for (const auto &r : records.time_demand_group_run_times) {
+    timdemrnt.data_owner_code.push_back(r.key.data_owner_code);
+    timdemrnt.line_planning_number.push_back(r.key.line_planning_number);
+    timdemrnt.journey_pattern_code.push_back(r.key.journey_pattern_code);
+    timdemrnt.time_demand_group_code.push_back(r.key.time_demand_group_code);
+    timdemrnt.timing_link_order.push_back(r.key.timing_link_order);
+    timdemrnt.user_stop_code_begin.push_back(r.user_stop_code_begin);
+    timdemrnt.user_stop_code_end.push_back(r.user_stop_code_end);
+    timdemrnt.total_drive_time_s.push_back(secondsOf(r.total_drive_time_s));
+    timdemrnt.drive_time_s.push_back(secondsOf(r.drive_time_s));
+    timdemrnt.expected_delay_s.push_back(secondsOf(r.expected_delay_s));
+    timdemrnt.layover_time_s.push_back(secondsOf(r.layover_time));
+    timdemrnt.stop_wait_time_s.push_back(secondsOf(r.stop_wait_time));
+    timdemrnt.minimum_stop_time_s.push_back(secondsOf(r.minimum_stop_time));
+    timdemrnt.line_row.push_back(rowOf(records.lines, r.p_line));
+    timdemrnt.user_stop_begin_row.push_back(rowOf(records.user_stop_points, r.p_user_stop_begin));
+    timdemrnt.user_stop_end_row.push_back(rowOf(records.user_stop_points, r.p_user_stop_end));
+    timdemrnt.journey_pattern_row.push_back(rowOf(records.journey_patterns, r.p_journey_pattern));
+    timdemrnt.time_demand_group_row.push_back(rowOf(records.time_demand_groups, r.p_time_demand_group));
+    timdemrnt.journey_pattern_timing_link_row.push_back(
+      rowOf(records.journey_pattern_timing_links, r.p_journey_pattern_timing_link));
+  }
+}
+
+Kv1Columns::Kv1Columns(const Kv1Records &records)
+  : public_journey_passing_times(records),
+    journey_pattern_timing_links(records),
+    point_on_links(records),
+    time_demand_group_run_times(records)
+{}
+
+size_t Kv1Columns::memoryUsage() const {
+  return memoryUsageOf(public_journey_passing_times)
+       + memoryUsageOf(journey_pattern_timing_links)
+       + memoryUsageOf(point_on_links)
+       + memoryUsageOf(time_demand_group_run_times);
+}
@@ -0,0 +1,216 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include <tmi8/kv1_diff.hpp>
+#include <tmi8/kv1_fields.hpp>
+
+size_t Kv1Diff::size() const {
+  return 0
+#define X(type, table) + table.size()
+  KV1_TABLES
+#undef X
+  ;
+}
+
+namespace {
+  // Encodes all fields of a record but the references to other records, such
+  // that two records have the same encoding if and only if those fields are
+  // equal. Symbols are encoded by their ID, so encodings are only comparable
+  // within the process that made them.
+  struct Encoder {
+    template<typename T>
+    void raw(T value) {
+      out.append(reinterpret_cast<const char *>(&value), sizeof value);
+    }
+
+    template<typename T>
+    void operator()(std::string_view, const T &value) { (*this)(value); }
+
+    void operator()(const std::string &value) {
+      raw(value.size());
+      out.append(value);
+    }
+    void operator()(Kv1Symbol value) { raw(value.id()); }
+    void operator()(bool value) { raw<uint8_t>(value); }
+    void operator()(char value) { raw(value); }
+    void operator()(short value) { raw(value); }
+    void operator()(int value) { raw(value); }
+    void operator()(double value) { raw(value); }
+    void operator()(RgbColor value) { raw(value.r); raw(value.g); raw(value.b); }
+    void operator()(Kv1WheelchairAccessibility value) { raw<uint8_t>(value); }
+    void operator()(Kv1ShowFlexibleTrip value) { raw<uint8_t>(value); }
+    void operator()(Kv1DayType value) { raw(value.weekdays); }
+    void operator()(std::chrono::year_month_day value) {
+      raw(std::chrono::sys_days(value).time_since_epoch().count());
+    }
+    void operator()(std::chrono::sys_seconds value) {
+      raw(value.time_since_epoch().count());
+    }
+    void operator()(std::chrono::hh_mm_ss<std::chrono::seconds> value) {
+      raw(value.to_duration().count());
+    }
+
+    template<typename T>
+    void operator()(const std::optional<T> &value) {
+      raw<uint8_t>(value.has_value());
+      if (value) (*this)(*value);
+    }
+
+    template<typename T>
+    void operator()(T *const &) {}
+
+    template<typename T>
+    const std::string &encode(const T &record) {
+      out.clear();
+      kv1Fields(*this, record);
+      return out;
+    }
+
+    std::string out;
+  };
+
+  // Tells if records refer to any table of which the records have moved
+  struct MovedReferences {
+    explicit MovedReferences(const std::array<bool, KV1_N_TABLES> &moved) : moved(moved) {}
+
+    template<typename T>
+    void operator()(std::string_view, T *const &) { found = found || moved[kv1TableNumber<T>()]; }
+    template<typename T>
+    void operator()(std::string_view, const T &) {}
+
+    const std::array<bool, KV1_N_TABLES> &moved;
+    bool found = false;
+  };
+}
+
+template<typename T>
+static void diffTable(Kv1TableDiff &diff, const Kv1IndexTable<T> &old_index,
+                      const std::vector<T> &old_records, const std::vector<T> &new_records) {
+  Encoder old_encoder, new_encoder;
+  std::vector<bool> matched(old_records.size());
+  // New deliveries mostly have the records in the same order, so the record
+  // following the last matched old record is tried before the index.
+  size_t next = 0;
+  for (size_t j = 0; j < new_records.size(); j++) {
+    const T *old = next < old_records.size() && old_records[next].key == new_records[j].key
+      ? &old_records[next]
+      : old_index.find(new_records[j].key);
+    // Of multiple new records with the same key, only the first one is matched
+    // with the old record. The others are added, so that all of them end up in
+    // the table, as when the new records would be loaded from scratch.
+    size_t i = old ? static_cast<size_t>(old - old_records.data()) : 0;
+    if (!old || matched[i]) {
+      diff.added.push_back(j);
+      continue;
+    }
+    matched[i] = true;
+    next = i + 1;
+    if (old_encoder.encode(*old) != new_encoder.encode(new_records[j]))
+      diff.changed.emplace_back(i, j);
+  }
+  for (size_t i = 0; i < old_records.size(); i++)
+    if (!matched[i]) diff.removed.push_back(i);
+}
+
+static void diffTable(Kv1TableDiff &diff, const std::vector<Kv1NoticeAssignment> &old_records,
+                      const std::vector<Kv1NoticeAssignment> &new_records) {
+  Encoder encoder;
+  std::unordered_multimap<std::string, size_t> unmatched;
+  for (size_t i = 0; i < old_records.size(); i++)
+    unmatched.emplace(encoder.encode(old_records[i]), i);
+  for (size_t j = 0; j < new_records.size(); j++) {
+    auto it = unmatched.find(encoder.encode(new_records[j]));
+    if (it == unmatched.end()) diff.added.push_back(j);
+    else unmatched.erase(it);
+  }
+  for (const auto &[_, i] : unmatched)
+    diff.removed.push_back(i);
+  std::sort(diff.removed.begin(), diff.removed.end());
+}
+
+Kv1Diff kv1Diff(const Kv1Index &old_index, const Kv1Records &new_records) {
+  const Kv1Records &old_records = *old_index.records;
+  Kv1Diff diff;
+#define X(type, table) diffTable(diff.table, old_index.table, old_records.table, new_records.table);
+  KV1_INDEXED_TABLES
+#undef X
+  diffTable(diff.notice_assignments, old_records.notice_assignments, new_records.notice_assignments);
+  return diff;
+}
+
+// Applies the diff of a single table. Adds the rows of the records that have
+// to be linked again to relink, and returns whether the records of the table
+// have moved, which is the case if any records were added or removed.
+template<typename T>
+static bool applyTableDiff(std::vector<T> &records, std::vector<T> &new_records,
+                           const Kv1TableDiff &diff, std::vector<size_t> &relink) {
+  for (auto [i, j] : diff.changed)
+    records[i] = std::move(new_records[j]);
+  if (diff.added.empty() && diff.removed.empty()) {
+    for (auto [i, _] : diff.changed) relink.push_back(i);
+    return false;
+  }
+
+  std::vector<bool> removed(records.size()), changed(records.size());
+  for (size_t i : diff.removed) removed[i] = true;
+  for (auto [i, _] : diff.changed) changed[i] = true;
+  size_t n = 0;
+  for (size_t i = 0; i < records.size(); i++) {
+    if (removed[i]) continue;
+    if (changed[i]) relink.push_back(n);
+    if (n != i) records[n] = std::move(records[i]);
+    n++;
+  }
+  records.erase(records.begin() + static_cast<std::ptrdiff_t>(n), records.end());
+  for (size_t j : diff.added) {
+    relink.push_back(records.size());
+    records.push_back(std::move(new_records[j]));
+  }
+  return true;
+}
+
+template<typename T>
+static void relinkTable(const Kv1Index &index, std::vector<T> &records, const std::vector<size_t> &rows,
+                        const std::array<bool, KV1_N_TABLES> &moved) {
+  if constexpr (requires (T &record) { kv1LinkRecord(index, record); }) {
+    if (records.empty()) return;
+    // Which tables a record refers to only depends on its type
+    MovedReferences references(moved);
+    kv1Fields(references, std::as_const(records.front()));
+    if (references.found) {
+      for (T &record : records) kv1LinkRecord(index, record);
+    } else {
+      for (size_t i : rows) kv1LinkRecord(index, records[i]);
+    }
+  }
+}
+
+void kv1ApplyDiff(Kv1Index &index, Kv1Records &&new_records, const Kv1Diff &diff) {
+  Kv1Records &records = *index.records;
+  std::array<bool, KV1_N_TABLES> moved{};
+  std::array<std::vector<size_t>, KV1_N_TABLES> relink;
+#define X(type, table) \
+  moved[kv1TableNumber<type>()] = applyTableDiff(records.table, new_records.table, diff.table, relink[kv1TableNumber<type>()]);
+  KV1_TABLES
+#undef X
+
+#define X(type, table) if (moved[kv1TableNumber<type>()]) index.table.build(records.table);
+  KV1_INDEXED_TABLES
+#undef X
+
+#define X(type, table) relinkTable(index, records.table, relink[kv1TableNumber<type>()], moved);
+  KV1_TABLES
+#undef X
+
+  if (diff.size() > 0) index.resetSecondaryIndexes();
+}
@@ -0,0 +1,96 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#include <algorithm>
+
+#include <tmi8/kv1_geometry.hpp>
+
+Kv1JourneyPatternGeometry::Kv1JourneyPatternGeometry(const Kv1Records &records, const Kv1Index &index)
+  : records(&records)
+{
+  const size_t n_jopas = records.journey_patterns.size();
+  const Kv1JourneyPattern *jopas = records.journey_patterns.data();
+
+  // Group the timing links by journey pattern (a counting sort), and then put
+  // every group in timing link order.
+  std::vector<size_t> jopatili_offsets(n_jopas + 1, 0);
+  for (const auto &jopatili : records.journey_pattern_timing_links)
+    if (jopatili.p_journey_pattern)
+      jopatili_offsets[jopatili.p_journey_pattern - jopas + 1]++;
+  for (size_t i = 0; i < n_jopas; i++)
+    jopatili_offsets[i + 1] += jopatili_offsets[i];
+  std::vector<const Kv1JourneyPatternTimingLink *> jopatilis(jopatili_offsets[n_jopas]);
+  {
+    std::vector<size_t> next(jopatili_offsets.begin(), jopatili_offsets.end() - 1);
+    for (const auto &jopatili : records.journey_pattern_timing_links)
+      if (jopatili.p_journey_pattern)
+        jopatilis[next[jopatili.p_journey_pattern - jopas]++] = &jopatili;
+  }
+  for (size_t i = 0; i < n_jopas; i++) {
+    std::sort(jopatilis.begin() + static_cast<ptrdiff_t>(jopatili_offsets[i]),
+              jopatilis.begin() + static_cast<ptrdiff_t>(jopatili_offsets[i + 1]),
+              [](const Kv1JourneyPatternTimingLink *a, const Kv1JourneyPatternTimingLink *b) {
+                return a->key.timing_link_order < b->key.timing_link_order;
+              });
+  }
+
+  stop_offsets.reserve(n_jopas + 1);
+  point_offsets.reserve(n_jopas + 1);
+  stops.reserve(jopatilis.size() + n_jopas);
+  for (size_t i = 0; i < n_jopas; i++) {
+    stop_offsets.push_back(stops.size());
+    point_offsets.push_back(points.size());
+
+    const Kv1JourneyPattern &jopa = jopas[i];
+    const Kv1Line *line = jopa.p_line;
+
+    double distance_since_start_of_journey = 0;
+    for (size_t j = jopatili_offsets[i]; j < jopatili_offsets[i + 1]; j++) {
+      const Kv1JourneyPatternTimingLink *jopatili = jopatilis[j];
+      // Without a line, the transport type of the link is unknown
+      const Kv1Link *link = nullptr;
+      std::span<Kv1PointOnLink *const> pools;
+      if (line) {
+        const Kv1Link::Key link_key(
+          jopatili->key.data_owner_code,
+          jopatili->user_stop_code_begin,
+          jopatili->user_stop_code_end,
+          line->transport_type);
+        link = index.links.find(link_key);
+        pools = index.pointOnLinksOf(link_key);
+      }
+      const double link_distance = link ? link->distance : 0;
+
+      stops.emplace_back(jopatili, jopatili->p_user_stop_begin, distance_since_start_of_journey);
+
+      const Kv1Point *begin_point = jopatili->p_user_stop_begin ? jopatili->p_user_stop_begin->p_point : nullptr;
+      const Kv1Point *end_point   = jopatili->p_user_stop_end   ? jopatili->p_user_stop_end->p_point   : nullptr;
+      points.emplace_back(true, jopatili, link, begin_point, 0, distance_since_start_of_journey);
+      for (const Kv1PointOnLink *pool : pools) {
+        points.emplace_back(false, jopatili, link, pool->p_point, pool->distance_since_start_of_link,
+                            distance_since_start_of_journey + pool->distance_since_start_of_link);
+      }
+      points.emplace_back(true, jopatili, link, end_point, link_distance,
+                          distance_since_start_of_journey + link_distance);
+
+      distance_since_start_of_journey += link_distance;
+    }
+    if (jopatili_offsets[i + 1] > jopatili_offsets[i]) {
+      const Kv1JourneyPatternTimingLink *last = jopatilis[jopatili_offsets[i + 1] - 1];
+      stops.emplace_back(last, last->p_user_stop_end, distance_since_start_of_journey);
+    }
+  }
+  stop_offsets.push_back(stops.size());
+  point_offsets.push_back(points.size());
+}
+
+std::span<const Kv1JourneyPatternGeometry::Stop> Kv1JourneyPatternGeometry::stopsOf(const Kv1JourneyPattern *jopa) const {
+  size_t i = static_cast<size_t>(jopa - records->journey_patterns.data());
+  return std::span(stops).subspan(stop_offsets[i], stop_offsets[i + 1] - stop_offsets[i]);
+}
+
+std::span<const Kv1JourneyPatternGeometry::Point> Kv1JourneyPatternGeometry::pointsOf(const Kv1JourneyPattern *jopa) const {
+  size_t i = static_cast<size_t>(jopa - records->journey_patterns.data());
+  return std::span(points).subspan(point_offsets[i], point_offsets[i + 1] - point_offsets[i]);
+}
@@ -2,151 +2,85 @@
 //
 // Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+
 #include <tmi8/kv1_index.hpp>
 
-Kv1Index::Kv1Index(Kv1Records *records) : records(records) {
-  organizational_units.reserve(records->organizational_units.size());
-  for (size_t i = 0; i < records->organizational_units.size(); i++)  {
-    auto *it = &records->organizational_units[i];
-    organizational_units[it->key] = it;
-  }
-  higher_organizational_units.reserve(records->higher_organizational_units.size());
-  for (size_t i = 0; i < records->higher_organizational_units.size(); i++) {
-    auto *it = &records->higher_organizational_units[i];
-    higher_organizational_units[it->key] = it;
-  }
-  user_stop_points.reserve(records->user_stop_points.size());
-  for (size_t i = 0; i < records->user_stop_points.size(); i++) {
-    auto *it = &records->user_stop_points[i];
-    user_stop_points[it->key] = it;
-  }
-  user_stop_areas.reserve(records->user_stop_areas.size());
-  for (size_t i = 0; i < records->user_stop_areas.size(); i++) {
-    auto *it = &records->user_stop_areas[i];
-    user_stop_areas[it->key] = it;
-  }
-  timing_links.reserve(records->timing_links.size());
-  for (size_t i = 0; i < records->timing_links.size(); i++) {
-    auto *it = &records->timing_links[i];
-    timing_links[it->key] = it;
-  }
-  links.reserve(records->links.size());
-  for (size_t i = 0; i < records->links.size(); i++) {
-    auto *it = &records->links[i];
-    links[it->key] = it;
-  }
-  lines.reserve(records->lines.size());
-  for (size_t i = 0; i < records->lines.size(); i++) {
-    auto *it = &records->lines[i];
-    lines[it->key] = it;
-  }
-  destinations.reserve(records->destinations.size());
-  for (size_t i = 0; i < records->destinations.size(); i++) {
-    auto *it = &records->destinations[i];
-    destinations[it->key] = it;
-  }
-  journey_patterns.reserve(records->journey_patterns.size());
-  for (size_t i = 0; i < records->journey_patterns.size(); i++) {
-    auto *it = &records->journey_patterns[i];
-    journey_patterns[it->key] = it;
-  }
-  concession_financer_relations.reserve(records->concession_financer_relations.size());
-  for (size_t i = 0; i < records->concession_financer_relations.size(); i++) {
-    auto *it = &records->concession_financer_relations[i];
-    concession_financer_relations[it->key] = it;
-  }
-  concession_areas.reserve(records->concession_areas.size());
-  for (size_t i = 0; i < records->concession_areas.size(); i++) {
-    auto *it = &records->concession_areas[i];
-    concession_areas[it->key] = it;
-  }
-  financers.reserve(records->financers.size());
-  for (size_t i = 0; i < records->financers.size(); i++) {
-    auto *it = &records->financers[i];
-    financers[it->key] = it;
-  }
-  journey_pattern_timing_links.reserve(records->journey_pattern_timing_links.size());
-  for (size_t i = 0; i < records->journey_pattern_timing_links.size(); i++) {
-    auto *it = &records->journey_pattern_timing_links[i];
-    journey_pattern_timing_links[it->key] = it;
-  }
-  points.reserve(records->points.size());
-  for (size_t i = 0; i < records->points.size(); i++) {
-    auto *it = &records->points[i];
-    points[it->key] = it;
-  }
-  point_on_links.reserve(records->point_on_links.size());
-  for (size_t i = 0; i < records->point_on_links.size(); i++) {
-    auto *it = &records->point_on_links[i];
-    point_on_links[it->key] = it;
-  }
-  icons.reserve(records->icons.size());
-  for (size_t i = 0; i < records->icons.size(); i++) {
-    auto *it = &records->icons[i];
-    icons[it->key] = it;
+// Runs the tasks on at most n_threads threads, which take the tasks in order.
+static void runTasks(const std::vector<std::function<void()>> &tasks, unsigned n_threads) {
+  size_t n = std::min<size_t>(std::max(n_threads, 1u), tasks.size());
+  if (n <= 1) {
+    for (const auto &task : tasks) task();
+    return;
   }
-  notices.reserve(records->notices.size());
-  for (size_t i = 0; i < records->notices.size(); i++) {
-    auto *it = &records->notices[i];
-    notices[it->key] = it;
-  }
-  time_demand_groups.reserve(records->time_demand_groups.size());
-  for (size_t i = 0; i < records->time_demand_groups.size(); i++) {
-    auto *it = &records->time_demand_groups[i];
-    time_demand_groups[it->key] = it;
-  }
-  time_demand_group_run_times.reserve(records->time_demand_group_run_times.size());
-  for (size_t i = 0; i < records->time_demand_group_run_times.size(); i++) {
-    auto *it = &records->time_demand_group_run_times[i];
-    time_demand_group_run_times[it->key] = it;
-  }
-  period_groups.reserve(records->period_groups.size());
-  for (size_t i = 0; i < records->period_groups.size(); i++) {
-    auto *it = &records->period_groups[i];
-    period_groups[it->key] = it;
-  }
-  specific_days.reserve(records->specific_days.size());
-  for (size_t i = 0; i < records->specific_days.size(); i++) {
-    auto *it = &records->specific_days[i];
-    specific_days[it->key] = it;
-  }
-  timetable_versions.reserve(records->timetable_versions.size());
-  for (size_t i = 0; i < records->timetable_versions.size(); i++) {
-    auto *it = &records->timetable_versions[i];
-    timetable_versions[it->key] = it;
-  }
-  public_journeys.reserve(records->public_journeys.size());
-  for (size_t i = 0; i < records->public_journeys.size(); i++) {
-    auto *it = &records->public_journeys[i];
-    public_journeys[it->key] = it;
-  }
-  period_group_validities.reserve(records->period_group_validities.size());
-  for (size_t i = 0; i < records->period_group_validities.size(); i++) {
-    auto *it = &records->period_group_validities[i];
-    period_group_validities[it->key] = it;
-  }
-  exceptional_operating_days.reserve(records->exceptional_operating_days.size());
-  for (size_t i = 0; i < records->exceptional_operating_days.size(); i++) {
-    auto *it = &records->exceptional_operating_days[i];
-    exceptional_operating_days[it->key] = it;
-  }
-  schedule_versions.reserve(records->schedule_versions.size());
-  for (size_t i = 0; i < records->schedule_versions.size(); i++) {
-    auto *it = &records->schedule_versions[i];
-    schedule_versions[it->key] = it;
-  }
-  public_journey_passing_times.reserve(records->public_journey_passing_times.size());
-  for (size_t i = 0; i < records->public_journey_passing_times.size(); i++) {
-    auto *it = &records->public_journey_passing_times[i];
-    public_journey_passing_times[it->key] = it;
-  }
-  operating_days.reserve(records->operating_days.size());
-  for (size_t i = 0; i < records->operating_days.size(); i++) {
-    auto *it = &records->operating_days[i];
-    operating_days[it->key] = it;
+
+  std::atomic<size_t> next = 0;
+  std::vector<std::jthread> threads;
+  for (size_t i = 0; i < n; i++) {
+    threads.emplace_back([&tasks, &next]() {
+      for (size_t j; (j = next.fetch_add(1, std::memory_order_relaxed)) < tasks.size();)
+        tasks[j]();
+    });
   }
 }
 
+namespace {
+  struct BuildTask {
+    size_t size;
+    std::function<void()> build;
+  };
+}
+
+template<typename T>
+static void addBuildTask(std::vector<BuildTask> &tasks, Kv1IndexTable<T> &table, std::vector<T> &records) {
+  tasks.push_back({ records.size(), [&table, &records]() { table.build(records); } });
+}
+
+Kv1Index::Kv1Index(Kv1Records *records, unsigned n_threads) : records(records) {
+  std::vector<BuildTask> tasks;
+  addBuildTask(tasks, organizational_units, records->organizational_units);
+  addBuildTask(tasks, higher_organizational_units, records->higher_organizational_units);
+  addBuildTask(tasks, user_stop_points, records->user_stop_points);
+  addBuildTask(tasks, user_stop_areas, records->user_stop_areas);
+  addBuildTask(tasks, timing_links, records->timing_links);
+  addBuildTask(tasks, links, records->links);
+  addBuildTask(tasks, lines, records->lines);
+  addBuildTask(tasks, destinations, records->destinations);
+  addBuildTask(tasks, journey_patterns, records->journey_patterns);
+  addBuildTask(tasks, concession_financer_relations, records->concession_financer_relations);
+  addBuildTask(tasks, concession_areas, records->concession_areas);
+  addBuildTask(tasks, financers, records->financers);
+  addBuildTask(tasks, journey_pattern_timing_links, records->journey_pattern_timing_links);
+  addBuildTask(tasks, points, records->points);
+  addBuildTask(tasks, point_on_links, records->point_on_links);
+  addBuildTask(tasks, icons, records->icons);
+  addBuildTask(tasks, notices, records->notices);
+  addBuildTask(tasks, time_demand_groups, records->time_demand_groups);
+  addBuildTask(tasks, time_demand_group_run_times, records->time_demand_group_run_times);
+  addBuildTask(tasks, period_groups, records->period_groups);
+  addBuildTask(tasks, specific_days, records->specific_days);
+  addBuildTask(tasks, timetable_versions, records->timetable_versions);
+  addBuildTask(tasks, public_journeys, records->public_journeys);
+  addBuildTask(tasks, period_group_validities, records->period_group_validities);
+  addBuildTask(tasks, exceptional_operating_days, records->exceptional_operating_days);
+  addBuildTask(tasks, schedule_versions, records->schedule_versions);
+  addBuildTask(tasks, public_journey_passing_times, records->public_journey_passing_times);
+  addBuildTask(tasks, operating_days, records->operating_days);
+  // The tables are built by whichever thread is free first, so starting with
+  // the largest ones keeps the threads busy until the end.
+  std::stable_sort(tasks.begin(), tasks.end(), [](const BuildTask &a, const BuildTask &b) {
+    return a.size > b.size;
+  });
+  std::vector<std::function<void()>> builds;
+  for (auto &task : tasks)
+    builds.push_back(std::move(task.build));
+  runTasks(builds, n_threads);
+}
+
 size_t Kv1Index::size() const {
   return organizational_units.size()
        + higher_organizational_units.size()
@@ -178,286 +112,456 @@ size_t Kv1Index::size() const {
        + operating_days.size();
 }
 
-void kv1LinkRecords(Kv1Index &index) {
-  for (auto &orunorun : index.records->higher_organizational_units) {
-    Kv1OrganizationalUnit::Key orun_parent_key(
-      orunorun.key.data_owner_code,
-      orunorun.key.organizational_unit_code_parent);
-    Kv1OrganizationalUnit::Key orun_child_key(
-      orunorun.key.data_owner_code,
-      orunorun.key.organizational_unit_code_child);
-    orunorun.p_organizational_unit_parent = index.organizational_units[orun_parent_key];
-    orunorun.p_organizational_unit_child  = index.organizational_units[orun_child_key];
-  }
-  for (auto &usrstop : index.records->user_stop_points) {
-    Kv1Point::Key point_key(
-      usrstop.key.data_owner_code,
-      usrstop.key.user_stop_code);
-    usrstop.p_point = index.points[point_key];
-    if (!usrstop.user_stop_area_code.empty()) {
-      Kv1UserStopArea::Key usrstar_key(
-        usrstop.key.data_owner_code,
-        usrstop.user_stop_area_code);
-      usrstop.p_user_stop_area = index.user_stop_areas[usrstar_key];
+size_t Kv1Index::memoryUsage() const {
+  return organizational_units.memoryUsage()
+       + higher_organizational_units.memoryUsage()
+       + user_stop_points.memoryUsage()
+       + user_stop_areas.memoryUsage()
+       + timing_links.memoryUsage()
+       + links.memoryUsage()
+       + lines.memoryUsage()
+       + destinations.memoryUsage()
+       + journey_patterns.memoryUsage()
+       + concession_financer_relations.memoryUsage()
+       + concession_areas.memoryUsage()
+       + financers.memoryUsage()
+       + journey_pattern_timing_links.memoryUsage()
+       + points.memoryUsage()
+       + point_on_links.memoryUsage()
+       + icons.memoryUsage()
+       + notices.memoryUsage()
+       + time_demand_groups.memoryUsage()
+       + time_demand_group_run_times.memoryUsage()
+       + period_groups.memoryUsage()
+       + specific_days.memoryUsage()
+       + timetable_versions.memoryUsage()
+       + public_journeys.memoryUsage()
+       + period_group_validities.memoryUsage()
+       + exceptional_operating_days.memoryUsage()
+       + schedule_versions.memoryUsage()
+       + public_journey_passing_times.memoryUsage()
+       + operating_days.memoryUsage();
+}
+
+std::span<Kv1PublicJourney *const> Kv1Index::publicJourneysByNumber(Kv1Symbol line_planning_number, int journey_number) const {
+  std::call_once(public_journeys_by_number.built, [this]() {
+    for (auto &pujo : records->public_journeys)
+      public_journeys_by_number.groups[{ pujo.key.line_planning_number, pujo.key.journey_number }].push_back(&pujo);
+  });
+  return public_journeys_by_number.find({ line_planning_number, journey_number });
+}
+
+std::span<Kv1JourneyPatternTimingLink *const> Kv1Index::journeyPatternTimingLinksOf(const Kv1JourneyPattern::Key &jopa) const {
+  std::call_once(journey_pattern_timing_links_by_jopa.built, [this]() {
+    auto &groups = journey_pattern_timing_links_by_jopa.groups;
+    for (auto &jopatili : records->journey_pattern_timing_links) {
+      Kv1JourneyPattern::Key jopa_key(
+        jopatili.key.data_owner_code,
+        jopatili.key.line_planning_number,
+        jopatili.key.journey_pattern_code);
+      groups[jopa_key].push_back(&jopatili);
     }
-  }
-  for (auto &tili : index.records->timing_links) {
-    Kv1UserStopPoint::Key usrstop_begin_key(
-      tili.key.data_owner_code,
-      tili.key.user_stop_code_begin);
-    Kv1UserStopPoint::Key usrstop_end_key(
-      tili.key.data_owner_code,
-      tili.key.user_stop_code_end);
-    tili.p_user_stop_begin = index.user_stop_points[usrstop_begin_key];
-    tili.p_user_stop_end   = index.user_stop_points[usrstop_end_key];
-  }
-  for (auto &link : index.records->links) {
-    Kv1UserStopPoint::Key usrstop_begin_key(
-      link.key.data_owner_code,
-      link.key.user_stop_code_begin);
-    Kv1UserStopPoint::Key usrstop_end_key(
-      link.key.data_owner_code,
-      link.key.user_stop_code_end);
-    link.p_user_stop_begin = index.user_stop_points[usrstop_begin_key];
-    link.p_user_stop_end   = index.user_stop_points[usrstop_end_key];
-  }
-  for (auto &line : index.records->lines) {
-    if (!line.line_icon)
-      continue;
-    Kv1Icon::Key icon_key(
-      line.key.data_owner_code,
-      *line.line_icon);
-    line.p_line_icon = index.icons[icon_key];
-  }
-  for (auto &jopa : index.records->journey_patterns) {
-    Kv1Line::Key line_key(
-      jopa.key.data_owner_code,
-      jopa.key.line_planning_number);
-    jopa.p_line = index.lines[line_key];
-  }
-  for (auto &confinrel : index.records->concession_financer_relations) {
-    Kv1ConcessionArea::Key conarea_key(
-      confinrel.key.data_owner_code,
-      confinrel.concession_area_code);
-    confinrel.p_concession_area = index.concession_areas[conarea_key];
-    if (!confinrel.financer_code.empty()) {
-      Kv1Financer::Key financer_key(
-        confinrel.key.data_owner_code,
-        confinrel.financer_code);
-      confinrel.p_financer = index.financers[financer_key];
+    for (auto &[_, jopatilis] : groups) {
+      std::stable_sort(jopatilis.begin(), jopatilis.end(), [](const auto *a, const auto *b) {
+        return a->key.timing_link_order < b->key.timing_link_order;
+      });
     }
-  }
-  for (auto &jopatili : index.records->journey_pattern_timing_links) {
-    Kv1Line::Key line_key(
-      jopatili.key.data_owner_code,
-      jopatili.key.line_planning_number);
-    Kv1JourneyPattern::Key jopa_key(
-      jopatili.key.data_owner_code,
-      jopatili.key.line_planning_number,
-      jopatili.key.journey_pattern_code);
-    Kv1UserStopPoint::Key usrstop_begin_key(
-      jopatili.key.data_owner_code,
-      jopatili.user_stop_code_begin);
-    Kv1UserStopPoint::Key usrstop_end_key(
-      jopatili.key.data_owner_code,
-      jopatili.user_stop_code_end);
-    Kv1ConcessionFinancerRelation::Key confinrel_key(
-      jopatili.key.data_owner_code,
-      jopatili.con_fin_rel_code);
-    Kv1Destination::Key dest_key(
-      jopatili.key.data_owner_code,
-      jopatili.dest_code);
-    jopatili.p_line            = index.lines[line_key];
-    jopatili.p_journey_pattern = index.journey_patterns[jopa_key];
-    jopatili.p_user_stop_begin = index.user_stop_points[usrstop_begin_key];
-    jopatili.p_user_stop_end   = index.user_stop_points[usrstop_end_key];
-    jopatili.p_con_fin_rel     = index.concession_financer_relations[confinrel_key];
-    jopatili.p_dest            = index.destinations[dest_key];
-    if (jopatili.line_dest_icon) {
-      Kv1Icon::Key icon_key{
-        jopatili.key.data_owner_code,
-        *jopatili.line_dest_icon,
-      };
-      jopatili.p_line_dest_icon = index.icons[icon_key];
+  });
+  return journey_pattern_timing_links_by_jopa.find(jopa);
+}
+
+std::span<Kv1PointOnLink *const> Kv1Index::pointOnLinksOf(const Kv1Link::Key &link) const {
+  std::call_once(point_on_links_by_link.built, [this]() {
+    auto &groups = point_on_links_by_link.groups;
+    for (auto &pool : records->point_on_links) {
+      Kv1Link::Key link_key(
+        pool.key.data_owner_code,
+        pool.key.user_stop_code_begin,
+        pool.key.user_stop_code_end,
+        pool.key.transport_type);
+      groups[link_key].push_back(&pool);
     }
+    for (auto &[_, pools] : groups) {
+      std::stable_sort(pools.begin(), pools.end(), [](const auto *a, const auto *b) {
+        return a->distance_since_start_of_link < b->distance_since_start_of_link;
+      });
+    }
+  });
+  return point_on_links_by_link.find(link);
+}
+
+std::span<Kv1TimeDemandGroupRunTime *const> Kv1Index::timeDemandGroupRunTimesOf(const Kv1TimeDemandGroup::Key &timdemgrp) const {
+  std::call_once(time_demand_group_run_times_by_timdemgrp.built, [this]() {
+    auto &groups = time_demand_group_run_times_by_timdemgrp.groups;
+    for (auto &timdemrnt : records->time_demand_group_run_times) {
+      Kv1TimeDemandGroup::Key timdemgrp_key(
+        timdemrnt.key.data_owner_code,
+        timdemrnt.key.line_planning_number,
+        timdemrnt.key.journey_pattern_code,
+        timdemrnt.key.time_demand_group_code);
+      groups[timdemgrp_key].push_back(&timdemrnt);
+    }
+    for (auto &[_, timdemrnts] : groups) {
+      std::stable_sort(timdemrnts.begin(), timdemrnts.end(), [](const auto *a, const auto *b) {
+        return a->key.timing_link_order < b->key.timing_link_order;
+      });
+    }
+  });
+  return time_demand_group_run_times_by_timdemgrp.find(timdemgrp);
+}
+
+// A std::once_flag cannot be reset, so the secondary indexes are destroyed and
+// constructed again instead.
+template<typename K, typename T>
+static void reset(Kv1MultiIndex<K, T> &index) {
+  std::destroy_at(&index);
+  std::construct_at(&index);
+}
+
+void Kv1Index::resetSecondaryIndexes() {
+  reset(public_journeys_by_number);
+  reset(journey_pattern_timing_links_by_jopa);
+  reset(point_on_links_by_link);
+  reset(time_demand_group_run_times_by_timdemgrp);
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1HigherOrganizationalUnit &orunorun) {
+  Kv1OrganizationalUnit::Key orun_parent_key(
+    orunorun.key.data_owner_code,
+    orunorun.key.organizational_unit_code_parent);
+  Kv1OrganizationalUnit::Key orun_child_key(
+    orunorun.key.data_owner_code,
+    orunorun.key.organizational_unit_code_child);
+  orunorun.p_organizational_unit_parent = index.organizational_units.find(orun_parent_key);
+  orunorun.p_organizational_unit_child  = index.organizational_units.find(orun_child_key);
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1UserStopPoint &usrstop) {
+  Kv1Point::Key point_key(
+    usrstop.key.data_owner_code,
+    usrstop.key.user_stop_code);
+  usrstop.p_point = index.points.find(point_key);
+  if (!usrstop.user_stop_area_code.empty()) {
+    Kv1UserStopArea::Key usrstar_key(
+      usrstop.key.data_owner_code,
+      usrstop.user_stop_area_code);
+    usrstop.p_user_stop_area = index.user_stop_areas.find(usrstar_key);
   }
-  for (auto &pool : index.records->point_on_links) {
-    Kv1UserStopPoint::Key usrstop_begin_key(
-      pool.key.data_owner_code,
-      pool.key.user_stop_code_begin);
-    Kv1UserStopPoint::Key usrstop_end_key(
-      pool.key.data_owner_code,
-      pool.key.user_stop_code_end);
-    Kv1Point::Key point_key(
-      pool.key.point_data_owner_code,
-      pool.key.point_code);
-    pool.p_user_stop_begin = index.user_stop_points[usrstop_begin_key];
-    pool.p_user_stop_end   = index.user_stop_points[usrstop_end_key];
-    pool.p_point           = index.points[point_key];
-  }
-  for (auto &ntcassgnm : index.records->notice_assignments) {
-    Kv1Notice::Key notice_key(
-      ntcassgnm.data_owner_code,
-      ntcassgnm.notice_code);
-    ntcassgnm.p_notice = index.notices[notice_key];
-  }
-  for (auto &timdemgrp : index.records->time_demand_groups) {
-    Kv1Line::Key line_key(
-      timdemgrp.key.data_owner_code,
-      timdemgrp.key.line_planning_number);
-    Kv1JourneyPattern::Key jopa_key(
-      timdemgrp.key.data_owner_code,
-      timdemgrp.key.line_planning_number,
-      timdemgrp.key.journey_pattern_code);
-    timdemgrp.p_line            = index.lines[line_key];
-    timdemgrp.p_journey_pattern = index.journey_patterns[jopa_key];
-  }
-  for (auto &timdemrnt : index.records->time_demand_group_run_times) {
-    Kv1Line::Key line_key(
-      timdemrnt.key.data_owner_code,
-      timdemrnt.key.line_planning_number);
-    Kv1JourneyPattern::Key jopa_key(
-      timdemrnt.key.data_owner_code,
-      timdemrnt.key.line_planning_number,
-      timdemrnt.key.journey_pattern_code);
-    Kv1TimeDemandGroup::Key timdemgrp_key(
-      timdemrnt.key.data_owner_code,
-      timdemrnt.key.line_planning_number,
-      timdemrnt.key.journey_pattern_code,
-      timdemrnt.key.time_demand_group_code);
-    Kv1UserStopPoint::Key usrstop_begin_key(
-      timdemrnt.key.data_owner_code,
-      timdemrnt.user_stop_code_begin);
-    Kv1UserStopPoint::Key usrstop_end_key(
-      timdemrnt.key.data_owner_code,
-      timdemrnt.user_stop_code_end);
-    Kv1JourneyPatternTimingLink::Key jopatili_key(
-      timdemrnt.key.data_owner_code,
-      timdemrnt.key.line_planning_number,
-      timdemrnt.key.journey_pattern_code,
-      timdemrnt.key.timing_link_order);
-    timdemrnt.p_line                        = index.lines[line_key];
-    timdemrnt.p_user_stop_end               = index.user_stop_points[usrstop_end_key];
-    timdemrnt.p_user_stop_begin             = index.user_stop_points[usrstop_begin_key];
-    timdemrnt.p_journey_pattern             = index.journey_patterns[jopa_key];
-    timdemrnt.p_time_demand_group           = index.time_demand_groups[timdemgrp_key];
-    timdemrnt.p_journey_pattern_timing_link = index.journey_pattern_timing_links[jopatili_key];
-  }
-  for (auto &tive : index.records->timetable_versions) {
-    Kv1OrganizationalUnit::Key orun_key(
-      tive.key.data_owner_code,
-      tive.key.organizational_unit_code);
-    Kv1PeriodGroup::Key pegr_key(
-      tive.key.data_owner_code,
-      tive.key.period_group_code);
-    Kv1SpecificDay::Key specday_key(
-      tive.key.data_owner_code,
-      tive.key.specific_day_code);
-    tive.p_organizational_unit = index.organizational_units[orun_key];
-    tive.p_period_group        = index.period_groups[pegr_key];
-    tive.p_specific_day        = index.specific_days[specday_key];
-  }
-  for (auto &pujo : index.records->public_journeys) {
-    Kv1TimetableVersion::Key tive_key(
-      pujo.key.data_owner_code,
-      pujo.key.organizational_unit_code,
-      pujo.key.timetable_version_code,
-      pujo.key.period_group_code,
-      pujo.key.specific_day_code);
-    Kv1OrganizationalUnit::Key orun_key(
-      pujo.key.data_owner_code,
-      pujo.key.organizational_unit_code);
-    Kv1PeriodGroup::Key pegr_key(
-      pujo.key.data_owner_code,
-      pujo.key.period_group_code);
-    Kv1SpecificDay::Key specday_key(
-      pujo.key.data_owner_code,
-      pujo.key.specific_day_code);
-    Kv1Line::Key line_key(
-      pujo.key.data_owner_code,
-      pujo.key.line_planning_number);
-    Kv1TimeDemandGroup::Key timdemgrp_key(
-      pujo.key.data_owner_code,
-      pujo.key.line_planning_number,
-      pujo.journey_pattern_code,
-      pujo.time_demand_group_code);
-    Kv1JourneyPattern::Key jopa_key(
-      pujo.key.data_owner_code,
-      pujo.key.line_planning_number,
-      pujo.journey_pattern_code);
-    pujo.p_timetable_version   = index.timetable_versions[tive_key];
-    pujo.p_organizational_unit = index.organizational_units[orun_key];
-    pujo.p_period_group        = index.period_groups[pegr_key];
-    pujo.p_specific_day        = index.specific_days[specday_key];
-    pujo.p_line                = index.lines[line_key];
-    pujo.p_time_demand_group   = index.time_demand_groups[timdemgrp_key];
-    pujo.p_journey_pattern     = index.journey_patterns[jopa_key];
-  }
-  for (auto &pegrval : index.records->period_group_validities) {
-    Kv1OrganizationalUnit::Key orun_key(
-      pegrval.key.data_owner_code,
-      pegrval.key.organizational_unit_code);
-    Kv1PeriodGroup::Key pegr_key(
-      pegrval.key.data_owner_code,
-      pegrval.key.period_group_code);
-    pegrval.p_organizational_unit = index.organizational_units[orun_key];
-    pegrval.p_period_group        = index.period_groups[pegr_key];
-  }
-  for (auto &excopday : index.records->exceptional_operating_days) {
-    Kv1OrganizationalUnit::Key orun_key(
-      excopday.key.data_owner_code,
-      excopday.key.organizational_unit_code);
-    Kv1SpecificDay::Key specday_key(
-      excopday.key.data_owner_code,
-      excopday.specific_day_code);
-    Kv1PeriodGroup::Key pegr_key(
-      excopday.key.data_owner_code,
-      excopday.period_group_code);
-    excopday.p_organizational_unit = index.organizational_units[orun_key];
-    excopday.p_specific_day        = index.specific_days[specday_key];
-    excopday.p_period_group        = index.period_groups[pegr_key];
-  }
-  for (auto &schedvers : index.records->schedule_versions) {
-    Kv1OrganizationalUnit::Key orun_key(
-      schedvers.key.data_owner_code,
-      schedvers.key.organizational_unit_code);
-    schedvers.p_organizational_unit = index.organizational_units[orun_key];
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1TimingLink &tili) {
+  Kv1UserStopPoint::Key usrstop_begin_key(
+    tili.key.data_owner_code,
+    tili.key.user_stop_code_begin);
+  Kv1UserStopPoint::Key usrstop_end_key(
+    tili.key.data_owner_code,
+    tili.key.user_stop_code_end);
+  tili.p_user_stop_begin = index.user_stop_points.find(usrstop_begin_key);
+  tili.p_user_stop_end   = index.user_stop_points.find(usrstop_end_key);
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1Link &link) {
+  Kv1UserStopPoint::Key usrstop_begin_key(
+    link.key.data_owner_code,
+    link.key.user_stop_code_begin);
+  Kv1UserStopPoint::Key usrstop_end_key(
+    link.key.data_owner_code,
+    link.key.user_stop_code_end);
+  link.p_user_stop_begin = index.user_stop_points.find(usrstop_begin_key);
+  link.p_user_stop_end   = index.user_stop_points.find(usrstop_end_key);
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1Line &line) {
+  if (!line.line_icon)
+    return;
+  Kv1Icon::Key icon_key(
+    line.key.data_owner_code,
+    *line.line_icon);
+  line.p_line_icon = index.icons.find(icon_key);
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1JourneyPattern &jopa) {
+  Kv1Line::Key line_key(
+    jopa.key.data_owner_code,
+    jopa.key.line_planning_number);
+  jopa.p_line = index.lines.find(line_key);
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1ConcessionFinancerRelation &confinrel) {
+  Kv1ConcessionArea::Key conarea_key(
+    confinrel.key.data_owner_code,
+    confinrel.concession_area_code);
+  confinrel.p_concession_area = index.concession_areas.find(conarea_key);
+  if (!confinrel.financer_code.empty()) {
+    Kv1Financer::Key financer_key(
+      confinrel.key.data_owner_code,
+      confinrel.financer_code);
+    confinrel.p_financer = index.financers.find(financer_key);
   }
-  for (auto &pujopass : index.records->public_journey_passing_times) {
-    Kv1OrganizationalUnit::Key orun_key(
-      pujopass.key.data_owner_code,
-      pujopass.key.organizational_unit_code);
-    Kv1ScheduleVersion::Key schedvers_key(
-      pujopass.key.data_owner_code,
-      pujopass.key.organizational_unit_code,
-      pujopass.key.schedule_code,
-      pujopass.key.schedule_type_code);
-    Kv1Line::Key line_key(
-      pujopass.key.data_owner_code,
-      pujopass.key.line_planning_number);
-    Kv1JourneyPattern::Key jopa_key(
-      pujopass.key.data_owner_code,
-      pujopass.key.line_planning_number,
-      pujopass.journey_pattern_code);
-    Kv1UserStopPoint::Key usrstop_key(
-      pujopass.key.data_owner_code,
-      pujopass.user_stop_code);
-    pujopass.p_organizational_unit = index.organizational_units[orun_key];
-    pujopass.p_schedule_version    = index.schedule_versions[schedvers_key];
-    pujopass.p_line                = index.lines[line_key];
-    pujopass.p_journey_pattern     = index.journey_patterns[jopa_key];
-    pujopass.p_user_stop           = index.user_stop_points[usrstop_key];
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1JourneyPatternTimingLink &jopatili) {
+  Kv1Line::Key line_key(
+    jopatili.key.data_owner_code,
+    jopatili.key.line_planning_number);
+  Kv1JourneyPattern::Key jopa_key(
+    jopatili.key.data_owner_code,
+    jopatili.key.line_planning_number,
+    jopatili.key.journey_pattern_code);
+  Kv1UserStopPoint::Key usrstop_begin_key(
+    jopatili.key.data_owner_code,
+    jopatili.user_stop_code_begin);
+  Kv1UserStopPoint::Key usrstop_end_key(
+    jopatili.key.data_owner_code,
+    jopatili.user_stop_code_end);
+  Kv1ConcessionFinancerRelation::Key confinrel_key(
+    jopatili.key.data_owner_code,
+    jopatili.con_fin_rel_code);
+  Kv1Destination::Key dest_key(
+    jopatili.key.data_owner_code,
+    jopatili.dest_code);
+  jopatili.p_line            = index.lines.find(line_key);
+  jopatili.p_journey_pattern = index.journey_patterns.find(jopa_key);
+  jopatili.p_user_stop_begin = index.user_stop_points.find(usrstop_begin_key);
+  jopatili.p_user_stop_end   = index.user_stop_points.find(usrstop_end_key);
+  jopatili.p_con_fin_rel     = index.concession_financer_relations.find(confinrel_key);
+  jopatili.p_dest            = index.destinations.find(dest_key);
+  if (jopatili.line_dest_icon) {
+    Kv1Icon::Key icon_key{
+      jopatili.key.data_owner_code,
+      *jopatili.line_dest_icon,
+    };
+    jopatili.p_line_dest_icon = index.icons.find(icon_key);
   }
-  for (auto &operday : index.records->operating_days) {
-    Kv1OrganizationalUnit::Key orun_key(
-      operday.key.data_owner_code,
-      operday.key.organizational_unit_code);
-    Kv1ScheduleVersion::Key schedvers_key(
-      operday.key.data_owner_code,
-      operday.key.organizational_unit_code,
-      operday.key.schedule_code,
-      operday.key.schedule_type_code);
-    operday.p_organizational_unit = index.organizational_units[orun_key];
-    operday.p_schedule_version    = index.schedule_versions[schedvers_key];
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1PointOnLink &pool) {
+  Kv1UserStopPoint::Key usrstop_begin_key(
+    pool.key.data_owner_code,
+    pool.key.user_stop_code_begin);
+  Kv1UserStopPoint::Key usrstop_end_key(
+    pool.key.data_owner_code,
+    pool.key.user_stop_code_end);
+  Kv1Point::Key point_key(
+    pool.key.point_data_owner_code,
+    pool.key.point_code);
+  pool.p_user_stop_begin = index.user_stop_points.find(usrstop_begin_key);
+  pool.p_user_stop_end   = index.user_stop_points.find(usrstop_end_key);
+  pool.p_point           = index.points.find(point_key);
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1NoticeAssignment &ntcassgnm) {
+  Kv1Notice::Key notice_key(
+    ntcassgnm.data_owner_code,
+    ntcassgnm.notice_code);
+  ntcassgnm.p_notice = index.notices.find(notice_key);
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1TimeDemandGroup &timdemgrp) {
+  Kv1Line::Key line_key(
+    timdemgrp.key.data_owner_code,
+    timdemgrp.key.line_planning_number);
+  Kv1JourneyPattern::Key jopa_key(
+    timdemgrp.key.data_owner_code,
+    timdemgrp.key.line_planning_number,
+    timdemgrp.key.journey_pattern_code);
+  timdemgrp.p_line            = index.lines.find(line_key);
+  timdemgrp.p_journey_pattern = index.journey_patterns.find(jopa_key);
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1TimeDemandGroupRunTime &timdemrnt) {
+  Kv1Line::Key line_key(
+    timdemrnt.key.data_owner_code,
+    timdemrnt.key.line_planning_number);
+  Kv1JourneyPattern::Key jopa_key(
+    timdemrnt.key.data_owner_code,
+    timdemrnt.key.line_planning_number,
+    timdemrnt.key.journey_pattern_code);
+  Kv1TimeDemandGroup::Key timdemgrp_key(
+    timdemrnt.key.data_owner_code,
+    timdemrnt.key.line_planning_number,
+    timdemrnt.key.journey_pattern_code,
+    timdemrnt.key.time_demand_group_code);
+  Kv1UserStopPoint::Key usrstop_begin_key(
+    timdemrnt.key.data_owner_code,
+    timdemrnt.user_stop_code_begin);
+  Kv1UserStopPoint::Key usrstop_end_key(
+    timdemrnt.key.data_owner_code,
+    timdemrnt.user_stop_code_end);
+  Kv1JourneyPatternTimingLink::Key jopatili_key(
+    timdemrnt.key.data_owner_code,
+    timdemrnt.key.line_planning_number,
+    timdemrnt.key.journey_pattern_code,
+    timdemrnt.key.timing_link_order);
+  timdemrnt.p_line                        = index.lines.find(line_key);
+  timdemrnt.p_user_stop_end               = index.user_stop_points.find(usrstop_end_key);
+  timdemrnt.p_user_stop_begin             = index.user_stop_points.find(usrstop_begin_key);
+  timdemrnt.p_journey_pattern             = index.journey_patterns.find(jopa_key);
+  timdemrnt.p_time_demand_group           = index.time_demand_groups.find(timdemgrp_key);
+  timdemrnt.p_journey_pattern_timing_link = index.journey_pattern_timing_links.find(jopatili_key);
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1TimetableVersion &tive) {
+  Kv1OrganizationalUnit::Key orun_key(
+    tive.key.data_owner_code,
+    tive.key.organizational_unit_code);
+  Kv1PeriodGroup::Key pegr_key(
+    tive.key.data_owner_code,
+    tive.key.period_group_code);
+  Kv1SpecificDay::Key specday_key(
+    tive.key.data_owner_code,
+    tive.key.specific_day_code);
+  tive.p_organizational_unit = index.organizational_units.find(orun_key);
+  tive.p_period_group        = index.period_groups.find(pegr_key);
+  tive.p_specific_day        = index.specific_days.find(specday_key);
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1PublicJourney &pujo) {
+  Kv1TimetableVersion::Key tive_key(
+    pujo.key.data_owner_code,
+    pujo.key.organizational_unit_code,
+    pujo.key.timetable_version_code,
+    pujo.key.period_group_code,
+    pujo.key.specific_day_code);
+  Kv1OrganizationalUnit::Key orun_key(
+    pujo.key.data_owner_code,
+    pujo.key.organizational_unit_code);
+  Kv1PeriodGroup::Key pegr_key(
+    pujo.key.data_owner_code,
+    pujo.key.period_group_code);
+  Kv1SpecificDay::Key specday_key(
+    pujo.key.data_owner_code,
+    pujo.key.specific_day_code);
+  Kv1Line::Key line_key(
+    pujo.key.data_owner_code,
+    pujo.key.line_planning_number);
+  Kv1TimeDemandGroup::Key timdemgrp_key(
+    pujo.key.data_owner_code,
+    pujo.key.line_planning_number,
+    pujo.journey_pattern_code,
+    pujo.time_demand_group_code);
+  Kv1JourneyPattern::Key jopa_key(
+    pujo.key.data_owner_code,
+    pujo.key.line_planning_number,
+    pujo.journey_pattern_code);
+  pujo.p_timetable_version   = index.timetable_versions.find(tive_key);
+  pujo.p_organizational_unit = index.organizational_units.find(orun_key);
+  pujo.p_period_group        = index.period_groups.find(pegr_key);
+  pujo.p_specific_day        = index.specific_days.find(specday_key);
+  pujo.p_line                = index.lines.find(line_key);
+  pujo.p_time_demand_group   = index.time_demand_groups.find(timdemgrp_key);
+  pujo.p_journey_pattern     = index.journey_patterns.find(jopa_key);
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1PeriodGroupValidity &pegrval) {
+  Kv1OrganizationalUnit::Key orun_key(
+    pegrval.key.data_owner_code,
+    pegrval.key.organizational_unit_code);
+  Kv1PeriodGroup::Key pegr_key(
+    pegrval.key.data_owner_code,
+    pegrval.key.period_group_code);
+  pegrval.p_organizational_unit = index.organizational_units.find(orun_key);
+  pegrval.p_period_group        = index.period_groups.find(pegr_key);
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1ExceptionalOperatingDay &excopday) {
+  Kv1OrganizationalUnit::Key orun_key(
+    excopday.key.data_owner_code,
+    excopday.key.organizational_unit_code);
+  Kv1SpecificDay::Key specday_key(
+    excopday.key.data_owner_code,
+    excopday.specific_day_code);
+  Kv1PeriodGroup::Key pegr_key(
+    excopday.key.data_owner_code,
+    excopday.period_group_code);
+  excopday.p_organizational_unit = index.organizational_units.find(orun_key);
+  excopday.p_specific_day        = index.specific_days.find(specday_key);
+  excopday.p_period_group        = index.period_groups.find(pegr_key);
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1ScheduleVersion &schedvers) {
+  Kv1OrganizationalUnit::Key orun_key(
+    schedvers.key.data_owner_code,
+    schedvers.key.organizational_unit_code);
+  schedvers.p_organizational_unit = index.organizational_units.find(orun_key);
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1PublicJourneyPassingTimes &pujopass) {
+  Kv1OrganizationalUnit::Key orun_key(
+    pujopass.key.data_owner_code,
+    pujopass.key.organizational_unit_code);
+  Kv1ScheduleVersion::Key schedvers_key(
+    pujopass.key.data_owner_code,
+    pujopass.key.organizational_unit_code,
+    pujopass.key.schedule_code,
+    pujopass.key.schedule_type_code);
+  Kv1Line::Key line_key(
+    pujopass.key.data_owner_code,
+    pujopass.key.line_planning_number);
+  Kv1JourneyPattern::Key jopa_key(
+    pujopass.key.data_owner_code,
+    pujopass.key.line_planning_number,
+    pujopass.journey_pattern_code);
+  Kv1UserStopPoint::Key usrstop_key(
+    pujopass.key.data_owner_code,
+    pujopass.user_stop_code);
+  pujopass.p_organizational_unit = index.organizational_units.find(orun_key);
+  pujopass.p_schedule_version    = index.schedule_versions.find(schedvers_key);
+  pujopass.p_line                = index.lines.find(line_key);
+  pujopass.p_journey_pattern     = index.journey_patterns.find(jopa_key);
+  pujopass.p_user_stop           = index.user_stop_points.find(usrstop_key);
+}
+
+void kv1LinkRecord(const Kv1Index &index, Kv1OperatingDay &operday) {
+  Kv1OrganizationalUnit::Key orun_key(
+    operday.key.data_owner_code,
+    operday.key.organizational_unit_code);
+  Kv1ScheduleVersion::Key schedvers_key(
+    operday.key.data_owner_code,
+    operday.key.organizational_unit_code,
+    operday.key.schedule_code,
+    operday.key.schedule_type_code);
+  operday.p_organizational_unit = index.organizational_units.find(orun_key);
+  operday.p_schedule_version    = index.schedule_versions.find(schedvers_key);
+}
+
+// Large tables are linked in chunks of this many records, so that they are
+// spread over all threads.
+static const size_t LINK_CHUNK_SIZE = 1 << 14;
+
+// Linking a record only reads the index and writes the pointers of the record
+// itself, so all chunks of all tables can be linked at the same time.
+template<typename T>
+static void addLinkTasks(std::vector<std::function<void()>> &tasks, const Kv1Index &index, std::vector<T> &records) {
+  for (size_t begin = 0; begin < records.size(); begin += LINK_CHUNK_SIZE) {
+    size_t end = std::min(begin + LINK_CHUNK_SIZE, records.size());
+    tasks.push_back([&index, &records, begin, end]() {
+      for (size_t i = begin; i < end; i++) kv1LinkRecord(index, records[i]);
+    });
   }
 }
+
+void kv1LinkRecords(Kv1Index &index, unsigned n_threads) {
+  std::vector<std::function<void()>> tasks;
+  addLinkTasks(tasks, index, index.records->higher_organizational_units);
+  addLinkTasks(tasks, index, index.records->user_stop_points);
+  addLinkTasks(tasks, index, index.records->timing_links);
+  addLinkTasks(tasks, index, index.records->links);
+  addLinkTasks(tasks, index, index.records->lines);
+  addLinkTasks(tasks, index, index.records->journey_patterns);
+  addLinkTasks(tasks, index, index.records->concession_financer_relations);
+  addLinkTasks(tasks, index, index.records->journey_pattern_timing_links);
+  addLinkTasks(tasks, index, index.records->point_on_links);
+  addLinkTasks(tasks, index, index.records->notice_assignments);
+  addLinkTasks(tasks, index, index.records->time_demand_groups);
+  addLinkTasks(tasks, index, index.records->time_demand_group_run_times);
+  addLinkTasks(tasks, index, index.records->timetable_versions);
+  addLinkTasks(tasks, index, index.records->public_journeys);
+  addLinkTasks(tasks, index, index.records->period_group_validities);
+  addLinkTasks(tasks, index, index.records->exceptional_operating_days);
+  addLinkTasks(tasks, index, index.records->schedule_versions);
+  addLinkTasks(tasks, index, index.records->public_journey_passing_times);
+  addLinkTasks(tasks, index, index.records->operating_days);
+
+  runTasks(tasks, n_threads);
+}
@@ -0,0 +1,89 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#include <cerrno>
+#include <cstring>
+#include <format>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <tmi8/kv1_input.hpp>
+
+using namespace std::string_view_literals;
+
+Kv1Input::Kv1Input(const char *path) {
+  bool from_stdin = path == "-"sv;
+  int fd = from_stdin ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    error = std::format("Open {}: {}", path, strerrordesc_np(errno));
+    return;
+  }
+
+  // Standard input may have been read from already, in which case only the
+  // rest of the file is ours.
+  struct stat st;
+  off_t offset = lseek(fd, 0, SEEK_CUR);
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && offset >= 0 && st.st_size > offset)
+    map(fd, static_cast<size_t>(offset), static_cast<size_t>(st.st_size));
+  if (!mapped() && error.empty())
+    read(fd);
+  if (!error.empty())
+    error = std::format("Read {}: {}", from_stdin ? "standard input" : path, error);
+
+  if (!from_stdin) close(fd);
+}
+
+Kv1Input::~Kv1Input() {
+  if (map_addr) munmap(map_addr, map_size);
+}
+
+void Kv1Input::map(int fd, size_t offset, size_t file_size) {
+  // Mappings have to start at a page boundary
+  size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t map_offset = offset - offset % page_size;
+  size_t size = file_size - map_offset;
+  void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(map_offset));
+  // Not all regular files can be mapped (e.g. on some special file systems),
+  // in which case we just read them.
+  if (addr == MAP_FAILED) return;
+  // The lexer reads the file from front to back exactly once, so the kernel
+  // can read ahead aggressively and drop pages that we have passed.
+  madvise(addr, size, MADV_SEQUENTIAL);
+  map_addr = addr;
+  map_size = size;
+  map_skip = offset - map_offset;
+}
+
+void Kv1Input::read(int fd) {
+  constexpr size_t chunk = 1 << 20;
+  while (true) {
+    size_t size = buffer.size();
+    buffer.resize(size + chunk);
+    ssize_t n = ::read(fd, buffer.data() + size, chunk);
+    if (n < 0 && errno == EINTR) {
+      buffer.resize(size);
+      continue;
+    }
+    if (n < 0) {
+      buffer.clear();
+      error = strerrordesc_np(errno);
+      return;
+    }
+    buffer.resize(size + static_cast<size_t>(n));
+    if (n == 0) return;
+  }
+}
+
+std::string_view Kv1Input::data() const {
+  if (map_addr)
+    return std::string_view(static_cast<const char *>(map_addr) + map_skip, map_size - map_skip);
+  return buffer;
+}
+
+bool Kv1Input::mapped() const {
+  return map_addr != nullptr;
+}
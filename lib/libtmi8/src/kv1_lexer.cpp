@@ -2,22 +2,102 @@
 //
 // Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
 
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 #include <tmi8/kv1_lexer.hpp>
 
-Kv1Lexer::Kv1Lexer(std::string_view input)
-  : input(input), slice(input)
+// Finding the end of a field or line is where the lexer spends nearly all of
+// its time, so we look for delimiters 16 (SSE2) or 32 (AVX2) bytes at a time
+// where the CPU allows it. Every scanner returns the offset of the first CR or
+// LF (and also pipe if WithPipe) in [data, data + size), or size if there is
+// none.
+namespace {
+
+using DelimiterScanner = size_t (*)(const char *data, size_t size);
+
+template<bool WithPipe>
+size_t findDelimiterScalar(const char *data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    char c = data[i];
+    if ((WithPipe && c == '|') || c == '\r' || c == '\n')
+      return i;
+  }
+  return size;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+template<bool WithPipe>
+__attribute__((target("sse2")))
+size_t findDelimiterSse2(const char *data, size_t size) {
+  const __m128i pipes = _mm_set1_epi8('|');
+  const __m128i crs   = _mm_set1_epi8('\r');
+  const __m128i lfs   = _mm_set1_epi8('\n');
+
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    __m128i match = _mm_or_si128(_mm_cmpeq_epi8(chunk, crs), _mm_cmpeq_epi8(chunk, lfs));
+    if constexpr (WithPipe) match = _mm_or_si128(match, _mm_cmpeq_epi8(chunk, pipes));
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(match));
+    if (mask != 0) return i + static_cast<size_t>(__builtin_ctz(mask));
+  }
+  return i + findDelimiterScalar<WithPipe>(data + i, size - i);
+}
+
+template<bool WithPipe>
+__attribute__((target("avx2")))
+size_t findDelimiterAvx2(const char *data, size_t size) {
+  const __m256i pipes = _mm256_set1_epi8('|');
+  const __m256i crs   = _mm256_set1_epi8('\r');
+  const __m256i lfs   = _mm256_set1_epi8('\n');
+
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    __m256i match = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, crs), _mm256_cmpeq_epi8(chunk, lfs));
+    if constexpr (WithPipe) match = _mm256_or_si256(match, _mm256_cmpeq_epi8(chunk, pipes));
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(match));
+    if (mask != 0) return i + static_cast<size_t>(__builtin_ctz(mask));
+  }
+  return i + findDelimiterSse2<WithPipe>(data + i, size - i);
+}
+#endif
+
+template<bool WithPipe>
+DelimiterScanner selectDelimiterScanner() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return findDelimiterAvx2<WithPipe>;
+  if (__builtin_cpu_supports("sse2")) return findDelimiterSse2<WithPipe>;
+#endif
+  return findDelimiterScalar<WithPipe>;
+}
+
+// Offset of the first pipe, CR or LF in s, or s.size() if there is none.
+size_t findFieldEnd(std::string_view s) {
+  static const DelimiterScanner scan = selectDelimiterScanner<true>();
+  return scan(s.data(), s.size());
+}
+
+// Offset of the first CR or LF in s, or s.size() if there is none.
+size_t findLineEnd(std::string_view s) {
+  static const DelimiterScanner scan = selectDelimiterScanner<false>();
+  return scan(s.data(), s.size());
+}
+
+}  // namespace
+
+Kv1Lexer::Kv1Lexer(std::string_view input, bool at_start_of_file)
+  : state(at_start_of_file ? START : BETWEEN_ROWS), input(input), slice(input)
 {}
 
 // Does not eat newline character.
 void Kv1Lexer::eatRestOfLine() {
-  size_t end = slice.size();
-  for (size_t i = 0; i < slice.size(); i++) {
-    if (slice[i] == '\r' || slice[i] == '\n') {
-      end = i;
-      break;
-    }
-  }
-  slice = slice.substr(end);
+  slice = slice.substr(findLineEnd(slice));
 }
 
 void Kv1Lexer::lexOptionalHeader() {
@@ -32,103 +112,99 @@ inline bool Kv1Lexer::isWhitespace(int c) {
   return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v';
 }
 
-void Kv1Lexer::readQuotedColumn() {
-  Kv1Token token{ .type = KV1_TOKEN_CELL };
+void Kv1Lexer::readQuotedColumn(Kv1Token &token) {
+  token = { .type = KV1_TOKEN_CELL };
 
   if (slice.size() == 0 || slice[0] != '"') {
     errors.push_back("(internal error) readQuotedColumn: slice[0] != '\"'");
     return;
   }
   slice = slice.substr(1);
+  // Only cells with escaped quotes need to be copied; the rest can point right
+  // into the input.
+  std::string *data = nullptr;
   while (true) {
     size_t quote = slice.find('"');
     if (quote == std::string_view::npos) {
       errors.push_back("readQuotedColumn: no matching closing quote found");
       return;
     }
+    // Quoted cells can span multiple lines
+    line_number += static_cast<size_t>(std::count(slice.begin(), slice.begin() + static_cast<ptrdiff_t>(quote), '\n'));
     if (quote+1 == slice.size() || slice[quote + 1] != '"') {
-      token.data.append(slice.substr(0, quote));
+      if (data) {
+        data->append(slice.substr(0, quote));
+        token.data = *data;
+      } else {
+        token.data = slice.substr(0, quote);
+      }
+      slice = slice.substr(quote + 1);
       break;
     }
-    token.data.append(slice.substr(0, quote + 1));
+    if (!data) data = &unescaped.emplace_back();
+    data->append(slice.substr(0, quote + 1));
     slice = slice.substr(quote + 2);
   }
 
-  size_t end = slice.size();
-  for (size_t i = 0; i < slice.size(); i++) {
-    if (slice[i] == '|' || slice[i] == '\r' || slice[i] == '\n') {
-      end = i;
-      break;
-    }
+  size_t end = findFieldEnd(slice);
+  for (size_t i = 0; i < end; i++) {
     if (!isWhitespace(slice[i])) {
       errors.push_back("readQuotedColumn: encountered non-whitespace character after closing quote");
       return;
     }
   }
-  if (end != std::string_view::npos) slice = slice.substr(end);
-  else slice = slice.substr(slice.size());
+  slice = slice.substr(end);
+}
 
-  tokens.push_back(std::move(token));
+void Kv1Lexer::readUnquotedColumn(Kv1Token &token) {
+  size_t end = findFieldEnd(slice);
+  // Trailing whitespace is not part of the value
+  size_t content_end = end;
+  while (content_end > 0 && isWhitespace(slice[content_end - 1]))
+    content_end--;
+  token = { .type = KV1_TOKEN_CELL, .data = slice.substr(0, content_end) };
+  slice = slice.substr(end);
 }
 
-void Kv1Lexer::readUnquotedColumn() {
-  size_t end = slice.size();
-  size_t content_end = 0;
-  for (size_t i = 0; i < slice.size(); i++) {
-    if (slice[i] == '|' || slice[i] == '\r' || slice[i] == '\n') {
-      end = i;
-      break;
-    } else if (!isWhitespace(slice[i])) {
-      content_end = i + 1;
-    }
-  }
-  tokens.emplace_back(KV1_TOKEN_CELL, std::string(slice.substr(0, content_end)));
-  if (end != std::string_view::npos) slice = slice.substr(end);
-  else slice = slice.substr(slice.size());
-}
-
-void Kv1Lexer::lexRow() {
-  size_t cols = 0;
-  while (slice.size() > 0 && slice[0] != '\r' && slice[0] != '\n') {
-    if (slice[0] == '"') readQuotedColumn();
-    else readUnquotedColumn();
-    if (!errors.empty()) return;
-    cols++;
-    if (slice.size() != 0) {
-      if (slice[0] == '|') {
-        slice = slice.substr(1);
-        // A newline/eof right after pipe? That means an empty field at the end
-        // of the record, we also want to emit that as a token.
-        if (slice.size() == 0 || slice[0] == '\r' || slice[0] == '\n') {
-          tokens.push_back({ .type = KV1_TOKEN_CELL });
-        }
-      } else if (slice[0] == '\r') {
-        if (slice.size() > 1 && slice[1] == '\n') slice = slice.substr(2);
-        else slice = slice.substr(1);
-        break;
-      } else if (slice[0] == '\n') {
-        slice = slice.substr(1);
-        break;
-      } else {
-        errors.push_back("lexRow: expected CR, LF or |");
-        return;
-      }
-    }
+void Kv1Lexer::lexCell(Kv1Token &token) {
+  if (slice[0] == '"') readQuotedColumn(token);
+  else readUnquotedColumn(token);
+  if (!errors.empty()) return;
+
+  if (slice.size() == 0) {
+    state = ROW_DONE;
+  } else if (slice[0] == '|') {
+    slice = slice.substr(1);
+    // A newline/eof right after pipe? That means an empty field at the end
+    // of the record, we also want to emit that as a token.
+    if (slice.size() == 0 || slice[0] == '\r' || slice[0] == '\n')
+      state = EMPTY_LAST_CELL;
+  } else if (slice[0] == '\r') {
+    if (slice.size() > 1 && slice[1] == '\n') slice = slice.substr(2);
+    else slice = slice.substr(1);
+    line_number++;
+    state = ROW_DONE;
+  } else if (slice[0] == '\n') {
+    slice = slice.substr(1);
+    line_number++;
+    state = ROW_DONE;
+  } else {
+    errors.push_back("lexCell: expected CR, LF or |");
   }
-  tokens.push_back({ .type = KV1_TOKEN_ROW_END });
 }
 
 // Returns true when a line ending was consumed.
 bool Kv1Lexer::eatWhitespace() {
   for (size_t i = 0; i < slice.size(); i++) {
     if (slice[i] == '\r') {
-      slice = slice.substr(i + 1);
-      if (slice.size() > 1 && slice[i + 1] == '\n')
-        slice = slice.substr(i + 2);
+      if (i + 1 < slice.size() && slice[i + 1] == '\n') slice = slice.substr(i + 2);
+      else slice = slice.substr(i + 1);
+      line_number++;
       return true;
     }
     if (slice[i] == '\n') {
       slice = slice.substr(i + 1);
+      line_number++;
       return true;
     }
     
@@ -140,15 +216,52 @@ bool Kv1Lexer::eatWhitespace() {
   return false;
 }
 
-void Kv1Lexer::lex() {
-  lexOptionalHeader();
-  eatWhitespace();
-
-  while (errors.empty() && !slice.empty()) {
-    lexOptionalComment();
-    bool newline = eatWhitespace();
-    if (newline) continue;
-    // We are now either (1) at the end of the file or (2) at the start of some column data
-    if (errors.empty()) lexRow();
+bool Kv1Lexer::next(Kv1Token &token) {
+  if (!errors.empty()) return false;
+
+  switch (state) {
+  case START:
+    lexOptionalHeader();
+    eatWhitespace();
+    state = BETWEEN_ROWS;
+    [[fallthrough]];
+  case BETWEEN_ROWS:
+    while (true) {
+      if (slice.empty()) return false;
+      lexOptionalComment();
+      bool newline = eatWhitespace();
+      if (newline) continue;
+      // We are now either (1) at the end of the file or (2) at the start of some column data
+      if (slice.empty()) return false;
+      break;
+    }
+    row_line_number = line_number;
+    state = IN_ROW;
+    [[fallthrough]];
+  case IN_ROW:
+    lexCell(token);
+    return errors.empty();
+  case EMPTY_LAST_CELL:
+    token = { .type = KV1_TOKEN_CELL };
+    state = ROW_DONE;
+    return true;
+  case ROW_DONE:
+    token = { .type = KV1_TOKEN_ROW_END };
+    state = BETWEEN_ROWS;
+    return true;
   }
+  return false;
+}
+
+void Kv1Lexer::lex() {
+  Kv1Token token;
+  while (next(token)) tokens.push_back(token);
+}
+
+size_t Kv1Lexer::line() const {
+  return line_number;
+}
+
+size_t Kv1Lexer::rowLine() const {
+  return row_line_number;
 }
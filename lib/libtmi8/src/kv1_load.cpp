@@ -0,0 +1,97 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include <tmi8/kv1_input.hpp>
+#include <tmi8/kv1_load.hpp>
+#include <tmi8/kv1_parser.hpp>
+#include <tmi8/kv1_snapshot.hpp>
+
+using namespace std::string_view_literals;
+
+using TimingClock = std::conditional_t<
+  std::chrono::high_resolution_clock::is_steady,
+  std::chrono::high_resolution_clock,
+  std::chrono::steady_clock>;
+
+static bool parse(const char *path, Kv1Records &into, unsigned n_threads) {
+  if (path == "-"sv) fputs("Reading KV1 from standard input\n", stderr);
+  Kv1Input input(path);
+  if (!input.error.empty()) {
+    fprintf(stderr, "%s\n", input.error.c_str());
+    return false;
+  }
+  std::string_view data = input.data();
+  fprintf(stderr, "%s %lu bytes\n", input.mapped() ? "Mapped" : "Read", data.size());
+
+  auto start = TimingClock::now();
+  Kv1ParallelParser parser(data, into, n_threads);
+  parser.parse();
+  auto end = TimingClock::now();
+
+  std::chrono::duration<double> elapsed{end - start};
+  double bytes = static_cast<double>(data.size()) / 1'000'000;
+  double speed = bytes / elapsed.count();
+
+  if (!parser.lexer_errors.empty()) {
+    fputs("Lexer reported errors:\n", stderr);
+    for (const auto &error : parser.lexer_errors)
+      fprintf(stderr, "- %s\n", error.c_str());
+    return false;
+  }
+
+  fprintf(stderr, "Duration: %f s\n", elapsed.count());
+  fprintf(stderr, "Speed: %f MB/s\n", speed);
+
+  bool ok = true;
+  if (!parser.global_errors.empty()) {
+    ok = false;
+    fputs("Parser reported errors:\n", stderr);
+    for (const auto &error : parser.global_errors)
+      fprintf(stderr, "- %s\n", error.message().c_str());
+    if (parser.global_errors.dropped() > 0)
+      fprintf(stderr, "- ... and %lu more\n", parser.global_errors.dropped());
+  }
+  if (!parser.warns.empty()) {
+    fputs("Parser reported warnings:\n", stderr);
+    for (const auto &warn : parser.warns)
+      fprintf(stderr, "- %s\n", warn.message().c_str());
+    if (parser.warns.dropped() > 0)
+      fprintf(stderr, "- ... and %lu more\n", parser.warns.dropped());
+  }
+
+  fprintf(stderr, "Parsed %lu records\n", into.size());
+
+  return ok;
+}
+
+static bool loadSnapshot(const char *path, Kv1Records &into) {
+  Kv1Input input(path);
+  if (!input.error.empty()) {
+    fprintf(stderr, "%s\n", input.error.c_str());
+    return false;
+  }
+
+  auto start = TimingClock::now();
+  std::string error = kv1ReadSnapshot(input.data(), into);
+  auto end = TimingClock::now();
+  if (!error.empty()) {
+    fprintf(stderr, "Read snapshot %s: %s\n", path, error.c_str());
+    return false;
+  }
+
+  std::chrono::duration<double> elapsed{end - start};
+  fprintf(stderr, "Loaded %lu records from snapshot in %f s\n", into.size(), elapsed.count());
+  return true;
+}
+
+bool kv1Load(const char *kv1_path, const char *snapshot_path, Kv1Records &into, unsigned n_threads) {
+  if (snapshot_path) return loadSnapshot(snapshot_path, into);
+  return parse(kv1_path, into, n_threads);
+}
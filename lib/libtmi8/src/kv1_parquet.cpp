@@ -0,0 +1,251 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#include <algorithm>
+#include <format>
+#include <span>
+#include <type_traits>
+
+#include <tmi8/kv1_fields.hpp>
+#include <tmi8/kv1_parquet.hpp>
+
+namespace {
+  // How a field of type T is represented in Arrow: the type of the column,
+  // the builder that MakeBuilder() makes for that type, and how a value is
+  // appended to it.
+  template<typename T>
+  struct ArrowRepr;
+
+  template<>
+  struct ArrowRepr<std::string> {
+    using Builder = arrow::StringBuilder;
+    static std::shared_ptr<arrow::DataType> type() { return arrow::utf8(); }
+    static arrow::Status append(Builder &b, const std::string &value) { return b.Append(value); }
+  };
+
+  template<>
+  struct ArrowRepr<Kv1Symbol> {
+    using Builder = arrow::StringBuilder;
+    static std::shared_ptr<arrow::DataType> type() { return arrow::utf8(); }
+    static arrow::Status append(Builder &b, Kv1Symbol value) { return b.Append(value.str()); }
+  };
+
+  template<typename E> requires std::is_enum_v<E>
+  struct ArrowRepr<E> {
+    using Builder = arrow::StringBuilder;
+    static std::shared_ptr<arrow::DataType> type() { return arrow::utf8(); }
+    static arrow::Status append(Builder &b, E value) { return b.Append(kv1Name(value)); }
+  };
+
+  template<>
+  struct ArrowRepr<Kv1DayType> {
+    using Builder = arrow::StringBuilder;
+    static std::shared_ptr<arrow::DataType> type() { return arrow::utf8(); }
+    static arrow::Status append(Builder &b, Kv1DayType value) { return b.Append(value.str()); }
+  };
+
+  template<>
+  struct ArrowRepr<RgbColor> {
+    using Builder = arrow::StringBuilder;
+    static std::shared_ptr<arrow::DataType> type() { return arrow::utf8(); }
+    static arrow::Status append(Builder &b, RgbColor value) {
+      return b.Append(std::format("{:02X}{:02X}{:02X}", value.r, value.g, value.b));
+    }
+  };
+
+  template<>
+  struct ArrowRepr<char> {
+    using Builder = arrow::StringBuilder;
+    static std::shared_ptr<arrow::DataType> type() { return arrow::utf8(); }
+    static arrow::Status append(Builder &b, char value) { return b.Append(std::string_view(&value, 1)); }
+  };
+
+  template<>
+  struct ArrowRepr<bool> {
+    using Builder = arrow::BooleanBuilder;
+    static std::shared_ptr<arrow::DataType> type() { return arrow::boolean(); }
+    static arrow::Status append(Builder &b, bool value) { return b.Append(value); }
+  };
+
+  template<>
+  struct ArrowRepr<short> {
+    using Builder = arrow::Int16Builder;
+    static std::shared_ptr<arrow::DataType> type() { return arrow::int16(); }
+    static arrow::Status append(Builder &b, short value) { return b.Append(value); }
+  };
+
+  template<>
+  struct ArrowRepr<int> {
+    using Builder = arrow::Int32Builder;
+    static std::shared_ptr<arrow::DataType> type() { return arrow::int32(); }
+    static arrow::Status append(Builder &b, int value) { return b.Append(value); }
+  };
+
+  template<>
+  struct ArrowRepr<double> {
+    using Builder = arrow::DoubleBuilder;
+    static std::shared_ptr<arrow::DataType> type() { return arrow::float64(); }
+    static arrow::Status append(Builder &b, double value) { return b.Append(value); }
+  };
+
+  template<>
+  struct ArrowRepr<std::chrono::year_month_day> {
+    using Builder = arrow::Date32Builder;
+    static std::shared_ptr<arrow::DataType> type() { return arrow::date32(); }
+    static arrow::Status append(Builder &b, std::chrono::year_month_day value) {
+      return b.Append(static_cast<int32_t>(std::chrono::sys_days(value).time_since_epoch().count()));
+    }
+  };
+
+  template<>
+  struct ArrowRepr<std::chrono::sys_seconds> {
+    using Builder = arrow::TimestampBuilder;
+    static std::shared_ptr<arrow::DataType> type() { return arrow::timestamp(arrow::TimeUnit::SECOND); }
+    static arrow::Status append(Builder &b, std::chrono::sys_seconds value) {
+      return b.Append(value.time_since_epoch().count());
+    }
+  };
+
+  template<>
+  struct ArrowRepr<std::chrono::hh_mm_ss<std::chrono::seconds>> {
+    using Builder = arrow::DurationBuilder;
+    static std::shared_ptr<arrow::DataType> type() { return arrow::duration(arrow::TimeUnit::SECOND); }
+    static arrow::Status append(Builder &b, std::chrono::hh_mm_ss<std::chrono::seconds> value) {
+      return b.Append(value.to_duration().count());
+    }
+  };
+
+  template<typename T>
+  struct ArrowRepr<std::optional<T>> {
+    using Builder = typename ArrowRepr<T>::Builder;
+    static std::shared_ptr<arrow::DataType> type() { return ArrowRepr<T>::type(); }
+    static arrow::Status append(Builder &b, const std::optional<T> &value) {
+      if (!value) return b.AppendNull();
+      return ArrowRepr<T>::append(b, *value);
+    }
+  };
+
+  template<typename T>
+  constexpr bool is_optional = false;
+  template<typename T>
+  constexpr bool is_optional<std::optional<T>> = true;
+
+  // Collects the Arrow fields of a record type: one column for every field
+  // in kv1Fields(), except for the references to other records
+  struct SchemaBuilder {
+    template<typename T>
+    void operator()(std::string_view, T *const &) {}
+    template<typename T>
+    void operator()(std::string_view name, const T &) {
+      fields.push_back(arrow::field(std::string(name), ArrowRepr<T>::type(), is_optional<T>));
+    }
+
+    arrow::FieldVector fields;
+  };
+
+  // Appends the fields of a record to the builders of their columns, which
+  // were made by MakeBuilder() for the schema of SchemaBuilder
+  struct RowAppender {
+    template<typename T>
+    void operator()(std::string_view, T *const &) {}
+    template<typename T>
+    void operator()(std::string_view, const T &value) {
+      auto &builder = static_cast<typename ArrowRepr<T>::Builder &>(*builders[column++]);
+      if (status.ok()) status = ArrowRepr<T>::append(builder, value);
+    }
+
+    std::span<const std::unique_ptr<arrow::ArrayBuilder>> builders;
+    size_t column = 0;
+    arrow::Status status;
+  };
+}
+
+template<typename R>
+static std::shared_ptr<arrow::Schema> schemaOf() {
+  // Only the types of the fields matter, not their values
+  const R record = kv1EmptyRecord<R>();
+  SchemaBuilder schema;
+  kv1Fields(schema, record);
+  return arrow::schema(std::move(schema.fields));
+}
+
+namespace {
+  template<typename R>
+  class TableBatchReader : public arrow::RecordBatchReader {
+   public:
+    TableBatchReader(const std::vector<R> &records, int64_t batch_size)
+      : records_(records), batch_size_(static_cast<size_t>(batch_size)), schema_(schemaOf<R>())
+    {}
+
+    std::shared_ptr<arrow::Schema> schema() const override { return schema_; }
+
+    arrow::Status ReadNext(std::shared_ptr<arrow::RecordBatch> *out) override {
+      if (next_ >= records_.size()) {
+        *out = nullptr;
+        return arrow::Status::OK();
+      }
+      size_t n = std::min(batch_size_, records_.size() - next_);
+      std::span<const R> batch(records_.data() + next_, n);
+      next_ += n;
+
+      std::vector<std::unique_ptr<arrow::ArrayBuilder>> builders;
+      builders.reserve(schema_->fields().size());
+      for (const auto &field : schema_->fields()) {
+        ARROW_ASSIGN_OR_RAISE(std::unique_ptr<arrow::ArrayBuilder> builder, arrow::MakeBuilder(field->type()));
+        ARROW_RETURN_NOT_OK(builder->Reserve(static_cast<int64_t>(n)));
+        builders.push_back(std::move(builder));
+      }
+      RowAppender appender{ .builders = builders };
+      for (const R &record : batch) {
+        appender.column = 0;
+        kv1Fields(appender, record);
+      }
+      ARROW_RETURN_NOT_OK(appender.status);
+
+      std::vector<std::shared_ptr<arrow::Array>> arrays;
+      arrays.reserve(builders.size());
+      for (const auto &builder : builders) {
+        ARROW_ASSIGN_OR_RAISE(auto array, builder->Finish());
+        arrays.push_back(std::move(array));
+      }
+      *out = arrow::RecordBatch::Make(schema_, static_cast<int64_t>(n), std::move(arrays));
+      return arrow::Status::OK();
+    }
+
+   private:
+    const std::vector<R> &records_;
+    size_t batch_size_;
+    std::shared_ptr<arrow::Schema> schema_;
+    size_t next_ = 0;
+  };
+}
+
+const std::vector<std::string_view> &kv1TableNames() {
+  static const std::vector<std::string_view> names = {
+#define X(type, table) #table,
+    KV1_TABLES
+#undef X
+  };
+  return names;
+}
+
+std::shared_ptr<arrow::Schema> kv1ArrowSchema(std::string_view table) {
+#define X(type, table_) \
+  if (table == #table_) return schemaOf<type>();
+  KV1_TABLES
+#undef X
+  return nullptr;
+}
+
+arrow::Result<std::shared_ptr<arrow::RecordBatchReader>> kv1ArrowRecordBatches(
+  const Kv1Records &records, std::string_view table, int64_t batch_size
+) {
+  if (batch_size <= 0)
+    return arrow::Status::Invalid("Batch size must be positive");
+#define X(type, table_) \
+  if (table == #table_) return std::make_shared<TableBatchReader<type>>(records.table_, batch_size);
+  KV1_TABLES
+#undef X
+  return arrow::Status::KeyError("No KV1 table named ", table);
+}
@@ -2,6 +2,11 @@
 //
 // Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
 #include <tmi8/kv1_parser.hpp>
 
 using rune = uint32_t;
@@ -43,10 +48,25 @@ static size_t decodeUtf8Cp(std::string_view s, rune *dest = nullptr) {
   return length;
 }
 
+// Returns the length of the longest prefix of s that only consists of ASCII
+// characters, checking eight bytes at a time.
+static size_t asciiPrefixLength(std::string_view s) {
+  size_t i = 0;
+  for (; i + 8 <= s.size(); i += 8) {
+    uint64_t word;
+    memcpy(&word, s.data() + i, sizeof(word));
+    if (word & 0x8080808080808080) break;
+  }
+  while (i < s.size() && !(static_cast<uint8_t>(s[i]) & 0x80)) i++;
+  return i;
+}
+
 // Counts the number of codepoints in a valid UTF-8 string. Returns SIZE_MAX if
 // the string contains invalid UTF-8 codepoints.
 static size_t stringViewLengthUtf8(std::string_view sv) {
-  size_t codepoints = 0;
+  // Nearly all KV1 data is ASCII, where every byte is a codepoint
+  size_t codepoints = asciiPrefixLength(sv);
+  sv = sv.substr(codepoints);
   while (sv.size() > 0) {
     size_t codepoint_size = decodeUtf8Cp(sv);
     if (codepoint_size == 0) return SIZE_MAX;
@@ -56,51 +76,157 @@ static size_t stringViewLengthUtf8(std::string_view sv) {
   return codepoints;
 }
 
-Kv1Parser::Kv1Parser(std::vector<Kv1Token> tokens, Kv1Records &parse_into)
-  : tokens(std::move(tokens)),
+Kv1Parser::Kv1Parser(Kv1Lexer &lexer, Kv1Records &parse_into)
+  : lexer(lexer),
     records(parse_into)
 {}
 
-bool Kv1Parser::atEnd() const {
-  return pos >= tokens.size();
+bool Kv1Parser::atEnd() {
+  return cur() == nullptr;
+}
+
+void Kv1Parser::advance() {
+  has_token = false;
 }
 
 void Kv1Parser::eatRowEnds() {
-  while (!atEnd() && tokens[pos].type == KV1_TOKEN_ROW_END) pos++;
+  while (!atEnd() && token.type == KV1_TOKEN_ROW_END) advance();
+}
+
+const Kv1Token *Kv1Parser::cur() {
+  if (!has_token && !lexer_done) {
+    has_token = lexer.next(token);
+    lexer_done = !has_token;
+  }
+  if (!has_token) return nullptr;
+  return &token;
+}
+
+std::string Kv1ParseError::message() const {
+  std::string msg;
+  switch (code) {
+  case KV1_ERROR_EXPECTED_CELL_GOT_EOF:
+    msg = std::format("Expected cell but got end of file when parsing {}", field);
+    break;
+  case KV1_ERROR_EXPECTED_CELL_GOT_ROW_END:
+    msg = std::format("Expected cell but got end of row when parsing {}", field);
+    break;
+  case KV1_ERROR_EMPTY_STRING:
+    msg = std::format("{} has length zero but is required", field);
+    break;
+  case KV1_ERROR_INVALID_UTF8:
+    msg = std::format("{} contains invalid UTF-8 code points", field);
+    break;
+  case KV1_ERROR_STRING_TOO_LONG:
+    msg = std::format("{} has length ({}) that is greater than maximum length ({})", field, actual, limit);
+    break;
+  case KV1_ERROR_MISSING_VALUE:
+    msg = std::format("{} is required, but has no value", field);
+    break;
+  case KV1_ERROR_BAD_BOOLEAN:
+    msg = std::format("{} should have value \"1\", \"0\", \"true\" or \"false\"", field);
+    break;
+  case KV1_ERROR_BAD_NUMBER:
+    msg = std::format("{} has a bad value that cannot be parsed as a number", field);
+    break;
+  case KV1_ERROR_TRAILING_CHARACTERS:
+    msg = std::format("{} contains characters that were not parsed as a number", field);
+    break;
+  case KV1_ERROR_TOO_MANY_DIGITS:
+    msg = std::format("{} contains more digits (in the integral part) ({}) than allowed ({})", field, actual, limit);
+    break;
+  case KV1_ERROR_TOO_FEW_DIGITS:
+    msg = std::format("{} contains less digits (in the integral part) ({}) than required ({}) [value: {}]",
+                      field, actual, limit, detail);
+    break;
+  case KV1_ERROR_NOT_AN_INTEGER:
+    msg = std::format("{} should be an integer", field);
+    break;
+  case KV1_ERROR_BAD_RGB_COLOR:
+    msg = std::format("{} should be an RGB color, i.e. a sequence of six hexadecimally represented nibbles", field);
+    break;
+  case KV1_ERROR_RD_COORD_TOO_LONG:
+    msg = std::format("{} may not have more than 15 characters", field);
+    break;
+  case KV1_ERROR_NOT_IN_ENUMERATION:
+    msg = std::format("{} has a value that is not in the respective BISON enumeration: {}", field, detail);
+    break;
+  case KV1_ERROR_BAD_DAY_TYPE:
+    msg = std::format("{} should be a day type like 1234500 (Monday through Friday): {}", field, detail);
+    break;
+  case KV1_ERROR_BAD_VALUE:
+    msg = std::format("{} has a bad value: {}", field, detail);
+    break;
+  case KV1_ERROR_UNPARSED_FIELDS:
+    msg = std::format("Parser function for Recordtype ({}) did not eat all record fields", detail);
+    break;
+  case KV1_ERROR_INVALID:
+    msg = field;
+    break;
+  case KV1_WARNING_UNKNOWN_RECORD_TYPE:
+    msg = std::format("Recordtype ({}) is bad or names a record type that this program cannot process", detail);
+    break;
+  case KV1_WARNING_UNKNOWN_TRANSPORT_TYPE:
+    msg = std::format("{} is not in BISON enumeration E9: {}", field, detail);
+    break;
+  }
+  if (line == 0) return msg;
+  return std::format("Line {}: {}", line, msg);
+}
+
+void Kv1ParseErrors::add(Kv1ParseError error) {
+  count++;
+  if (retained.size() < MAX_RETAINED)
+    retained.push_back(std::move(error));
 }
 
-const Kv1Token *Kv1Parser::cur() const {
-  if (atEnd()) return nullptr;
-  return &tokens[pos];
+void Kv1ParseErrors::append(const Kv1ParseErrors &other, size_t line_offset) {
+  for (const auto &error : other.retained) {
+    if (retained.size() >= MAX_RETAINED) break;
+    retained.push_back(error);
+    retained.back().line += line_offset;
+  }
+  count += other.count;
+}
+
+void Kv1Parser::recordError(Kv1ParseErrorCode code, std::string_view field, size_t actual, size_t limit,
+                            std::string_view detail) {
+  record_errors.push_back({
+    .code   = code,
+    .line   = row_line,
+    .field  = field,
+    .actual = actual,
+    .limit  = limit,
+    .detail = std::string(detail),
+  });
 }
 
-const std::string *Kv1Parser::eatCell(std::string_view parsing_what) {
+std::optional<std::string_view> Kv1Parser::eatCell(std::string_view parsing_what) {
   const Kv1Token *tok = cur();
   if (!tok) {
-    record_errors.push_back(std::format("Expected cell but got end of file when parsing {}", parsing_what));
-    return nullptr;
+    recordError(KV1_ERROR_EXPECTED_CELL_GOT_EOF, parsing_what);
+    return std::nullopt;
   }
   if (tok->type == KV1_TOKEN_ROW_END) {
-    record_errors.push_back(std::format("Expected cell but got end of row when parsing {}", parsing_what));
-    return nullptr;
+    recordError(KV1_ERROR_EXPECTED_CELL_GOT_ROW_END, parsing_what);
+    return std::nullopt;
   }
-  pos++;
-  return &tok->data;
+  advance();
+  return tok->data;
 }
 
 void Kv1Parser::requireString(std::string_view field, bool mandatory, size_t max_length, std::string_view value) {
   if (value.empty() && mandatory) {
-    record_errors.push_back(std::format("{} has length zero but is required", field));
+    recordError(KV1_ERROR_EMPTY_STRING, field);
     return;
   }
   size_t codepoints = stringViewLengthUtf8(value);
   if (codepoints == SIZE_MAX) {
-    global_errors.push_back(std::format("{} contains invalid UTF-8 code points", field));
+    global_errors.add({ .code = KV1_ERROR_INVALID_UTF8, .line = row_line, .field = field });
     return;
   }
   if (codepoints > max_length) {
-    record_errors.push_back(std::format("{} has length ({}) that is greater than maximum length ({})",
-                                  field, value.size(), max_length));
+    recordError(KV1_ERROR_STRING_TOO_LONG, field, value.size(), max_length);
   }
 }
 
@@ -115,12 +241,12 @@ static inline std::optional<bool> parseBoolean(std::string_view src) {
 std::optional<bool> Kv1Parser::requireBoolean(std::string_view field, bool mandatory, std::string_view value) {
   if (value.empty()) {
     if (mandatory)
-      record_errors.push_back(std::format("{} is required, but has no value", field));
+      recordError(KV1_ERROR_MISSING_VALUE, field);
     return std::nullopt;
   }
   auto parsed = parseBoolean(value);
   if (!parsed.has_value())
-    record_errors.push_back(std::format("{} should have value \"1\", \"0\", \"true\" or \"false\"", field));
+    recordError(KV1_ERROR_BAD_BOOLEAN, field);
   return parsed;
 }
 
@@ -133,31 +259,63 @@ static inline size_t countDigits(long x) {
 std::optional<double> Kv1Parser::requireNumber(std::string_view field, bool mandatory, size_t max_digits, std::string_view value) {
   if (value.empty()) {
     if (mandatory)
-      record_errors.push_back(std::format("{} has no value but is required", field));
+      recordError(KV1_ERROR_MISSING_VALUE, field);
     return std::nullopt;
   }
 
   double parsed;
   auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), parsed, std::chars_format::fixed);
   if (ec != std::errc()) {
-    record_errors.push_back(std::format("{} has a bad value that cannot be parsed as a number", field));
+    recordError(KV1_ERROR_BAD_NUMBER, field);
     return std::nullopt;
   }
   if (ptr != value.data() + value.size()) {
-    record_errors.push_back(std::format("{} contains characters that were not parsed as a number", field));
+    recordError(KV1_ERROR_TRAILING_CHARACTERS, field);
     return std::nullopt;
   }
  
   size_t digits = countDigits(static_cast<long>(parsed));
   if (digits > max_digits) {
-    record_errors.push_back(std::format("{} contains more digits (in the integral part) ({}) than allowed ({})",
-                                  field, digits, max_digits));
+    recordError(KV1_ERROR_TOO_MANY_DIGITS, field, digits, max_digits);
     return std::nullopt;
   }
 
   return parsed;
 }
 
+template<size_t MaxDigits, std::integral T>
+std::optional<T> Kv1Parser::requireInt(std::string_view field, bool mandatory, std::string_view value) {
+  static_assert(MaxDigits <= std::numeric_limits<T>::digits10);
+  if (value.empty()) {
+    if (mandatory)
+      recordError(KV1_ERROR_MISSING_VALUE, field);
+    return std::nullopt;
+  }
+
+  bool negative = std::is_signed_v<T> && value[0] == '-';
+  if (negative) value = value.substr(1);
+  // Integral fields used to be parsed as doubles, which accepted e.g. 12.0 too
+  if (size_t dot = value.find('.'); dot != std::string_view::npos
+      && value.find_first_not_of('0', dot + 1) == std::string_view::npos)
+    value = value.substr(0, dot);
+  if (value.empty() || value.find_first_not_of("0123456789") != std::string_view::npos) {
+    recordError(KV1_ERROR_NOT_AN_INTEGER, field);
+    return std::nullopt;
+  }
+  // Leading zeros do not count towards the number of digits
+  size_t zeros = value.find_first_not_of('0');
+  std::string_view digits = zeros == std::string_view::npos ? std::string_view() : value.substr(zeros);
+  if (digits.size() > MaxDigits) {
+    recordError(KV1_ERROR_TOO_MANY_DIGITS, field, digits.size(), MaxDigits);
+    return std::nullopt;
+  }
+
+  T parsed = 0;
+  for (char c : digits)
+    parsed = static_cast<T>(parsed * 10 + (c - '0'));
+  return negative ? static_cast<T>(-parsed) : parsed;
+}
+
 static inline bool isHexDigit(char c) {
   return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'F');
 }
@@ -183,52 +341,99 @@ static std::optional<RgbColor> parseRgbColor(std::string_view src) {
 std::optional<RgbColor> Kv1Parser::requireRgbColor(std::string_view field, bool mandatory, std::string_view value) {
   if (value.empty()) {
     if (mandatory)
-      record_errors.push_back(std::format("{} is required, but has no value", field));
+      recordError(KV1_ERROR_MISSING_VALUE, field);
     return std::nullopt;
   }
   auto parsed = parseRgbColor(value);
   if (!parsed.has_value())
-    record_errors.push_back(std::format("{} should be an RGB color, i.e. a sequence of six hexadecimally represented nibbles", field));
+    recordError(KV1_ERROR_BAD_RGB_COLOR, field);
   return parsed;
 }
 
 std::optional<double> Kv1Parser::requireRdCoord(std::string_view field, bool mandatory, size_t min_digits, std::string_view value) {
   if (value.empty()) {
     if (mandatory)
-      record_errors.push_back(std::format("{} is required, but has no value", field));
+      recordError(KV1_ERROR_MISSING_VALUE, field);
     return std::nullopt;
   }
   if (value.size() > 15) {
-    record_errors.push_back(std::format("{} may not have more than 15 characters", field));
+    recordError(KV1_ERROR_RD_COORD_TOO_LONG, field);
     return std::nullopt;
   }
 
   double parsed;
   auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), parsed, std::chars_format::fixed);
   if (ec != std::errc()) {
-    record_errors.push_back(std::format("{} has a bad value that cannot be parsed as a number", field));
+    recordError(KV1_ERROR_BAD_NUMBER, field);
     return std::nullopt;
   }
   if (ptr != value.data() + value.size()) {
-    record_errors.push_back(std::format("{} contains characters that were not parsed as a number", field));
+    recordError(KV1_ERROR_TRAILING_CHARACTERS, field);
     return std::nullopt;
   }
  
   size_t digits = countDigits(static_cast<long>(parsed));
   if (digits < min_digits) {
-    record_errors.push_back(std::format("{} contains less digits (in the integral part) ({}) than required ({}) [value: {}]",
-                                  field, digits, min_digits, value));
+    recordError(KV1_ERROR_TOO_FEW_DIGITS, field, digits, min_digits, value);
     return std::nullopt;
   }
 
   return parsed;
 }
 
+template<typename E>
+std::optional<E> Kv1Parser::requireEnumeration(std::string_view field, bool mandatory, E last, std::string_view value) {
+  if (value.empty()) {
+    if (mandatory)
+      recordError(KV1_ERROR_MISSING_VALUE, field);
+    return std::nullopt;
+  }
+  for (int i = 0; i <= last; i++) {
+    E e = static_cast<E>(i);
+    if (kv1Name(e) == value) return e;
+  }
+  recordError(KV1_ERROR_NOT_IN_ENUMERATION, field, 0, 0, value);
+  return std::nullopt;
+}
+
+// Position i (counting from 0) holds either '0' or the digit of ISO weekday
+// i + 1, so that every day type has exactly one spelling.
+static std::optional<Kv1DayType> parseDayType(std::string_view src) {
+  if (src.size() != 7) return std::nullopt;
+  Kv1DayType day_type;
+  for (size_t i = 0; i < src.size(); i++) {
+    if (src[i] == '0') continue;
+    if (src[i] != static_cast<char>('1' + i)) return std::nullopt;
+    day_type.weekdays |= static_cast<uint8_t>(1 << i);
+  }
+  return day_type;
+}
+
+std::optional<Kv1DayType> Kv1Parser::requireDayType(std::string_view field, bool mandatory, std::string_view value) {
+  if (value.empty()) {
+    if (mandatory)
+      recordError(KV1_ERROR_MISSING_VALUE, field);
+    return std::nullopt;
+  }
+  auto parsed = parseDayType(value);
+  if (!parsed.has_value())
+    recordError(KV1_ERROR_BAD_DAY_TYPE, field, 0, 0, value);
+  return parsed;
+}
+
 std::string Kv1Parser::eatString(std::string_view field, bool mandatory, size_t max_length) {
+  return std::string(eatStringView(field, mandatory, max_length));
+}
+
+Kv1Symbol Kv1Parser::eatSymbol(std::string_view field, bool mandatory, size_t max_length) {
+  return Kv1Symbol(eatStringView(field, mandatory, max_length));
+}
+
+std::string_view Kv1Parser::eatStringView(std::string_view field, bool mandatory, size_t max_length) {
   auto value = eatCell(field);
   if (!record_errors.empty()) return {};
   requireString(field, mandatory, max_length, *value);
-  return std::move(*value);
+  return *value;
 }
 
 std::optional<bool> Kv1Parser::eatBoolean(std::string_view field, bool mandatory) {
@@ -243,6 +448,13 @@ std::optional<double> Kv1Parser::eatNumber(std::string_view field, bool mandator
   return requireNumber(field, mandatory, max_digits, *value);
 }
 
+template<size_t MaxDigits, std::integral T>
+std::optional<T> Kv1Parser::eatInt(std::string_view field, bool mandatory) {
+  auto value = eatCell(field);
+  if (!record_errors.empty()) return {};
+  return requireInt<MaxDigits, T>(field, mandatory, *value);
+}
+
 std::optional<RgbColor> Kv1Parser::eatRgbColor(std::string_view field, bool mandatory) {
   auto value = eatCell(field);
   if (!record_errors.empty()) return {};
@@ -255,18 +467,48 @@ std::optional<double> Kv1Parser::eatRdCoord(std::string_view field, bool mandato
   return requireRdCoord(field, mandatory, min_digits, *value);
 }
 
-std::string Kv1Parser::parseHeader() {
-  auto record_type       = eatString("<header>.Recordtype",        true, 10);
-  auto version_number    = eatString("<header>.VersionNumber",     true,  2);
-  auto implicit_explicit = eatString("<header>.Implicit/Explicit", true,  1);
+template<typename E>
+std::optional<E> Kv1Parser::eatEnumeration(std::string_view field, bool mandatory, E last) {
+  auto value = eatCell(field);
+  if (!record_errors.empty()) return {};
+  return requireEnumeration(field, mandatory, last, *value);
+}
+
+Kv1Symbol Kv1Parser::eatTransportType(std::string_view field) {
+  // BISON enumeration E9
+  static constexpr std::string_view MODALITIES[] = { "BUS", "TRAIN", "METRO", "TRAM", "BOAT" };
+
+  auto value = eatStringView(field, true, 5);
+  if (!record_errors.empty()) return {};
+  if (std::find(std::begin(MODALITIES), std::end(MODALITIES), value) == std::end(MODALITIES)) {
+    warns.add({
+      .code   = KV1_WARNING_UNKNOWN_TRANSPORT_TYPE,
+      .line   = row_line,
+      .field  = field,
+      .detail = std::string(value),
+    });
+  }
+  return Kv1Symbol(value);
+}
+
+std::optional<Kv1DayType> Kv1Parser::eatDayType(std::string_view field, bool mandatory) {
+  auto value = eatCell(field);
+  if (!record_errors.empty()) return {};
+  return requireDayType(field, mandatory, *value);
+}
+
+std::string_view Kv1Parser::parseHeader() {
+  auto record_type       = eatStringView("<header>.Recordtype",        true, 10);
+  auto version_number    = eatStringView("<header>.VersionNumber",     true,  2);
+  auto implicit_explicit = eatStringView("<header>.Implicit/Explicit", true,  1);
   if (!record_errors.empty()) return {};
 
   if (version_number != "1") {
-    record_errors.push_back("<header>.VersionNumber should be 1");
+    recordError(KV1_ERROR_INVALID, "<header>.VersionNumber should be 1");
     return "";
   }
   if (implicit_explicit != "I") {
-    record_errors.push_back("<header>.Implicit/Explicit should be 'I'");
+    recordError(KV1_ERROR_INVALID, "<header>.Implicit/Explicit should be 'I'");
     return "";
   }
 
@@ -274,40 +516,43 @@ std::string Kv1Parser::parseHeader() {
 }
 
 void Kv1Parser::eatRestOfRow() {
-  while (!atEnd() && cur()->type != KV1_TOKEN_ROW_END) pos++;
+  while (!atEnd() && cur()->type != KV1_TOKEN_ROW_END) advance();
 }
 
 void Kv1Parser::parse() {
   while (!atEnd()) {
     eatRowEnds();
     if (atEnd()) return;
+    row_line = lexer.rowLine();
 
-    std::string record_type = parseHeader();
+    std::string_view record_type = parseHeader();
     if (!record_errors.empty()) break;
-    if (!type_parsers.contains(record_type)) {
-      warns.push_back(std::format("Recordtype ({}) is bad or names a record type that this program cannot process",
-                                  record_type));
+    if (record_type != section_type) {
+      section_type = record_type;
+      section_parser = findTypeParser(record_type);
+    }
+    if (!section_parser) {
+      warns.add({ .code = KV1_WARNING_UNKNOWN_RECORD_TYPE, .line = row_line, .detail = std::string(record_type) });
       eatRestOfRow();
       continue;
     }
 
-    ParseFunc parseType = Kv1Parser::type_parsers.at(record_type);
-    (this->*parseType)();
+    (this->*section_parser)();
     if (cur() && cur()->type != KV1_TOKEN_ROW_END) {
-      record_errors.push_back(std::format("Parser function for Recordtype ({}) did not eat all record fields",
-                                    record_type));
+      recordError(KV1_ERROR_UNPARSED_FIELDS, {}, 0, 0, record_type);
       eatRestOfRow();
     }
     if (!record_errors.empty()) {
-      global_errors.insert(global_errors.end(), record_errors.begin(), record_errors.end());
+      for (auto &error : record_errors)
+        global_errors.add(std::move(error));
       record_errors.clear();
     }
   }
 }
 
 void Kv1Parser::parseOrganizationalUnit() {
-  auto data_owner_code          = eatString("ORUN.DataOwnerCode",          true,   10);
-  auto organizational_unit_code = eatString("ORUN.OrganizationalUnitCode", true,   10);
+  auto data_owner_code          = eatSymbol("ORUN.DataOwnerCode",          true,   10);
+  auto organizational_unit_code = eatSymbol("ORUN.OrganizationalUnitCode", true,   10);
   auto name                     = eatString("ORUN.Name",                   true,   50);
   auto organizational_unit_type = eatString("ORUN.OrganizationalUnitType", true,   10);
   auto description              = eatString("ORUN.Description",            false, 255);
@@ -419,15 +664,15 @@ static std::optional<std::chrono::sys_seconds> parseDateTime(std::string_view sr
 }
 
 void Kv1Parser::parseHigherOrganizationalUnit() {
-  auto data_owner_code                 = eatString("ORUNORUN.DataOwnerCode",                true, 10);
-  auto organizational_unit_code_parent = eatString("ORUNORUN.OrganizationalUnitCodeParent", true, 10);
-  auto organizational_unit_code_child  = eatString("ORUNORUN.OrganizationalUnitCodeChild",  true, 10);
+  auto data_owner_code                 = eatSymbol("ORUNORUN.DataOwnerCode",                true, 10);
+  auto organizational_unit_code_parent = eatSymbol("ORUNORUN.OrganizationalUnitCodeParent", true, 10);
+  auto organizational_unit_code_child  = eatSymbol("ORUNORUN.OrganizationalUnitCodeChild",  true, 10);
   auto valid_from_raw                  = eatString("ORUNORUN.ValidFrom",                    true, 10);
   if (!record_errors.empty()) return;
 
   auto valid_from = parseYyyymmdd(valid_from_raw);
   if (!valid_from) {
-    record_errors.push_back("ORUNORUN.ValidFrom has invalid format, should be YYYY-MM-DD");
+    recordError(KV1_ERROR_INVALID, "ORUNORUN.ValidFrom has invalid format, should be YYYY-MM-DD");
     return;
   }
 
@@ -440,8 +685,8 @@ void Kv1Parser::parseHigherOrganizationalUnit() {
 }
 
 void Kv1Parser::parseUserStopPoint() {
-  auto data_owner_code     = eatString ("USRSTOP.DataOwnerCode",        true,   10);
-  auto user_stop_code      = eatString ("USRSTOP.UserStopCode",         true,   10);
+  auto data_owner_code     = eatSymbol ("USRSTOP.DataOwnerCode",        true,   10);
+  auto user_stop_code      = eatSymbol ("USRSTOP.UserStopCode",         true,   10);
   auto timing_point_code   = eatString ("USRSTOP.TimingPointCode",      false,  10);
   auto get_in              = eatBoolean("USRSTOP.GetIn",                true      );
   auto get_out             = eatBoolean("USRSTOP.GetOut",               true      );
@@ -478,7 +723,7 @@ void Kv1Parser::parseUserStopPoint() {
 }
 
 void Kv1Parser::parseUserStopArea() {
-  auto data_owner_code     = eatString("USRSTAR.DataOwnerCode",        true,   10);
+  auto data_owner_code     = eatSymbol("USRSTAR.DataOwnerCode",        true,   10);
   auto user_stop_area_code = eatString("USRSTAR.UserStopAreaCode",     true,   10);
   auto name                = eatString("USRSTAR.Name",                 true,   50);
   auto town                = eatString("USRSTAR.Town",                 true,   50);
@@ -497,9 +742,9 @@ void Kv1Parser::parseUserStopArea() {
 }
 
 void Kv1Parser::parseTimingLink() {
-  auto data_owner_code      = eatString("TILI.DataOwnerCode",     true,   10);
-  auto user_stop_code_begin = eatString("TILI.UserStopCodeBegin", true,   10);
-  auto user_stop_code_end   = eatString("TILI.UserStopCodeEnd",   true,   10);
+  auto data_owner_code      = eatSymbol("TILI.DataOwnerCode",     true,   10);
+  auto user_stop_code_begin = eatSymbol("TILI.UserStopCodeBegin", true,   10);
+  auto user_stop_code_end   = eatSymbol("TILI.UserStopCodeEnd",   true,   10);
   auto minimal_drive_time   = eatNumber("TILI.MinimalDriveTime",  false,   5);
   auto description          = eatString("TILI.Description",       false, 255);
   if (!record_errors.empty()) return;
@@ -514,13 +759,13 @@ void Kv1Parser::parseTimingLink() {
 }
 
 void Kv1Parser::parseLink() {
-  auto data_owner_code      = eatString("LINK.DataOwnerCode",        true,   10);
-  auto user_stop_code_begin = eatString("LINK.UserStopCodeBegin",    true,   10);
-  auto user_stop_code_end   = eatString("LINK.UserStopCodeEnd",      true,   10);
+  auto data_owner_code      = eatSymbol("LINK.DataOwnerCode",        true,   10);
+  auto user_stop_code_begin = eatSymbol("LINK.UserStopCodeBegin",    true,   10);
+  auto user_stop_code_end   = eatSymbol("LINK.UserStopCodeEnd",      true,   10);
                                 eatCell("LINK.<deprecated field #1>"           );
   auto distance             = eatNumber("LINK.Distance",             true,    6);
   auto description          = eatString("LINK.Description",          false, 255);
-  auto transport_type       = eatString("LINK.TransportType",        true,    5);
+  auto transport_type       = eatTransportType("LINK.TransportType");
   if (!record_errors.empty()) return;
 
   records.links.emplace_back(
@@ -534,14 +779,14 @@ void Kv1Parser::parseLink() {
 }
 
 void Kv1Parser::parseLine() {
-  auto data_owner_code      = eatString  ("LINE.DataOwnerCode",      true,   10);
-  auto line_planning_number = eatString  ("LINE.LinePlanningNumber", true,   10);
+  auto data_owner_code      = eatSymbol  ("LINE.DataOwnerCode",      true,   10);
+  auto line_planning_number = eatSymbol  ("LINE.LinePlanningNumber", true,   10);
   auto line_public_number   = eatString  ("LINE.LinePublicNumber",   true,    4);
   auto line_name            = eatString  ("LINE.LineName",           true,   50);
-  auto line_ve_tag_number   = eatNumber  ("LINE.LineVeTagNumber",    true,    3);
+  auto line_ve_tag_number   = eatInt<3, short>("LINE.LineVeTagNumber", true);
   auto description          = eatString  ("LINE.Description",        false, 255);
-  auto transport_type       = eatString  ("LINE.TransportType",      true,    5);
-  auto line_icon            = eatNumber  ("LINE.LineIcon",           false,   4);
+  auto transport_type       = eatTransportType("LINE.TransportType");
+  auto line_icon            = eatInt<4, short>("LINE.LineIcon",       false);
   auto line_color           = eatRgbColor("LINE.LineColor",          false     );
   auto line_text_color      = eatRgbColor("LINE.LineTextColor",      false     );
   if (!record_errors.empty()) return;
@@ -553,28 +798,22 @@ void Kv1Parser::parseLine() {
   //   record_errors.push_back(std::format("LINE.LineVeTagNumber is out of range [0-399] with value {}", *line_ve_tag_number));
   //   return;
   // }
-  if (*line_ve_tag_number != static_cast<short>(*line_ve_tag_number))
-    record_errors.push_back("LINE.LineVeTagNumber should be an integer");
-  if (line_icon && *line_icon != static_cast<short>(*line_icon))
-    record_errors.push_back("LINE.LineIcon should be an integer");
-  if (!record_errors.empty()) return;
-
   records.lines.emplace_back(
     Kv1Line::Key(
       data_owner_code,
       line_planning_number),
     line_public_number,
     line_name,
-    static_cast<short>(*line_ve_tag_number),
+    *line_ve_tag_number,
     description,
     transport_type,
-    static_cast<std::optional<short>>(line_icon),
+    line_icon,
     line_color,
     line_text_color);
 }
 
 void Kv1Parser::parseDestination() {
-  auto data_owner_code           = eatString  ("DEST.DataOwnerCode",           true, 10);
+  auto data_owner_code           = eatSymbol  ("DEST.DataOwnerCode",           true, 10);
   auto dest_code                 = eatString  ("DEST.DestCode",                true, 10);
   auto dest_name_full            = eatString  ("DEST.DestNameFull",            true, 50);
   auto dest_name_main            = eatString  ("DEST.DestNameMain",            true, 24);
@@ -586,7 +825,7 @@ void Kv1Parser::parseDestination() {
   auto dest_name_detail_19       = eatString  ("DEST.DestNameDetail19",       false, 19);
   auto dest_name_main_16         = eatString  ("DEST.DestNameMain16",          true, 16);
   auto dest_name_detail_16       = eatString  ("DEST.DestNameDetail16",       false, 16);
-  auto dest_icon                 = eatNumber  ("DEST.DestIcon",               false,  4);
+  auto dest_icon                 = eatInt<4, short>("DEST.DestIcon",        false);
   auto dest_color                = eatRgbColor("DEST.DestColor",              false    );
   // NOTE: Deviating from the offical KV1 specification here. It specifies that
   // the maximum length for this field should be 30, but then proceeds to
@@ -596,11 +835,6 @@ void Kv1Parser::parseDestination() {
   auto dest_text_color           = eatRgbColor("DEST.DestTextColor",          false    );
   if (!record_errors.empty()) return;
 
-  if (dest_icon && *dest_icon != static_cast<short>(*dest_icon)) {
-    record_errors.push_back("DEST.DestIcon should be an integer");
-    return;
-  }
-
   records.destinations.emplace_back(
     Kv1Destination::Key(
       data_owner_code,
@@ -621,16 +855,16 @@ void Kv1Parser::parseDestination() {
 }
 
 void Kv1Parser::parseJourneyPattern() {
-  auto data_owner_code      = eatString("JOPA.DataOwnerCode",       true,  10);
-  auto line_planning_number = eatString("JOPA.LinePlanningNumber",  true,  10);
-  auto journey_pattern_code = eatString("JOPA.JourneyPatternCode",  true,  10);
+  auto data_owner_code      = eatSymbol("JOPA.DataOwnerCode",       true,  10);
+  auto line_planning_number = eatSymbol("JOPA.LinePlanningNumber",  true,  10);
+  auto journey_pattern_code = eatSymbol("JOPA.JourneyPatternCode",  true,  10);
   auto journey_pattern_type = eatString("JOPA.JourneyPatternType",  true,  10);
   auto direction            = eatString("JOPA.Direction",           true,   1);
   auto description          = eatString("JOPA.Description",        false, 255);
   if (!record_errors.empty()) return;
 
   if (direction != "1" && direction != "2" && direction != "A" && direction != "B") {
-    record_errors.push_back("JOPA.Direction should be in [1, 2, A, B]");
+    recordError(KV1_ERROR_INVALID, "JOPA.Direction should be in [1, 2, A, B]");
     return;
   }
 
@@ -645,7 +879,7 @@ void Kv1Parser::parseJourneyPattern() {
 }
 
 void Kv1Parser::parseConcessionFinancerRelation() {
-  auto data_owner_code      = eatString("CONFINREL.DataOwnerCode",       true, 10);
+  auto data_owner_code      = eatSymbol("CONFINREL.DataOwnerCode",       true, 10);
   auto con_fin_rel_code     = eatString("CONFINREL.ConFinRelCode",       true, 10);
   auto concession_area_code = eatString("CONFINREL.ConcessionAreaCode",  true, 10);
   auto financer_code        = eatString("CONFINREL.FinancerCode",       false, 10);
@@ -660,7 +894,7 @@ void Kv1Parser::parseConcessionFinancerRelation() {
 }
 
 void Kv1Parser::parseConcessionArea() {
-  auto data_owner_code      = eatString("CONAREA.DataOwnerCode",      true,  10);
+  auto data_owner_code      = eatSymbol("CONAREA.DataOwnerCode",      true,  10);
   auto concession_area_code = eatString("CONAREA.ConcessionAreaCode", true,  10);
   auto description          = eatString("CONAREA.Description",        true, 255);
   if (!record_errors.empty()) return;
@@ -673,7 +907,7 @@ void Kv1Parser::parseConcessionArea() {
 }
 
 void Kv1Parser::parseFinancer() {
-  auto data_owner_code = eatString("FINANCER.DataOwnerCode", true,  10);
+  auto data_owner_code = eatSymbol("FINANCER.DataOwnerCode", true,  10);
   auto financer_code   = eatString("FINANCER.FinancerCode",  true,  10);
   auto description     = eatString("FINANCER.Description",   true, 255);
   if (!record_errors.empty()) return;
@@ -686,39 +920,32 @@ void Kv1Parser::parseFinancer() {
 }
 
 void Kv1Parser::parseJourneyPatternTimingLink() {
-  auto data_owner_code      = eatString  ("JOPATILI.DataOwnerCode",        true, 10);
-  auto line_planning_number = eatString  ("JOPATILI.LinePlanningNumber",   true, 10);
-  auto journey_pattern_code = eatString  ("JOPATILI.JourneyPatternCode",   true, 10);
-  auto timing_link_order    = eatNumber  ("JOPATILI.TimingLinkOrder",      true,  3);
-  auto user_stop_code_begin = eatString  ("JOPATILI.UserStopCodeBegin",    true, 10);
-  auto user_stop_code_end   = eatString  ("JOPATILI.UserStopCodeEnd",      true, 10);
+  auto data_owner_code      = eatSymbol  ("JOPATILI.DataOwnerCode",        true, 10);
+  auto line_planning_number = eatSymbol  ("JOPATILI.LinePlanningNumber",   true, 10);
+  auto journey_pattern_code = eatSymbol  ("JOPATILI.JourneyPatternCode",   true, 10);
+  auto timing_link_order    = eatInt<3, short>("JOPATILI.TimingLinkOrder", true);
+  auto user_stop_code_begin = eatSymbol  ("JOPATILI.UserStopCodeBegin",    true, 10);
+  auto user_stop_code_end   = eatSymbol  ("JOPATILI.UserStopCodeEnd",      true, 10);
   auto con_fin_rel_code     = eatString  ("JOPATILI.ConFinRelCode",        true, 10);
   auto dest_code            = eatString  ("JOPATILI.DestCode",             true, 10);
                               eatCell    ("JOPATILI.<deprecated field #1>"         );
   auto is_timing_stop       = eatBoolean ("JOPATILI.IsTimingStop",         true    );
   auto display_public_line  = eatString  ("JOPATILI.DisplayPublicLine",    false, 4);
-  auto product_formula_type = eatNumber  ("JOPATILI.ProductFormulaType",   false, 4);
+  auto product_formula_type = eatInt<4, short>("JOPATILI.ProductFormulaType", false);
   auto get_in               = eatBoolean ("JOPATILI.GetIn",                true    );
   auto get_out              = eatBoolean ("JOPATILI.GetOut",               true    );
-  auto show_flexible_trip   = eatString  ("JOPATILI.ShowFlexibleTrip",     false, 8);
-  auto line_dest_icon       = eatNumber  ("JOPATILI.LineDestIcon",         false, 4);
+  auto show_flexible_trip   = eatEnumeration("JOPATILI.ShowFlexibleTrip", false, _KV1_SHOW_FLEXIBLE_TRIP_LAST);
+  auto line_dest_icon       = eatInt<4, short>("JOPATILI.LineDestIcon",   false);
   auto line_dest_color      = eatRgbColor("JOPATILI.LineDestColor",        false   );
   auto line_dest_text_color = eatRgbColor("JOPATILI.LineDestTextColor",    false   );
   if (!record_errors.empty()) return;
 
-  if (line_dest_icon && *line_dest_icon != static_cast<short>(*line_dest_icon))
-    record_errors.push_back("JOPATILI.LineDestIcon should be an integer");
-  if (!show_flexible_trip.empty() && show_flexible_trip != "TRUE" &&
-       show_flexible_trip != "FALSE" && show_flexible_trip != "REALTIME")
-    record_errors.push_back("JOPATILI.ShowFlexibleTrip should be in BISON E21 values [TRUE, FALSE, REALTIME]");
-  if (!record_errors.empty()) return;
-
   records.journey_pattern_timing_links.emplace_back(
     Kv1JourneyPatternTimingLink::Key(
       data_owner_code,
       line_planning_number,
       journey_pattern_code,
-      static_cast<short>(*timing_link_order)),
+      *timing_link_order),
     user_stop_code_begin,
     user_stop_code_end,
     con_fin_rel_code,
@@ -735,8 +962,8 @@ void Kv1Parser::parseJourneyPatternTimingLink() {
 }
 
 void Kv1Parser::parsePoint() {
-  auto data_owner_code        = eatString("POINT.DataOwnerCode",        true,   10);
-  auto point_code             = eatString("POINT.PointCode",            true,   10);
+  auto data_owner_code        = eatSymbol("POINT.DataOwnerCode",        true,   10);
+  auto point_code             = eatSymbol("POINT.PointCode",            true,   10);
                                 eatCell  ("POINT.<deprecated field #1>"           );
   auto point_type             = eatString("POINT.PointType",            true,   10);
   auto coordinate_system_type = eatString("POINT.CoordinateSystemType", true,   10);
@@ -764,17 +991,17 @@ void Kv1Parser::parsePoint() {
 }
 
 void Kv1Parser::parsePointOnLink() {
-  auto data_owner_code              = eatString("POOL.DataOwnerCode",             true,  10);
-  auto user_stop_code_begin         = eatString("POOL.UserStopCodeBegin",         true,  10);
-  auto user_stop_code_end           = eatString("POOL.UserStopCodeEnd",           true,  10);
+  auto data_owner_code              = eatSymbol("POOL.DataOwnerCode",             true,  10);
+  auto user_stop_code_begin         = eatSymbol("POOL.UserStopCodeBegin",         true,  10);
+  auto user_stop_code_end           = eatSymbol("POOL.UserStopCodeEnd",           true,  10);
                                       eatCell  ("POOL.<deprecated field #1>"               );
-  auto point_data_owner_code        = eatString("POOL.PointDataOwnerCode",        true,  10);
-  auto point_code                   = eatString("POOL.PointCode",                 true,  10);
+  auto point_data_owner_code        = eatSymbol("POOL.PointDataOwnerCode",        true,  10);
+  auto point_code                   = eatSymbol("POOL.PointCode",                 true,  10);
   auto distance_since_start_of_link = eatNumber("POOL.DistanceSinceStartOfLink",  true,   5);
   auto segment_speed                = eatNumber("POOL.SegmentSpeed",             false,   4);
   auto local_point_speed            = eatNumber("POOL.LocalPointSpeed",          false,   4);
   auto description                  = eatString("POOL.Description",              false, 255);
-  auto transport_type               = eatString("POOL.TransportType",             true,   5);
+  auto transport_type               = eatTransportType("POOL.TransportType");
   if (!record_errors.empty()) return;
 
   records.point_on_links.emplace_back(
@@ -792,25 +1019,20 @@ void Kv1Parser::parsePointOnLink() {
 }
 
 void Kv1Parser::parseIcon() {
-  auto data_owner_code = eatString("ICON.DataOwnerCode", true,   10);
-  auto icon_number     = eatNumber("ICON.IconNumber",    true,    4);
+  auto data_owner_code = eatSymbol("ICON.DataOwnerCode", true,   10);
+  auto icon_number     = eatInt<4, short>("ICON.IconNumber", true);
   auto icon_uri        = eatString("ICON.IconURI",       true, 1024);
   if (!record_errors.empty()) return;
 
-  if (*icon_number != static_cast<short>(*icon_number)) {
-    record_errors.push_back("ICON.IconNumber should be an integer");
-    return;
-  }
-
   records.icons.emplace_back(
     Kv1Icon::Key(
       data_owner_code,
-      static_cast<short>(*icon_number)),
+      *icon_number),
     icon_uri);
 }
 
 void Kv1Parser::parseNotice() {
-  auto data_owner_code = eatString("NOTICE.DataOwnerCode", true,   10);
+  auto data_owner_code = eatSymbol("NOTICE.DataOwnerCode", true,   10);
   auto notice_code     = eatString("NOTICE.NoticeCode",    true,   20);
   auto notice_content  = eatString("NOTICE.NoticeContent", true, 1024);
   if (!record_errors.empty()) return;
@@ -823,34 +1045,30 @@ void Kv1Parser::parseNotice() {
 }
 
 void Kv1Parser::parseNoticeAssignment() {
-  auto data_owner_code          = eatString("NTCASSGNM.DataOwnerCode",           true, 10);
+  auto data_owner_code          = eatSymbol("NTCASSGNM.DataOwnerCode",           true, 10);
   auto notice_code              = eatString("NTCASSGNM.NoticeCode",              true, 20);
   auto assigned_object          = eatString("NTCASSGNM.AssignedObject",          true,  8);
   auto timetable_version_code   = eatString("NTCASSGNM.TimetableVersionCode",   false, 10);
-  auto organizational_unit_code = eatString("NTCASSGNM.OrganizationalUnitCode", false, 10);
+  auto organizational_unit_code = eatSymbol("NTCASSGNM.OrganizationalUnitCode", false, 10);
   auto schedule_code            = eatString("NTCASSGNM.ScheduleCode",           false, 10);
   auto schedule_type_code       = eatString("NTCASSGNM.ScheduleTypeCode",       false, 10);
   auto period_group_code        = eatString("NTCASSGNM.PeriodGroupCode",        false, 10);
   auto specific_day_code        = eatString("NTCASSGNM.SpecificDayCode",        false, 10);
-  auto day_type                 = eatString("NTCASSGNM.DayType",                false,  7);
-  auto line_planning_number     = eatString("NTCASSGNM.LinePlanningNumber",      true, 10);
-  auto journey_number           = eatNumber("NTCASSGNM.JourneyNumber",          false,  6);
-  auto stop_order               = eatNumber("NTCASSGNM.StopOrder",              false,  4);
-  auto journey_pattern_code     = eatString("NTCASSGNM.JourneyPatternCode",     false, 10);
-  auto timing_link_order        = eatNumber("NTCASSGNM.TimingLinkOrder",        false,  3);
-  auto user_stop_code           = eatString("NTCASSGNM.UserStopCode",           false, 10);
+  auto day_type                 = eatDayType("NTCASSGNM.DayType",               false    );
+  auto line_planning_number     = eatSymbol("NTCASSGNM.LinePlanningNumber",      true, 10);
+  auto journey_number           = eatInt<6, int>("NTCASSGNM.JourneyNumber",     false);
+  auto stop_order               = eatInt<4, int>("NTCASSGNM.StopOrder",         false);
+  auto journey_pattern_code     = eatSymbol("NTCASSGNM.JourneyPatternCode",     false, 10);
+  auto timing_link_order        = eatInt<3, short>("NTCASSGNM.TimingLinkOrder", false);
+  auto user_stop_code           = eatSymbol("NTCASSGNM.UserStopCode",           false, 10);
   if (!record_errors.empty()) return;
 
-  if (journey_number && *journey_number != static_cast<short>(*journey_number))
-    record_errors.push_back("NTCASSGNM.JourneyNumber should be an integer");
   if (journey_number && (*journey_number < 0 || *journey_number > 999'999))
-    record_errors.push_back("NTCASSGNM.JourneyNumber should be within the range [0-999999]");
-  if (stop_order && *stop_order != static_cast<short>(*stop_order))
-    record_errors.push_back("NTCASSGNM.StopOrder should be an integer");
+    recordError(KV1_ERROR_INVALID, "NTCASSGNM.JourneyNumber should be within the range [0-999999]");
   if (!journey_number && (assigned_object == "PUJO" || assigned_object == "PUJOPASS"))
-    record_errors.push_back("NTCASSGNM.JourneyNumber is required for AssignedObject PUJO/PUJOPASS");
+    recordError(KV1_ERROR_INVALID, "NTCASSGNM.JourneyNumber is required for AssignedObject PUJO/PUJOPASS");
   if (journey_pattern_code.empty() && assigned_object == "JOPATILI")
-    record_errors.push_back("NTCASSGNM.JourneyPatternCode is required for AssignedObject JOPATILI");
+    recordError(KV1_ERROR_INVALID, "NTCASSGNM.JourneyPatternCode is required for AssignedObject JOPATILI");
   if (!record_errors.empty()) return;
 
   records.notice_assignments.emplace_back(
@@ -873,10 +1091,10 @@ void Kv1Parser::parseNoticeAssignment() {
 }
 
 void Kv1Parser::parseTimeDemandGroup() {
-  auto data_owner_code        = eatString("TIMDEMGRP.DataOwnerCode",       true, 10);
-  auto line_planning_number   = eatString("TIMDEMGRP.LinePlanningNumber",  true, 10);
-  auto journey_pattern_code   = eatString("TIMDEMGRP.JourneyPatternCode",  true, 10);
-  auto time_demand_group_code = eatString("TIMDEMGRP.TimeDemandGroupCode", true, 10);
+  auto data_owner_code        = eatSymbol("TIMDEMGRP.DataOwnerCode",       true, 10);
+  auto line_planning_number   = eatSymbol("TIMDEMGRP.LinePlanningNumber",  true, 10);
+  auto journey_pattern_code   = eatSymbol("TIMDEMGRP.JourneyPatternCode",  true, 10);
+  auto time_demand_group_code = eatSymbol("TIMDEMGRP.TimeDemandGroupCode", true, 10);
   if (!record_errors.empty()) return;
 
   records.time_demand_groups.emplace_back(
@@ -888,13 +1106,13 @@ void Kv1Parser::parseTimeDemandGroup() {
 }
 
 void Kv1Parser::parseTimeDemandGroupRunTime() {
-  auto data_owner_code        = eatString("TIMDEMRNT.DataOwnerCode",       true,  10);
-  auto line_planning_number   = eatString("TIMDEMRNT.LinePlanningNumber",  true,  10);
-  auto journey_pattern_code   = eatString("TIMDEMRNT.JourneyPatternCode",  true,  10);
-  auto time_demand_group_code = eatString("TIMDEMRNT.TimeDemandGroupCode", true,  10);
-  auto timing_link_order      = eatNumber("TIMDEMRNT.TimingLinkOrder",     true,   3);
-  auto user_stop_code_begin   = eatString("TIMDEMRNT.UserStopCodeBegin",   true,  10);
-  auto user_stop_code_end     = eatString("TIMDEMRNT.UserStopCodeEnd",     true,  10);
+  auto data_owner_code        = eatSymbol("TIMDEMRNT.DataOwnerCode",       true,  10);
+  auto line_planning_number   = eatSymbol("TIMDEMRNT.LinePlanningNumber",  true,  10);
+  auto journey_pattern_code   = eatSymbol("TIMDEMRNT.JourneyPatternCode",  true,  10);
+  auto time_demand_group_code = eatSymbol("TIMDEMRNT.TimeDemandGroupCode", true,  10);
+  auto timing_link_order      = eatInt<3, short>("TIMDEMRNT.TimingLinkOrder", true);
+  auto user_stop_code_begin   = eatSymbol("TIMDEMRNT.UserStopCodeBegin",   true,  10);
+  auto user_stop_code_end     = eatSymbol("TIMDEMRNT.UserStopCodeEnd",     true,  10);
   auto total_drive_time       = eatNumber("TIMDEMRNT.TotalDriveTime",      true,   5);
   auto drive_time             = eatNumber("TIMDEMRNT.DriveTime",           true,   5);
   auto expected_delay         = eatNumber("TIMDEMRNT.ExpectedDelay",       false,  5);
@@ -903,18 +1121,13 @@ void Kv1Parser::parseTimeDemandGroupRunTime() {
   auto minimum_stop_time      = eatNumber("TIMDEMRNT.MinimumStopTime",     false,  5);
   if (!record_errors.empty()) return;
 
-  if (timing_link_order && *timing_link_order != static_cast<short>(*timing_link_order)) {
-    record_errors.push_back("TIMDEMRNT.TimingLinkOrder should be an integer");
-    return;
-  }
-
   records.time_demand_group_run_times.emplace_back(
     Kv1TimeDemandGroupRunTime::Key(
       data_owner_code,
       line_planning_number,
       journey_pattern_code,
       time_demand_group_code,
-      static_cast<short>(*timing_link_order)),
+      *timing_link_order),
     user_stop_code_begin,
     user_stop_code_end,
     *total_drive_time,
@@ -926,7 +1139,7 @@ void Kv1Parser::parseTimeDemandGroupRunTime() {
 }
 
 void Kv1Parser::parsePeriodGroup() {
-  auto data_owner_code   = eatString("PEGR.DataOwnerCode",    true,  10);
+  auto data_owner_code   = eatSymbol("PEGR.DataOwnerCode",    true,  10);
   auto period_group_code = eatString("PEGR.PeriodGroupCode",  true,  10);
   auto description       = eatString("PEGR.Description",     false, 255);
   if (!record_errors.empty()) return;
@@ -939,7 +1152,7 @@ void Kv1Parser::parsePeriodGroup() {
 }
 
 void Kv1Parser::parseSpecificDay() {
-  auto data_owner_code   = eatString("SPECDAY.DataOwnerCode",    true,  10);
+  auto data_owner_code   = eatSymbol("SPECDAY.DataOwnerCode",    true,  10);
   auto specific_day_code = eatString("SPECDAY.SpecificDayCode",  true,  10);
   auto name              = eatString("SPECDAY.Name",             true,  50);
   auto description       = eatString("SPECDAY.Description",     false, 255);
@@ -954,8 +1167,8 @@ void Kv1Parser::parseSpecificDay() {
 }
 
 void Kv1Parser::parseTimetableVersion() {
-  auto data_owner_code          = eatString("TIVE.DataOwnerCode",           true,  10);
-  auto organizational_unit_code = eatString("TIVE.OrganizationalUnitCode",  true,  10);
+  auto data_owner_code          = eatSymbol("TIVE.DataOwnerCode",           true,  10);
+  auto organizational_unit_code = eatSymbol("TIVE.OrganizationalUnitCode",  true,  10);
   auto timetable_version_code   = eatString("TIVE.TimetableVersionCode",    true,  10);
   auto period_group_code        = eatString("TIVE.PeriodGroupCode",         true,  10);
   auto specific_day_code        = eatString("TIVE.SpecificDayCode",         true,  10);
@@ -967,16 +1180,16 @@ void Kv1Parser::parseTimetableVersion() {
 
   auto valid_from = parseYyyymmdd(valid_from_raw);
   if (!valid_from)
-    record_errors.push_back("TIVE.ValidFrom has invalid format, should be YYYY-MM-DD");
+    recordError(KV1_ERROR_INVALID, "TIVE.ValidFrom has invalid format, should be YYYY-MM-DD");
   std::optional<std::chrono::year_month_day> valid_thru;
   if (!valid_thru_raw.empty()) {
     valid_thru = parseYyyymmdd(valid_thru_raw);
     if (!valid_thru) {
-      record_errors.push_back("TIVE.ValidFrom has invalid format, should be YYYY-MM-DD");
+      recordError(KV1_ERROR_INVALID, "TIVE.ValidFrom has invalid format, should be YYYY-MM-DD");
     }
   }
   if (!description.empty())
-    record_errors.push_back("TIVE.Description should be empty");
+    recordError(KV1_ERROR_INVALID, "TIVE.Description should be empty");
   if (!record_errors.empty()) return;
 
   records.timetable_versions.emplace_back(
@@ -993,38 +1206,29 @@ void Kv1Parser::parseTimetableVersion() {
 }
 
 void Kv1Parser::parsePublicJourney() {
-  auto data_owner_code          = eatString ("PUJO.DataOwnerCode",           true, 10);
+  auto data_owner_code          = eatSymbol ("PUJO.DataOwnerCode",           true, 10);
   auto timetable_version_code   = eatString ("PUJO.TimetableVersionCode",    true, 10);
-  auto organizational_unit_code = eatString ("PUJO.OrganizationalUnitCode",  true, 10);
+  auto organizational_unit_code = eatSymbol ("PUJO.OrganizationalUnitCode",  true, 10);
   auto period_group_code        = eatString ("PUJO.PeriodGroupCode",         true, 10);
   auto specific_day_code        = eatString ("PUJO.SpecificDayCode",         true, 10);
-  auto day_type                 = eatString ("PUJO.DayType",                 true,  7);
-  auto line_planning_number     = eatString ("PUJO.LinePlanningNumber",      true, 10);
-  auto journey_number           = eatNumber ("PUJO.JourneyNumber",           true,  6);
-  auto time_demand_group_code   = eatString ("PUJO.TimeDemandGroupCode",     true, 10);
-  auto journey_pattern_code     = eatString ("PUJO.JourneyPatternCode",      true, 10);
+  auto day_type                 = eatDayType("PUJO.DayType",                 true    );
+  auto line_planning_number     = eatSymbol ("PUJO.LinePlanningNumber",      true, 10);
+  auto journey_number           = eatInt<6, int>("PUJO.JourneyNumber",     true);
+  auto time_demand_group_code   = eatSymbol ("PUJO.TimeDemandGroupCode",     true, 10);
+  auto journey_pattern_code     = eatSymbol ("PUJO.JourneyPatternCode",      true, 10);
   auto departure_time_raw       = eatString ("PUJO.DepartureTime",           true,  8);
-  auto wheelchair_accessible    = eatString ("PUJO.WheelChairAccessible",    true, 13);
+  auto wheelchair_accessible    = eatEnumeration("PUJO.WheelChairAccessible", true, _KV1_WHEELCHAIR_LAST);
   auto data_owner_is_operator   = eatBoolean("PUJO.DataOwnerIsOperator",     true    );
   auto planned_monitored        = eatBoolean("PUJO.PlannedMonitored",        true    );
-  auto product_formula_type     = eatNumber ("PUJO.ProductFormulaType",     false,  4);
-  auto show_flexible_trip       = eatString ("PUJO.ShowFlexibleTrip",       false,  8);
+  auto product_formula_type     = eatInt<4, short>("PUJO.ProductFormulaType", false);
+  auto show_flexible_trip       = eatEnumeration("PUJO.ShowFlexibleTrip",   false, _KV1_SHOW_FLEXIBLE_TRIP_LAST);
   if (!record_errors.empty()) return;
 
   auto departure_time = parseHhmmss(departure_time_raw);
   if (!departure_time)
-    record_errors.push_back("PUJO.DepartureTime has a bad format");
+    recordError(KV1_ERROR_INVALID, "PUJO.DepartureTime has a bad format");
   if (*journey_number < 0 || *journey_number > 999'999)
-    record_errors.push_back("PUJO.JourneyNumber should be within the range [0-999999]");
-  if (*journey_number != static_cast<int>(*journey_number))
-    record_errors.push_back("PUJO.JourneyNumber should be an integer");
-  if (product_formula_type && *product_formula_type != static_cast<short>(*product_formula_type))
-    record_errors.push_back("PUJO.ProductFormulaType should be an integer");
-  if (wheelchair_accessible != "ACCESSIBLE" && wheelchair_accessible != "NOTACCESSIBLE" && wheelchair_accessible != "UNKNOWN")
-    record_errors.push_back("PUJO.WheelChairAccessible should be in BISON E3 values [ACCESSIBLE, NOTACCESSIBLE, UNKNOWN]");
-  if (!show_flexible_trip.empty() && show_flexible_trip != "TRUE" &&
-       show_flexible_trip != "FALSE" && show_flexible_trip != "REALTIME")
-    record_errors.push_back("PUJO.ShowFlexibleTrip should be in BISON E21 values [TRUE, FALSE, REALTIME]");
+    recordError(KV1_ERROR_INVALID, "PUJO.JourneyNumber should be within the range [0-999999]");
   if (!record_errors.empty()) return;
 
   records.public_journeys.emplace_back(
@@ -1034,13 +1238,13 @@ void Kv1Parser::parsePublicJourney() {
       organizational_unit_code,
       period_group_code,
       specific_day_code,
-      day_type,
+      *day_type,
       line_planning_number,
-      static_cast<int>(*journey_number)),
+      *journey_number),
     time_demand_group_code,
     journey_pattern_code,
     *departure_time,
-    wheelchair_accessible,
+    *wheelchair_accessible,
     *data_owner_is_operator,
     *planned_monitored,
     product_formula_type,
@@ -1048,8 +1252,8 @@ void Kv1Parser::parsePublicJourney() {
 }
 
 void Kv1Parser::parsePeriodGroupValidity() {
-  auto data_owner_code          = eatString("PEGRVAL.DataOwnerCode",          true, 10);
-  auto organizational_unit_code = eatString("PEGRVAL.OrganizationalUnitCode", true, 10);
+  auto data_owner_code          = eatSymbol("PEGRVAL.DataOwnerCode",          true, 10);
+  auto organizational_unit_code = eatSymbol("PEGRVAL.OrganizationalUnitCode", true, 10);
   auto period_group_code        = eatString("PEGRVAL.PeriodGroupCode",        true, 10);
   auto valid_from_raw           = eatString("PEGRVAL.ValidFrom",              true, 10);
   auto valid_thru_raw           = eatString("PEGRVAL.ValidThru",              true, 10);
@@ -1058,9 +1262,9 @@ void Kv1Parser::parsePeriodGroupValidity() {
   auto valid_from = parseYyyymmdd(valid_from_raw);
   auto valid_thru = parseYyyymmdd(valid_thru_raw);
   if (!valid_from)
-    record_errors.push_back("PEGRVAL.ValidFrom has invalid format, should be YYYY-MM-DD");
+    recordError(KV1_ERROR_INVALID, "PEGRVAL.ValidFrom has invalid format, should be YYYY-MM-DD");
   if (!valid_thru)
-    record_errors.push_back("PEGRVAL.ValidThru has invalid format, should be YYYY-MM-DD");
+    recordError(KV1_ERROR_INVALID, "PEGRVAL.ValidThru has invalid format, should be YYYY-MM-DD");
   if (!record_errors.empty()) return;
 
   records.period_group_validities.emplace_back(
@@ -1073,10 +1277,10 @@ void Kv1Parser::parsePeriodGroupValidity() {
 }
 
 void Kv1Parser::parseExceptionalOperatingDay() {
-  auto data_owner_code          = eatString("EXCOPDAY.DataOwnerCode",           true,  10);
-  auto organizational_unit_code = eatString("EXCOPDAY.OrganizationalUnitCode",  true,  10);
+  auto data_owner_code          = eatSymbol("EXCOPDAY.DataOwnerCode",           true,  10);
+  auto organizational_unit_code = eatSymbol("EXCOPDAY.OrganizationalUnitCode",  true,  10);
   auto valid_date_raw           = eatString("EXCOPDAY.ValidDate",               true,  23);
-  auto day_type_as_on           = eatString("EXCOPDAY.DayTypeAsOn",             true,   7);
+  auto day_type_as_on           = eatDayType("EXCOPDAY.DayTypeAsOn",            true     );
   auto specific_day_code        = eatString("EXCOPDAY.SpecificDayCode",         true,  10);
   auto period_group_code        = eatString("EXCOPDAY.PeriodGroupCode",        false,  10);
   auto description              = eatString("EXCOPDAY.Description",            false, 255);
@@ -1085,7 +1289,7 @@ void Kv1Parser::parseExceptionalOperatingDay() {
   std::string_view error;
   auto valid_date = parseDateTime(valid_date_raw, amsterdam, &error);
   if (!valid_date) {
-    record_errors.push_back(std::format("EXCOPDAY.ValidDate has an bad format (value: {}): {}", valid_date_raw, error));
+    recordError(KV1_ERROR_BAD_VALUE, "EXCOPDAY.ValidDate", 0, 0, std::format("{} ({})", valid_date_raw, error));
     return;
   }
 
@@ -1094,15 +1298,15 @@ void Kv1Parser::parseExceptionalOperatingDay() {
       data_owner_code,
       organizational_unit_code,
       *valid_date),
-    day_type_as_on,
+    *day_type_as_on,
     specific_day_code,
     period_group_code,
     description);
 }
 
 void Kv1Parser::parseScheduleVersion() {
-  auto data_owner_code          = eatString("SCHEDVERS.DataOwnerCode",           true,  10);
-  auto organizational_unit_code = eatString("SCHEDVERS.OrganizationalUnitCode",  true,  10);
+  auto data_owner_code          = eatSymbol("SCHEDVERS.DataOwnerCode",           true,  10);
+  auto organizational_unit_code = eatSymbol("SCHEDVERS.OrganizationalUnitCode",  true,  10);
   auto schedule_code            = eatString("SCHEDVERS.ScheduleCode",            true,  10);
   auto schedule_type_code       = eatString("SCHEDVERS.ScheduleTypeCode",        true,  10);
   auto valid_from_raw           = eatString("SCHEDVERS.ValidFrom",               true,  10);
@@ -1112,16 +1316,16 @@ void Kv1Parser::parseScheduleVersion() {
 
   auto valid_from = parseYyyymmdd(valid_from_raw);
   if (!valid_from)
-    record_errors.push_back("SCHEDVERS.ValidFrom has invalid format, should be YYYY-MM-DD");
+    recordError(KV1_ERROR_INVALID, "SCHEDVERS.ValidFrom has invalid format, should be YYYY-MM-DD");
   std::optional<std::chrono::year_month_day> valid_thru;
   if (!valid_thru_raw.empty()) {
     valid_thru = parseYyyymmdd(valid_thru_raw);
     if (!valid_thru) {
-      record_errors.push_back("SCHEDVERS.ValidFrom has invalid format, should be YYYY-MM-DD");
+      recordError(KV1_ERROR_INVALID, "SCHEDVERS.ValidFrom has invalid format, should be YYYY-MM-DD");
     }
   }
   if (!description.empty())
-    record_errors.push_back("SCHEDVERS.Description should be empty");
+    recordError(KV1_ERROR_INVALID, "SCHEDVERS.Description should be empty");
   if (!record_errors.empty()) return;
  
   records.schedule_versions.emplace_back(
@@ -1136,49 +1340,38 @@ void Kv1Parser::parseScheduleVersion() {
 }
 
 void Kv1Parser::parsePublicJourneyPassingTimes() {
-  auto data_owner_code           = eatString ("PUJOPASS.DataOwnerCode",           true, 10);
-  auto organizational_unit_code  = eatString ("PUJOPASS.OrganizationalUnitCode",  true, 10);
+  auto data_owner_code           = eatSymbol ("PUJOPASS.DataOwnerCode",           true, 10);
+  auto organizational_unit_code  = eatSymbol ("PUJOPASS.OrganizationalUnitCode",  true, 10);
   auto schedule_code             = eatString ("PUJOPASS.ScheduleCode",            true, 10);
   auto schedule_type_code        = eatString ("PUJOPASS.ScheduleTypeCode",        true, 10);
-  auto line_planning_number      = eatString ("PUJOPASS.LinePlanningNumber",      true, 10);
-  auto journey_number            = eatNumber ("PUJOPASS.JourneyNumber",           true,  6);
-  auto stop_order                = eatNumber ("PUJOPASS.StopOrder",               true,  4);
-  auto journey_pattern_code      = eatString ("PUJOPASS.JourneyPatternCode",      true, 10);
-  auto user_stop_code            = eatString ("PUJOPASS.UserStopCode",            true, 10);
+  auto line_planning_number      = eatSymbol ("PUJOPASS.LinePlanningNumber",      true, 10);
+  auto journey_number            = eatInt<6, int>  ("PUJOPASS.JourneyNumber",     true);
+  auto stop_order                = eatInt<4, short>("PUJOPASS.StopOrder",         true);
+  auto journey_pattern_code      = eatSymbol ("PUJOPASS.JourneyPatternCode",      true, 10);
+  auto user_stop_code            = eatSymbol ("PUJOPASS.UserStopCode",            true, 10);
   auto target_arrival_time_raw   = eatString ("PUJOPASS.TargetArrivalTime",      false,  8);
   auto target_departure_time_raw = eatString ("PUJOPASS.TargetDepartureTime",    false,  8);
-  auto wheelchair_accessible     = eatString ("PUJOPASS.WheelChairAccessible",    true, 13);
+  auto wheelchair_accessible     = eatEnumeration("PUJOPASS.WheelChairAccessible", true, _KV1_WHEELCHAIR_LAST);
   auto data_owner_is_operator    = eatBoolean("PUJOPASS.DataOwnerIsOperator",     true    );
   auto planned_monitored         = eatBoolean("PUJOPASS.PlannedMonitored",        true    );
-  auto product_formula_type      = eatNumber ("PUJOPASS.ProductFormulaType",     false,  4);
-  auto show_flexible_trip        = eatString ("PUJOPASS.ShowFlexibleTrip",       false,  8);
+  auto product_formula_type      = eatInt<4, short>("PUJOPASS.ProductFormulaType", false);
+  auto show_flexible_trip        = eatEnumeration("PUJOPASS.ShowFlexibleTrip",   false, _KV1_SHOW_FLEXIBLE_TRIP_LAST);
   if (!record_errors.empty()) return;
 
   if (*journey_number < 0 || *journey_number > 999'999)
-    record_errors.push_back("PUJOPASS.JourneyNumber should be within the range [0-999999]");
-  if (*journey_number != static_cast<int>(*journey_number))
-    record_errors.push_back("PUJOPASS.JourneyNumber should be an integer");
-  if (*stop_order != static_cast<short>(*stop_order))
-    record_errors.push_back("PUJOPASS.StopOrder should be an integer");
-  if (product_formula_type && *product_formula_type != static_cast<short>(*product_formula_type))
-    record_errors.push_back("PUJOPASS.ProductFormulaType should be an integer");
-  if (wheelchair_accessible != "ACCESSIBLE" && wheelchair_accessible != "NOTACCESSIBLE" && wheelchair_accessible != "UNKNOWN")
-    record_errors.push_back("PUJOPASS.WheelChairAccessible should be in BISON E3 values [ACCESSIBLE, NOTACCESSIBLE, UNKNOWN]");
-  if (!show_flexible_trip.empty() && show_flexible_trip != "TRUE" &&
-       show_flexible_trip != "FALSE" && show_flexible_trip != "REALTIME")
-    record_errors.push_back("PUJOPASS.ShowFlexibleTrip should be in BISON E21 values [TRUE, FALSE, REALTIME]");
+    recordError(KV1_ERROR_INVALID, "PUJOPASS.JourneyNumber should be within the range [0-999999]");
   std::optional<std::chrono::hh_mm_ss<std::chrono::seconds>> target_arrival_time;
   if (!target_arrival_time_raw.empty()) {
     target_arrival_time = parseHhmmss(target_arrival_time_raw);
     if (!target_arrival_time) {
-      record_errors.push_back("PUJOPASS.TargetArrivalTime has invalid format, should be HH:MM:SS");
+      recordError(KV1_ERROR_INVALID, "PUJOPASS.TargetArrivalTime has invalid format, should be HH:MM:SS");
     }
   }
   std::optional<std::chrono::hh_mm_ss<std::chrono::seconds>> target_departure_time;
   if (!target_departure_time_raw.empty()) {
     target_departure_time = parseHhmmss(target_departure_time_raw);
     if (!target_departure_time) {
-      record_errors.push_back("PUJOPASS.TargetDepartureTime has invalid format, should be HH:MM:SS");
+      recordError(KV1_ERROR_INVALID, "PUJOPASS.TargetDepartureTime has invalid format, should be HH:MM:SS");
     }
   }
   if (!record_errors.empty()) return;
@@ -1190,13 +1383,13 @@ void Kv1Parser::parsePublicJourneyPassingTimes() {
       schedule_code,
       schedule_type_code,
       line_planning_number,
-      static_cast<int>(*journey_number),
-      static_cast<short>(*stop_order)),
+      *journey_number,
+      *stop_order),
     journey_pattern_code,
     user_stop_code,
     target_arrival_time,
     target_departure_time,
-    wheelchair_accessible,
+    *wheelchair_accessible,
     *data_owner_is_operator,
     *planned_monitored,
     product_formula_type,
@@ -1204,8 +1397,8 @@ void Kv1Parser::parsePublicJourneyPassingTimes() {
 }
 
 void Kv1Parser::parseOperatingDay() {
-  auto data_owner_code          = eatString("OPERDAY.DataOwnerCode",           true,  10);
-  auto organizational_unit_code = eatString("OPERDAY.OrganizationalUnitCode",  true,  10);
+  auto data_owner_code          = eatSymbol("OPERDAY.DataOwnerCode",           true,  10);
+  auto organizational_unit_code = eatSymbol("OPERDAY.OrganizationalUnitCode",  true,  10);
   auto schedule_code            = eatString("OPERDAY.ScheduleCode",            true,  10);
   auto schedule_type_code       = eatString("OPERDAY.ScheduleTypeCode",        true,  10);
   auto valid_date_raw           = eatString("OPERDAY.ValidDate",               true,  10);
@@ -1214,7 +1407,7 @@ void Kv1Parser::parseOperatingDay() {
 
   auto valid_date = parseYyyymmdd(valid_date_raw);
   if (!valid_date)
-    record_errors.push_back("OPERDAY.ValidDate has invalid format, should be YYYY-MM-DD");
+    recordError(KV1_ERROR_INVALID, "OPERDAY.ValidDate has invalid format, should be YYYY-MM-DD");
   if (!record_errors.empty()) return;
  
   records.operating_days.emplace_back(
@@ -1227,7 +1420,7 @@ void Kv1Parser::parseOperatingDay() {
     description);
 }
 
-const std::unordered_map<std::string_view, Kv1Parser::ParseFunc> Kv1Parser::type_parsers{
+constexpr std::array<Kv1Parser::TypeParser, 29> Kv1Parser::type_parsers{{
   { "ORUN",      &Kv1Parser::parseOrganizationalUnit         },
   { "ORUNORUN",  &Kv1Parser::parseHigherOrganizationalUnit   },
   { "USRSTOP",   &Kv1Parser::parseUserStopPoint              },
@@ -1257,4 +1450,145 @@ const std::unordered_map<std::string_view, Kv1Parser::ParseFunc> Kv1Parser::type
   { "SCHEDVERS", &Kv1Parser::parseScheduleVersion            },
   { "PUJOPASS",  &Kv1Parser::parsePublicJourneyPassingTimes  },
   { "OPERDAY",   &Kv1Parser::parseOperatingDay               },
-};
+}};
+
+// FNV-1a, but with a custom offset basis (seed)
+static constexpr uint32_t hashRecordType(std::string_view record_type, uint32_t seed) {
+  uint32_t hash = seed;
+  for (char c : record_type) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 16777619;
+  }
+  return hash;
+}
+
+static constexpr size_t TYPE_PARSER_SLOT_BITS = 7;
+static constexpr uint8_t NO_TYPE_PARSER = UINT8_MAX;
+
+Kv1Parser::ParseFunc Kv1Parser::findTypeParser(std::string_view record_type) {
+  // Find a seed for which all record types hash to a different slot, making
+  // the hash perfect. This is done at compile time, so adding a record type
+  // that collides simply results in some other seed being picked.
+  static constexpr uint32_t seed = [] {
+    for (uint32_t candidate = 2166136261;; candidate++) {
+      bool used[1 << TYPE_PARSER_SLOT_BITS] = {};
+      bool ok = true;
+      for (const auto &tp : type_parsers) {
+        uint32_t slot = hashRecordType(tp.record_type, candidate) >> (32 - TYPE_PARSER_SLOT_BITS);
+        if (used[slot]) { ok = false; break; }
+        used[slot] = true;
+      }
+      if (ok) return candidate;
+    }
+  }();
+  static constexpr std::array<uint8_t, 1 << TYPE_PARSER_SLOT_BITS> slots = [] {
+    std::array<uint8_t, 1 << TYPE_PARSER_SLOT_BITS> slots;
+    slots.fill(NO_TYPE_PARSER);
+    for (size_t i = 0; i < type_parsers.size(); i++)
+      slots[hashRecordType(type_parsers[i].record_type, seed) >> (32 - TYPE_PARSER_SLOT_BITS)] = static_cast<uint8_t>(i);
+    return slots;
+  }();
+
+  uint8_t i = slots[hashRecordType(record_type, seed) >> (32 - TYPE_PARSER_SLOT_BITS)];
+  if (i == NO_TYPE_PARSER || type_parsers[i].record_type != record_type) return nullptr;
+  return type_parsers[i].parse;
+}
+
+// Chunks smaller than this are not worth a thread of their own.
+static const size_t MIN_PARALLEL_CHUNK_SIZE = 1 << 20;
+
+// Splits input into at most n chunks of roughly equal size. Every chunk but
+// the last ends right after a line feed.
+static std::vector<std::string_view> splitAtLines(std::string_view input, size_t n) {
+  n = std::clamp<size_t>(input.size() / MIN_PARALLEL_CHUNK_SIZE, 1, std::max<size_t>(n, 1));
+
+  std::vector<std::string_view> chunks;
+  size_t begin = 0;
+  for (size_t i = 1; i < n && begin < input.size(); i++) {
+    size_t target = std::max(begin, input.size() / n * i);
+    size_t lf = input.find('\n', target);
+    if (lf == std::string_view::npos) break;
+    chunks.push_back(input.substr(begin, lf + 1 - begin));
+    begin = lf + 1;
+  }
+  if (begin < input.size() || chunks.empty())
+    chunks.push_back(input.substr(begin));
+  return chunks;
+}
+
+Kv1ParallelParser::Kv1ParallelParser(std::string_view input, Kv1Records &parse_into, unsigned n_threads)
+  : records(parse_into),
+    input(input),
+    n_threads(n_threads)
+{}
+
+void Kv1ParallelParser::parseSequentially() {
+  Kv1Lexer lexer(input);
+  Kv1Parser parser(lexer, records);
+  parser.parse();
+  lexer_errors  = std::move(lexer.errors);
+  warns         = std::move(parser.warns);
+  global_errors = std::move(parser.global_errors);
+  record_errors = std::move(parser.record_errors);
+}
+
+void Kv1ParallelParser::parse() {
+  std::vector<std::string_view> chunks = splitAtLines(input, n_threads);
+  if (chunks.size() == 1) {
+    parseSequentially();
+    return;
+  }
+
+  struct ChunkResult {
+    Kv1Records records;
+    std::vector<std::string> lexer_errors;
+    Kv1ParseErrors warns;
+    Kv1ParseErrors global_errors;
+    std::vector<Kv1ParseError> record_errors;
+    // Number of lines in the chunk
+    size_t lines = 0;
+  };
+  std::vector<ChunkResult> results(chunks.size());
+  {
+    std::vector<std::jthread> threads;
+    for (size_t i = 0; i < chunks.size(); i++) {
+      threads.emplace_back([&chunk = chunks[i], &result = results[i], i]() {
+        Kv1Lexer lexer(chunk, i == 0);
+        Kv1Parser parser(lexer, result.records);
+        parser.parse();
+        result.lexer_errors  = std::move(lexer.errors);
+        result.warns         = std::move(parser.warns);
+        result.global_errors = std::move(parser.global_errors);
+        result.record_errors = std::move(parser.record_errors);
+        result.lines         = lexer.line() - 1;
+      });
+    }
+  }
+
+  // Quoted cells may contain line breaks. If a chunk ends in one, the lexer
+  // will not find the closing quote. Like any other lexer error, we take this
+  // as a sign to parse the file as a whole instead, which also gets us the
+  // exact same errors as without chunking.
+  for (const auto &result : results) {
+    if (!result.lexer_errors.empty()) {
+      results.clear();
+      parseSequentially();
+      return;
+    }
+  }
+
+  size_t line_offset = 0;
+  for (auto &result : results) {
+    records.append(std::move(result.records));
+    warns.append(result.warns, line_offset);
+    global_errors.append(result.global_errors, line_offset);
+    // Kv1Parser stops at a bad header, and so should we
+    if (!result.record_errors.empty()) {
+      record_errors = std::move(result.record_errors);
+      for (auto &error : record_errors)
+        error.line += line_offset;
+      break;
+    }
+    line_offset += result.lines;
+  }
+}
@@ -0,0 +1,309 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <format>
+#include <unordered_map>
+#include <vector>
+
+#include <tmi8/kv1_fields.hpp>
+#include <tmi8/kv1_snapshot.hpp>
+
+using namespace std::string_view_literals;
+
+#define X(type, table) \
+  [[maybe_unused]] static std::vector<type> &tableOf(Kv1Records &records, const type *) { return records.table; } \
+  [[maybe_unused]] static const std::vector<type> &tableOf(const Kv1Records &records, const type *) { return records.table; }
+KV1_TABLES
+#undef X
+
+static constexpr std::string_view MAGIC = "OEUFKV1S"sv;
+static constexpr size_t HEADER_SIZE = MAGIC.size() + 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+
+// FNV-1a, but on 64-bit words instead of bytes. Every step is a bijection of
+// the state, so changing any single word always changes the checksum.
+static uint64_t checksum(std::string_view data) {
+  constexpr uint64_t prime = 0x100000001b3;
+  uint64_t hash = 0xcbf29ce484222325;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= data.size(); i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data.data() + i, sizeof word);
+    hash = (hash ^ word) * prime;
+  }
+  for (; i < data.size(); i++)
+    hash = (hash ^ static_cast<uint8_t>(data[i])) * prime;
+  return hash;
+}
+
+namespace {
+  struct Writer {
+    explicit Writer(const Kv1Records &records) : records(records) {}
+
+    template<typename T>
+    void raw(T value) {
+      out.append(reinterpret_cast<const char *>(&value), sizeof value);
+    }
+
+    // Fields are written in the order of kv1Fields(), without their names
+    template<typename T>
+    void operator()(std::string_view, const T &value) { (*this)(value); }
+
+    void operator()(const std::string &value) {
+      auto [it, inserted] = string_ids.try_emplace(value, static_cast<uint32_t>(strings.size()));
+      if (inserted) strings.push_back(value);
+      raw(it->second);
+    }
+    void operator()(Kv1Symbol value) { (*this)(value.str()); }
+    void operator()(bool value) { raw<uint8_t>(value); }
+    void operator()(char value) { raw(value); }
+    void operator()(short value) { raw<int16_t>(value); }
+    void operator()(int value) { raw<int32_t>(value); }
+    void operator()(double value) { raw(value); }
+    void operator()(RgbColor value) { raw(value.r); raw(value.g); raw(value.b); }
+    void operator()(Kv1WheelchairAccessibility value) { raw<uint8_t>(value); }
+    void operator()(Kv1ShowFlexibleTrip value) { raw<uint8_t>(value); }
+    void operator()(Kv1DayType value) { raw(value.weekdays); }
+    void operator()(std::chrono::year_month_day value) {
+      raw(static_cast<int32_t>(std::chrono::sys_days(value).time_since_epoch().count()));
+    }
+    void operator()(std::chrono::sys_seconds value) {
+      raw<int64_t>(value.time_since_epoch().count());
+    }
+    void operator()(std::chrono::hh_mm_ss<std::chrono::seconds> value) {
+      raw<int64_t>(value.to_duration().count());
+    }
+
+    // Absent values still take up space, so that all records of a table have
+    // the same size.
+    template<typename T>
+    void operator()(const std::optional<T> &value) {
+      raw<uint8_t>(value.has_value());
+      (*this)(value.value_or(T{}));
+    }
+
+    template<typename T>
+    void operator()(T *const &value) {
+      const auto &table = tableOf(records, value);
+      raw<uint32_t>(value ? static_cast<uint32_t>(value - table.data() + 1) : 0);
+    }
+
+    const Kv1Records &records;
+    std::string out;
+    std::unordered_map<std::string_view, uint32_t> string_ids;
+    std::vector<std::string_view> strings;
+  };
+
+  struct Reader {
+    explicit Reader(Kv1Records &records, std::string_view data) : records(records), data(data) {}
+
+    template<typename T>
+    T raw() {
+      T value{};
+      if (data.size() - pos < sizeof value) {
+        ok = false;
+        return value;
+      }
+      memcpy(&value, data.data() + pos, sizeof value);
+      pos += sizeof value;
+      return value;
+    }
+
+    template<typename T>
+    void operator()(std::string_view, T &value) { (*this)(value); }
+
+    void operator()(std::string &value) {
+      uint32_t id = raw<uint32_t>();
+      if (id >= strings.size()) {
+        ok = false;
+        return;
+      }
+      value = strings[id];
+    }
+    void operator()(Kv1Symbol &value) {
+      uint32_t id = raw<uint32_t>();
+      if (id >= strings.size()) {
+        ok = false;
+        return;
+      }
+      // Every string is interned only once, not for every record using it
+      if (symbols[id].empty()) symbols[id] = Kv1Symbol(strings[id]);
+      value = symbols[id];
+    }
+    void operator()(bool &value) { value = raw<uint8_t>() != 0; }
+    void operator()(char &value) { value = raw<char>(); }
+    void operator()(short &value) { value = raw<int16_t>(); }
+    void operator()(int &value) { value = raw<int32_t>(); }
+    void operator()(double &value) { value = raw<double>(); }
+    void operator()(RgbColor &value) {
+      value.r = raw<uint8_t>();
+      value.g = raw<uint8_t>();
+      value.b = raw<uint8_t>();
+    }
+    void operator()(Kv1WheelchairAccessibility &value) { value = enumeration(_KV1_WHEELCHAIR_LAST); }
+    void operator()(Kv1ShowFlexibleTrip &value) { value = enumeration(_KV1_SHOW_FLEXIBLE_TRIP_LAST); }
+    void operator()(Kv1DayType &value) {
+      value.weekdays = raw<uint8_t>();
+      if (value.weekdays >= 1 << 7) ok = false;
+    }
+    void operator()(std::chrono::year_month_day &value) {
+      value = std::chrono::sys_days(std::chrono::days(raw<int32_t>()));
+    }
+    void operator()(std::chrono::sys_seconds &value) {
+      value = std::chrono::sys_seconds(std::chrono::seconds(raw<int64_t>()));
+    }
+    void operator()(std::chrono::hh_mm_ss<std::chrono::seconds> &value) {
+      value = std::chrono::hh_mm_ss(std::chrono::seconds(raw<int64_t>()));
+    }
+
+    template<typename T>
+    void operator()(std::optional<T> &value) {
+      bool present = raw<uint8_t>() != 0;
+      T inner{};
+      (*this)(inner);
+      if (present) value = inner;
+      else value.reset();
+    }
+
+    // All tables have been reserved before any record is read, so pointers to
+    // records that have not been read yet stay valid once they are.
+    template<typename T>
+    void operator()(T *&value) {
+      uint32_t i = raw<uint32_t>();
+      if (i > counts[kv1TableNumber<T>()]) {
+        ok = false;
+        i = 0;
+      }
+      value = i ? tableOf(records, value).data() + (i - 1) : nullptr;
+    }
+
+    template<typename E>
+    E enumeration(E last) {
+      uint8_t value = raw<uint8_t>();
+      if (value > last) ok = false;
+      return static_cast<E>(value);
+    }
+
+    Kv1Records &records;
+    std::string_view data;
+    size_t pos = 0;
+    bool ok = true;
+    std::vector<std::string_view> strings;
+    std::vector<Kv1Symbol> symbols;
+    std::array<uint64_t, KV1_N_TABLES> counts{};
+  };
+}
+
+std::string kv1WriteSnapshot(const Kv1Records &records, const char *path) {
+  Writer writer(records);
+#define X(type, table) for (const auto &record : records.table) kv1Fields(writer, record);
+  KV1_TABLES
+#undef X
+
+  std::string body;
+  auto append = [&body]<typename T>(T value) {
+    body.append(reinterpret_cast<const char *>(&value), sizeof value);
+  };
+  append(static_cast<uint64_t>(writer.strings.size()));
+  uint64_t offset = 0;
+  append(offset);
+  for (std::string_view string : writer.strings)
+    append(offset += string.size());
+  body.reserve(body.size() + offset + KV1_N_TABLES * sizeof(uint64_t) + writer.out.size());
+  for (std::string_view string : writer.strings)
+    body.append(string);
+#define X(type, table) append(static_cast<uint64_t>(records.table.size()));
+  KV1_TABLES
+#undef X
+  body.append(writer.out);
+
+  std::string header(MAGIC);
+  auto appendHeader = [&header]<typename T>(T value) {
+    header.append(reinterpret_cast<const char *>(&value), sizeof value);
+  };
+  appendHeader(KV1_SNAPSHOT_VERSION);
+  appendHeader(static_cast<uint32_t>(KV1_N_TABLES));
+  appendHeader(static_cast<uint64_t>(body.size()));
+  appendHeader(checksum(body));
+
+  FILE *file = fopen(path, "wb");
+  if (!file) return std::format("Open {}: {}", path, strerrordesc_np(errno));
+  bool ok = fwrite(header.data(), 1, header.size(), file) == header.size()
+         && fwrite(body.data(), 1, body.size(), file) == body.size();
+  std::string error = ok ? "" : std::format("Write {}: {}", path, strerrordesc_np(errno));
+  if (fclose(file) != 0 && ok) error = std::format("Close {}: {}", path, strerrordesc_np(errno));
+  return error;
+}
+
+std::string kv1ReadSnapshot(std::string_view data, Kv1Records &into) {
+  if (into.size() != 0)
+    return "Snapshot can only be read into empty records";
+  if (data.size() < HEADER_SIZE || !data.starts_with(MAGIC))
+    return "Not a KV1 snapshot";
+
+  Reader header(into, data.substr(MAGIC.size(), HEADER_SIZE - MAGIC.size()));
+  uint32_t version = header.raw<uint32_t>();
+  uint32_t n_tables = header.raw<uint32_t>();
+  uint64_t body_size = header.raw<uint64_t>();
+  uint64_t body_checksum = header.raw<uint64_t>();
+  if (version != KV1_SNAPSHOT_VERSION)
+    return std::format("Snapshot has version {}, expected version {}", version, KV1_SNAPSHOT_VERSION);
+  if (n_tables != KV1_N_TABLES)
+    return std::format("Snapshot has {} tables, expected {}", n_tables, KV1_N_TABLES);
+  std::string_view body = data.substr(HEADER_SIZE);
+  if (body.size() != body_size)
+    return std::format("Snapshot is {} bytes, but its header says {} bytes", data.size(), HEADER_SIZE + body_size);
+  if (checksum(body) != body_checksum)
+    return "Snapshot is corrupt (checksum mismatch)";
+
+  Reader reader(into, body);
+  uint64_t n_strings = reader.raw<uint64_t>();
+  if (n_strings > UINT32_MAX || (n_strings + 1) * sizeof(uint64_t) > body.size())
+    return "Snapshot has a bad string table";
+  std::string_view offsets = body.substr(reader.pos, (n_strings + 1) * sizeof(uint64_t));
+  reader.pos += offsets.size();
+  uint64_t n_string_bytes;
+  memcpy(&n_string_bytes, offsets.data() + n_strings * sizeof(uint64_t), sizeof n_string_bytes);
+  if (n_string_bytes > body.size() - reader.pos)
+    return "Snapshot has a bad string table";
+  std::string_view string_bytes = body.substr(reader.pos, n_string_bytes);
+  reader.pos += n_string_bytes;
+  reader.strings.reserve(n_strings);
+  for (size_t i = 0; i < n_strings; i++) {
+    uint64_t begin, end;
+    memcpy(&begin, offsets.data() + i * sizeof(uint64_t), sizeof begin);
+    memcpy(&end, offsets.data() + (i + 1) * sizeof(uint64_t), sizeof end);
+    if (begin > end || end > n_string_bytes)
+      return "Snapshot has a bad string table";
+    reader.strings.push_back(string_bytes.substr(begin, end - begin));
+  }
+  reader.symbols.resize(n_strings);
+
+  // Every record takes up at least one byte, which bounds what we reserve
+  for (auto &count : reader.counts) {
+    count = reader.raw<uint64_t>();
+    if (count > body.size()) reader.ok = false;
+  }
+  if (!reader.ok)
+    return "Snapshot has bad record counts";
+#define X(type, table) into.table.reserve(reader.counts[kv1TableNumber<type>()]);
+  KV1_TABLES
+#undef X
+#define X(type, table) \
+  for (uint64_t i = 0; i < reader.counts[kv1TableNumber<type>()] && reader.ok; i++) { \
+    into.table.push_back(kv1EmptyRecord<type>()); \
+    kv1Fields(reader, into.table.back()); \
+  }
+  KV1_TABLES
+#undef X
+
+  if (!reader.ok || reader.pos != body.size()) {
+    into = Kv1Records();
+    return "Snapshot is malformed";
+  }
+  return "";
+}
@@ -0,0 +1,109 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <tmi8/kv1_symbol.hpp>
+
+namespace {
+
+// The symbol table is split into shards, each with its own lock, so that the
+// threads of Kv1ParallelParser rarely wait for each other. The lower bits of
+// an ID are the number of the shard and the upper bits are the index of the
+// string in the shard.
+constexpr unsigned SHARD_BITS = 4;
+constexpr size_t   N_SHARDS   = size_t(1) << SHARD_BITS;
+// The strings of a shard are stored in chunks that are never moved, so that
+// str() can look strings up without taking the lock.
+constexpr unsigned CHUNK_BITS = 12;
+constexpr size_t   CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+constexpr size_t   MAX_CHUNKS = size_t(1) << (32 - SHARD_BITS - CHUNK_BITS);
+
+struct Shard {
+  std::mutex mutex;
+  std::unordered_map<std::string_view, uint32_t> ids;
+  // Index 0 of every shard is unused, so that ID 0 can be the empty string.
+  uint32_t next = 1;
+  std::array<std::atomic<std::string *>, MAX_CHUNKS> chunks{};
+};
+
+std::array<Shard, N_SHARDS> shards;
+const std::string empty_string;
+
+}
+
+static size_t shardNumberOf(std::string_view str) {
+  size_t hash = std::hash<std::string_view>{}(str);
+  // The low bits of the hash are used by the buckets of the map
+  return (hash >> 32) & (N_SHARDS - 1);
+}
+
+Kv1Symbol::Kv1Symbol(std::string_view str) {
+  if (str.empty()) return;
+
+  size_t shard_number = shardNumberOf(str);
+  Shard &shard = shards[shard_number];
+
+  std::lock_guard lock(shard.mutex);
+  if (auto it = shard.ids.find(str); it != shard.ids.end()) {
+    id_ = it->second;
+    return;
+  }
+
+  uint32_t index = shard.next;
+  if (index >> CHUNK_BITS >= MAX_CHUNKS) {
+    fputs("Kv1Symbol: too many distinct strings\n", stderr);
+    abort();
+  }
+  std::string *chunk = shard.chunks[index >> CHUNK_BITS].load(std::memory_order_relaxed);
+  if (!chunk) {
+    chunk = new std::string[CHUNK_SIZE];
+    shard.chunks[index >> CHUNK_BITS].store(chunk, std::memory_order_release);
+  }
+  std::string &stored = chunk[index & (CHUNK_SIZE - 1)];
+  stored = str;
+  shard.next++;
+
+  id_ = index << SHARD_BITS | static_cast<uint32_t>(shard_number);
+  shard.ids.emplace(stored, id_);
+}
+
+std::optional<Kv1Symbol> Kv1Symbol::find(std::string_view str) {
+  if (str.empty()) return Kv1Symbol();
+  Shard &shard = shards[shardNumberOf(str)];
+  std::lock_guard lock(shard.mutex);
+  auto it = shard.ids.find(str);
+  if (it == shard.ids.end()) return std::nullopt;
+  Kv1Symbol sym;
+  sym.id_ = it->second;
+  return sym;
+}
+
+const std::string &Kv1Symbol::str() const {
+  if (id_ == 0) return empty_string;
+  const Shard &shard = shards[id_ & (N_SHARDS - 1)];
+  uint32_t index = id_ >> SHARD_BITS;
+  // Whoever got this ID from the constructor must have synchronized with the
+  // thread that interned the string, so the string itself is visible.
+  return shard.chunks[index >> CHUNK_BITS].load(std::memory_order_acquire)[index & (CHUNK_SIZE - 1)];
+}
+
+size_t kv1SymbolCount() {
+  size_t count = 0;
+  for (Shard &shard : shards) {
+    std::lock_guard lock(shard.mutex);
+    count += shard.ids.size();
+  }
+  return count;
+}
+
+std::ostream &operator<<(std::ostream &os, Kv1Symbol sym) {
+  return os << sym.str();
+}
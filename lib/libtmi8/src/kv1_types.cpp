@@ -2,6 +2,9 @@
 //
 // Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
 
+#include <iterator>
+#include <utility>
+
 #include <boost/container_hash/hash.hpp>
 
 #include <tmi8/kv1_types.hpp>
@@ -38,17 +41,84 @@ size_t Kv1Records::size() const {
        + operating_days.size();
 }
 
+template<typename T>
+static void appendTable(std::vector<T> &to, std::vector<T> &from) {
+  if (to.empty()) {
+    std::swap(to, from);
+    return;
+  }
+  to.insert(to.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end()));
+  from.clear();
+}
+
+void Kv1Records::append(Kv1Records &&other) {
+  appendTable(organizational_units, other.organizational_units);
+  appendTable(higher_organizational_units, other.higher_organizational_units);
+  appendTable(user_stop_points, other.user_stop_points);
+  appendTable(user_stop_areas, other.user_stop_areas);
+  appendTable(timing_links, other.timing_links);
+  appendTable(links, other.links);
+  appendTable(lines, other.lines);
+  appendTable(destinations, other.destinations);
+  appendTable(journey_patterns, other.journey_patterns);
+  appendTable(concession_financer_relations, other.concession_financer_relations);
+  appendTable(concession_areas, other.concession_areas);
+  appendTable(financers, other.financers);
+  appendTable(journey_pattern_timing_links, other.journey_pattern_timing_links);
+  appendTable(points, other.points);
+  appendTable(point_on_links, other.point_on_links);
+  appendTable(icons, other.icons);
+  appendTable(notices, other.notices);
+  appendTable(notice_assignments, other.notice_assignments);
+  appendTable(time_demand_groups, other.time_demand_groups);
+  appendTable(time_demand_group_run_times, other.time_demand_group_run_times);
+  appendTable(period_groups, other.period_groups);
+  appendTable(specific_days, other.specific_days);
+  appendTable(timetable_versions, other.timetable_versions);
+  appendTable(public_journeys, other.public_journeys);
+  appendTable(period_group_validities, other.period_group_validities);
+  appendTable(exceptional_operating_days, other.exceptional_operating_days);
+  appendTable(schedule_versions, other.schedule_versions);
+  appendTable(public_journey_passing_times, other.public_journey_passing_times);
+  appendTable(operating_days, other.operating_days);
+}
+
+std::string_view kv1Name(Kv1WheelchairAccessibility wheelchair_accessible) {
+  switch (wheelchair_accessible) {
+  case KV1_WHEELCHAIR_ACCESSIBLE:     return "ACCESSIBLE";
+  case KV1_WHEELCHAIR_NOT_ACCESSIBLE: return "NOTACCESSIBLE";
+  case KV1_WHEELCHAIR_UNKNOWN:        return "UNKNOWN";
+  }
+  return {};
+}
+
+std::string_view kv1Name(Kv1ShowFlexibleTrip show_flexible_trip) {
+  switch (show_flexible_trip) {
+  case KV1_SHOW_FLEXIBLE_TRIP_TRUE:     return "TRUE";
+  case KV1_SHOW_FLEXIBLE_TRIP_FALSE:    return "FALSE";
+  case KV1_SHOW_FLEXIBLE_TRIP_REALTIME: return "REALTIME";
+  }
+  return {};
+}
+
+std::string Kv1DayType::str() const {
+  std::string s = "0000000";
+  for (int i = 0; i < 7; i++)
+    if (weekdays & (1 << i)) s[i] = static_cast<char>('1' + i);
+  return s;
+}
+
 Kv1OrganizationalUnit::Key::Key(
-    std::string data_owner_code,
-    std::string organizational_unit_code)
+    Kv1Symbol data_owner_code,
+    Kv1Symbol organizational_unit_code)
   : data_owner_code(std::move(data_owner_code)),
     organizational_unit_code(std::move(organizational_unit_code))
 {}
 
 Kv1HigherOrganizationalUnit::Key::Key(
-    std::string data_owner_code,
-    std::string organizational_unit_code_parent,
-    std::string organizational_unit_code_child,
+    Kv1Symbol data_owner_code,
+    Kv1Symbol organizational_unit_code_parent,
+    Kv1Symbol organizational_unit_code_child,
     std::chrono::year_month_day valid_from)
   : data_owner_code(std::move(data_owner_code)),
     organizational_unit_code_parent(std::move(organizational_unit_code_parent)),
@@ -57,79 +127,79 @@ Kv1HigherOrganizationalUnit::Key::Key(
 {}
 
 Kv1UserStopPoint::Key::Key(
-    std::string data_owner_code,
-    std::string user_stop_code)
+    Kv1Symbol data_owner_code,
+    Kv1Symbol user_stop_code)
   : data_owner_code(std::move(data_owner_code)),
     user_stop_code(std::move(user_stop_code))
 {}
 
 Kv1UserStopArea::Key::Key(
-    std::string data_owner_code,
+    Kv1Symbol data_owner_code,
     std::string user_stop_area_code)
   : data_owner_code(std::move(data_owner_code)),
     user_stop_area_code(std::move(user_stop_area_code))
 {}
 
 Kv1TimingLink::Key::Key(
-    std::string data_owner_code,
-    std::string user_stop_code_begin,
-    std::string user_stop_code_end)
+    Kv1Symbol data_owner_code,
+    Kv1Symbol user_stop_code_begin,
+    Kv1Symbol user_stop_code_end)
   : data_owner_code(std::move(data_owner_code)),
     user_stop_code_begin(std::move(user_stop_code_begin)),
     user_stop_code_end(std::move(user_stop_code_end))
 {}
 
-Kv1Link::Key::Key(std::string data_owner_code,
-                  std::string user_stop_code_begin,
-                  std::string user_stop_code_end,
-                  std::string transport_type)
+Kv1Link::Key::Key(Kv1Symbol data_owner_code,
+                  Kv1Symbol user_stop_code_begin,
+                  Kv1Symbol user_stop_code_end,
+                  Kv1Symbol transport_type)
   : data_owner_code(std::move(data_owner_code)),
     user_stop_code_begin(std::move(user_stop_code_begin)),
     user_stop_code_end(std::move(user_stop_code_end)),
     transport_type(std::move(transport_type))
 {}
 
-Kv1Line::Key::Key(std::string data_owner_code,
-                  std::string line_planning_number)
+Kv1Line::Key::Key(Kv1Symbol data_owner_code,
+                  Kv1Symbol line_planning_number)
   : data_owner_code(std::move(data_owner_code)),
     line_planning_number(std::move(line_planning_number))
 {}
 
-Kv1Destination::Key::Key(std::string data_owner_code,
+Kv1Destination::Key::Key(Kv1Symbol data_owner_code,
                          std::string dest_code)
   : data_owner_code(std::move(data_owner_code)),
     dest_code(std::move(dest_code))
 {}
 
-Kv1JourneyPattern::Key::Key(std::string data_owner_code,
-                            std::string line_planning_number,
-                            std::string journey_pattern_code)
+Kv1JourneyPattern::Key::Key(Kv1Symbol data_owner_code,
+                            Kv1Symbol line_planning_number,
+                            Kv1Symbol journey_pattern_code)
   : data_owner_code(std::move(data_owner_code)),
     line_planning_number(std::move(line_planning_number)),
     journey_pattern_code(std::move(journey_pattern_code))
 {}
 
-Kv1ConcessionFinancerRelation::Key::Key(std::string data_owner_code,
+Kv1ConcessionFinancerRelation::Key::Key(Kv1Symbol data_owner_code,
                                         std::string con_fin_rel_code)
   : data_owner_code(std::move(data_owner_code)),
     con_fin_rel_code(std::move(con_fin_rel_code))
 {}
 
-Kv1ConcessionArea::Key::Key(std::string data_owner_code,
+Kv1ConcessionArea::Key::Key(Kv1Symbol data_owner_code,
                             std::string concession_area_code)
   : data_owner_code(std::move(data_owner_code)),
     concession_area_code(std::move(concession_area_code))
 {}
 
-Kv1Financer::Key::Key(std::string data_owner_code,
+Kv1Financer::Key::Key(Kv1Symbol data_owner_code,
                       std::string financer_code)
   : data_owner_code(std::move(data_owner_code)),
     financer_code(std::move(financer_code))
 {}
 
-Kv1JourneyPatternTimingLink::Key::Key(std::string data_owner_code,
-                                      std::string line_planning_number,
-                                      std::string journey_pattern_code,
+Kv1JourneyPatternTimingLink::Key::Key(Kv1Symbol data_owner_code,
+                                      Kv1Symbol line_planning_number,
+                                      Kv1Symbol journey_pattern_code,
                                       short timing_link_order)
   : data_owner_code(std::move(data_owner_code)),
     line_planning_number(std::move(line_planning_number)),
@@ -137,18 +207,18 @@ Kv1JourneyPatternTimingLink::Key::Key(std::string data_owner_code,
     timing_link_order(timing_link_order)
 {}
 
-Kv1Point::Key::Key(std::string data_owner_code,
-                   std::string point_code)
+Kv1Point::Key::Key(Kv1Symbol data_owner_code,
+                   Kv1Symbol point_code)
   : data_owner_code(std::move(data_owner_code)),
     point_code(std::move(point_code))
 {}
 
-Kv1PointOnLink::Key::Key(std::string data_owner_code,
-                         std::string user_stop_code_begin,
-                         std::string user_stop_code_end,
-                         std::string point_data_owner_code,
-                         std::string point_code,
-                         std::string transport_type)
+Kv1PointOnLink::Key::Key(Kv1Symbol data_owner_code,
+                         Kv1Symbol user_stop_code_begin,
+                         Kv1Symbol user_stop_code_end,
+                         Kv1Symbol point_data_owner_code,
+                         Kv1Symbol point_code,
+                         Kv1Symbol transport_type)
   : data_owner_code(std::move(data_owner_code)),
     user_stop_code_begin(std::move(user_stop_code_begin)),
     user_stop_code_end(std::move(user_stop_code_end)),
@@ -157,32 +227,32 @@ Kv1PointOnLink::Key::Key(std::string data_owner_code,
     transport_type(std::move(transport_type))
 {}
 
-Kv1Icon::Key::Key(std::string data_owner_code,
+Kv1Icon::Key::Key(Kv1Symbol data_owner_code,
                   short icon_number)
   : data_owner_code(std::move(data_owner_code)),
     icon_number(icon_number)
 {}
 
-Kv1Notice::Key::Key(std::string data_owner_code,
+Kv1Notice::Key::Key(Kv1Symbol data_owner_code,
                     std::string notice_code)
   : data_owner_code(std::move(data_owner_code)),
     notice_code(std::move(notice_code))
 {}
 
-Kv1TimeDemandGroup::Key::Key(std::string data_owner_code,
-                             std::string line_planning_number,
-                             std::string journey_pattern_code,
-                             std::string time_demand_group_code)
+Kv1TimeDemandGroup::Key::Key(Kv1Symbol data_owner_code,
+                             Kv1Symbol line_planning_number,
+                             Kv1Symbol journey_pattern_code,
+                             Kv1Symbol time_demand_group_code)
   : data_owner_code(std::move(data_owner_code)),
     line_planning_number(std::move(line_planning_number)),
     journey_pattern_code(std::move(journey_pattern_code)),
     time_demand_group_code(std::move(time_demand_group_code))
 {}
 
-Kv1TimeDemandGroupRunTime::Key::Key(std::string data_owner_code,
-                                    std::string line_planning_number,
-                                    std::string journey_pattern_code,
-                                    std::string time_demand_group_code,
+Kv1TimeDemandGroupRunTime::Key::Key(Kv1Symbol data_owner_code,
+                                    Kv1Symbol line_planning_number,
+                                    Kv1Symbol journey_pattern_code,
+                                    Kv1Symbol time_demand_group_code,
                                     short timing_link_order)
   : data_owner_code(std::move(data_owner_code)),
     line_planning_number(std::move(line_planning_number)),
@@ -191,20 +261,20 @@ Kv1TimeDemandGroupRunTime::Key::Key(std::string data_owner_code,
     timing_link_order(std::move(timing_link_order))
 {}
 
-Kv1PeriodGroup::Key::Key(std::string data_owner_code,
+Kv1PeriodGroup::Key::Key(Kv1Symbol data_owner_code,
                          std::string period_group_code)
   : data_owner_code(std::move(data_owner_code)),
     period_group_code(std::move(period_group_code))
 {}
 
-Kv1SpecificDay::Key::Key(std::string data_owner_code,
+Kv1SpecificDay::Key::Key(Kv1Symbol data_owner_code,
                          std::string specific_day_code)
   : data_owner_code(std::move(data_owner_code)),
     specific_day_code(std::move(specific_day_code))
 {}
 
-Kv1TimetableVersion::Key::Key(std::string data_owner_code,
-                              std::string organizational_unit_code,
+Kv1TimetableVersion::Key::Key(Kv1Symbol data_owner_code,
+                              Kv1Symbol organizational_unit_code,
                               std::string timetable_version_code,
                               std::string period_group_code,
                               std::string specific_day_code)
@@ -215,26 +285,26 @@ Kv1TimetableVersion::Key::Key(std::string data_owner_code,
     specific_day_code(std::move(specific_day_code))
 {}
 
-Kv1PublicJourney::Key::Key(std::string data_owner_code,
+Kv1PublicJourney::Key::Key(Kv1Symbol data_owner_code,
                            std::string timetable_version_code,
-                           std::string organizational_unit_code,
+                           Kv1Symbol organizational_unit_code,
                            std::string period_group_code,
                            std::string specific_day_code,
-                           std::string day_type,
-                           std::string line_planning_number,
+                           Kv1DayType day_type,
+                           Kv1Symbol line_planning_number,
                            int journey_number)
   : data_owner_code(std::move(data_owner_code)),
     timetable_version_code(std::move(timetable_version_code)),
     organizational_unit_code(std::move(organizational_unit_code)),
     period_group_code(std::move(period_group_code)),
     specific_day_code(std::move(specific_day_code)),
-    day_type(std::move(day_type)),
+    day_type(day_type),
     line_planning_number(std::move(line_planning_number)),
     journey_number(journey_number)
 {}
 
-Kv1PeriodGroupValidity::Key::Key(std::string data_owner_code,
-                                 std::string organizational_unit_code,
+Kv1PeriodGroupValidity::Key::Key(Kv1Symbol data_owner_code,
+                                 Kv1Symbol organizational_unit_code,
                                  std::string period_group_code,
                                  std::chrono::year_month_day valid_from)
   : data_owner_code(std::move(data_owner_code)),
@@ -243,16 +313,16 @@ Kv1PeriodGroupValidity::Key::Key(std::string data_owner_code,
     valid_from(valid_from)
 {}
 
-Kv1ExceptionalOperatingDay::Key::Key(std::string data_owner_code,
-                                     std::string organizational_unit_code,
+Kv1ExceptionalOperatingDay::Key::Key(Kv1Symbol data_owner_code,
+                                     Kv1Symbol organizational_unit_code,
                                      std::chrono::sys_seconds valid_date)
   : data_owner_code(std::move(data_owner_code)),
     organizational_unit_code(std::move(organizational_unit_code)),
     valid_date(valid_date)
 {}
 
-Kv1ScheduleVersion::Key::Key(std::string data_owner_code,
-                             std::string organizational_unit_code,
+Kv1ScheduleVersion::Key::Key(Kv1Symbol data_owner_code,
+                             Kv1Symbol organizational_unit_code,
                              std::string schedule_code,
                              std::string schedule_type_code)
   : data_owner_code(std::move(data_owner_code)),
@@ -261,11 +331,11 @@ Kv1ScheduleVersion::Key::Key(std::string data_owner_code,
     schedule_type_code(std::move(schedule_type_code))
 {}
 
-Kv1PublicJourneyPassingTimes::Key::Key(std::string data_owner_code,
-                                       std::string organizational_unit_code,
+Kv1PublicJourneyPassingTimes::Key::Key(Kv1Symbol data_owner_code,
+                                       Kv1Symbol organizational_unit_code,
                                        std::string schedule_code,
                                        std::string schedule_type_code,
-                                       std::string line_planning_number,
+                                       Kv1Symbol line_planning_number,
                                        int journey_number,
                                        short stop_order)
   : data_owner_code(std::move(data_owner_code)),
@@ -277,8 +347,8 @@ Kv1PublicJourneyPassingTimes::Key::Key(std::string data_owner_code,
     stop_order(stop_order)
 {}
 
-Kv1OperatingDay::Key::Key(std::string data_owner_code,
-                          std::string organizational_unit_code,
+Kv1OperatingDay::Key::Key(Kv1Symbol data_owner_code,
+                          Kv1Symbol organizational_unit_code,
                           std::string schedule_code,
                           std::string schedule_type_code,
                           std::chrono::year_month_day valid_date)
@@ -0,0 +1,170 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include <arrow/util/bitmap_ops.h>
+
+#include <tmi8/kv6_local_time.hpp>
+
+namespace cp = arrow::compute;
+
+AmsterdamOffsetTable::AmsterdamOffsetTable(int64_t begin, int64_t end) {
+  const std::chrono::time_zone *amsterdam = std::chrono::locate_zone("Europe/Amsterdam");
+
+  std::chrono::sys_info info = amsterdam->get_info(std::chrono::sys_seconds(std::chrono::seconds(begin)));
+  offsets.push_back(info.offset.count());
+  while (info.end.time_since_epoch().count() <= end) {
+    int64_t at = info.end.time_since_epoch().count();
+    info = amsterdam->get_info(info.end);
+    // Some transitions only change the abbreviation or whether it is
+    // 'summer time', which we do not care about.
+    if (info.offset.count() == offsets.back()) continue;
+    transitions.push_back(at);
+    offsets.push_back(info.offset.count());
+  }
+}
+
+int64_t AmsterdamOffsetTable::offsetAt(int64_t t) const {
+  // There are only two transitions per year, so for most data sets this is a
+  // short loop without branches (as opposed to a binary search).
+  if (transitions.size() <= 16) {
+    size_t n = 0;
+    for (size_t i = 0; i < transitions.size(); i++)
+      n += t >= transitions[i];
+    return offsets[n];
+  }
+  auto it = std::upper_bound(transitions.begin(), transitions.end(), t);
+  return offsets[it - transitions.begin()];
+}
+
+static int64_t unitsPerSecond(arrow::TimeUnit::type unit) {
+  switch (unit) {
+  case arrow::TimeUnit::SECOND: return 1;
+  case arrow::TimeUnit::MILLI:  return 1'000;
+  case arrow::TimeUnit::MICRO:  return 1'000'000;
+  case arrow::TimeUnit::NANO:   return 1'000'000'000;
+  }
+  return 1;
+}
+
+// Division rounding towards negative infinity, for times before the epoch
+static inline int64_t floorDiv(int64_t a, int64_t b) {
+  return a / b - (a % b < 0);
+}
+
+static std::shared_ptr<arrow::DataType> localTimesType() {
+  return arrow::struct_({
+    arrow::field("iso_day_of_week", arrow::int64()),
+    arrow::field("date", arrow::date32()),
+    arrow::field("local_time", arrow::time32(arrow::TimeUnit::SECOND)),
+  });
+}
+
+template<typename T>
+static arrow::Result<std::shared_ptr<arrow::Buffer>> allocateValues(int64_t n) {
+  ARROW_ASSIGN_OR_RAISE(std::unique_ptr<arrow::Buffer> buffer,
+                        arrow::AllocateBuffer(n * static_cast<int64_t>(sizeof(T))));
+  return std::shared_ptr<arrow::Buffer>(std::move(buffer));
+}
+
+arrow::Result<std::shared_ptr<arrow::StructArray>> kv6LocalTimes(const arrow::TimestampArray &timestamps) {
+  auto type = std::static_pointer_cast<arrow::TimestampType>(timestamps.type());
+  if (!type->timezone().empty() && type->timezone() != "UTC")
+    return arrow::Status::Invalid("Expected naive or UTC timestamps, got time zone ", type->timezone());
+  const int64_t units_per_second = unitsPerSecond(type->unit());
+
+  const int64_t n = timestamps.length();
+  const int64_t *values = timestamps.raw_values();
+
+  ARROW_ASSIGN_OR_RAISE(auto seconds_values, allocateValues<int64_t>(n));
+  ARROW_ASSIGN_OR_RAISE(auto day_of_week_values, allocateValues<int64_t>(n));
+  ARROW_ASSIGN_OR_RAISE(auto date_values, allocateValues<int32_t>(n));
+  ARROW_ASSIGN_OR_RAISE(auto local_time_values, allocateValues<int32_t>(n));
+  int64_t *seconds = reinterpret_cast<int64_t *>(seconds_values->mutable_data());
+  int64_t *day_of_week_out = reinterpret_cast<int64_t *>(day_of_week_values->mutable_data());
+  int32_t *date_out = reinterpret_cast<int32_t *>(date_values->mutable_data());
+  int32_t *local_time_out = reinterpret_cast<int32_t *>(local_time_values->mutable_data());
+
+  for (int64_t i = 0; i < n; i++)
+    seconds[i] = floorDiv(values[i], units_per_second);
+
+  // Only look up the offsets for the range of time that we actually have
+  // data for. Values in null slots are undefined, so we skip those here.
+  int64_t min = std::numeric_limits<int64_t>::max();
+  int64_t max = std::numeric_limits<int64_t>::min();
+  if (timestamps.null_count() == 0) {
+    for (int64_t i = 0; i < n; i++) {
+      min = std::min(min, seconds[i]);
+      max = std::max(max, seconds[i]);
+    }
+  } else {
+    for (int64_t i = 0; i < n; i++) {
+      if (timestamps.IsNull(i)) seconds[i] = 0;
+      else {
+        min = std::min(min, seconds[i]);
+        max = std::max(max, seconds[i]);
+      }
+    }
+  }
+  if (min > max) min = max = 0;
+  AmsterdamOffsetTable offsets(min, max);
+
+  for (int64_t i = 0; i < n; i++)
+    seconds[i] += offsets.offsetAt(seconds[i]);
+  for (int64_t i = 0; i < n; i++) {
+    int64_t unix_days = floorDiv(seconds[i], 86400);
+    // 1970-01-01 was a Thursday, which has ISO day of week 4.
+    day_of_week_out[i] = (unix_days % 7 + 10) % 7 + 1;
+    date_out[i] = static_cast<int32_t>(unix_days);
+    local_time_out[i] = static_cast<int32_t>(seconds[i] - unix_days * 86400);
+  }
+
+  std::shared_ptr<arrow::Buffer> validity;
+  if (timestamps.null_count() != 0) {
+    if (timestamps.offset() == 0) {
+      validity = timestamps.null_bitmap();
+    } else {
+      ARROW_ASSIGN_OR_RAISE(validity, arrow::internal::CopyBitmap(
+        arrow::default_memory_pool(), timestamps.null_bitmap_data(), timestamps.offset(), n));
+    }
+  }
+  const int64_t null_count = timestamps.null_count();
+
+  auto struct_type = localTimesType();
+  return arrow::StructArray::Make(
+    {
+      std::make_shared<arrow::Int64Array>(n, day_of_week_values, validity, null_count),
+      std::make_shared<arrow::Date32Array>(n, date_values, validity, null_count),
+      std::make_shared<arrow::Time32Array>(struct_type->field(2)->type(), n, local_time_values, validity, null_count),
+    },
+    struct_type->fields());
+}
+
+static arrow::Status execKv6LocalTime(cp::KernelContext *, const cp::ExecSpan &batch, cp::ExecResult *out) {
+  if (!batch[0].is_array())
+    return arrow::Status::NotImplemented(KV6_LOCAL_TIME_FUNCTION, " only takes arrays");
+  auto timestamps = std::static_pointer_cast<arrow::TimestampArray>(batch[0].array.ToArray());
+  ARROW_ASSIGN_OR_RAISE(std::shared_ptr<arrow::StructArray> local_times, kv6LocalTimes(*timestamps));
+  out->value = local_times->data();
+  return arrow::Status::OK();
+}
+
+arrow::Status registerKv6LocalTimeFunction(cp::FunctionRegistry *registry) {
+  static const cp::FunctionDoc doc{
+    "Derive Europe/Amsterdam local time columns from KV6 timestamps",
+    "Returns a struct with the ISO day of week, date and time of day in local time.",
+    { "timestamps" },
+  };
+
+  auto func = std::make_shared<cp::ScalarFunction>(KV6_LOCAL_TIME_FUNCTION, cp::Arity::Unary(), doc);
+  cp::ScalarKernel kernel({ cp::InputType(arrow::Type::TIMESTAMP) }, cp::OutputType(localTimesType()), execKv6LocalTime);
+  kernel.null_handling = cp::NullHandling::COMPUTED_NO_PREALLOCATE;
+  kernel.mem_allocation = cp::MemAllocation::NO_PREALLOCATE;
+  kernel.can_write_into_slices = false;
+  ARROW_RETURN_NOT_OK(func->AddKernel(std::move(kernel)));
+  return registry->AddFunction(std::move(func));
+}
@@ -0,0 +1,188 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+// Checks that applying kv1Diff(index, new_records) to the index gives the same
+// records as indexing and linking new_records from scratch, and that only what
+// the diff touches is updated.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <tmi8/kv1_diff.hpp>
+#include <tmi8/kv1_fields.hpp>
+#include <tmi8/kv1_index.hpp>
+#include <tmi8/kv1_parser.hpp>
+#include <tmi8/kv1_types.hpp>
+
+static constexpr std::string_view OLD_KV1 =
+  "ORUN|1|I|CXX|ORU1|Organisatie|TYPE|\n"
+  "CONAREA|1|I|CXX|CA1|Concessie\n"
+  "CONFINREL|1|I|CXX|CFR1|CA1|\n"
+  "PEGR|1|I|CXX|PG1|Winter\n"
+  "SPECDAY|1|I|CXX|NORM|Normaal|\n"
+  "PEGRVAL|1|I|CXX|ORU1|PG1|2024-01-01|2024-12-31\n"
+  "TIVE|1|I|CXX|ORU1|TV1|PG1|NORM|2024-01-01|PUBT||\n"
+  "ICON|1|I|CXX|12|https://example.org/icon.png\n"
+  "DEST|1|I|CXX|D1|Groningen Centraal|Groningen|Centraal|true|Groningen|Centraal|Groningen|Centraal|Groningen|Centraal|12|FF00AA|000000\n"
+  "POINT|1|I|CXX|10031||SP|RD|200093|580155||\n"
+  "USRSTOP|1|I|CXX|10031|10031|true|true||Dorpsstraat|Sneek||-|||0|||BUSSTOP|NL:Q:10031\n"
+  "POINT|1|I|CXX|10205||SP|RD|200615|581025||\n"
+  "USRSTOP|1|I|CXX|10205|10205|true|true||Dorpsstraat|Haren||-|||0|||BUSSTOP|NL:Q:10205\n"
+  "POINT|1|I|CXX|10245||SP|RD|200735|581225||\n"
+  "USRSTOP|1|I|CXX|10245|10245|true|true||Stationsweg|'s-Hertogenbosch||-|||0|||BUSSTOP|NL:Q:10245\n"
+  "POINT|1|I|CXX|P1||AG|RD|200000.5|580000||\n"
+  "POINT|1|I|CXX|P2||AG|RD|200001.5|580001||\n"
+  "POINT|1|I|CXX|P4||AG|RD|200000.5|580000||\n"
+  "POINT|1|I|CXX|P6||AG|RD|200002.5|580002||\n"
+  "LINK|1|I|CXX|10031|10245||703||BUS\n"
+  "TILI|1|I|CXX|10031|10245|60|\n"
+  "LINK|1|I|CXX|10245|10205||1029||BUS\n"
+  "TILI|1|I|CXX|10245|10205|60|\n"
+  "POOL|1|I|CXX|10031|10245||CXX|P1|0|||x|BUS\n"
+  "POOL|1|I|CXX|10031|10245||CXX|P2|30|||x|BUS\n"
+  "POOL|1|I|CXX|10245|10205||CXX|P4|0|||x|BUS\n"
+  "POOL|1|I|CXX|10245|10205||CXX|P6|60|||x|BUS\n"
+  "LINE|1|I|CXX|1000|0|Lijn 0|0||BUS|12|FFFFFF|000000\n"
+  "JOPA|1|I|CXX|1000|1|BUS|1|\n"
+  "JOPATILI|1|I|CXX|1000|1|1|10031|10245|CFR1|D1||true|0|1|true|true||12|FF00FF|\n"
+  "JOPATILI|1|I|CXX|1000|1|2|10245|10205|CFR1|D1||false|0||true|true|TRUE||FF00FF|\n"
+  "TIMDEMGRP|1|I|CXX|1000|1|TD0\n"
+  "TIMDEMRNT|1|I|CXX|1000|1|TD0|1|10031|10245|0|60|0|0|0|\n"
+  "TIMDEMRNT|1|I|CXX|1000|1|TD0|2|10245|10205|60|60|0|0|0|\n"
+  "PUJO|1|I|CXX|TV1|ORU1|PG1|NORM|0000060|1000|0|TD0|1|06:00:00|ACCESSIBLE|true|false|3|REALTIME\n"
+  "PUJO|1|I|CXX|TV1|ORU1|PG1|NORM|0000060|1000|1|TD0|1|07:05:00|ACCESSIBLE|true|false||\n";
+
+// Compared to OLD_KV1: the name of user stop 10245 has changed, point P6 (and
+// its point on link) has been replaced by P5, journey 1 leaves later, and
+// there is a new notice for journey 1.
+static constexpr std::string_view NEW_KV1 =
+  "ORUN|1|I|CXX|ORU1|Organisatie|TYPE|\n"
+  "CONAREA|1|I|CXX|CA1|Concessie\n"
+  "CONFINREL|1|I|CXX|CFR1|CA1|\n"
+  "PEGR|1|I|CXX|PG1|Winter\n"
+  "SPECDAY|1|I|CXX|NORM|Normaal|\n"
+  "PEGRVAL|1|I|CXX|ORU1|PG1|2024-01-01|2024-12-31\n"
+  "TIVE|1|I|CXX|ORU1|TV1|PG1|NORM|2024-01-01|PUBT||\n"
+  "ICON|1|I|CXX|12|https://example.org/icon.png\n"
+  "DEST|1|I|CXX|D1|Groningen Centraal|Groningen|Centraal|true|Groningen|Centraal|Groningen|Centraal|Groningen|Centraal|12|FF00AA|000000\n"
+  "POINT|1|I|CXX|10031||SP|RD|200093|580155||\n"
+  "USRSTOP|1|I|CXX|10031|10031|true|true||Dorpsstraat|Sneek||-|||0|||BUSSTOP|NL:Q:10031\n"
+  "POINT|1|I|CXX|10205||SP|RD|200615|581025||\n"
+  "USRSTOP|1|I|CXX|10205|10205|true|true||Dorpsstraat|Haren||-|||0|||BUSSTOP|NL:Q:10205\n"
+  "POINT|1|I|CXX|10245||SP|RD|200735|581225||\n"
+  "USRSTOP|1|I|CXX|10245|10245|true|true||Stationsplein|'s-Hertogenbosch||-|||0|||BUSSTOP|NL:Q:10245\n"
+  "POINT|1|I|CXX|P1||AG|RD|200000.5|580000||\n"
+  "POINT|1|I|CXX|P2||AG|RD|200001.5|580001||\n"
+  "POINT|1|I|CXX|P4||AG|RD|200000.5|580000||\n"
+  "POINT|1|I|CXX|P5||AG|RD|200001.5|580001||\n"
+  "LINK|1|I|CXX|10031|10245||703||BUS\n"
+  "TILI|1|I|CXX|10031|10245|60|\n"
+  "LINK|1|I|CXX|10245|10205||1029||BUS\n"
+  "TILI|1|I|CXX|10245|10205|60|\n"
+  "POOL|1|I|CXX|10031|10245||CXX|P1|0|||x|BUS\n"
+  "POOL|1|I|CXX|10031|10245||CXX|P2|30|||x|BUS\n"
+  "POOL|1|I|CXX|10245|10205||CXX|P4|0|||x|BUS\n"
+  "POOL|1|I|CXX|10245|10205||CXX|P5|30|||x|BUS\n"
+  "LINE|1|I|CXX|1000|0|Lijn 0|0||BUS|12|FFFFFF|000000\n"
+  "JOPA|1|I|CXX|1000|1|BUS|1|\n"
+  "JOPATILI|1|I|CXX|1000|1|1|10031|10245|CFR1|D1||true|0|1|true|true||12|FF00FF|\n"
+  "JOPATILI|1|I|CXX|1000|1|2|10245|10205|CFR1|D1||false|0||true|true|TRUE||FF00FF|\n"
+  "TIMDEMGRP|1|I|CXX|1000|1|TD0\n"
+  "TIMDEMRNT|1|I|CXX|1000|1|TD0|1|10031|10245|0|60|0|0|0|\n"
+  "TIMDEMRNT|1|I|CXX|1000|1|TD0|2|10245|10205|60|60|0|0|0|\n"
+  "PUJO|1|I|CXX|TV1|ORU1|PG1|NORM|0000060|1000|0|TD0|1|06:00:00|ACCESSIBLE|true|false|3|REALTIME\n"
+  "PUJO|1|I|CXX|TV1|ORU1|PG1|NORM|0000060|1000|1|TD0|1|08:15:00|ACCESSIBLE|true|false||\n"
+  "NOTICE|1|I|CXX|N1|Let op\n"
+  "NTCASSGNM|1|I|CXX|N1|PUJO|TV1|ORU1|||PG1|NORM|0000060|1000|1||||\n";
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+  if (ok) return;
+  fprintf(stderr, "FAIL: %s\n", what);
+  failures++;
+}
+
+static Kv1Records parse(std::string_view kv1) {
+  Kv1Records records;
+  Kv1ParallelParser parser(kv1, records, 1);
+  parser.parse();
+  if (!parser.lexer_errors.empty() || !parser.global_errors.empty() || !parser.record_errors.empty()) {
+    fputs("Test data could not be parsed\n", stderr);
+    exit(EXIT_FAILURE);
+  }
+  return records;
+}
+
+namespace {
+  // Collects the references (p_* fields) of records
+  struct References {
+    template<typename T>
+    void operator()(std::string_view, T *const &p) { pointers.push_back(p); }
+    template<typename T>
+    void operator()(std::string_view, const T &) {}
+
+    std::vector<const void *> pointers;
+  };
+}
+
+static std::vector<const void *> references(const Kv1Records &records) {
+  References references;
+#define X(type, table) for (const type &record : records.table) kv1Fields(references, record);
+  KV1_TABLES
+#undef X
+  return references.pointers;
+}
+
+static bool indexed(const Kv1Index &index) {
+  const Kv1Records &records = *index.records;
+#define X(type, table) \
+  for (const type &record : records.table) \
+    if (index.table.find(record.key) != &record) return false;
+  KV1_INDEXED_TABLES
+#undef X
+  return index.size() == records.size() - records.notice_assignments.size();
+}
+
+int main() {
+  Kv1Records records = parse(OLD_KV1);
+  Kv1Index index(&records, 1);
+  kv1LinkRecords(index, 1);
+
+  check(kv1Diff(index, parse(OLD_KV1)).size() == 0, "data does not differ from itself");
+
+  Kv1Diff diff = kv1Diff(index, parse(NEW_KV1));
+  check(diff.size() == 8, "eight records differ");
+  check(diff.user_stop_points.changed.size() == 1, "one user stop point has changed");
+  check(diff.public_journeys.changed.size() == 1, "one public journey has changed");
+  check(diff.points.added.size() == 1 && diff.points.removed.size() == 1, "one point has been replaced");
+  check(diff.point_on_links.added.size() == 1 && diff.point_on_links.removed.size() == 1,
+        "one point on link has been replaced");
+  check(diff.notices.added.size() == 1, "one notice has been added");
+  check(diff.notice_assignments.added.size() == 1, "one notice assignment has been added");
+
+  const Kv1Line *line = &records.lines[0];
+  const Kv1PublicJourney *journey = &records.public_journeys[1];
+  kv1ApplyDiff(index, parse(NEW_KV1), diff);
+  check(&records.lines[0] == line, "unchanged tables have not moved");
+  check(&records.public_journeys[1] == journey, "changed records are updated in place");
+  check(journey->departure_time.to_duration() == std::chrono::hours(8) + std::chrono::minutes(15),
+        "changed records have been updated");
+
+  check(kv1Diff(index, parse(NEW_KV1)).size() == 0, "applying the diff gives the new data");
+  check(indexed(index), "all records are indexed");
+  std::vector<const void *> linked = references(records);
+  kv1LinkRecords(index, 1);
+  check(references(records) == linked, "all records are linked");
+
+  if (failures > 0) {
+    fprintf(stderr, "%d checks failed\n", failures);
+    return EXIT_FAILURE;
+  }
+  fputs("All checks passed\n", stderr);
+}
@@ -2,6 +2,8 @@
 //
 // Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
 
+#include <algorithm>
+#include <charconv>
 #include <chrono>
 #include <cstdio>
 #include <deque>
@@ -11,25 +13,26 @@
 #include <iostream>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
-#include <arrow/acero/exec_plan.h>
 #include <arrow/api.h>
 #include <arrow/compute/api.h>
 #include <arrow/dataset/api.h>
 #include <arrow/filesystem/api.h>
 #include <arrow/io/api.h>
-#include <parquet/arrow/reader.h>
+#include <arrow/util/bit_util.h>
+#include <arrow/util/thread_pool.h>
 
+#include <tmi8/kv1_geometry.hpp>
 #include <tmi8/kv1_index.hpp>
-#include <tmi8/kv1_lexer.hpp>
-#include <tmi8/kv1_parser.hpp>
+#include <tmi8/kv1_load.hpp>
 #include <tmi8/kv1_types.hpp>
+#include <tmi8/kv6_local_time.hpp>
 #include <tmi8/kv6_parquet.hpp>
 
 using namespace std::string_view_literals;
 
-namespace ac = arrow::acero;
 namespace ds = arrow::dataset;
 namespace cp = arrow::compute;
 using namespace arrow;
@@ -39,74 +42,6 @@ using TimingClock = std::conditional_t<
   std::chrono::high_resolution_clock,
   std::chrono::steady_clock>;
 
-std::string readKv1() {
-  fputs("Reading KV1 from standard input\n", stderr);
-
-  char buf[4096];
-  std::string data;
-  while (!feof(stdin) && !ferror(stdin)) {
-    size_t read = fread(buf, sizeof(char), 4096, stdin);
-    data.append(buf, read);
-  }
-  if (ferror(stdin)) {
-    fputs("Error when reading from stdin\n", stderr);
-    exit(1);
-  }
-  fprintf(stderr, "Read %lu bytes\n", data.size());
-
-  return data;
-}
-
-std::vector<Kv1Token> lex() {
-  std::string data = readKv1();
-
-  auto start = TimingClock::now();
-  Kv1Lexer lexer(data);
-  lexer.lex();
-  auto end = TimingClock::now();
-
-  std::chrono::duration<double> elapsed{end - start};
-  double bytes = static_cast<double>(data.size()) / 1'000'000;
-  double speed = bytes / elapsed.count();
-
-  if (!lexer.errors.empty()) {
-    fputs("Lexer reported errors:\n", stderr);
-    for (const auto &error : lexer.errors)
-      fprintf(stderr, "- %s\n", error.c_str());
-    exit(1);
-  }
-
-  fprintf(stderr, "Got %lu tokens\n", lexer.tokens.size());
-  fprintf(stderr, "Duration: %f s\n", elapsed.count());
-  fprintf(stderr, "Speed: %f MB/s\n", speed);
-
-  return std::move(lexer.tokens);
-}
-
-bool parse(Kv1Records &into) {
-  std::vector<Kv1Token> tokens = lex();
-
-  Kv1Parser parser(tokens, into);
-  parser.parse();
-
-  bool ok = true;
-  if (!parser.global_errors.empty()) {
-    ok = false;
-    fputs("Parser reported errors:\n", stderr);
-    for (const auto &error : parser.global_errors)
-      fprintf(stderr, "- %s\n", error.c_str());
-  }
-  if (!parser.warns.empty()) {
-    fputs("Parser reported warnings:\n", stderr);
-    for (const auto &warn : parser.warns)
-      fprintf(stderr, "- %s\n", warn.c_str());
-  }
-
-  fprintf(stderr, "Parsed %lu records\n", into.size());
-
-  return ok;
-}
-
 void printParsedRecords(const Kv1Records &records) {
   fputs("Parsed records:\n", stderr);
   fprintf(stderr, "  organizational_units: %lu\n", records.organizational_units.size());
@@ -140,371 +75,681 @@ void printParsedRecords(const Kv1Records &records) {
   fprintf(stderr, "  operating_days: %lu\n", records.operating_days.size());
 }
 
-void printIndexSize(const Kv1Index &index) {
-  fputs("Index size:\n", stderr);
-  fprintf(stderr, "  organizational_units: %lu\n", index.organizational_units.size());
-  fprintf(stderr, "  user_stop_points: %lu\n", index.user_stop_points.size());
-  fprintf(stderr, "  user_stop_areas: %lu\n", index.user_stop_areas.size());
-  fprintf(stderr, "  timing_links: %lu\n", index.timing_links.size());
-  fprintf(stderr, "  links: %lu\n", index.links.size());
-  fprintf(stderr, "  lines: %lu\n", index.lines.size());
-  fprintf(stderr, "  destinations: %lu\n", index.destinations.size());
-  fprintf(stderr, "  journey_patterns: %lu\n", index.journey_patterns.size());
-  fprintf(stderr, "  concession_financer_relations: %lu\n", index.concession_financer_relations.size());
-  fprintf(stderr, "  concession_areas: %lu\n", index.concession_areas.size());
-  fprintf(stderr, "  financers: %lu\n", index.financers.size());
-  fprintf(stderr, "  journey_pattern_timing_links: %lu\n", index.journey_pattern_timing_links.size());
-  fprintf(stderr, "  points: %lu\n", index.points.size());
-  fprintf(stderr, "  point_on_links: %lu\n", index.point_on_links.size());
-  fprintf(stderr, "  icons: %lu\n", index.icons.size());
-  fprintf(stderr, "  notices: %lu\n", index.notices.size());
-  fprintf(stderr, "  time_demand_groups: %lu\n", index.time_demand_groups.size());
-  fprintf(stderr, "  time_demand_group_run_times: %lu\n", index.time_demand_group_run_times.size());
-  fprintf(stderr, "  period_groups: %lu\n", index.period_groups.size());
-  fprintf(stderr, "  specific_days: %lu\n", index.specific_days.size());
-  fprintf(stderr, "  timetable_versions: %lu\n", index.timetable_versions.size());
-  fprintf(stderr, "  public_journeys: %lu\n", index.public_journeys.size());
-  fprintf(stderr, "  period_group_validities: %lu\n", index.period_group_validities.size());
-  fprintf(stderr, "  exceptional_operating_days: %lu\n", index.exceptional_operating_days.size());
-  fprintf(stderr, "  schedule_versions: %lu\n", index.schedule_versions.size());
-  fprintf(stderr, "  public_journey_passing_times: %lu\n", index.public_journey_passing_times.size());
-  fprintf(stderr, "  operating_days: %lu\n", index.operating_days.size());
+void printIndexSize(const Kv1Index &index, std::chrono::duration<double> build_time) {
+  fprintf(stderr, "Index size (built in %f s, using %lu bytes):\n", build_time.count(), index.memoryUsage());
+  fprintf(stderr, "  organizational_units: %lu (%lu bytes)\n", index.organizational_units.size(), index.organizational_units.memoryUsage());
+  fprintf(stderr, "  user_stop_points: %lu (%lu bytes)\n", index.user_stop_points.size(), index.user_stop_points.memoryUsage());
+  fprintf(stderr, "  user_stop_areas: %lu (%lu bytes)\n", index.user_stop_areas.size(), index.user_stop_areas.memoryUsage());
+  fprintf(stderr, "  timing_links: %lu (%lu bytes)\n", index.timing_links.size(), index.timing_links.memoryUsage());
+  fprintf(stderr, "  links: %lu (%lu bytes)\n", index.links.size(), index.links.memoryUsage());
+  fprintf(stderr, "  lines: %lu (%lu bytes)\n", index.lines.size(), index.lines.memoryUsage());
+  fprintf(stderr, "  destinations: %lu (%lu bytes)\n", index.destinations.size(), index.destinations.memoryUsage());
+  fprintf(stderr, "  journey_patterns: %lu (%lu bytes)\n", index.journey_patterns.size(), index.journey_patterns.memoryUsage());
+  fprintf(stderr, "  concession_financer_relations: %lu (%lu bytes)\n", index.concession_financer_relations.size(), index.concession_financer_relations.memoryUsage());
+  fprintf(stderr, "  concession_areas: %lu (%lu bytes)\n", index.concession_areas.size(), index.concession_areas.memoryUsage());
+  fprintf(stderr, "  financers: %lu (%lu bytes)\n", index.financers.size(), index.financers.memoryUsage());
+  fprintf(stderr, "  journey_pattern_timing_links: %lu (%lu bytes)\n", index.journey_pattern_timing_links.size(), index.journey_pattern_timing_links.memoryUsage());
+  fprintf(stderr, "  points: %lu (%lu bytes)\n", index.points.size(), index.points.memoryUsage());
+  fprintf(stderr, "  point_on_links: %lu (%lu bytes)\n", index.point_on_links.size(), index.point_on_links.memoryUsage());
+  fprintf(stderr, "  icons: %lu (%lu bytes)\n", index.icons.size(), index.icons.memoryUsage());
+  fprintf(stderr, "  notices: %lu (%lu bytes)\n", index.notices.size(), index.notices.memoryUsage());
+  fprintf(stderr, "  time_demand_groups: %lu (%lu bytes)\n", index.time_demand_groups.size(), index.time_demand_groups.memoryUsage());
+  fprintf(stderr, "  time_demand_group_run_times: %lu (%lu bytes)\n", index.time_demand_group_run_times.size(), index.time_demand_group_run_times.memoryUsage());
+  fprintf(stderr, "  period_groups: %lu (%lu bytes)\n", index.period_groups.size(), index.period_groups.memoryUsage());
+  fprintf(stderr, "  specific_days: %lu (%lu bytes)\n", index.specific_days.size(), index.specific_days.memoryUsage());
+  fprintf(stderr, "  timetable_versions: %lu (%lu bytes)\n", index.timetable_versions.size(), index.timetable_versions.memoryUsage());
+  fprintf(stderr, "  public_journeys: %lu (%lu bytes)\n", index.public_journeys.size(), index.public_journeys.memoryUsage());
+  fprintf(stderr, "  period_group_validities: %lu (%lu bytes)\n", index.period_group_validities.size(), index.period_group_validities.memoryUsage());
+  fprintf(stderr, "  exceptional_operating_days: %lu (%lu bytes)\n", index.exceptional_operating_days.size(), index.exceptional_operating_days.memoryUsage());
+  fprintf(stderr, "  schedule_versions: %lu (%lu bytes)\n", index.schedule_versions.size(), index.schedule_versions.memoryUsage());
+  fprintf(stderr, "  public_journey_passing_times: %lu (%lu bytes)\n", index.public_journey_passing_times.size(), index.public_journey_passing_times.memoryUsage());
+  fprintf(stderr, "  operating_days: %lu (%lu bytes)\n", index.operating_days.size(), index.operating_days.memoryUsage());
 }
 
-struct BasicJourneyKey {
-  std::string data_owner_code;
-  std::string line_planning_number;
-  int         journey_number;
+// Open-addressing hash table (with linear probing) from 64-bit integer keys to
+// 32-bit values. Only supports insertion and lookup, which is all we need for
+// the journey table and distance map. UINT64_MAX is reserved to mark empty
+// slots.
+class FlatU64Map {
+ public:
+  static constexpr uint64_t EMPTY = UINT64_MAX;
+
+  FlatU64Map() : keys(16, EMPTY), values(16) {}
+
+  void insert(uint64_t key, uint32_t value) {
+    if ((count + 1) * 2 > keys.size()) grow();
+    size_t slot = find(key);
+    if (keys[slot] == EMPTY) count++;
+    keys[slot] = key;
+    values[slot] = value;
+  }
+
+  // Returns false if the key is not present. Looking up EMPTY always fails.
+  bool lookup(uint64_t key, uint32_t &value) const {
+    size_t slot = find(key);
+    if (keys[slot] == EMPTY) return false;
+    value = values[slot];
+    return true;
+  }
+
+  size_t size() const { return count; }
+
+ private:
+  size_t find(uint64_t key) const {
+    size_t mask = keys.size() - 1;
+    // Fibonacci hashing: the multiplication spreads sequential IDs over the
+    // high bits, so we take those.
+    size_t slot = static_cast<size_t>((key * 0x9e3779b97f4a7c15ull) >> 32) & mask;
+    while (keys[slot] != EMPTY && keys[slot] != key)
+      slot = (slot + 1) & mask;
+    return slot;
+  }
+
+  void grow() {
+    std::vector<uint64_t> old_keys(keys.size() * 2, EMPTY);
+    std::vector<uint32_t> old_values(values.size() * 2);
+    std::swap(keys, old_keys);
+    std::swap(values, old_values);
+    for (size_t i = 0; i < old_keys.size(); i++) {
+      if (old_keys[i] == EMPTY) continue;
+      size_t slot = find(old_keys[i]);
+      keys[slot] = old_keys[i];
+      values[slot] = old_values[i];
+    }
+  }
 
-  auto operator<=>(const BasicJourneyKey &) const = default;
+  size_t count = 0;
+  std::vector<uint64_t> keys;
+  std::vector<uint32_t> values;
 };
 
-size_t hash_value(const BasicJourneyKey &k) {
-  size_t seed = 0;
+// Marks a string that does not occur in a table of IDs, and thus can never
+// produce a hit.
+static constexpr uint32_t UNKNOWN_ID = UINT32_MAX;
 
-  boost::hash_combine(seed, k.data_owner_code);
-  boost::hash_combine(seed, k.line_planning_number);
-  boost::hash_combine(seed, k.journey_number);
+// Data owner codes get 8 bits and line planning numbers 24 bits in a packed
+// journey key, which leaves the lower 32 bits for the journey number.
+static constexpr uint32_t MAX_DATA_OWNER_CODE_IDS = 1 << 8;
+static constexpr uint32_t MAX_LINE_PLANNING_NUMBER_IDS = 1 << 24;
 
-  return seed;
-}
+// Dense IDs for strings, in order of first appearance
+struct IdTable {
+  std::unordered_map<std::string, uint32_t> ids;
+  std::vector<std::string> names;
 
-using BasicJourneyKeySet = std::unordered_set<BasicJourneyKey, boost::hash<BasicJourneyKey>>;
+  uint32_t intern(std::string_view name) {
+    auto [it, inserted] = ids.try_emplace(std::string(name), static_cast<uint32_t>(names.size()));
+    if (inserted) names.push_back(it->first);
+    return it->second;
+  }
 
-arrow::Result<BasicJourneyKeySet> basicJourneys(std::shared_ptr<arrow::Table> table) {
-  ac::TableSourceNodeOptions table_source_node_options(table);
-  ac::Declaration table_source("table_source", std::move(table_source_node_options));
-  auto aggregate_options = ac::AggregateNodeOptions{
-    /* .aggregates = */ {},
-    /* .keys = */ { "data_owner_code", "line_planning_number", "journey_number" },
-  };
-  ac::Declaration aggregate("aggregate", { std::move(table_source) }, std::move(aggregate_options));
-  
-  std::shared_ptr<arrow::Table> result;
-  ARROW_ASSIGN_OR_RAISE(result, ac::DeclarationToTable(std::move(aggregate)));
-
-  std::shared_ptr<arrow::ChunkedArray> data_owner_codes = result->GetColumnByName("data_owner_code");
-  std::shared_ptr<arrow::ChunkedArray> line_planning_numbers = result->GetColumnByName("line_planning_number");
-  std::shared_ptr<arrow::ChunkedArray> journey_numbers = result->GetColumnByName("journey_number");
-
-  int i_data_owner_codes_chunk = 0;
-  int i_journey_numbers_chunk = 0;
-  int i_line_planning_numbers_chunk = 0;
-  int i_in_data_owner_codes_chunk = 0;
-  int i_in_journey_numbers_chunk = 0;
-  int i_in_line_planning_numbers_chunk = 0;
-
-  BasicJourneyKeySet journeys;
-
-  for (int64_t i = 0; i < result->num_rows(); i++) {
-    auto data_owner_codes_chunk = std::static_pointer_cast<arrow::StringArray>(data_owner_codes->chunk(i_data_owner_codes_chunk));
-    auto line_planning_numbers_chunk = std::static_pointer_cast<arrow::StringArray>(line_planning_numbers->chunk(i_line_planning_numbers_chunk));
-    auto journey_numbers_chunk = std::static_pointer_cast<arrow::UInt32Array>(journey_numbers->chunk(i_journey_numbers_chunk));
-
-    std::string_view data_owner_code = data_owner_codes_chunk->Value(i_in_data_owner_codes_chunk);
-    std::string_view line_planning_number = line_planning_numbers_chunk->Value(i_in_line_planning_numbers_chunk);
-    uint32_t journey_number = journey_numbers_chunk->Value(i_in_journey_numbers_chunk);
-
-    journeys.emplace(
-      std::string(data_owner_code),
-      std::string(line_planning_number),
-      journey_number
-    );
-
-    i_in_data_owner_codes_chunk++;
-    i_in_line_planning_numbers_chunk++;
-    i_in_journey_numbers_chunk++;
-    if (i_in_data_owner_codes_chunk >= data_owner_codes_chunk->length()) {
-      i_data_owner_codes_chunk++;
-      i_in_data_owner_codes_chunk = 0;
-    }
-    if (i_in_line_planning_numbers_chunk >= line_planning_numbers_chunk->length()) {
-      i_line_planning_numbers_chunk++;
-      i_in_line_planning_numbers_chunk = 0;
-    }
-    if (i_in_journey_numbers_chunk >= journey_numbers_chunk->length()) {
-      i_journey_numbers_chunk++;
-      i_in_journey_numbers_chunk = 0;
-    }
+  uint32_t find(const std::string &name) const {
+    auto it = ids.find(name);
+    return it == ids.end() ? UNKNOWN_ID : it->second;
   }
 
-  return journeys;
-}
+  size_t size() const { return names.size(); }
+};
+
+// The distinct journeys (DataOwnerCode + LinePlanningNumber + JourneyNumber)
+// in some KV6 data, each of which has a dense journey ID.
+struct JourneyTable {
+  IdTable data_owner_codes;
+  IdTable line_planning_numbers;
+
+  // Journey ID -> packed journey key (see key())
+  std::vector<uint64_t> keys;
+  // Packed journey key -> journey ID
+  FlatU64Map ids;
+
+  static uint64_t key(uint32_t data_owner_code_id, uint32_t line_planning_number_id, uint32_t journey_number) {
+    if (data_owner_code_id == UNKNOWN_ID || line_planning_number_id == UNKNOWN_ID)
+      return FlatU64Map::EMPTY;
+    return static_cast<uint64_t>(data_owner_code_id) << 56
+         | static_cast<uint64_t>(line_planning_number_id) << 32
+         | journey_number;
+  }
 
-struct DistanceKey {
-  BasicJourneyKey journey;
-  std::string last_passed_user_stop_code;
+  const std::string &dataOwnerCode(uint32_t journey_id) const {
+    return data_owner_codes.names[keys[journey_id] >> 56];
+  }
 
-  auto operator<=>(const DistanceKey &) const = default;
+  const std::string &linePlanningNumber(uint32_t journey_id) const {
+    return line_planning_numbers.names[(keys[journey_id] >> 32) & (MAX_LINE_PLANNING_NUMBER_IDS - 1)];
+  }
+
+  uint32_t journeyNumber(uint32_t journey_id) const {
+    return static_cast<uint32_t>(keys[journey_id]);
+  }
+
+  size_t size() const { return keys.size(); }
 };
 
-size_t hash_value(const DistanceKey &k) {
-  size_t seed = 0;
+// Dictionary-encodes a string column, so that whatever we need to do for
+// each of its values only has to be done once per distinct value.
+static arrow::Result<std::shared_ptr<arrow::DictionaryArray>> dictionaryEncode(std::shared_ptr<arrow::Array> column) {
+  ARROW_ASSIGN_OR_RAISE(arrow::Datum encoded, cp::DictionaryEncode(column));
+  auto dict = std::static_pointer_cast<arrow::DictionaryArray>(encoded.make_array());
+  if (dict->indices()->type_id() != arrow::Type::INT32)
+    return arrow::Status::Invalid("Expected dictionary indices to be of type INT32");
+  return dict;
+}
 
-  boost::hash_combine(seed, k.journey);
-  boost::hash_combine(seed, k.last_passed_user_stop_code);
+// Dictionary-encodes a string column and translates every entry of the
+// resulting dictionary to its ID in ids (or UNKNOWN_ID). Then for every row i,
+// dict_ids[indices[i]] is the ID of the key in that row.
+static arrow::Result<std::shared_ptr<arrow::DictionaryArray>> translateDictionary(
+  std::shared_ptr<arrow::Array> column,
+  const IdTable &ids,
+  std::vector<uint32_t> &dict_ids
+) {
+  ARROW_ASSIGN_OR_RAISE(auto dict, dictionaryEncode(std::move(column)));
+  auto values = std::static_pointer_cast<arrow::StringArray>(dict->dictionary());
+  dict_ids.resize(values->length());
+  for (int64_t i = 0; i < values->length(); i++)
+    dict_ids[i] = ids.find(std::string(values->Value(i)));
+  return dict;
+}
 
-  return seed;
+// Like translateDictionary, but adds values that are not in ids yet.
+static arrow::Result<std::shared_ptr<arrow::DictionaryArray>> internDictionary(
+  std::shared_ptr<arrow::Array> column,
+  IdTable &ids,
+  std::vector<uint32_t> &dict_ids
+) {
+  ARROW_ASSIGN_OR_RAISE(auto dict, dictionaryEncode(std::move(column)));
+  auto values = std::static_pointer_cast<arrow::StringArray>(dict->dictionary());
+  dict_ids.resize(values->length());
+  for (int64_t i = 0; i < values->length(); i++)
+    dict_ids[i] = ids.intern(values->Value(i));
+  return dict;
 }
 
-struct DistanceTimingLink {
-  const Kv1JourneyPatternTimingLink *jopatili;
-  double distance_since_start_of_journey = 0; // at the start of the link
-};
+static constexpr int64_t AUGMENT_BLOCK_SIZE = 4096;
+
+// Looks up the ID for every row in [start, start+len) of a dictionary-encoded
+// column. Rows for which the column is null get UNKNOWN_ID.
+static void gatherIds(
+  const arrow::DictionaryArray &dict,
+  const std::vector<uint32_t> &dict_ids,
+  int64_t start, int64_t len,
+  uint32_t *out
+) {
+  const int32_t *indices = std::static_pointer_cast<arrow::Int32Array>(dict.indices())->raw_values();
+  if (dict.null_count() == 0) {
+    for (int64_t i = 0; i < len; i++)
+      out[i] = dict_ids[indices[start + i]];
+  } else {
+    for (int64_t i = 0; i < len; i++)
+      out[i] = dict.IsNull(start + i) ? UNKNOWN_ID : dict_ids[indices[start + i]];
+  }
+}
 
-using DistanceMap = std::unordered_map<DistanceKey, double, boost::hash<DistanceKey>>;
+arrow::Result<JourneyTable> basicJourneys(std::shared_ptr<arrow::RecordBatchReader> batches) {
+  JourneyTable journeys;
+  std::vector<uint32_t> data_owner_code_ids, line_planning_number_ids;
+  std::vector<uint32_t> data_owner_code_block(AUGMENT_BLOCK_SIZE), line_planning_number_block(AUGMENT_BLOCK_SIZE);
+
+  for (const auto &batchr : *batches) {
+    ARROW_ASSIGN_OR_RAISE(auto batch, batchr);
+    ARROW_ASSIGN_OR_RAISE(auto data_owner_codes, internDictionary(
+      batch->GetColumnByName("data_owner_code"), journeys.data_owner_codes, data_owner_code_ids));
+    ARROW_ASSIGN_OR_RAISE(auto line_planning_numbers, internDictionary(
+      batch->GetColumnByName("line_planning_number"), journeys.line_planning_numbers, line_planning_number_ids));
+    if (journeys.data_owner_codes.size() > MAX_DATA_OWNER_CODE_IDS)
+      return arrow::Status::CapacityError("Too many distinct data owner codes");
+    if (journeys.line_planning_numbers.size() > MAX_LINE_PLANNING_NUMBER_IDS)
+      return arrow::Status::CapacityError("Too many distinct line planning numbers");
+
+    auto journey_numbers = std::static_pointer_cast<arrow::UInt32Array>(batch->GetColumnByName("journey_number"));
+    const uint32_t *journey_number_values = journey_numbers->raw_values();
+
+    const int64_t num_rows = batch->num_rows();
+    for (int64_t start = 0; start < num_rows; start += AUGMENT_BLOCK_SIZE) {
+      const int64_t len = std::min(AUGMENT_BLOCK_SIZE, num_rows - start);
+      gatherIds(*data_owner_codes, data_owner_code_ids, start, len, data_owner_code_block.data());
+      gatherIds(*line_planning_numbers, line_planning_number_ids, start, len, line_planning_number_block.data());
+
+      for (int64_t i = 0; i < len; i++) {
+        if (journey_numbers->IsNull(start + i)) continue;
+        uint64_t key = JourneyTable::key(
+          data_owner_code_block[i], line_planning_number_block[i], journey_number_values[start + i]);
+        if (key == FlatU64Map::EMPTY) continue;
+
+        uint32_t journey_id;
+        if (!journeys.ids.lookup(key, journey_id)) {
+          journeys.ids.insert(key, static_cast<uint32_t>(journeys.keys.size()));
+          journeys.keys.push_back(key);
+        }
+      }
+    }
+  }
+
+  return journeys;
+}
+
+struct DistanceMap {
+  // The journeys in the map; keys from the KV6 data are translated into
+  // journey IDs with the help of this table.
+  JourneyTable journeys;
+  // Dense IDs for all user stop codes in the map
+  IdTable user_stop_codes;
+
+  // Journey ID + user stop code ID -> distance since start of journey (m)
+  FlatU64Map distances;
+
+  static uint64_t distanceKey(uint32_t journey_id, uint32_t user_stop_code_id) {
+    if (journey_id == UNKNOWN_ID || user_stop_code_id == UNKNOWN_ID)
+      return FlatU64Map::EMPTY;
+    return static_cast<uint64_t>(journey_id) << 32 | user_stop_code_id;
+  }
+
+  size_t size() const { return distances.size(); }
+};
 
 // Returns a map, where
 //   DataOwnerCode + LinePlanningNumber + JourneyNumber + UserStopCode ->
 //     Distance of Last User Stop
-DistanceMap makeDistanceMap(Kv1Records &records, Kv1Index &index, BasicJourneyKeySet &journeys) {
-  std::unordered_map<
-    Kv1JourneyPattern::Key,
-    std::vector<DistanceTimingLink>, 
-    boost::hash<Kv1JourneyPattern::Key>> jopatili_index;
-  std::unordered_map<
-    BasicJourneyKey,
-    const Kv1PublicJourney *,
-    boost::hash<BasicJourneyKey>> journey_index;
+DistanceMap makeDistanceMap(
+  const Kv1Records &records,
+  const Kv1JourneyPatternGeometry &geometry,
+  JourneyTable journeys
+) {
+  // Journey ID -> PUJO
+  std::vector<const Kv1PublicJourney *> journey_pujos(journeys.size(), nullptr);
   for (size_t i = 0; i < records.public_journeys.size(); i++) {
     const Kv1PublicJourney *pujo = &records.public_journeys[i];
-    
-    BasicJourneyKey journey_key(
-      pujo->key.data_owner_code,
-      pujo->key.line_planning_number,
-      pujo->key.journey_number);
-
-    if (journeys.contains(journey_key)) {
-      journey_index[journey_key] = pujo;
-
-      Kv1JourneyPattern::Key jopa_key(
-        pujo->key.data_owner_code,
-        pujo->key.line_planning_number,
-        pujo->journey_pattern_code);
-      jopatili_index[jopa_key] = {};
-    }
-  }
 
-  for (size_t i = 0; i < records.journey_pattern_timing_links.size(); i++) {
-    const Kv1JourneyPatternTimingLink *jopatili = &records.journey_pattern_timing_links[i];
-    Kv1JourneyPattern::Key jopa_key(
-      jopatili->key.data_owner_code,
-      jopatili->key.line_planning_number,
-      jopatili->key.journey_pattern_code);
-    if (jopatili_index.contains(jopa_key)) {
-      jopatili_index[jopa_key].push_back(DistanceTimingLink(jopatili, 0));
-    }
+    uint64_t key = JourneyTable::key(
+      journeys.data_owner_codes.find(pujo->key.data_owner_code.str()),
+      journeys.line_planning_numbers.find(pujo->key.line_planning_number.str()),
+      static_cast<uint32_t>(pujo->key.journey_number));
+    uint32_t journey_id;
+    if (journeys.ids.lookup(key, journey_id))
+      journey_pujos[journey_id] = pujo;
   }
 
-  for (auto &[jopa_key, timing_links] : jopatili_index) {
-    std::sort(timing_links.begin(), timing_links.end(), [](auto a, auto b) {
-      return a.jopatili->key.timing_link_order < b.jopatili->key.timing_link_order;
-    });
-
-    const std::string transport_type = index.journey_patterns[jopa_key]->p_line->transport_type;
-
-    for (size_t i = 1; i < timing_links.size(); i++) {
-      DistanceTimingLink *timing_link      = &timing_links[i];
-      DistanceTimingLink *prev_timing_link = &timing_links[i - 1];
-
-      const Kv1Link::Key link_key(
-        prev_timing_link->jopatili->key.data_owner_code,
-        prev_timing_link->jopatili->user_stop_code_begin,
-        prev_timing_link->jopatili->user_stop_code_end,
-        transport_type);
-      double link_distance = index.links[link_key]->distance;
-      timing_link->distance_since_start_of_journey =
-        prev_timing_link->distance_since_start_of_journey + link_distance;
-    }
-  }
-
-  // DataOwnerCode + LinePlanningNumber + JourneyNumber + UserStopCode ->
-  //   Distance of Last User Stop
+  // Journey ID + UserStopCode -> Distance of Last User Stop
   DistanceMap distance_map;
 
-  for (const auto &journey : journeys) {
-    const Kv1PublicJourney *pujo = journey_index[journey];
+  for (uint32_t journey_id = 0; journey_id < journeys.size(); journey_id++) {
+    const Kv1PublicJourney *pujo = journey_pujos[journey_id];
     if (pujo == nullptr) {
-      std::cerr << "Warning: No PUJO found for [" << journey.data_owner_code << "] "
-                << journey.line_planning_number << "/" << journey.journey_number << std::endl;
+      std::cerr << "Warning: No PUJO found for [" << journeys.dataOwnerCode(journey_id) << "] "
+                << journeys.linePlanningNumber(journey_id) << "/"
+                << journeys.journeyNumber(journey_id) << std::endl;
       continue;
     }
-    Kv1JourneyPattern::Key jopa_key(
-      pujo->key.data_owner_code,
-      pujo->key.line_planning_number,
-      pujo->journey_pattern_code);
-    for (const auto &timing_link : jopatili_index[jopa_key]) {
-      DistanceKey key(journey, timing_link.jopatili->user_stop_code_begin);
-      distance_map[key] = timing_link.distance_since_start_of_journey;
+    if (pujo->p_journey_pattern == nullptr) continue;
+
+    auto stops = geometry.stopsOf(pujo->p_journey_pattern);
+    // The last stop of every journey pattern is left out, like it was when
+    // distances were taken from the begin stops of the timing links. Vehicles
+    // should not be 'on route' from there, and for circular journey patterns
+    // it would shadow the first stop.
+    for (size_t i = 0; i + 1 < stops.size(); i++) {
+      uint32_t user_stop_code_id = distance_map.user_stop_codes.intern(stops[i].jopatili->user_stop_code_begin.str());
+      distance_map.distances.insert(
+        DistanceMap::distanceKey(journey_id, user_stop_code_id),
+        static_cast<uint32_t>(stops[i].distance_since_start_of_journey));
     }
   }
 
+  distance_map.journeys = std::move(journeys);
   return distance_map;
 }
 
-arrow::Result<std::shared_ptr<arrow::Table>> augment(
-  std::shared_ptr<arrow::Table> table,
+template<typename T>
+static arrow::Result<std::shared_ptr<arrow::Buffer>> allocateValues(int64_t n) {
+  ARROW_ASSIGN_OR_RAISE(std::unique_ptr<arrow::Buffer> buffer,
+                        arrow::AllocateBuffer(n * static_cast<int64_t>(sizeof(T))));
+  return std::shared_ptr<arrow::Buffer>(std::move(buffer));
+}
+
+// The columns that augment() adds
+static const std::vector<std::shared_ptr<arrow::Field>> augmented_fields = {
+  arrow::field("distance_since_start_of_journey", arrow::uint32()),
+  arrow::field("timestamp_iso_day_of_week", arrow::int64()),
+  arrow::field("timestamp_date", arrow::date32()),
+  arrow::field("timestamp_local_time", arrow::time32(arrow::TimeUnit::SECOND)),
+};
+
+// Only reads from distance_map, so batches can be augmented concurrently.
+arrow::Result<std::shared_ptr<arrow::RecordBatch>> augment(
+  std::shared_ptr<arrow::RecordBatch> batch,
   const DistanceMap &distance_map
 ) {
-  for (int i = 0; i < table->num_columns(); i++) {
-    if (table->column(i)->num_chunks() > 1) {
-      std::stringstream ss;
-      ss << "Error: Expected column " << i
-         << " (" << table->ColumnNames()[i] << ") to have 1 chunk, got "
-         << table->column(i)->num_chunks();
-      return arrow::Status::Invalid(ss.str());
-    }
-  }
-
-  auto data_owner_codes = std::static_pointer_cast<arrow::StringArray>(table->GetColumnByName("data_owner_code")->chunk(0));
-  auto line_planning_numbers = std::static_pointer_cast<arrow::StringArray>(table->GetColumnByName("line_planning_number")->chunk(0));
-  auto journey_numbers = std::static_pointer_cast<arrow::UInt32Array>(table->GetColumnByName("journey_number")->chunk(0));
-  auto user_stop_codes = std::static_pointer_cast<arrow::StringArray>(table->GetColumnByName("user_stop_code")->chunk(0));
-  auto distance_since_last_user_stops = std::static_pointer_cast<arrow::UInt32Array>(table->GetColumnByName("distance_since_last_user_stop")->chunk(0));
-  auto timestamps = std::static_pointer_cast<arrow::TimestampArray>(table->GetColumnByName("timestamp")->chunk(0));
+  auto journey_numbers = std::static_pointer_cast<arrow::UInt32Array>(batch->GetColumnByName("journey_number"));
+  auto distance_since_last_user_stops = std::static_pointer_cast<arrow::UInt32Array>(batch->GetColumnByName("distance_since_last_user_stop"));
+  auto timestamps = batch->GetColumnByName("timestamp");
 
-  auto timestamps_type = table->schema()->GetFieldByName("timestamp")->type();
+  auto timestamps_type = batch->schema()->GetFieldByName("timestamp")->type();
   if (timestamps_type->id() != arrow::Type::TIMESTAMP)
     return arrow::Status::Invalid("Field 'timestamp' does not have expected type TIMESTAMP");
-  if (std::static_pointer_cast<arrow::TimestampType>(timestamps_type)->unit() != arrow::TimeUnit::MILLI)
-    return arrow::Status::Invalid("Field 'timestamp' does not have unit MILLI");
-  if (!std::static_pointer_cast<arrow::TimestampType>(timestamps_type)->timezone().empty())
-    return arrow::Status::Invalid("Field 'timestamp' should have empty time zone name");
-
-  std::shared_ptr<arrow::Field> field_distance_since_start_of_journey =
-    arrow::field("distance_since_start_of_journey", arrow::uint32());
-  std::shared_ptr<arrow::Field> field_day_of_week =
-    arrow::field("timestamp_iso_day_of_week", arrow::int64());
-  std::shared_ptr<arrow::Field> field_date =
-    arrow::field("timestamp_date", arrow::date32());
-  std::shared_ptr<arrow::Field> field_local_time =
-    arrow::field("timestamp_local_time", arrow::time32(arrow::TimeUnit::SECOND));
-  arrow::UInt32Builder distance_since_start_of_journey_builder;
-  arrow::Int64Builder  day_of_week_builder;
-  arrow::Date32Builder date_builder;
-  arrow::Time32Builder local_time_builder(arrow::time32(arrow::TimeUnit::SECOND), arrow::default_memory_pool());
-
-  const std::chrono::time_zone *amsterdam = std::chrono::locate_zone("Europe/Amsterdam");
-
-  for (int64_t i = 0; i < table->num_rows(); i++) {
-    DistanceKey key(
-      BasicJourneyKey(
-        std::string(data_owner_codes->Value(i)),
-        std::string(line_planning_numbers->Value(i)),
-        journey_numbers->Value(i)),
-      std::string(user_stop_codes->Value(i)));
-
-    uint32_t distance_since_last_user_stop = distance_since_last_user_stops->Value(i);
-    if (distance_map.contains(key)) {
-      uint32_t total_distance = distance_since_last_user_stop + static_cast<uint32_t>(distance_map.at(key));
-      ARROW_RETURN_NOT_OK(distance_since_start_of_journey_builder.Append(total_distance));
+
+  std::vector<uint32_t> data_owner_code_ids, line_planning_number_ids, user_stop_code_ids;
+  ARROW_ASSIGN_OR_RAISE(auto data_owner_codes, translateDictionary(
+    batch->GetColumnByName("data_owner_code"), distance_map.journeys.data_owner_codes, data_owner_code_ids));
+  ARROW_ASSIGN_OR_RAISE(auto line_planning_numbers, translateDictionary(
+    batch->GetColumnByName("line_planning_number"), distance_map.journeys.line_planning_numbers, line_planning_number_ids));
+  ARROW_ASSIGN_OR_RAISE(auto user_stop_codes, translateDictionary(
+    batch->GetColumnByName("user_stop_code"), distance_map.user_stop_codes, user_stop_code_ids));
+
+  const int64_t num_rows = batch->num_rows();
+  ARROW_ASSIGN_OR_RAISE(auto distance_since_start_of_journey_values, allocateValues<uint32_t>(num_rows));
+  ARROW_ASSIGN_OR_RAISE(auto distance_since_start_of_journey_validity, arrow::AllocateEmptyBitmap(num_rows));
+
+  uint32_t *distance_since_start_of_journey_out = reinterpret_cast<uint32_t *>(distance_since_start_of_journey_values->mutable_data());
+  uint8_t  *distance_since_start_of_journey_valid = distance_since_start_of_journey_validity->mutable_data();
+
+  const uint32_t *journey_number_values = journey_numbers->raw_values();
+  const uint32_t *distance_since_last_user_stop_values = distance_since_last_user_stops->raw_values();
+
+  int64_t null_distances = 0;
+  uint32_t data_owner_code_block[AUGMENT_BLOCK_SIZE];
+  uint32_t line_planning_number_block[AUGMENT_BLOCK_SIZE];
+  uint32_t user_stop_code_block[AUGMENT_BLOCK_SIZE];
+  uint32_t journey_id_block[AUGMENT_BLOCK_SIZE];
+  uint32_t distance_block[AUGMENT_BLOCK_SIZE];
+  bool     found_block[AUGMENT_BLOCK_SIZE];
+
+  for (int64_t start = 0; start < num_rows; start += AUGMENT_BLOCK_SIZE) {
+    const int64_t len = std::min(AUGMENT_BLOCK_SIZE, num_rows - start);
+
+    gatherIds(*data_owner_codes, data_owner_code_ids, start, len, data_owner_code_block);
+    gatherIds(*line_planning_numbers, line_planning_number_ids, start, len, line_planning_number_block);
+    gatherIds(*user_stop_codes, user_stop_code_ids, start, len, user_stop_code_block);
+
+    for (int64_t i = 0; i < len; i++) {
+      uint64_t key = JourneyTable::key(
+        data_owner_code_block[i], line_planning_number_block[i], journey_number_values[start + i]);
+      if (!distance_map.journeys.ids.lookup(key, journey_id_block[i]))
+        journey_id_block[i] = UNKNOWN_ID;
+    }
+    for (int64_t i = 0; i < len; i++) {
+      uint64_t key = DistanceMap::distanceKey(journey_id_block[i], user_stop_code_block[i]);
+      found_block[i] = distance_map.distances.lookup(key, distance_block[i]);
+    }
+
+    // A missing distance since the last user stop (e.g. for arrivals and
+    // departures) means that we are at the user stop itself.
+    if (distance_since_last_user_stops->null_count() == 0) {
+      for (int64_t i = 0; i < len; i++)
+        distance_since_start_of_journey_out[start + i] =
+          distance_block[i] + distance_since_last_user_stop_values[start + i];
     } else {
-      ARROW_RETURN_NOT_OK(distance_since_start_of_journey_builder.AppendNull());
+      for (int64_t i = 0; i < len; i++)
+        distance_since_start_of_journey_out[start + i] = distance_block[i] +
+          (distance_since_last_user_stops->IsValid(start + i) ? distance_since_last_user_stop_values[start + i] : 0);
+    }
+    for (int64_t i = 0; i < len; i++) {
+      if (found_block[i]) arrow::bit_util::SetBit(distance_since_start_of_journey_valid, start + i);
+      else { distance_since_start_of_journey_out[start + i] = 0; null_distances++; }
     }
+  }
+
+  ARROW_ASSIGN_OR_RAISE(arrow::Datum local_times, cp::CallFunction(KV6_LOCAL_TIME_FUNCTION, { timestamps }));
+  auto local_times_struct = std::static_pointer_cast<arrow::StructArray>(local_times.make_array());
+
+  auto distance_since_start_of_journey_col = std::make_shared<arrow::UInt32Array>(
+    num_rows, distance_since_start_of_journey_values, distance_since_start_of_journey_validity, null_distances);
+  std::vector<std::shared_ptr<arrow::Array>> augmented_cols = {
+    distance_since_start_of_journey_col,
+    local_times_struct->field(0),
+    local_times_struct->field(1),
+    local_times_struct->field(2),
+  };
 
-    // Welp, this has gotten a bit complicated!
-    std::chrono::sys_seconds timestamp(std::chrono::floor<std::chrono::seconds>(std::chrono::milliseconds(timestamps->Value(i))));
-    std::chrono::zoned_seconds zoned_timestamp(amsterdam, timestamp);
-    std::chrono::local_seconds local_timestamp(zoned_timestamp);
-    std::chrono::local_days local_date = std::chrono::floor<std::chrono::days>(local_timestamp);
-    std::chrono::year_month_day date(local_date);
-    std::chrono::weekday day_of_week(local_date);
-    std::chrono::hh_mm_ss<std::chrono::seconds> time(local_timestamp - local_date);
-    std::chrono::sys_days unix_date(date);
-
-    int64_t iso_day_of_week = day_of_week.iso_encoding();
-    int32_t unix_days = static_cast<int32_t>(unix_date.time_since_epoch().count());
-    int32_t secs_since_midnight = static_cast<int32_t>(std::chrono::seconds(time).count());
-
-    ARROW_RETURN_NOT_OK(day_of_week_builder.Append(iso_day_of_week));
-    ARROW_RETURN_NOT_OK(date_builder.Append(unix_days));
-    ARROW_RETURN_NOT_OK(local_time_builder.Append(secs_since_midnight));
+  for (size_t i = 0; i < augmented_fields.size(); i++) {
+    ARROW_ASSIGN_OR_RAISE(batch, batch->AddColumn(batch->num_columns(), augmented_fields[i], augmented_cols[i]));
   }
 
-  ARROW_ASSIGN_OR_RAISE(auto distance_since_start_of_journey_col_chunk, distance_since_start_of_journey_builder.Finish());
-  ARROW_ASSIGN_OR_RAISE(auto day_of_week_col_chunk, day_of_week_builder.Finish());
-  ARROW_ASSIGN_OR_RAISE(auto date_col_chunk, date_builder.Finish());
-  ARROW_ASSIGN_OR_RAISE(auto local_time_col_chunk, local_time_builder.Finish());
-  auto distance_since_start_of_journey_col =
-    std::make_shared<arrow::ChunkedArray>(distance_since_start_of_journey_col_chunk);
-  auto day_of_week_col = std::make_shared<arrow::ChunkedArray>(day_of_week_col_chunk);
-  auto date_col        = std::make_shared<arrow::ChunkedArray>(date_col_chunk);
-  auto local_time_col  = std::make_shared<arrow::ChunkedArray>(local_time_col_chunk);
-  
-  ARROW_ASSIGN_OR_RAISE(table, table->AddColumn(
-    table->num_columns(),
-    field_distance_since_start_of_journey,
-    distance_since_start_of_journey_col));
-  ARROW_ASSIGN_OR_RAISE(table, table->AddColumn(table->num_columns(), field_day_of_week, day_of_week_col));
-  ARROW_ASSIGN_OR_RAISE(table, table->AddColumn(table->num_columns(), field_date, date_col));
-  ARROW_ASSIGN_OR_RAISE(table, table->AddColumn(table->num_columns(), field_local_time, local_time_col));
-
-  return table;
+  return batch;
 }
 
-arrow::Status processTables(Kv1Records &records, Kv1Index &index) {
-  std::shared_ptr<arrow::io::RandomAccessFile> input;
-  ARROW_ASSIGN_OR_RAISE(input, arrow::io::ReadableFile::Open("oeuf-input.parquet"));
+// Augments the batches from some other reader. Up to max_in_flight batches are
+// augmented at the same time on Arrow's CPU thread pool, but they are returned
+// in the order in which they were read.
+class AugmentingBatchReader : public arrow::RecordBatchReader {
+ public:
+  AugmentingBatchReader(std::shared_ptr<arrow::RecordBatchReader> input, const DistanceMap &distance_map)
+    : input_(std::move(input)), distance_map_(distance_map),
+      max_in_flight_(2 * static_cast<size_t>(arrow::GetCpuThreadPoolCapacity()))
+  {
+    arrow::FieldVector fields = input_->schema()->fields();
+    fields.insert(fields.end(), augmented_fields.begin(), augmented_fields.end());
+    schema_ = arrow::schema(std::move(fields));
+  }
+
+  ~AugmentingBatchReader() override {
+    // The tasks reference distance_map_, which may not outlive us
+    for (auto &future : in_flight_) future.Wait();
+  }
+
+  std::shared_ptr<arrow::Schema> schema() const override { return schema_; }
+
+  arrow::Status ReadNext(std::shared_ptr<arrow::RecordBatch> *out) override {
+    while (!input_done_ && in_flight_.size() < max_in_flight_) {
+      std::shared_ptr<arrow::RecordBatch> batch;
+      ARROW_RETURN_NOT_OK(input_->ReadNext(&batch));
+      if (!batch) {
+        input_done_ = true;
+        break;
+      }
+      const DistanceMap &distance_map = distance_map_;
+      ARROW_ASSIGN_OR_RAISE(auto future, arrow::internal::GetCpuThreadPool()->Submit(
+        [batch = std::move(batch), &distance_map]() { return augment(batch, distance_map); }));
+      in_flight_.push_back(std::move(future));
+    }
 
-  std::unique_ptr<parquet::arrow::FileReader> arrow_reader;
-  ARROW_RETURN_NOT_OK(parquet::arrow::OpenFile(input, arrow::default_memory_pool(), &arrow_reader));
+    if (in_flight_.empty()) {
+      *out = nullptr;
+      return arrow::Status::OK();
+    }
+    auto future = std::move(in_flight_.front());
+    in_flight_.pop_front();
+    ARROW_ASSIGN_OR_RAISE(*out, future.result());
+    return arrow::Status::OK();
+  }
 
-  std::shared_ptr<arrow::Table> table;
-  ARROW_RETURN_NOT_OK(arrow_reader->ReadTable(&table));
+ private:
+  std::shared_ptr<arrow::RecordBatchReader> input_;
+  const DistanceMap &distance_map_;
+  std::shared_ptr<arrow::Schema> schema_;
+  size_t max_in_flight_;
+  bool input_done_ = false;
+  std::deque<arrow::Future<std::shared_ptr<arrow::RecordBatch>>> in_flight_;
+};
+
+// Opens a Parquet dataset, which is either a single file, a directory
+// (searched recursively) or a manifest: a text file listing one Parquet file
+// per line, relative to the directory that the manifest is in.
+arrow::Result<std::shared_ptr<ds::Dataset>> openDataset(
+  std::shared_ptr<arrow::fs::FileSystem> filesystem,
+  const std::filesystem::path &path
+) {
+  auto format = std::static_pointer_cast<ds::FileFormat>(std::make_shared<ds::ParquetFileFormat>());
+  std::filesystem::path abs_path = std::filesystem::absolute(path);
+
+  std::shared_ptr<ds::DatasetFactory> factory;
+  if (std::filesystem::is_directory(abs_path)) {
+    arrow::fs::FileSelector selector;
+    selector.base_dir = abs_path;
+    selector.recursive = true;
+    ARROW_ASSIGN_OR_RAISE(factory, ds::FileSystemDatasetFactory::Make(
+      filesystem, selector, format, ds::FileSystemFactoryOptions()));
+  } else if (abs_path.extension() == ".parquet") {
+    ARROW_ASSIGN_OR_RAISE(factory, ds::FileSystemDatasetFactory::Make(
+      filesystem, std::vector<std::string>{ abs_path }, format, ds::FileSystemFactoryOptions()));
+  } else {
+    std::ifstream manifest(abs_path);
+    if (!manifest)
+      return arrow::Status::IOError("Could not open manifest ", abs_path.string());
+    std::vector<std::string> paths;
+    for (std::string line; std::getline(manifest, line);) {
+      if (line.empty()) continue;
+      paths.push_back(abs_path.parent_path() / line);
+    }
+    ARROW_ASSIGN_OR_RAISE(factory, ds::FileSystemDatasetFactory::Make(
+      filesystem, paths, format, ds::FileSystemFactoryOptions()));
+  }
+
+  return factory->Finish();
+}
 
-  std::cerr << "Input KV6 file has " << table->num_rows() << " rows" << std::endl;
-  ARROW_ASSIGN_OR_RAISE(BasicJourneyKeySet journeys, basicJourneys(table));
+arrow::Result<std::shared_ptr<arrow::RecordBatchReader>> scanDataset(
+  std::shared_ptr<ds::Dataset> dataset,
+  std::vector<std::string> columns = {}
+) {
+  ARROW_ASSIGN_OR_RAISE(auto scan_builder, dataset->NewScan());
+  if (!columns.empty()) ARROW_RETURN_NOT_OK(scan_builder->Project(columns));
+  ARROW_RETURN_NOT_OK(scan_builder->UseThreads(true));
+  ARROW_ASSIGN_OR_RAISE(auto scanner, scan_builder->Finish());
+  return scanner->ToRecordBatchReader();
+}
+
+// Writes the augmented batches to a dataset in output_dir, partitioned
+// Hive-style by operating day (e.g. operating_day=2024-03-01/part0.parquet).
+// Partitions that are written to are emptied first, so that no files of an
+// earlier run are left behind in them; other partitions are kept.
+arrow::Status writeAugmentedDataset(
+  std::shared_ptr<arrow::fs::FileSystem> filesystem,
+  std::shared_ptr<arrow::RecordBatchReader> augmented,
+  const std::filesystem::path &output_dir
+) {
+  auto format = std::make_shared<ds::ParquetFileFormat>();
+  auto file_write_options = std::static_pointer_cast<ds::ParquetFileWriteOptions>(format->DefaultWriteOptions());
+  file_write_options->writer_properties = parquet::WriterProperties::Builder()
+    .compression(arrow::Compression::ZSTD)
+    ->created_by("oeuf-augmentkv6")
+    ->version(parquet::ParquetVersion::PARQUET_2_6)
+    ->data_page_version(parquet::ParquetDataPageVersion::V2)
+    ->max_row_group_length(MAX_PARQUET_CHUNK)
+    ->build();
+  file_write_options->arrow_writer_properties = parquet::ArrowWriterProperties::Builder()
+    .store_schema()->build();
+
+  ds::FileSystemDatasetWriteOptions write_options;
+  write_options.file_write_options = file_write_options;
+  write_options.filesystem = filesystem;
+  write_options.base_dir = std::filesystem::absolute(output_dir);
+  write_options.partitioning = std::make_shared<ds::HivePartitioning>(
+    arrow::schema({ arrow::field("operating_day", arrow::date32()) }));
+  write_options.basename_template = "part{i}.parquet";
+  write_options.existing_data_behavior = ds::ExistingDataBehavior::kDeleteMatchingPartitions;
+
+  auto scan_builder = ds::ScannerBuilder::FromRecordBatchReader(std::move(augmented));
+  ARROW_ASSIGN_OR_RAISE(auto scanner, scan_builder->Finish());
+  return ds::FileSystemDataset::Write(write_options, scanner);
+}
+
+// Reads the input dataset twice: first only the columns identifying journeys,
+// to build the distance map, and then all columns, in a streaming fashion. If
+// output_dir is empty, the result is written to oeuf-augmented.parquet.
+arrow::Status processTables(
+  Kv1Records &records,
+  const Kv1JourneyPatternGeometry &geometry,
+  const std::filesystem::path &input,
+  const std::filesystem::path &output_dir
+) {
+  auto filesystem = std::make_shared<arrow::fs::LocalFileSystem>();
+  ARROW_ASSIGN_OR_RAISE(auto dataset, openDataset(filesystem, input));
+  auto files = std::static_pointer_cast<ds::FileSystemDataset>(dataset)->files();
+  std::cerr << "Input KV6 dataset has " << files.size() << " file(s)" << std::endl;
+
+  ARROW_ASSIGN_OR_RAISE(auto journey_columns, scanDataset(
+    dataset, { "data_owner_code", "line_planning_number", "journey_number" }));
+  ARROW_ASSIGN_OR_RAISE(JourneyTable journeys, basicJourneys(journey_columns));
   std::cerr << "Found " << journeys.size() << " distinct journeys" << std::endl;
-  DistanceMap distance_map = makeDistanceMap(records, index, journeys);
+  DistanceMap distance_map = makeDistanceMap(records, geometry, std::move(journeys));
   std::cerr << "Distance map has " << distance_map.size() << " keys" << std::endl;
 
-  std::cerr << "Creating augmented table" << std::endl;
-  ARROW_ASSIGN_OR_RAISE(std::shared_ptr<arrow::Table> augmented, augment(table, distance_map));
+  std::cerr << "Augmenting and writing table" << std::endl;
+  ARROW_ASSIGN_OR_RAISE(auto batches, scanDataset(dataset));
+  auto augmented = std::make_shared<AugmentingBatchReader>(std::move(batches), distance_map);
+  if (output_dir.empty())
+    return writeArrowRecordsAsParquetFile(*augmented, "oeuf-augmented.parquet");
+  return writeAugmentedDataset(filesystem, std::move(augmented), output_dir);
+}
 
-  std::cerr << "Writing augmented table" << std::endl;
-  return writeArrowTableAsParquetFile(*augmented, "oeuf-augmented.parquet");
+const char help[] =
+  "Usage: %s [--kv1-snapshot SNAPSHOT] [--threads N] [INPUT [OUTPUT]] <KV1\n"
+  "\n"
+  "  INPUT   KV6 Parquet file, directory of Parquet files (searched recursively)\n"
+  "          or manifest listing one Parquet file per line, relative to the\n"
+  "          manifest. Defaults to oeuf-input.parquet.\n"
+  "  OUTPUT  Directory to write the augmented data set to, partitioned by\n"
+  "          operating day. Operating days that were already in OUTPUT are\n"
+  "          replaced. If not given, all augmented data is written to\n"
+  "          oeuf-augmented.parquet.\n"
+  "\n"
+  "KV1 data is read from standard input, unless a KV1 snapshot (as written by\n"
+  "querykv1 snapshot) is given with --kv1-snapshot. It is loaded on N threads,\n"
+  "or on as many threads as there are CPUs if --threads is not given.\n";
+
+void exitHelp(const char *progname, int code = 1) {
+  fprintf(stderr, help, progname);
+  exit(code);
 }
 
 int main(int argc, char *argv[]) {
+  const char *progname = argv[0];
+  const char *kv1_snapshot_path = nullptr;
+  unsigned n_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  while (argc > 1 && (argv[1] == "--kv1-snapshot"sv || argv[1] == "--threads"sv)) {
+    if (argv[1] == "--kv1-snapshot"sv) {
+      if (argc < 3 || argv[2] == ""sv) {
+        fputs("Error: --kv1-snapshot requires a path\n\n", stderr);
+        exitHelp(progname);
+      }
+      kv1_snapshot_path = argv[2];
+    } else {
+      std::string_view threads(argc < 3 ? "" : argv[2]);
+      auto [threads_end, ec] = std::from_chars(threads.begin(), threads.end(), n_threads);
+      if (ec != std::errc() || threads_end != threads.end() || n_threads == 0) {
+        fputs("Error: --threads requires a positive integer\n\n", stderr);
+        exitHelp(progname);
+      }
+    }
+    argc -= 2;
+    argv += 2;
+  }
+  if (argc > 3) {
+    fputs("Error: too many arguments provided\n\n", stderr);
+    exitHelp(progname);
+  }
+  if (argc > 1 && (argv[1] == "-h"sv || argv[1] == "--help"sv))
+    exitHelp(progname, 0);
+  std::filesystem::path input = argc > 1 ? argv[1] : "oeuf-input.parquet";
+  std::filesystem::path output_dir = argc > 2 ? argv[2] : "";
+
   Kv1Records records;
-  if (!parse(records)) {
-    fputs("Error parsing records, exiting\n", stderr);
+  if (!kv1Load("-", kv1_snapshot_path, records, n_threads)) {
+    fputs("Error loading records, exiting\n", stderr);
     return EXIT_FAILURE;
   }
   printParsedRecords(records);
   fputs("Indexing...\n", stderr);
-  Kv1Index index(&records);
+  auto index_start = TimingClock::now();
+  Kv1Index index(&records, n_threads);
+  auto index_end = TimingClock::now();
   fprintf(stderr, "Indexed %lu records\n", index.size());
   // Only notice assignments are not indexed. If this equality is not valid,
   // then this means that we had duplicate keys or that something else went
   // wrong. That would really not be great.
   assert(index.size() == records.size() - records.notice_assignments.size());
-  printIndexSize(index);
-  fputs("Linking records...\n", stderr);
-  kv1LinkRecords(index);
-  fputs("Done linking\n", stderr);
+  printIndexSize(index, index_end - index_start);
+  // Records in a snapshot have been linked already
+  if (!kv1_snapshot_path) {
+    fputs("Linking records...\n", stderr);
+    kv1LinkRecords(index, n_threads);
+    fputs("Done linking\n", stderr);
+  }
+  Kv1JourneyPatternGeometry geometry(records, index);
+  fprintf(stderr, "Computed geometry of %lu journey patterns\n", records.journey_patterns.size());
 
-  arrow::Status st = processTables(records, index);
+  arrow::Status st = registerKv6LocalTimeFunction();
+  if (st.ok()) st = processTables(records, geometry, input, output_dir);
   if (!st.ok()) {
     std::cerr << "Failed to process tables: " << st << std::endl;
     return EXIT_FAILURE;
@@ -0,0 +1,112 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <arrow/api.h>
+
+#include <tmi8/kv1_load.hpp>
+#include <tmi8/kv1_parquet.hpp>
+#include <tmi8/kv1_types.hpp>
+#include <tmi8/kv6_parquet.hpp>
+
+using namespace std::string_view_literals;
+
+using TimingClock = std::conditional_t<
+  std::chrono::high_resolution_clock::is_steady,
+  std::chrono::high_resolution_clock,
+  std::chrono::steady_clock>;
+
+arrow::Status writeTables(const Kv1Records &records, const std::vector<std::string_view> &tables,
+                          const std::filesystem::path &output_dir) {
+  for (std::string_view table : tables) {
+    std::filesystem::path path = output_dir / (std::string(table) + ".parquet");
+    auto start = TimingClock::now();
+    ARROW_ASSIGN_OR_RAISE(auto batches, kv1ArrowRecordBatches(records, table));
+    ARROW_RETURN_NOT_OK(writeArrowRecordsAsParquetFile(*batches, path));
+    auto end = TimingClock::now();
+
+    std::chrono::duration<double> elapsed{end - start};
+    fprintf(stderr, "Wrote %s in %f s\n", path.c_str(), elapsed.count());
+  }
+  return arrow::Status::OK();
+}
+
+const char help[] =
+  "Usage: %s [--kv1-snapshot SNAPSHOT] OUTPUT [TABLE...] <KV1\n"
+  "\n"
+  "  OUTPUT  Directory to write the tables to, every table to TABLE.parquet.\n"
+  "          It is created if it does not exist yet.\n"
+  "  TABLE   Name of a table to write, e.g. public_journey_passing_times. If\n"
+  "          no tables are given, all tables are written.\n"
+  "\n"
+  "KV1 data is read from standard input, unless a KV1 snapshot (as written by\n"
+  "querykv1 snapshot) is given with --kv1-snapshot.\n";
+
+void exitHelp(const char *progname, int code = 1) {
+  fprintf(stderr, help, progname);
+  fputs("\nTables:\n", stderr);
+  for (std::string_view table : kv1TableNames())
+    fprintf(stderr, "  %.*s\n", static_cast<int>(table.size()), table.data());
+  exit(code);
+}
+
+int main(int argc, char *argv[]) {
+  const char *progname = argv[0];
+  const char *kv1_snapshot_path = nullptr;
+  if (argc > 1 && argv[1] == "--kv1-snapshot"sv) {
+    if (argc < 3 || argv[2] == ""sv) {
+      fputs("Error: --kv1-snapshot requires a path\n\n", stderr);
+      exitHelp(progname);
+    }
+    kv1_snapshot_path = argv[2];
+    argc -= 2;
+    argv += 2;
+  }
+  if (argc > 1 && (argv[1] == "-h"sv || argv[1] == "--help"sv))
+    exitHelp(progname, 0);
+  if (argc < 2 || argv[1] == ""sv) {
+    fputs("Error: no output directory provided\n\n", stderr);
+    exitHelp(progname);
+  }
+  std::filesystem::path output_dir = argv[1];
+
+  const auto &all_tables = kv1TableNames();
+  std::vector<std::string_view> tables(argv + 2, argv + argc);
+  for (std::string_view table : tables) {
+    if (std::find(all_tables.begin(), all_tables.end(), table) == all_tables.end()) {
+      fprintf(stderr, "Error: unknown table %.*s\n\n", static_cast<int>(table.size()), table.data());
+      exitHelp(progname);
+    }
+  }
+  if (tables.empty()) tables = all_tables;
+
+  std::error_code ec;
+  std::filesystem::create_directories(output_dir, ec);
+  if (ec) {
+    fprintf(stderr, "Create %s: %s\n", output_dir.c_str(), ec.message().c_str());
+    return EXIT_FAILURE;
+  }
+
+  // References between records are not exported, so the records need not be
+  // indexed and linked.
+  Kv1Records records;
+  if (!kv1Load("-", kv1_snapshot_path, records)) {
+    fputs("Error loading records, exiting\n", stderr);
+    return EXIT_FAILURE;
+  }
+
+  arrow::Status st = writeTables(records, tables, output_dir);
+  if (!st.ok()) {
+    std::cerr << "Failed to write tables: " << st << std::endl;
+    return EXIT_FAILURE;
+  }
+}
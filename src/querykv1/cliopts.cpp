@@ -2,10 +2,13 @@
 //
 // Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
 
+#include <algorithm>
+#include <charconv>
 #include <cstdlib>
 #include <cstdio>
 #include <string>
 #include <string_view>
+#include <thread>
 
 #include <getopt.h>
 
@@ -19,15 +22,23 @@ const char *opt_unset = nullptr;
 const char help[] = R"(Usage: %1$s [OPTIONS] <COMMAND>
 
 Global Options:
-      --kv1 <PATH>  Path to file containing all KV1 data, '-' for stdin
-  -h, --help        Print this help
+      --kv1 <PATH>           Path to file containing all KV1 data, '-' for stdin
+      --kv1-snapshot <PATH>  Path to KV1 snapshot to use instead of --kv1
+      --threads <N>          Number of threads to load KV1 data with (default:
+                             the number of CPUs)
+      --socket <PATH>        Send the command to 'serve' at this Unix socket
+                             instead of loading KV1 data
+  -h, --help                 Print this help
 
 Commands:
   joparoute     Generate CSV for journey pattern route
   journeyinfo   Print some information on a journey
   journeyroute  Generate CSV for journey route
   journeys      List journeys of a specific line going from stop A to B
+  reload        Make 'serve' load its KV1 data again
   schedule      Generate schedule
+  serve         Load KV1 data once and answer commands on a Unix socket
+  snapshot      Write KV1 snapshot, for use with --kv1-snapshot
 )";
 
 const char joparoute_help[] = R"(Usage: %1$s joparoute --line <NUMBER> --jopa <CODE> [OPTIONS]
@@ -38,8 +49,13 @@ Options:
   -o <PATH>            Path of file to write to, '-' for stdout
 
 Global Options:
-      --kv1 <PATH>  Path to file containing all KV1 data, '-' for stdin
-  -h, --help        Print this help
+      --kv1 <PATH>           Path to file containing all KV1 data, '-' for stdin
+      --kv1-snapshot <PATH>  Path to KV1 snapshot to use instead of --kv1
+      --threads <N>          Number of threads to load KV1 data with (default:
+                             the number of CPUs)
+      --socket <PATH>        Send the command to 'serve' at this Unix socket
+                             instead of loading KV1 data
+  -h, --help                 Print this help
 )";
 
 const char journeyroute_help[] = R"(Usage: %1$s journeyroute --line <NUMBER> [OPTIONS]
@@ -50,8 +66,13 @@ Options:
   -o <PATH>               Path of file to write to, '-' for stdout
 
 Global Options:
-      --kv1 <PATH>  Path to file containing all KV1 data, '-' for stdin
-  -h, --help        Print this help
+      --kv1 <PATH>           Path to file containing all KV1 data, '-' for stdin
+      --kv1-snapshot <PATH>  Path to KV1 snapshot to use instead of --kv1
+      --threads <N>          Number of threads to load KV1 data with (default:
+                             the number of CPUs)
+      --socket <PATH>        Send the command to 'serve' at this Unix socket
+                             instead of loading KV1 data
+  -h, --help                 Print this help
 )";
 
 const char journeys_help[] = R"(Usage: %1$s journeys --line <NUMBER> --begin <STOP> --end <STOP> [OPTIONS]
@@ -67,8 +88,13 @@ Options:
   -o <PATH>            Path of file to write to, '-' for stdout
 
 Global Options:
-      --kv1 <PATH>  Path to file containing all KV1 data, '-' for stdin
-  -h, --help        Print this help
+      --kv1 <PATH>           Path to file containing all KV1 data, '-' for stdin
+      --kv1-snapshot <PATH>  Path to KV1 snapshot to use instead of --kv1
+      --threads <N>          Number of threads to load KV1 data with (default:
+                             the number of CPUs)
+      --socket <PATH>        Send the command to 'serve' at this Unix socket
+                             instead of loading KV1 data
+  -h, --help                 Print this help
 )";
 
 const char journeyinfo_help[] = R"(Usage: %1$s journeyinfo --line <NUMBER> --journey <NUMBER> [OPTIONS]
@@ -78,8 +104,13 @@ Options:
       --journey <NUMBER>  Journey number as in schedule
 
 Global Options:
-      --kv1 <PATH>  Path to file containing all KV1 data, '-' for stdin
-  -h, --help        Print this help
+      --kv1 <PATH>           Path to file containing all KV1 data, '-' for stdin
+      --kv1-snapshot <PATH>  Path to KV1 snapshot to use instead of --kv1
+      --threads <N>          Number of threads to load KV1 data with (default:
+                             the number of CPUs)
+      --socket <PATH>        Send the command to 'serve' at this Unix socket
+                             instead of loading KV1 data
+  -h, --help                 Print this help
 )";
 
 const char schedule_help[] = R"(Usage: %1$s schedule --line <NUMBER> [OPTIONS]
@@ -89,13 +120,69 @@ Options:
   -o <PATH>            Path of file to write to, '-' for stdout
 
 Global Options:
-      --kv1 <PATH>  Path to file containing all KV1 data, '-' for stdin
-  -h, --help        Print this help
+      --kv1 <PATH>           Path to file containing all KV1 data, '-' for stdin
+      --kv1-snapshot <PATH>  Path to KV1 snapshot to use instead of --kv1
+      --threads <N>          Number of threads to load KV1 data with (default:
+                             the number of CPUs)
+      --socket <PATH>        Send the command to 'serve' at this Unix socket
+                             instead of loading KV1 data
+  -h, --help                 Print this help
+)";
+
+const char serve_help[] = R"(Usage: %1$s serve --socket <PATH> [OPTIONS]
+
+Loads the KV1 data once, and then answers the commands joparoute, journeyinfo,
+journeyroute, journeys and schedule of clients, e.g. querykv1 with --socket.
+Every request is a line of JSON with the command and its long options, like
+  {"command":"journeyinfo","line":"1","journey":"2001"}
+and is answered with a line of JSON like {"output":"..."} or {"error":"..."},
+with what the command logged in "log".
+Clients can send multiple requests over one connection, which are answered in
+order. Requests are answered on as many threads as given with --threads.
+Connections on which nothing has been sent for a minute are closed.
+The command reload ({"command":"reload"}, see '%1$s reload') makes the server
+load the KV1 data again, unless it was read from standard input.
+
+Options:
+      --socket <PATH>  Path of the Unix socket to listen on
+
+Global Options:
+      --kv1 <PATH>           Path to file containing all KV1 data, '-' for stdin
+      --kv1-snapshot <PATH>  Path to KV1 snapshot to use instead of --kv1
+      --threads <N>          Number of threads to load KV1 data with (default:
+                             the number of CPUs)
+  -h, --help                 Print this help
+)";
+
+const char reload_help[] = R"(Usage: %1$s reload --socket <PATH>
+
+Makes 'serve' load its KV1 data again, from where it was loaded from when the
+server was started, and replace the records that have changed. Until then,
+requests are answered from the old data.
+
+Options:
+      --socket <PATH>  Path of the Unix socket that 'serve' listens on
+  -h, --help           Print this help
+)";
+
+const char snapshot_help[] = R"(Usage: %1$s snapshot -o <PATH> [OPTIONS]
+
+Options:
+  -o <PATH>  Path of file to write the KV1 snapshot to
+
+Global Options:
+      --kv1 <PATH>           Path to file containing all KV1 data, '-' for stdin
+      --kv1-snapshot <PATH>  Path to KV1 snapshot to use instead of --kv1
+      --threads <N>          Number of threads to load KV1 data with (default:
+                             the number of CPUs)
+  -h, --help                 Print this help
 )";
 
 void journeyRouteValidateOptions(const char *progname, Options *options) {
 #define X(name, argument, long_, short_) \
-  if (#name != "kv1_file_path"sv  && #name != "line_planning_number"sv \
+  if (#name != "kv1_file_path"sv && #name != "kv1_snapshot_path"sv && #name != "socket_path"sv \
+   && #name != "threads"sv \
+   && #name != "line_planning_number"sv \
    && #name != "journey_number"sv && #name != "help"sv && #name != "output_file_path"sv) \
     if (options->name) { \
       if (long_) { \
@@ -116,11 +203,11 @@ void journeyRouteValidateOptions(const char *progname, Options *options) {
     exit(1);
   }
 
-  if (!options->kv1_file_path)
+  if (!options->kv1_file_path && !options->kv1_snapshot_path)
     options->kv1_file_path = "-";
   if (!options->output_file_path)
     options->output_file_path = "-";
-  if (options->kv1_file_path == ""sv) {
+  if (options->kv1_file_path && options->kv1_file_path == ""sv) {
     fprintf(stderr, "%s: KV1 file path cannot be empty\n\n", progname);
     fprintf(stderr, journeyroute_help, progname);
     exit(1);
@@ -144,7 +231,9 @@ void journeyRouteValidateOptions(const char *progname, Options *options) {
 
 void scheduleValidateOptions(const char *progname, Options *options) {
 #define X(name, argument, long_, short_) \
-  if (#name != "kv1_file_path"sv && #name != "help"sv \
+  if (#name != "kv1_file_path"sv && #name != "kv1_snapshot_path"sv && #name != "socket_path"sv \
+   && #name != "threads"sv \
+   && #name != "help"sv \
    && #name != "line_planning_number"sv && #name != "output_file_path"sv) \
     if (options->name) { \
       if (long_) { \
@@ -165,11 +254,11 @@ void scheduleValidateOptions(const char *progname, Options *options) {
     exit(1);
   }
 
-  if (!options->kv1_file_path)
+  if (!options->kv1_file_path && !options->kv1_snapshot_path)
     options->kv1_file_path = "-";
   if (!options->output_file_path)
     options->output_file_path = "-";
-  if (options->kv1_file_path == ""sv) {
+  if (options->kv1_file_path && options->kv1_file_path == ""sv) {
     fprintf(stderr, "%s: KV1 file path cannot be empty\n\n", progname);
     fprintf(stderr, schedule_help, progname);
     exit(1);
@@ -188,7 +277,9 @@ void scheduleValidateOptions(const char *progname, Options *options) {
 
 void journeysValidateOptions(const char *progname, Options *options) {
 #define X(name, argument, long_, short_) \
-  if (#name != "kv1_file_path"sv && #name != "help"sv \
+  if (#name != "kv1_file_path"sv && #name != "kv1_snapshot_path"sv && #name != "socket_path"sv \
+   && #name != "threads"sv \
+   && #name != "help"sv \
    && #name != "line_planning_number"sv && #name != "output_file_path"sv \
    && #name != "begin_stop_code"sv && #name != "end_stop_code"sv) \
     if (options->name) { \
@@ -210,11 +301,11 @@ void journeysValidateOptions(const char *progname, Options *options) {
     exit(1);
   }
 
-  if (!options->kv1_file_path)
+  if (!options->kv1_file_path && !options->kv1_snapshot_path)
     options->kv1_file_path = "-";
   if (!options->output_file_path)
     options->output_file_path = "-";
-  if (options->kv1_file_path == ""sv) {
+  if (options->kv1_file_path && options->kv1_file_path == ""sv) {
     fprintf(stderr, "%s: KV1 file path cannot be empty\n\n", progname);
     fprintf(stderr, journeys_help, progname);
     exit(1);
@@ -255,7 +346,9 @@ void journeysValidateOptions(const char *progname, Options *options) {
 
 void journeyInfoValidateOptions(const char *progname, Options *options) {
 #define X(name, argument, long_, short_) \
-  if (#name != "kv1_file_path"sv  && #name != "line_planning_number"sv \
+  if (#name != "kv1_file_path"sv && #name != "kv1_snapshot_path"sv && #name != "socket_path"sv \
+   && #name != "threads"sv \
+   && #name != "line_planning_number"sv \
    && #name != "journey_number"sv && #name != "help"sv) \
     if (options->name) { \
       if (long_) { \
@@ -276,9 +369,9 @@ void journeyInfoValidateOptions(const char *progname, Options *options) {
     exit(1);
   }
 
-  if (!options->kv1_file_path)
+  if (!options->kv1_file_path && !options->kv1_snapshot_path)
     options->kv1_file_path = "-";
-  if (options->kv1_file_path == ""sv) {
+  if (options->kv1_file_path && options->kv1_file_path == ""sv) {
     fprintf(stderr, "%s: KV1 file path cannot be empty\n\n", progname);
     fprintf(stderr, journeyinfo_help, progname);
     exit(1);
@@ -297,7 +390,9 @@ void journeyInfoValidateOptions(const char *progname, Options *options) {
 
 void jopaRouteValidateOptions(const char *progname, Options *options) {
 #define X(name, argument, long_, short_) \
-  if (#name != "kv1_file_path"sv  && #name != "line_planning_number"sv \
+  if (#name != "kv1_file_path"sv && #name != "kv1_snapshot_path"sv && #name != "socket_path"sv \
+   && #name != "threads"sv \
+   && #name != "line_planning_number"sv \
    && #name != "journey_pattern_code"sv && #name != "help"sv && #name != "output_file_path"sv) \
     if (options->name) { \
       if (long_) { \
@@ -318,11 +413,11 @@ void jopaRouteValidateOptions(const char *progname, Options *options) {
     exit(1);
   }
 
-  if (!options->kv1_file_path)
+  if (!options->kv1_file_path && !options->kv1_snapshot_path)
     options->kv1_file_path = "-";
   if (!options->output_file_path)
     options->output_file_path = "-";
-  if (options->kv1_file_path == ""sv) {
+  if (options->kv1_file_path && options->kv1_file_path == ""sv) {
     fprintf(stderr, "%s: KV1 file path cannot be empty\n\n", progname);
     fprintf(stderr, joparoute_help, progname);
     exit(1);
@@ -344,6 +439,109 @@ void jopaRouteValidateOptions(const char *progname, Options *options) {
   }
 }
 
+void serveValidateOptions(const char *progname, Options *options) {
+#define X(name, argument, long_, short_) \
+  if (#name != "kv1_file_path"sv && #name != "kv1_snapshot_path"sv \
+   && #name != "help"sv && #name != "socket_path"sv && #name != "threads"sv) \
+    if (options->name) { \
+      if (long_) { \
+        if (short_) fprintf(stderr, "%s: unexpected flag --%s (-%c) for serve subcommand\n\n", progname, static_cast<const char *>(long_), short_); \
+        else fprintf(stderr, "%s: unexpected flag --%s for serve subcommand\n\n", progname, static_cast<const char *>(long_)); \
+      } else if (short_) fprintf(stderr, "%s: unexpected flag -%c for serve subcommand\n\n", progname, short_); \
+      fprintf(stderr, serve_help, progname); \
+      exit(1); \
+    }
+  LONG_OPTIONS
+  SHORT_OPTIONS
+#undef X
+
+  if (options->positional.size() > 0) {
+    fprintf(stderr, "%s: unexpected positional argument(s) for serve subcommand\n\n", progname);
+    for (auto pos : options->positional) fprintf(stderr, "opt: %s\n", pos);
+    fprintf(stderr, serve_help, progname);
+    exit(1);
+  }
+
+  if (!options->kv1_file_path && !options->kv1_snapshot_path)
+    options->kv1_file_path = "-";
+  if (options->kv1_file_path && options->kv1_file_path == ""sv) {
+    fprintf(stderr, "%s: KV1 file path cannot be empty\n\n", progname);
+    fprintf(stderr, serve_help, progname);
+    exit(1);
+  }
+  if (!options->socket_path || options->socket_path == ""sv) {
+    fprintf(stderr, "%s: socket path must be provided\n\n", progname);
+    fprintf(stderr, serve_help, progname);
+    exit(1);
+  }
+}
+
+void reloadValidateOptions(const char *progname, Options *options) {
+#define X(name, argument, long_, short_) \
+  if (#name != "help"sv && #name != "socket_path"sv) \
+    if (options->name) { \
+      if (long_) { \
+        if (short_) fprintf(stderr, "%s: unexpected flag --%s (-%c) for reload subcommand\n\n", progname, static_cast<const char *>(long_), short_); \
+        else fprintf(stderr, "%s: unexpected flag --%s for reload subcommand\n\n", progname, static_cast<const char *>(long_)); \
+      } else if (short_) fprintf(stderr, "%s: unexpected flag -%c for reload subcommand\n\n", progname, short_); \
+      fprintf(stderr, reload_help, progname); \
+      exit(1); \
+    }
+  LONG_OPTIONS
+  SHORT_OPTIONS
+#undef X
+
+  if (options->positional.size() > 0) {
+    fprintf(stderr, "%s: unexpected positional argument(s) for reload subcommand\n\n", progname);
+    for (auto pos : options->positional) fprintf(stderr, "opt: %s\n", pos);
+    fprintf(stderr, reload_help, progname);
+    exit(1);
+  }
+
+  if (!options->socket_path || options->socket_path == ""sv) {
+    fprintf(stderr, "%s: socket path must be provided\n\n", progname);
+    fprintf(stderr, reload_help, progname);
+    exit(1);
+  }
+}
+
+void snapshotValidateOptions(const char *progname, Options *options) {
+#define X(name, argument, long_, short_) \
+  if (#name != "kv1_file_path"sv && #name != "kv1_snapshot_path"sv \
+   && #name != "threads"sv && #name != "help"sv && #name != "output_file_path"sv) \
+    if (options->name) { \
+      if (long_) { \
+        if (short_) fprintf(stderr, "%s: unexpected flag --%s (-%c) for snapshot subcommand\n\n", progname, static_cast<const char *>(long_), short_); \
+        else fprintf(stderr, "%s: unexpected flag --%s for snapshot subcommand\n\n", progname, static_cast<const char *>(long_)); \
+      } else if (short_) fprintf(stderr, "%s: unexpected flag -%c for snapshot subcommand\n\n", progname, short_); \
+      fprintf(stderr, snapshot_help, progname); \
+      exit(1); \
+    }
+  LONG_OPTIONS
+  SHORT_OPTIONS
+#undef X
+
+  if (options->positional.size() > 0) {
+    fprintf(stderr, "%s: unexpected positional argument(s) for snapshot subcommand\n\n", progname);
+    for (auto pos : options->positional) fprintf(stderr, "opt: %s\n", pos);
+    fprintf(stderr, snapshot_help, progname);
+    exit(1);
+  }
+
+  if (!options->kv1_file_path && !options->kv1_snapshot_path)
+    options->kv1_file_path = "-";
+  if (options->kv1_file_path && options->kv1_file_path == ""sv) {
+    fprintf(stderr, "%s: KV1 file path cannot be empty\n\n", progname);
+    fprintf(stderr, snapshot_help, progname);
+    exit(1);
+  }
+  if (!options->output_file_path || options->output_file_path == ""sv) {
+    fprintf(stderr, "%s: output file path must be provided\n\n", progname);
+    fprintf(stderr, snapshot_help, progname);
+    exit(1);
+  }
+}
+
 struct ShortFlag {
   int has_arg;
   int c;
@@ -366,6 +564,15 @@ const std::string mkargarr =
 const std::string argarr = mkargarr<SHORT_OPTIONS LONG_OPTIONS ShortFlag(no_argument, 0)>;
 #undef X
 
+unsigned threadCount(const Options &options) {
+  unsigned n_threads = 0;
+  if (options.threads) {
+    std::string_view threads(options.threads);
+    std::from_chars(threads.begin(), threads.end(), n_threads);
+  }
+  return n_threads > 0 ? n_threads : std::max(std::thread::hardware_concurrency(), 1u);
+}
+
 Options parseOptions(int argc, char *argv[]) {
   const char *progname = argv[0];
 
@@ -414,7 +621,10 @@ Options parseOptions(int argc, char *argv[]) {
    && options.subcommand != "joparoute"sv
    && options.subcommand != "journeyinfo"sv
    && options.subcommand != "journeyroute"sv
-   && options.subcommand != "journeys"sv) {
+   && options.subcommand != "journeys"sv
+   && options.subcommand != "reload"sv
+   && options.subcommand != "serve"sv
+   && options.subcommand != "snapshot"sv) {
     fprintf(stderr, "%s: unknown subcommand '%s'\n\n", progname, options.subcommand);
     fprintf(stderr, help, progname);
     exit(1);
@@ -425,7 +635,10 @@ Options parseOptions(int argc, char *argv[]) {
     if (options.subcommand == "journeyinfo"sv) fprintf(stderr, journeyinfo_help, progname);
     if (options.subcommand == "journeyroute"sv) fprintf(stderr, journeyroute_help, progname);
     if (options.subcommand == "journeys"sv) fprintf(stderr, journeys_help, progname);
+    if (options.subcommand == "reload"sv) fprintf(stderr, reload_help, progname);
     if (options.subcommand == "schedule"sv) fprintf(stderr, schedule_help, progname);
+    if (options.subcommand == "serve"sv) fprintf(stderr, serve_help, progname);
+    if (options.subcommand == "snapshot"sv) fprintf(stderr, snapshot_help, progname);
     exit(1);
   }
   if (error || !options.subcommand) {
@@ -439,10 +652,40 @@ Options parseOptions(int argc, char *argv[]) {
     if (options.subcommand == "journeyinfo"sv) fprintf(stderr, journeyinfo_help, progname);
     if (options.subcommand == "journeyroute"sv) fprintf(stderr, journeyroute_help, progname);
     if (options.subcommand == "journeys"sv) fprintf(stderr, journeys_help, progname);
+    if (options.subcommand == "reload"sv) fprintf(stderr, reload_help, progname);
     if (options.subcommand == "schedule"sv) fprintf(stderr, schedule_help, progname);
+    if (options.subcommand == "serve"sv) fprintf(stderr, serve_help, progname);
+    if (options.subcommand == "snapshot"sv) fprintf(stderr, snapshot_help, progname);
     exit(0);
   }
 
+  if (options.kv1_file_path && options.kv1_snapshot_path) {
+    fprintf(stderr, "%s: --kv1 and --kv1-snapshot cannot be used together\n\n", progname);
+    fprintf(stderr, help, progname);
+    exit(1);
+  }
+  if (options.kv1_snapshot_path && options.kv1_snapshot_path == ""sv) {
+    fprintf(stderr, "%s: KV1 snapshot path cannot be empty\n\n", progname);
+    fprintf(stderr, help, progname);
+    exit(1);
+  }
+  if (options.socket_path && options.subcommand != "serve"sv
+   && (options.kv1_file_path || options.kv1_snapshot_path || options.threads)) {
+    fprintf(stderr, "%s: --socket cannot be used together with --kv1, --kv1-snapshot or --threads\n\n", progname);
+    fprintf(stderr, help, progname);
+    exit(1);
+  }
+  if (options.threads) {
+    std::string_view threads(options.threads);
+    unsigned n_threads = 0;
+    auto [threads_end, ec] = std::from_chars(threads.begin(), threads.end(), n_threads);
+    if (ec != std::errc() || threads_end != threads.end() || n_threads == 0) {
+      fprintf(stderr, "%s: number of threads must be a positive integer\n\n", progname);
+      fprintf(stderr, help, progname);
+      exit(1);
+    }
+  }
+
   if (options.subcommand == "joparoute"sv)
     jopaRouteValidateOptions(progname, &options);
   if (options.subcommand == "journeyinfo"sv)
@@ -453,6 +696,12 @@ Options parseOptions(int argc, char *argv[]) {
     journeysValidateOptions(progname, &options);
   if (options.subcommand == "schedule"sv)
     scheduleValidateOptions(progname, &options);
+  if (options.subcommand == "reload"sv)
+    reloadValidateOptions(progname, &options);
+  if (options.subcommand == "serve"sv)
+    serveValidateOptions(progname, &options);
+  if (options.subcommand == "snapshot"sv)
+    snapshotValidateOptions(progname, &options);
 
   return options;
 }
@@ -8,14 +8,17 @@
 #include <vector>
 
 #define LONG_OPTIONS \
-/*  name                  req/opt/no arg     long        short */ \
-  X(kv1_file_path,        required_argument, "kv1",      0 ) \
-  X(line_planning_number, required_argument, "line",     0 ) \
-  X(journey_number,       required_argument, "journey",  0 ) \
-  X(journey_pattern_code, required_argument, "jopa",     0 ) \
-  X(begin_stop_code,      required_argument, "begin",    0 ) \
-  X(end_stop_code,        required_argument, "end",      0 ) \
-  X(help,                 no_argument,       "help",    'h')
+/*  name                  req/opt/no arg     long            short */ \
+  X(kv1_file_path,        required_argument, "kv1",          0 ) \
+  X(kv1_snapshot_path,    required_argument, "kv1-snapshot", 0 ) \
+  X(line_planning_number, required_argument, "line",         0 ) \
+  X(journey_number,       required_argument, "journey",      0 ) \
+  X(journey_pattern_code, required_argument, "jopa",         0 ) \
+  X(begin_stop_code,      required_argument, "begin",        0 ) \
+  X(end_stop_code,        required_argument, "end",          0 ) \
+  X(socket_path,          required_argument, "socket",       0 ) \
+  X(threads,              required_argument, "threads",      0 ) \
+  X(help,                 no_argument,       "help",         'h')
 
 #define SHORT_OPTIONS \
   X(output_file_path, required_argument, nullptr, 'o')
@@ -34,4 +37,7 @@ extern const char *opt_unset;
 
 Options parseOptions(int argc, char *argv[]);
 
+// The number of threads given with --threads, or else the number of CPUs
+unsigned threadCount(const Options &options);
+
 #endif // OEUF_QUERYKV1_CLIOPTS_HPP
@@ -5,11 +5,15 @@
 #ifndef OEUF_QUERYKV1_JOPAROUTE_HPP
 #define OEUF_QUERYKV1_JOPAROUTE_HPP
 
+#include <cstdio>
+#include <string>
+
+#include <tmi8/kv1_geometry.hpp>
 #include <tmi8/kv1_types.hpp>
 #include <tmi8/kv1_index.hpp>
 
 #include "cliopts.hpp"
 
-void jopaRoute(const Options &options, Kv1Records &records, Kv1Index &index);
+std::string jopaRoute(const Options &options, const Kv1JourneyPatternGeometry &geometry, Kv1Index &index, FILE *out, FILE *log);
 
 #endif // OEUF_QUERYKV1_JOPAROUTE_HPP
@@ -2,65 +2,70 @@
 //
 // Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
 
+#include <charconv>
 #include <iostream>
+#include <span>
+#include <sstream>
+#include <string_view>
 
 #include "journeyinfo.hpp"
 
-void journeyInfo(const Options &options, Kv1Records &records, Kv1Index &index) {
-  std::cout << "Info for journey " << options.line_planning_number
-            << "/" << options.journey_number << std::endl;
+std::string journeyInfo(const Options &options, Kv1Records &records, Kv1Index &index, FILE *out, FILE *log) {
+  std::ostringstream info;
+  info << "Info for journey " << options.line_planning_number
+       << "/" << options.journey_number << std::endl;
 
-  std::unordered_map<std::string, const Kv1UserStopPoint *> usrstops;
-  for (size_t i = 0; i < records.user_stop_points.size(); i++) {
-    const Kv1UserStopPoint *usrstop = &records.user_stop_points[i];
-    usrstops[usrstop->key.user_stop_code] = usrstop;
-  }
+  std::string_view journey_number(options.journey_number);
+  int want_journey_number = 0;
+  auto [journey_number_end, ec] = std::from_chars(journey_number.begin(), journey_number.end(), want_journey_number);
+  auto line_planning_number = Kv1Symbol::find(options.line_planning_number);
+  std::span<Kv1PublicJourney *const> pujos;
+  if (line_planning_number && ec == std::errc() && journey_number_end == journey_number.end())
+    pujos = index.publicJourneysByNumber(*line_planning_number, want_journey_number);
 
-  for (const auto &pujo : records.public_journeys) {
-    if (pujo.key.line_planning_number != options.line_planning_number
-     || std::to_string(pujo.key.journey_number) != options.journey_number)
+  for (const Kv1PublicJourney *pujo_ptr : pujos) {
+    const Kv1PublicJourney &pujo = *pujo_ptr;
+    Kv1JourneyPattern::Key jopa_key(
+      pujo.key.data_owner_code,
+      pujo.key.line_planning_number,
+      pujo.journey_pattern_code);
+    auto timing_links = index.journeyPatternTimingLinksOf(jopa_key);
+    if (timing_links.empty())
       continue;
 
-    std::vector<const Kv1JourneyPatternTimingLink *> timing_links;
-    for (size_t i = 0; i < records.journey_pattern_timing_links.size(); i++) {
-      const Kv1JourneyPatternTimingLink *jopatili = &records.journey_pattern_timing_links[i];
-      if (jopatili->key.line_planning_number != options.line_planning_number
-       || jopatili->key.journey_pattern_code != pujo.journey_pattern_code)
-        continue;
-      timing_links.push_back(jopatili);
-    }
-  
-    std::sort(timing_links.begin(), timing_links.end(), [](auto a, auto b) -> bool {
-      return a->key.timing_link_order < b->key.timing_link_order;
-    });
     auto begin_stop = timing_links.front()->user_stop_code_begin;
     auto end_stop   = timing_links.back()->user_stop_code_end;
 
-    const auto *begin = usrstops[begin_stop];
-    const auto *end   = usrstops[end_stop];
+    const auto *begin = timing_links.front()->p_user_stop_begin;
+    const auto *end   = timing_links.back()->p_user_stop_end;
+    if (!begin || !end)
+      continue;
 
-    std::cout << "  Journey pattern:  " << pujo.key.line_planning_number
-              << "/" << pujo.journey_pattern_code << std::endl
-              << "  Begin stop:       " << begin_stop
-              << "; name: " << std::quoted(begin->name)
-              << "; town: " << std::quoted(begin->town) << std::endl
-              << "  End stop:         " << end_stop
-              << "; name: " << std::quoted(end->name)
-              << "; town: " << std::quoted(end->town) << std::endl;
+    info << "  Journey pattern:  " << pujo.key.line_planning_number
+         << "/" << pujo.journey_pattern_code << std::endl
+         << "  Begin stop:       " << begin_stop
+         << "; name: " << std::quoted(begin->name)
+         << "; town: " << std::quoted(begin->town) << std::endl
+         << "  End stop:         " << end_stop
+         << "; name: " << std::quoted(end->name)
+         << "; town: " << std::quoted(end->town) << std::endl;
 
     const auto *begin_star = begin->p_user_stop_area;
     const auto *end_star = end->p_user_stop_area;
     if (begin_star)
-      std::cout << "  Begin stop area:  " << begin_star->key.user_stop_area_code
-                << "; name: " << std::quoted(begin_star->name)
-                << ", town: " << std::quoted(begin_star->town)
-                << std::endl;
+      info << "  Begin stop area:  " << begin_star->key.user_stop_area_code
+           << "; name: " << std::quoted(begin_star->name)
+           << ", town: " << std::quoted(begin_star->town)
+           << std::endl;
     if (end_star)
-      std::cout << "  End stop area:    " << end_star->key.user_stop_area_code
-                << "; name: " << std::quoted(end_star->name)
-                << ", town: " << std::quoted(end_star->town)
-                << std::endl;
+      info << "  End stop area:    " << end_star->key.user_stop_area_code
+           << "; name: " << std::quoted(end_star->name)
+           << ", town: " << std::quoted(end_star->town)
+           << std::endl;
 
     break;
   }
+
+  fputs(info.str().c_str(), out);
+  return "";
 }
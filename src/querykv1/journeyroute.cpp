@@ -2,97 +2,110 @@
 //
 // Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
 
-#include <iostream>
+#include <charconv>
+#include <span>
+#include <sstream>
 #include <string_view>
 
 #include "journeyroute.hpp"
 
-using namespace std::string_view_literals;
+std::string journeyRoute(const Options &options, Kv1Records &records, Kv1Index &index, FILE *out, FILE *log) {
+  std::string_view journey_number(options.journey_number);
+  int want_journey_number = 0;
+  auto [journey_number_end, ec] = std::from_chars(journey_number.begin(), journey_number.end(), want_journey_number);
+  auto line_planning_number = Kv1Symbol::find(options.line_planning_number);
+  std::span<Kv1PublicJourney *const> pujos;
+  if (line_planning_number && ec == std::errc() && journey_number_end == journey_number.end())
+    pujos = index.publicJourneysByNumber(*line_planning_number, want_journey_number);
 
-void journeyRoute(const Options &options, Kv1Records &records, Kv1Index &index) {
-  FILE *out = stdout;
-  if (options.output_file_path != "-"sv)
-    out = fopen(options.output_file_path, "wb");
-  if (!out) {
-    fprintf(stderr, "Open %s: %s\n", options.output_file_path, strerrordesc_np(errno));
-    exit(EXIT_FAILURE);
-  }
-
-  for (auto &pujo : records.public_journeys) {
-    if (pujo.key.line_planning_number == options.line_planning_number && std::to_string(pujo.key.journey_number) == options.journey_number) {
-      fprintf(stderr, "Got PUJO %s/%s:\n", options.line_planning_number, options.journey_number);
-      fprintf(stderr, "  Day type: %s\n", pujo.key.day_type.c_str());
-      auto &pegr = *pujo.p_period_group;
-      fprintf(stderr, "  PEGR Code: %s\n", pegr.key.period_group_code.c_str());
-      fprintf(stderr, "  PEGR Description: %s\n", pegr.description.c_str());
-      fprintf(stderr, "  SPECDAY Code: %s\n", pujo.key.specific_day_code.c_str());
-      auto &timdemgrp = *pujo.p_time_demand_group;
+  for (const Kv1PublicJourney *pujo_ptr : pujos) {
+    const Kv1PublicJourney &pujo = *pujo_ptr;
+    fprintf(log, "Got PUJO %s/%s:\n", options.line_planning_number, options.journey_number);
+    fprintf(log, "  Day type: %s\n", pujo.key.day_type.str().c_str());
+    // The KV1 data may refer to records that it does not contain, so the
+    // references of the journey are not followed without checking them
+    fprintf(log, "  PEGR Code: %s\n", pujo.key.period_group_code.c_str());
+    if (pujo.p_period_group)
+      fprintf(log, "  PEGR Description: %s\n", pujo.p_period_group->description.c_str());
+    fprintf(log, "  SPECDAY Code: %s\n", pujo.key.specific_day_code.c_str());
+    Kv1TimeDemandGroup::Key timdemgrp_key(
+      pujo.key.data_owner_code,
+      pujo.key.line_planning_number,
+      pujo.journey_pattern_code,
+      pujo.time_demand_group_code);
 
-      for (auto &pegrval : records.period_group_validities) {
-        if (pegrval.key.period_group_code == pegr.key.period_group_code) {
-          fprintf(stderr, "Got PEGRVAL for PEGR %s\n", pegr.key.period_group_code.c_str());
-          std::cerr << "  Valid from: " << pegrval.key.valid_from << std::endl;
-          std::cerr << "  Valid thru: " << pegrval.valid_thru << std::endl;
-        }
+    for (auto &pegrval : records.period_group_validities) {
+      if (pegrval.key.period_group_code == pujo.key.period_group_code) {
+        std::ostringstream validity;
+        validity << "Got PEGRVAL for PEGR " << pujo.key.period_group_code << std::endl
+                 << "  Valid from: " << pegrval.key.valid_from << std::endl
+                 << "  Valid thru: " << pegrval.valid_thru << std::endl;
+        fputs(validity.str().c_str(), log);
       }
+    }
 
-      struct Point {
-        Kv1JourneyPatternTimingLink *jopatili = nullptr;
-        Kv1TimeDemandGroupRunTime *timdemrnt = nullptr;
-        double distance_since_start_of_link = 0;
-        double rd_x = 0;
-        double rd_y = 0;
-        double total_time_s = 0;
-      };
-      std::vector<Point> points;
+    struct Point {
+      Kv1JourneyPatternTimingLink *jopatili = nullptr;
+      Kv1TimeDemandGroupRunTime *timdemrnt = nullptr;
+      double distance_since_start_of_link = 0;
+      double rd_x = 0;
+      double rd_y = 0;
+      double total_time_s = 0;
+    };
+    std::vector<Point> points;
 
-      for (size_t i = 0; i < records.time_demand_group_run_times.size(); i++) {
-        Kv1TimeDemandGroupRunTime *timdemrnt = &records.time_demand_group_run_times[i];
-        if (timdemrnt->key.line_planning_number   == timdemgrp.key.line_planning_number
-         && timdemrnt->key.journey_pattern_code   == timdemgrp.key.journey_pattern_code
-         && timdemrnt->key.time_demand_group_code == timdemgrp.key.time_demand_group_code) {
-          Kv1JourneyPatternTimingLink *jopatili = timdemrnt->p_journey_pattern_timing_link;
-          for (auto &pool : records.point_on_links) {
-            if (pool.key.user_stop_code_begin == timdemrnt->user_stop_code_begin
-             && pool.key.user_stop_code_end   == timdemrnt->user_stop_code_end
-             && pool.key.transport_type       == jopatili->p_line->transport_type) {
-              points.emplace_back(
-                jopatili,
-                timdemrnt,
-                pool.distance_since_start_of_link,
-                pool.p_point->location_x_ew,
-                pool.p_point->location_y_ns
-              );
-            }
-          }
+    size_t missing = 0;
+    for (Kv1TimeDemandGroupRunTime *timdemrnt : index.timeDemandGroupRunTimesOf(timdemgrp_key)) {
+      Kv1JourneyPatternTimingLink *jopatili = timdemrnt->p_journey_pattern_timing_link;
+      if (!jopatili || !jopatili->p_line) {
+        missing++;
+        continue;
+      }
+      Kv1Link::Key link_key(
+        timdemrnt->key.data_owner_code,
+        timdemrnt->user_stop_code_begin,
+        timdemrnt->user_stop_code_end,
+        jopatili->p_line->transport_type);
+      for (const Kv1PointOnLink *pool : index.pointOnLinksOf(link_key)) {
+        if (!pool->p_point) {
+          missing++;
+          continue;
         }
+        points.emplace_back(
+          jopatili,
+          timdemrnt,
+          pool->distance_since_start_of_link,
+          pool->p_point->location_x_ew,
+          pool->p_point->location_y_ns
+        );
       }
+    }
+    if (missing > 0)
+      fprintf(log, "Left out %zu timing links or points on links that are missing from the KV1 data\n", missing);
 
-      std::sort(points.begin(), points.end(), [](Point &a, Point &b) {
-        if (a.jopatili->key.timing_link_order != b.jopatili->key.timing_link_order)
-          return a.jopatili->key.timing_link_order < b.jopatili->key.timing_link_order;
-        return a.distance_since_start_of_link < b.distance_since_start_of_link;
-      });
+    std::sort(points.begin(), points.end(), [](Point &a, Point &b) {
+      if (a.jopatili->key.timing_link_order != b.jopatili->key.timing_link_order)
+        return a.jopatili->key.timing_link_order < b.jopatili->key.timing_link_order;
+      return a.distance_since_start_of_link < b.distance_since_start_of_link;
+    });
 
-      double total_time_s = 0;
-      for (size_t i = 0; i < points.size(); i++) {
-        Point *p = &points[i];
-        p->total_time_s = total_time_s;
-        if (i > 0) {
-          Point *prev = &points[i - 1];
-          if (p->timdemrnt != prev->timdemrnt) {
-            total_time_s += prev->timdemrnt->total_drive_time_s;
-            prev->total_time_s = total_time_s;
-          }
+    double total_time_s = 0;
+    for (size_t i = 0; i < points.size(); i++) {
+      Point *p = &points[i];
+      p->total_time_s = total_time_s;
+      if (i > 0) {
+        Point *prev = &points[i - 1];
+        if (p->timdemrnt != prev->timdemrnt) {
+          total_time_s += prev->timdemrnt->total_drive_time_s;
+          prev->total_time_s = total_time_s;
         }
       }
+    }
 
-      fputs("rd_x,rd_y,total_time_s,is_timing_stop\n", out);
-      for (const auto &point : points) {
-        fprintf(out, "%f,%f,%f,%d\n", point.rd_x, point.rd_y, point.total_time_s, point.jopatili->is_timing_stop);
-      }
+    fputs("rd_x,rd_y,total_time_s,is_timing_stop\n", out);
+    for (const auto &point : points) {
+      fprintf(out, "%f,%f,%f,%d\n", point.rd_x, point.rd_y, point.total_time_s, point.jopatili->is_timing_stop);
     }
   }
-
-  if (options.output_file_path != "-"sv) fclose(out);
+  return "";
 }
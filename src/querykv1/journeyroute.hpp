@@ -5,11 +5,14 @@
 #ifndef OEUF_QUERYKV1_JOURNEYROUTE_HPP
 #define OEUF_QUERYKV1_JOURNEYROUTE_HPP
 
+#include <cstdio>
+#include <string>
+
 #include <tmi8/kv1_types.hpp>
 #include <tmi8/kv1_index.hpp>
 
 #include "cliopts.hpp"
 
-void journeyRoute(const Options &options, Kv1Records &records, Kv1Index &index);
+std::string journeyRoute(const Options &options, Kv1Records &records, Kv1Index &index, FILE *out, FILE *log);
 
 #endif // OEUF_QUERYKV1_JOURNEYROUTE_HPP
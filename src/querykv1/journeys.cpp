@@ -2,83 +2,84 @@
 //
 // Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
 
-#include <iostream>
+#include <algorithm>
 #include <map>
 #include <string_view>
 #include <unordered_set>
 
 #include "journeys.hpp"
 
-using namespace std::string_view_literals;
-
-void journeys(const Options &options, Kv1Records &records, Kv1Index &index) {
+std::string journeys(const Options &options, Kv1Records &records, const Kv1JourneyPatternTimingLinkColumns &jopatili_columns, FILE *out, FILE *log) {
   const std::string_view want_begin_stop_code(options.begin_stop_code);
   const std::string_view want_end_stop_code(options.end_stop_code);
 
-  FILE *out = stdout;
-  if (options.output_file_path != "-"sv)
-    out = fopen(options.output_file_path, "wb");
-  if (!out) {
-    fprintf(stderr, "Open %s: %s\n", options.output_file_path, strerrordesc_np(errno));
-    exit(EXIT_FAILURE);
-  }
+  fprintf(log, "Generating journeys for %s, going from stop %s to %s\n",
+    options.line_planning_number, options.begin_stop_code, options.end_stop_code);
 
-  std::cerr << "Generating journeys for " << options.line_planning_number << ", going from stop "
-            << options.begin_stop_code << " to " << options.end_stop_code << std::endl;
+  fputs("journey_number,time_demand_group_code,journey_pattern_code\n", out);
+  // A line planning number that was never interned is not in the data
+  auto found_line_planning_number = Kv1Symbol::find(options.line_planning_number);
+  if (!found_line_planning_number)
+    return "";
+  const Kv1Symbol want_line_planning_number = *found_line_planning_number;
 
-  std::unordered_map<std::string, const Kv1UserStopPoint *> usrstops;
+  std::unordered_map<Kv1Symbol, const Kv1UserStopPoint *> usrstops;
   for (size_t i = 0; i < records.user_stop_points.size(); i++) {
     const Kv1UserStopPoint *usrstop = &records.user_stop_points[i];
     usrstops[usrstop->key.user_stop_code] = usrstop;
   }
 
-  std::unordered_set<std::string> journey_pattern_codes;
+  std::unordered_set<Kv1Symbol> journey_pattern_codes;
   for (const auto &jopa : records.journey_patterns) {
-    if (jopa.key.line_planning_number != options.line_planning_number)
+    if (jopa.key.line_planning_number != want_line_planning_number)
       continue;
     journey_pattern_codes.insert(jopa.key.journey_pattern_code);
   }
 
-  std::unordered_map<std::string, std::vector<const Kv1JourneyPatternTimingLink *>> jopatilis;
-  for (size_t i = 0; i < records.journey_pattern_timing_links.size(); i++) {
-    const Kv1JourneyPatternTimingLink *jopatili = &records.journey_pattern_timing_links[i];
-    if (jopatili->key.line_planning_number != options.line_planning_number
-     || !journey_pattern_codes.contains(jopatili->key.journey_pattern_code))
+  // Only a few fields of every timing link are needed, which are scanned much
+  // faster as columns than as records
+  std::unordered_map<Kv1Symbol, std::vector<size_t>> jopatili_rows;
+  for (size_t i = 0; i < jopatili_columns.size(); i++) {
+    if (jopatili_columns.line_planning_number[i] != want_line_planning_number
+     || !journey_pattern_codes.contains(jopatili_columns.journey_pattern_code[i]))
       continue;
-    jopatilis[jopatili->key.journey_pattern_code].push_back(jopatili);
+    jopatili_rows[jopatili_columns.journey_pattern_code[i]].push_back(i);
   }
 
-  std::unordered_set<std::string> valid_jopas;
-  for (auto &[journey_pattern_code, timing_links] : jopatilis) {
-    std::sort(timing_links.begin(), timing_links.end(), [](auto a, auto b) -> bool {
-      return a->key.timing_link_order < b->key.timing_link_order;
+  std::unordered_set<Kv1Symbol> valid_jopas;
+  for (auto &[journey_pattern_code, rows] : jopatili_rows) {
+    std::sort(rows.begin(), rows.end(), [&](size_t a, size_t b) -> bool {
+      return jopatili_columns.timing_link_order[a] < jopatili_columns.timing_link_order[b];
     });
-    auto begin_stop = timing_links.front()->user_stop_code_begin;
-    auto end_stop   = timing_links.back()->user_stop_code_end;
+    auto begin_stop = jopatili_columns.user_stop_code_begin[rows.front()];
+    auto end_stop   = jopatili_columns.user_stop_code_end[rows.back()];
 
-    const auto *begin = usrstops[begin_stop];
-    const auto *end   = usrstops[end_stop];
+    // Stops that are missing from the KV1 data are in no stop area
+    auto begin = usrstops.find(begin_stop);
+    auto end   = usrstops.find(end_stop);
 
     bool begin_stop_ok = false;
     if (want_begin_stop_code.starts_with("stop:"))
-      begin_stop_ok = want_begin_stop_code.substr(5) == begin_stop;
+      begin_stop_ok = want_begin_stop_code.substr(5) == begin_stop.str();
     else if (want_begin_stop_code.starts_with("star:"))
-      begin_stop_ok = want_begin_stop_code.substr(5) == begin->user_stop_area_code;
+      begin_stop_ok = begin != usrstops.end()
+        && want_begin_stop_code.substr(5) == begin->second->user_stop_area_code;
 
     bool end_stop_ok = false;
     if (want_end_stop_code.starts_with("stop:"))
-      end_stop_ok = want_end_stop_code.substr(5) == end_stop;
+      end_stop_ok = want_end_stop_code.substr(5) == end_stop.str();
     else if (want_end_stop_code.starts_with("star:"))
-      end_stop_ok = want_end_stop_code.substr(5) == end->user_stop_area_code;
+      end_stop_ok = end != usrstops.end()
+        && want_end_stop_code.substr(5) == end->second->user_stop_area_code;
 
     if (begin_stop_ok && end_stop_ok) {
       valid_jopas.insert(journey_pattern_code);
     }
   }
 
-  std::map<int, std::pair<std::string, std::string>> valid_journeys;
+  std::map<int, std::pair<Kv1Symbol, Kv1Symbol>> valid_journeys;
   for (const auto &pujo : records.public_journeys) {
-    if (pujo.key.line_planning_number == options.line_planning_number
+    if (pujo.key.line_planning_number == want_line_planning_number
      && valid_jopas.contains(pujo.journey_pattern_code)) {
       valid_journeys[pujo.key.journey_number] = {
         pujo.time_demand_group_code,
@@ -87,11 +88,9 @@ void journeys(const Options &options, Kv1Records &records, Kv1Index &index) {
     }
   }
 
-  fputs("journey_number,time_demand_group_code,journey_pattern_code\n", out);
   for (const auto &[journey_number, timdemgrp_jopa] : valid_journeys) {
     const auto &[time_demand_group_code, journey_pattern_code] = timdemgrp_jopa;
     fprintf(out, "%d,%s,%s\n", journey_number, time_demand_group_code.c_str(), journey_pattern_code.c_str());
   }
-
-  if (options.output_file_path != "-"sv) fclose(out);
+  return "";
 }
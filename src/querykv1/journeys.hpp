@@ -5,11 +5,14 @@
 #ifndef OEUF_QUERYKV1_JOURNEYS_HPP
 #define OEUF_QUERYKV1_JOURNEYS_HPP
 
+#include <cstdio>
+#include <string>
+
+#include <tmi8/kv1_columns.hpp>
 #include <tmi8/kv1_types.hpp>
-#include <tmi8/kv1_index.hpp>
 
 #include "cliopts.hpp"
 
-void journeys(const Options &options, Kv1Records &records, Kv1Index &index);
+std::string journeys(const Options &options, Kv1Records &records, const Kv1JourneyPatternTimingLinkColumns &jopatili_columns, FILE *out, FILE *log);
 
 #endif // OEUF_QUERYKV1_JOURNEYS_HPP
@@ -2,23 +2,21 @@
 //
 // Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
 
+#include <cerrno>
 #include <chrono>
 #include <cstdio>
+#include <cstring>
 #include <string>
 #include <string_view>
 #include <vector>
 
 #include <tmi8/kv1_types.hpp>
 #include <tmi8/kv1_index.hpp>
-#include <tmi8/kv1_lexer.hpp>
-#include <tmi8/kv1_parser.hpp>
+#include <tmi8/kv1_load.hpp>
+#include <tmi8/kv1_snapshot.hpp>
 
 #include "cliopts.hpp"
-#include "joparoute.hpp"
-#include "journeyinfo.hpp"
-#include "journeyroute.hpp"
-#include "journeys.hpp"
-#include "schedule.hpp"
+#include "serve.hpp"
 
 using namespace std::string_view_literals;
 
@@ -27,86 +25,6 @@ using TimingClock = std::conditional_t<
   std::chrono::high_resolution_clock,
   std::chrono::steady_clock>;
 
-std::string readKv1(const char *path) {
-  FILE *in = stdin;
-  if (path != "-"sv) in = fopen(path, "rb");
-  else fputs("Reading KV1 from standard input\n", stderr);
-  if (!in) {
-    fprintf(stderr, "Open %s: %s\n", path, strerrordesc_np(errno));
-    exit(1);
-  }
-
-  char buf[4096];
-  std::string data;
-  while (!feof(in) && !ferror(in)) {
-    size_t read = fread(buf, sizeof(char), 4096, in);
-    data.append(buf, read);
-  }
-  if (ferror(in)) {
-    if (path == "-"sv)
-      fputs("Error when reading from stdin\n", stderr);
-    else
-      fprintf(stderr, "Error reading from file \"%s\"\n", path);
-    exit(1);
-  }
-  fprintf(stderr, "Read %lu bytes\n", data.size());
-
-  if (path != "-"sv)
-    fclose(in);
-
-  return data;
-}
-
-std::vector<Kv1Token> lex(const char *path) {
-  std::string data = readKv1(path);
-
-  auto start = TimingClock::now();
-  Kv1Lexer lexer(data);
-  lexer.lex();
-  auto end = TimingClock::now();
-
-  std::chrono::duration<double> elapsed{end - start};
-  double bytes = static_cast<double>(data.size()) / 1'000'000;
-  double speed = bytes / elapsed.count();
-
-  if (!lexer.errors.empty()) {
-    fputs("Lexer reported errors:\n", stderr);
-    for (const auto &error : lexer.errors)
-      fprintf(stderr, "- %s\n", error.c_str());
-    exit(1);
-  }
-
-  fprintf(stderr, "Got %lu tokens\n", lexer.tokens.size());
-  fprintf(stderr, "Duration: %f s\n", elapsed.count());
-  fprintf(stderr, "Speed: %f MB/s\n", speed);
-
-  return std::move(lexer.tokens);
-}
-
-bool parse(const char *path, Kv1Records &into) {
-  std::vector<Kv1Token> tokens = lex(path);
-
-  Kv1Parser parser(tokens, into);
-  parser.parse();
-
-  bool ok = true;
-  if (!parser.global_errors.empty()) {
-    ok = false;
-    fputs("Parser reported errors:\n", stderr);
-    for (const auto &error : parser.global_errors)
-      fprintf(stderr, "- %s\n", error.c_str());
-  }
-  if (!parser.warns.empty()) {
-    fputs("Parser reported warnings:\n", stderr);
-    for (const auto &warn : parser.warns)
-      fprintf(stderr, "- %s\n", warn.c_str());
-  }
-
-  fprintf(stderr, "Parsed %lu records\n", into.size());
-
-  return ok;
-}
-
 void printParsedRecords(const Kv1Records &records) {
   fputs("Parsed records:\n", stderr);
   fprintf(stderr, "  organizational_units: %lu\n", records.organizational_units.size());
@@ -140,61 +58,102 @@ void printParsedRecords(const Kv1Records &records) {
   fprintf(stderr, "  operating_days: %lu\n", records.operating_days.size());
 }
 
-void printIndexSize(const Kv1Index &index) {
-  fputs("Index size:\n", stderr);
-  fprintf(stderr, "  organizational_units: %lu\n", index.organizational_units.size());
-  fprintf(stderr, "  user_stop_points: %lu\n", index.user_stop_points.size());
-  fprintf(stderr, "  user_stop_areas: %lu\n", index.user_stop_areas.size());
-  fprintf(stderr, "  timing_links: %lu\n", index.timing_links.size());
-  fprintf(stderr, "  links: %lu\n", index.links.size());
-  fprintf(stderr, "  lines: %lu\n", index.lines.size());
-  fprintf(stderr, "  destinations: %lu\n", index.destinations.size());
-  fprintf(stderr, "  journey_patterns: %lu\n", index.journey_patterns.size());
-  fprintf(stderr, "  concession_financer_relations: %lu\n", index.concession_financer_relations.size());
-  fprintf(stderr, "  concession_areas: %lu\n", index.concession_areas.size());
-  fprintf(stderr, "  financers: %lu\n", index.financers.size());
-  fprintf(stderr, "  journey_pattern_timing_links: %lu\n", index.journey_pattern_timing_links.size());
-  fprintf(stderr, "  points: %lu\n", index.points.size());
-  fprintf(stderr, "  point_on_links: %lu\n", index.point_on_links.size());
-  fprintf(stderr, "  icons: %lu\n", index.icons.size());
-  fprintf(stderr, "  notices: %lu\n", index.notices.size());
-  fprintf(stderr, "  time_demand_groups: %lu\n", index.time_demand_groups.size());
-  fprintf(stderr, "  time_demand_group_run_times: %lu\n", index.time_demand_group_run_times.size());
-  fprintf(stderr, "  period_groups: %lu\n", index.period_groups.size());
-  fprintf(stderr, "  specific_days: %lu\n", index.specific_days.size());
-  fprintf(stderr, "  timetable_versions: %lu\n", index.timetable_versions.size());
-  fprintf(stderr, "  public_journeys: %lu\n", index.public_journeys.size());
-  fprintf(stderr, "  period_group_validities: %lu\n", index.period_group_validities.size());
-  fprintf(stderr, "  exceptional_operating_days: %lu\n", index.exceptional_operating_days.size());
-  fprintf(stderr, "  schedule_versions: %lu\n", index.schedule_versions.size());
-  fprintf(stderr, "  public_journey_passing_times: %lu\n", index.public_journey_passing_times.size());
-  fprintf(stderr, "  operating_days: %lu\n", index.operating_days.size());
+void printIndexSize(const Kv1Index &index, std::chrono::duration<double> build_time) {
+  fprintf(stderr, "Index size (built in %f s, using %lu bytes):\n", build_time.count(), index.memoryUsage());
+  fprintf(stderr, "  organizational_units: %lu (%lu bytes)\n", index.organizational_units.size(), index.organizational_units.memoryUsage());
+  fprintf(stderr, "  user_stop_points: %lu (%lu bytes)\n", index.user_stop_points.size(), index.user_stop_points.memoryUsage());
+  fprintf(stderr, "  user_stop_areas: %lu (%lu bytes)\n", index.user_stop_areas.size(), index.user_stop_areas.memoryUsage());
+  fprintf(stderr, "  timing_links: %lu (%lu bytes)\n", index.timing_links.size(), index.timing_links.memoryUsage());
+  fprintf(stderr, "  links: %lu (%lu bytes)\n", index.links.size(), index.links.memoryUsage());
+  fprintf(stderr, "  lines: %lu (%lu bytes)\n", index.lines.size(), index.lines.memoryUsage());
+  fprintf(stderr, "  destinations: %lu (%lu bytes)\n", index.destinations.size(), index.destinations.memoryUsage());
+  fprintf(stderr, "  journey_patterns: %lu (%lu bytes)\n", index.journey_patterns.size(), index.journey_patterns.memoryUsage());
+  fprintf(stderr, "  concession_financer_relations: %lu (%lu bytes)\n", index.concession_financer_relations.size(), index.concession_financer_relations.memoryUsage());
+  fprintf(stderr, "  concession_areas: %lu (%lu bytes)\n", index.concession_areas.size(), index.concession_areas.memoryUsage());
+  fprintf(stderr, "  financers: %lu (%lu bytes)\n", index.financers.size(), index.financers.memoryUsage());
+  fprintf(stderr, "  journey_pattern_timing_links: %lu (%lu bytes)\n", index.journey_pattern_timing_links.size(), index.journey_pattern_timing_links.memoryUsage());
+  fprintf(stderr, "  points: %lu (%lu bytes)\n", index.points.size(), index.points.memoryUsage());
+  fprintf(stderr, "  point_on_links: %lu (%lu bytes)\n", index.point_on_links.size(), index.point_on_links.memoryUsage());
+  fprintf(stderr, "  icons: %lu (%lu bytes)\n", index.icons.size(), index.icons.memoryUsage());
+  fprintf(stderr, "  notices: %lu (%lu bytes)\n", index.notices.size(), index.notices.memoryUsage());
+  fprintf(stderr, "  time_demand_groups: %lu (%lu bytes)\n", index.time_demand_groups.size(), index.time_demand_groups.memoryUsage());
+  fprintf(stderr, "  time_demand_group_run_times: %lu (%lu bytes)\n", index.time_demand_group_run_times.size(), index.time_demand_group_run_times.memoryUsage());
+  fprintf(stderr, "  period_groups: %lu (%lu bytes)\n", index.period_groups.size(), index.period_groups.memoryUsage());
+  fprintf(stderr, "  specific_days: %lu (%lu bytes)\n", index.specific_days.size(), index.specific_days.memoryUsage());
+  fprintf(stderr, "  timetable_versions: %lu (%lu bytes)\n", index.timetable_versions.size(), index.timetable_versions.memoryUsage());
+  fprintf(stderr, "  public_journeys: %lu (%lu bytes)\n", index.public_journeys.size(), index.public_journeys.memoryUsage());
+  fprintf(stderr, "  period_group_validities: %lu (%lu bytes)\n", index.period_group_validities.size(), index.period_group_validities.memoryUsage());
+  fprintf(stderr, "  exceptional_operating_days: %lu (%lu bytes)\n", index.exceptional_operating_days.size(), index.exceptional_operating_days.memoryUsage());
+  fprintf(stderr, "  schedule_versions: %lu (%lu bytes)\n", index.schedule_versions.size(), index.schedule_versions.memoryUsage());
+  fprintf(stderr, "  public_journey_passing_times: %lu (%lu bytes)\n", index.public_journey_passing_times.size(), index.public_journey_passing_times.memoryUsage());
+  fprintf(stderr, "  operating_days: %lu (%lu bytes)\n", index.operating_days.size(), index.operating_days.memoryUsage());
+}
+
+FILE *openOutput(const Options &options) {
+  if (!options.output_file_path || options.output_file_path == "-"sv)
+    return stdout;
+  FILE *out = fopen(options.output_file_path, "wb");
+  if (!out) {
+    fprintf(stderr, "Open %s: %s\n", options.output_file_path, strerrordesc_np(errno));
+    exit(EXIT_FAILURE);
+  }
+  return out;
 }
 
 int main(int argc, char *argv[]) {
   Options options = parseOptions(argc, argv);
 
+  // With --socket, the KV1 data has been loaded by the server already
+  if (options.socket_path && options.subcommand != "serve"sv) {
+    std::string output;
+    if (!queryServer(options, output)) return EXIT_FAILURE;
+    FILE *out = openOutput(options);
+    fwrite(output.data(), 1, output.size(), out);
+    if (out != stdout) fclose(out);
+    return EXIT_SUCCESS;
+  }
+
+  unsigned n_threads = threadCount(options);
   Kv1Records records;
-  if (!parse(options.kv1_file_path, records)) {
-    fputs("Error parsing records, exiting\n", stderr);
+  // Records in a snapshot have been linked already
+  bool from_snapshot = options.kv1_snapshot_path != nullptr;
+  if (!kv1Load(options.kv1_file_path, options.kv1_snapshot_path, records, n_threads)) {
+    fputs("Error loading records, exiting\n", stderr);
     return EXIT_FAILURE;
   }
   printParsedRecords(records);
   fputs("Indexing...\n", stderr);
-  Kv1Index index(&records);
+  auto index_start = TimingClock::now();
+  Kv1Index index(&records, n_threads);
+  auto index_end = TimingClock::now();
   fprintf(stderr, "Indexed %lu records\n", index.size());
   // Only notice assignments are not indexed. If this equality is not valid,
   // then this means that we had duplicate keys or that something else went
   // wrong. That would really not be great.
   assert(index.size() == records.size() - records.notice_assignments.size());
-  printIndexSize(index);
-  fputs("Linking records...\n", stderr);
-  kv1LinkRecords(index);
-  fputs("Done linking\n", stderr);
+  printIndexSize(index, index_end - index_start);
+  if (!from_snapshot) {
+    fputs("Linking records...\n", stderr);
+    kv1LinkRecords(index, n_threads);
+    fputs("Done linking\n", stderr);
+  }
 
-  if (options.subcommand == "joparoute"sv) jopaRoute(options, records, index);
-  if (options.subcommand == "journeyroute"sv) journeyRoute(options, records, index);
-  if (options.subcommand == "journeys"sv) journeys(options, records, index);
-  if (options.subcommand == "journeyinfo"sv) journeyInfo(options, records, index);
-  if (options.subcommand == "schedule"sv) schedule(options, records, index);
+  QueryData data(records, index);
+  if (options.subcommand == "serve"sv) serve(options, data);
+  if (options.subcommand == "snapshot"sv) {
+    std::string error = kv1WriteSnapshot(records, options.output_file_path);
+    if (!error.empty()) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return EXIT_FAILURE;
+    }
+    fprintf(stderr, "Wrote snapshot to %s\n", options.output_file_path);
+  } else {
+    FILE *out = openOutput(options);
+    std::string error = query(options, data, out, stderr);
+    if (out != stdout) fclose(out);
+    if (!error.empty()) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return EXIT_FAILURE;
+    }
+  }
 }
@@ -2,7 +2,7 @@
 //
 // Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
 
-#include <iostream>
+#include <sstream>
 #include <string_view>
 #include <unordered_map>
 #include <vector>
@@ -10,18 +10,15 @@
 #include "daterange.hpp"
 #include "schedule.hpp"
 
-using namespace std::string_view_literals;
+std::string schedule(const Options &options, Kv1Records &records, Kv1Index &index, FILE *out, FILE *log) {
+  fprintf(log, "Generating schedule for %s\n", options.line_planning_number);
 
-void schedule(const Options &options, Kv1Records &records, Kv1Index &index) {
-  FILE *out = stdout;
-  if (options.output_file_path != "-"sv)
-    out = fopen(options.output_file_path, "wb");
-  if (!out) {
-    fprintf(stderr, "Open %s: %s\n", options.output_file_path, strerrordesc_np(errno));
-    exit(EXIT_FAILURE);
-  }
-
-  std::cerr << "Generating schedule for " << options.line_planning_number << std::endl;
+  fputs("line_planning_number,journey_number,date,departure_time\n", out);
+  // A line planning number that was never interned is not in the data
+  auto found_line_planning_number = Kv1Symbol::find(options.line_planning_number);
+  if (!found_line_planning_number)
+    return "";
+  const Kv1Symbol want_line_planning_number = *found_line_planning_number;
 
   std::unordered_multimap<std::string, Kv1PeriodGroupValidity> period_group_validities;
   for (const auto &pegr : records.period_group_validities)
@@ -30,7 +27,7 @@ void schedule(const Options &options, Kv1Records &records, Kv1Index &index) {
   for (const auto &pujo : records.public_journeys)
     public_journeys.insert({ pujo.key.timetable_version_code, pujo });
 
-  std::cout << "line_planning_number,journey_number,date,departure_time" << std::endl;
+  std::ostringstream csv;
   for (const auto &tive : records.timetable_versions) {
     std::vector<DateRange> tive_pegrval_ranges;
 
@@ -52,14 +49,14 @@ void schedule(const Options &options, Kv1Records &records, Kv1Index &index) {
       for (auto itt = pujo_range.first; itt != pujo_range.second; itt++) {
         const auto &[_, pujo] = *itt;
 
-        if (pujo.key.line_planning_number == options.line_planning_number && pujo.key.day_type.size() == 7
-         && pujo.key.day_type[weekday.iso_encoding() - 1] == static_cast<char>('0' + weekday.iso_encoding())) {
-          std::cout << pujo.key.line_planning_number << "," << pujo.key.journey_number << ","
-                    << date << "," << pujo.departure_time << std::endl;
+        if (pujo.key.line_planning_number == want_line_planning_number && pujo.key.day_type.has(weekday)) {
+          csv << pujo.key.line_planning_number << "," << pujo.key.journey_number << ","
+              << date << "," << pujo.departure_time << "\n";
         }
       }
     }
   }
 
-  if (options.output_file_path != "-"sv) fclose(out);
+  fputs(csv.str().c_str(), out);
+  return "";
 }
@@ -0,0 +1,513 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+#include <tmi8/kv1_diff.hpp>
+#include <tmi8/kv1_fields.hpp>
+#include <tmi8/kv1_load.hpp>
+
+#include "joparoute.hpp"
+#include "journeyinfo.hpp"
+#include "journeyroute.hpp"
+#include "journeys.hpp"
+#include "schedule.hpp"
+#include "serve.hpp"
+
+using namespace std::string_view_literals;
+
+using ServeClock = std::chrono::steady_clock;
+
+// The options of the commands that are sent to the server, by the name of
+// their long flag, which is also their name in requests.
+#define QUERY_OPTIONS \
+  X(line_planning_number, "line") \
+  X(journey_number,       "journey") \
+  X(journey_pattern_code, "jopa") \
+  X(begin_stop_code,      "begin") \
+  X(end_stop_code,        "end")
+
+struct QueryCommand {
+  const char *name;
+  // Requests for the command must have these options
+  std::vector<std::string_view> required;
+};
+
+static const QueryCommand query_commands[] = {
+  { "joparoute",    { "line", "jopa" } },
+  { "journeyinfo",  { "line", "journey" } },
+  { "journeyroute", { "line", "journey" } },
+  { "journeys",     { "line", "begin", "end" } },
+  { "schedule",     { "line" } },
+};
+
+const Kv1JourneyPatternGeometry &QueryData::geometry() {
+  std::call_once(geometry_built, [this]() { geometry_.emplace(records, index); });
+  return *geometry_;
+}
+
+const Kv1JourneyPatternTimingLinkColumns &QueryData::jopatiliColumns() {
+  std::call_once(jopatili_columns_built, [this]() { jopatili_columns_.emplace(records); });
+  return *jopatili_columns_;
+}
+
+// A std::once_flag cannot be reset, so it is destroyed and constructed again
+// instead.
+void QueryData::reset() {
+  geometry_.reset();
+  std::destroy_at(&geometry_built);
+  std::construct_at(&geometry_built);
+  jopatili_columns_.reset();
+  std::destroy_at(&jopatili_columns_built);
+  std::construct_at(&jopatili_columns_built);
+}
+
+std::string query(const Options &options, QueryData &data, FILE *out, FILE *log) {
+  Kv1Records &records = data.records;
+  Kv1Index &index = data.index;
+  if (options.subcommand == "joparoute"sv) return jopaRoute(options, data.geometry(), index, out, log);
+  if (options.subcommand == "journeyroute"sv) return journeyRoute(options, records, index, out, log);
+  if (options.subcommand == "journeys"sv) return journeys(options, records, data.jopatiliColumns(), out, log);
+  if (options.subcommand == "journeyinfo"sv) return journeyInfo(options, records, index, out, log);
+  if (options.subcommand == "schedule"sv) return schedule(options, records, index, out, log);
+  return std::string("Unknown command ") + options.subcommand;
+}
+
+// Strings sent to and from the server may come straight from the KV1 data,
+// which is not necessarily valid UTF-8.
+static std::string dumpLine(const nlohmann::json &json) {
+  return json.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) + '\n';
+}
+
+static bool sendAll(int fd, std::string_view data) {
+  while (!data.empty()) {
+    ssize_t n = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return false;
+    data.remove_prefix(static_cast<size_t>(n));
+  }
+  return true;
+}
+
+static nlohmann::json errorResponse(const std::string &message) {
+  return { { "error", message } };
+}
+
+// Only one reload can be done at a time, as a diff can only be applied to the
+// records that it was made against.
+static std::mutex reload_mutex;
+
+// Loads the KV1 data again, and applies what has changed. Queries are answered
+// from the old data until the changes are applied.
+static nlohmann::json reload(const Options &server_options, QueryData &data) {
+  if (!server_options.kv1_snapshot_path && server_options.kv1_file_path == "-"sv)
+    return errorResponse("KV1 data was read from standard input, and cannot be loaded again");
+
+  std::lock_guard reload_lock(reload_mutex);
+  auto start = ServeClock::now();
+  Kv1Records new_records;
+  if (!kv1Load(server_options.kv1_file_path, server_options.kv1_snapshot_path, new_records, threadCount(server_options)))
+    return errorResponse("Could not load the KV1 data; see the log of the server");
+  auto loaded = ServeClock::now();
+
+  Kv1Diff diff;
+  {
+    std::shared_lock lock(data.mutex);
+    diff = kv1Diff(data.index, new_records);
+  }
+  auto diffed = ServeClock::now();
+  {
+    std::unique_lock lock(data.mutex);
+    kv1ApplyDiff(data.index, std::move(new_records), diff);
+    data.reset();
+  }
+  auto applied = ServeClock::now();
+
+  size_t added = 0, removed = 0, changed = 0;
+#define X(type, table) \
+  added += diff.table.added.size(); \
+  removed += diff.table.removed.size(); \
+  changed += diff.table.changed.size();
+  KV1_TABLES
+#undef X
+  std::chrono::duration<double> load_time = loaded - start, diff_time = diffed - loaded, apply_time = applied - diffed;
+  char summary[256];
+  snprintf(summary, sizeof summary,
+    "Reloaded KV1 data: %zu records added, %zu removed and %zu changed "
+    "(loaded in %f s, compared in %f s, applied in %f s)\n",
+    added, removed, changed, load_time.count(), diff_time.count(), apply_time.count());
+  fputs(summary, stderr);
+  return { { "output", summary } };
+}
+
+static nlohmann::json answer(std::string_view line, const Options &server_options, QueryData &data) {
+  nlohmann::json request = nlohmann::json::parse(line, nullptr, false);
+  if (request.is_discarded() || !request.is_object())
+    return errorResponse("Request is not a JSON object");
+
+  // The options point into these strings
+  std::unordered_map<std::string, std::string> values;
+  for (const auto &[key, value] : request.items()) {
+    if (!value.is_string())
+      return errorResponse("Value of '" + key + "' is not a string");
+    values[key] = value.get<std::string>();
+  }
+
+  if (values["command"] == "reload") {
+    if (values.size() > 1)
+      return errorResponse("Command 'reload' has no options");
+    return reload(server_options, data);
+  }
+
+  Options options;
+  const QueryCommand *command = nullptr;
+  for (const auto &candidate : query_commands)
+    if (values["command"] == candidate.name) command = &candidate;
+  if (!command)
+    return errorResponse("Unknown command '" + values["command"] + "'");
+  options.subcommand = command->name;
+  for (const auto &[key, value] : values) {
+    if (key == "command") continue;
+    bool known = false;
+#define X(name, long_) if (key == long_) { options.name = value.c_str(); known = true; }
+    QUERY_OPTIONS
+#undef X
+    if (!known)
+      return errorResponse("Unknown option '" + key + "'");
+  }
+  for (std::string_view required : command->required) {
+    auto it = values.find(std::string(required));
+    if (it == values.end() || it->second.empty())
+      return errorResponse("Option '" + std::string(required) + "' must be provided");
+  }
+
+  // The log is sent along with the output, so that it ends up with the client
+  // instead of being interleaved with the logs of other requests
+  char *output = nullptr, *log_output = nullptr;
+  size_t output_size = 0, log_size = 0;
+  FILE *out = open_memstream(&output, &output_size);
+  FILE *log = open_memstream(&log_output, &log_size);
+  if (!out || !log) {
+    std::string error = std::string("Open output: ") + strerrordesc_np(errno);
+    if (out) fclose(out);
+    if (log) fclose(log);
+    free(output);
+    free(log_output);
+    return errorResponse(error);
+  }
+  std::string error;
+  try {
+    std::shared_lock lock(data.mutex);
+    error = query(options, data, out, log);
+  } catch (const std::exception &e) {
+    error = e.what();
+  }
+  fclose(out);
+  fclose(log);
+  std::string result(output, output_size), log_result(log_output, log_size);
+  free(output);
+  free(log_output);
+
+  nlohmann::json response = error.empty() ? nlohmann::json{ { "output", result } } : errorResponse(error);
+  if (!log_result.empty())
+    response["log"] = log_result;
+  return response;
+}
+
+// Connections on which no request has come in for this long, while none of
+// their requests is being answered, are closed.
+static constexpr auto IDLE_TIMEOUT = std::chrono::seconds(60);
+// Sending an answer fails if the client has not read any of it for this long
+static constexpr timeval SEND_TIMEOUT{ .tv_sec = 10, .tv_usec = 0 };
+// Longer requests are not read, and close the connection
+static constexpr size_t MAX_REQUEST_SIZE = 1 << 16;
+
+namespace {
+  struct Connection {
+    explicit Connection(int fd) : fd(fd), last_active(ServeClock::now()) {}
+    ~Connection() { close(fd); }
+
+    const int fd;
+    // What has been read of the request that is being received. Only used by
+    // the thread that reads from the connections.
+    std::string received;
+
+    std::mutex mutex;
+    // Requests that have been received but not answered yet, in order
+    std::deque<std::string> requests;
+    // Whether the connection is queued or one of its requests is being
+    // answered. Only one request of a connection is answered at a time, so
+    // that the answers are sent in the order of the requests.
+    bool answering = false;
+    ServeClock::time_point last_active;
+  };
+
+  // Connections that have a request to be answered
+  class ConnectionQueue {
+   public:
+    void push(std::shared_ptr<Connection> connection) {
+      {
+        std::lock_guard lock(mutex_);
+        connections_.push_back(std::move(connection));
+      }
+      cv_.notify_one();
+    }
+
+    std::shared_ptr<Connection> pop() {
+      std::unique_lock lock(mutex_);
+      cv_.wait(lock, [this]() { return !connections_.empty(); });
+      std::shared_ptr<Connection> connection = std::move(connections_.front());
+      connections_.pop_front();
+      return connection;
+    }
+
+   private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::shared_ptr<Connection>> connections_;
+  };
+}
+
+// Answers the first request of the connection. The connection is queued again
+// if more of its requests have come in in the meantime, so that a client that
+// sends many requests at once cannot keep a thread to itself.
+static void answerNext(ConnectionQueue &queue, std::shared_ptr<Connection> connection,
+                       const Options &options, QueryData &data) {
+  std::string request;
+  {
+    std::lock_guard lock(connection->mutex);
+    request = std::move(connection->requests.front());
+    connection->requests.pop_front();
+  }
+  bool sent = sendAll(connection->fd, dumpLine(answer(request, options, data)));
+  bool more;
+  {
+    std::lock_guard lock(connection->mutex);
+    // Nobody will read the answers to the other requests
+    if (!sent) connection->requests.clear();
+    more = !connection->requests.empty();
+    connection->answering = more;
+    connection->last_active = ServeClock::now();
+  }
+  if (more) queue.push(std::move(connection));
+}
+
+// Reads what the client has sent, and queues the connection if it has sent
+// requests. Returns false if the connection should be closed.
+static bool receive(ConnectionQueue &queue, const std::shared_ptr<Connection> &connection) {
+  char buf[4096];
+  ssize_t n = recv(connection->fd, buf, sizeof buf, 0);
+  if (n < 0 && errno == EINTR) return true;
+  if (n <= 0) return false;
+
+  std::vector<std::string> requests;
+  std::string_view chunk(buf, static_cast<size_t>(n));
+  for (size_t end; (end = chunk.find('\n')) != std::string_view::npos; chunk.remove_prefix(end + 1)) {
+    connection->received.append(chunk.substr(0, end));
+    if (!connection->received.empty())
+      requests.push_back(std::move(connection->received));
+    connection->received.clear();
+  }
+  connection->received.append(chunk);
+  if (connection->received.size() > MAX_REQUEST_SIZE)
+    return false;
+
+  std::lock_guard lock(connection->mutex);
+  connection->last_active = ServeClock::now();
+  if (requests.empty()) return true;
+  for (auto &request : requests)
+    connection->requests.push_back(std::move(request));
+  if (!connection->answering) {
+    connection->answering = true;
+    queue.push(connection);
+  }
+  return true;
+}
+
+void serve(const Options &options, QueryData &data) {
+  unsigned n_threads = threadCount(options);
+
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (strlen(options.socket_path) >= sizeof addr.sun_path) {
+    fprintf(stderr, "Socket path %s is too long\n", options.socket_path);
+    exit(EXIT_FAILURE);
+  }
+  strcpy(addr.sun_path, options.socket_path);
+
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0) {
+    fprintf(stderr, "Create socket: %s\n", strerrordesc_np(errno));
+    exit(EXIT_FAILURE);
+  }
+  // A socket left behind by an earlier server is replaced, but other files
+  // are left alone.
+  struct stat st;
+  if (lstat(options.socket_path, &st) == 0 && S_ISSOCK(st.st_mode))
+    unlink(options.socket_path);
+  if (bind(listen_fd, reinterpret_cast<const sockaddr *>(&addr), sizeof addr) != 0) {
+    fprintf(stderr, "Bind %s: %s\n", options.socket_path, strerrordesc_np(errno));
+    exit(EXIT_FAILURE);
+  }
+  if (listen(listen_fd, SOMAXCONN) != 0) {
+    fprintf(stderr, "Listen on %s: %s\n", options.socket_path, strerrordesc_np(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  // The queries only read the data (besides building what is derived from it
+  // once), so requests can be answered on multiple threads at once. Reading
+  // requests is left to this thread, such that idle connections do not take
+  // up any of the threads that answer requests.
+  ConnectionQueue queue;
+  std::vector<std::jthread> workers;
+  for (unsigned i = 0; i < n_threads; i++) {
+    workers.emplace_back([&queue, &options, &data]() {
+      for (;;) answerNext(queue, queue.pop(), options, data);
+    });
+  }
+  fprintf(stderr, "Listening on %s with %u threads\n", options.socket_path, n_threads);
+
+  // connections[i] is polled with pollfds[i + 1]
+  std::vector<std::shared_ptr<Connection>> connections;
+  std::vector<pollfd> pollfds{ { .fd = listen_fd, .events = POLLIN, .revents = 0 } };
+  for (;;) {
+    // Wake up when the first idle connection times out. Connections that are
+    // being answered may be idle by then as well.
+    auto now = ServeClock::now();
+    int timeout_ms = -1;
+    for (const auto &connection : connections) {
+      std::lock_guard lock(connection->mutex);
+      auto timeout_at = (connection->answering ? now : connection->last_active) + IDLE_TIMEOUT;
+      auto left = std::chrono::ceil<std::chrono::milliseconds>(timeout_at - now).count();
+      int left_ms = static_cast<int>(std::max<decltype(left)>(left, 0));
+      if (timeout_ms < 0 || left_ms < timeout_ms) timeout_ms = left_ms;
+    }
+
+    if (poll(pollfds.data(), pollfds.size(), timeout_ms) < 0) {
+      if (errno == EINTR) continue;
+      fprintf(stderr, "Poll: %s\n", strerrordesc_np(errno));
+      exit(EXIT_FAILURE);
+    }
+
+    now = ServeClock::now();
+    size_t kept = 0;
+    for (size_t i = 0; i < connections.size(); i++) {
+      bool keep = true;
+      if (pollfds[i + 1].revents)
+        keep = receive(queue, connections[i]);
+      if (keep) {
+        std::lock_guard lock(connections[i]->mutex);
+        keep = connections[i]->answering || now - connections[i]->last_active < IDLE_TIMEOUT;
+      }
+      // A connection that is closed here is only really closed once the
+      // answers to its requests have been sent.
+      if (!keep) continue;
+      connections[kept] = std::move(connections[i]);
+      pollfds[kept + 1] = pollfds[i + 1];
+      kept++;
+    }
+    connections.resize(kept);
+    pollfds.resize(kept + 1);
+
+    if (pollfds[0].revents & POLLIN) {
+      int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd < 0 && errno != EINTR && errno != ECONNABORTED) {
+        fprintf(stderr, "Accept on %s: %s\n", options.socket_path, strerrordesc_np(errno));
+        exit(EXIT_FAILURE);
+      }
+      if (fd >= 0) {
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &SEND_TIMEOUT, sizeof SEND_TIMEOUT);
+        connections.push_back(std::make_shared<Connection>(fd));
+        pollfds.push_back({ .fd = fd, .events = POLLIN, .revents = 0 });
+      }
+    }
+  }
+}
+
+bool queryServer(const Options &options, std::string &output) {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (strlen(options.socket_path) >= sizeof addr.sun_path) {
+    fprintf(stderr, "Socket path %s is too long\n", options.socket_path);
+    return false;
+  }
+  strcpy(addr.sun_path, options.socket_path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    fprintf(stderr, "Create socket: %s\n", strerrordesc_np(errno));
+    return false;
+  }
+  if (connect(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof addr) != 0) {
+    fprintf(stderr, "Connect to %s: %s\n", options.socket_path, strerrordesc_np(errno));
+    close(fd);
+    return false;
+  }
+
+  nlohmann::json request{ { "command", options.subcommand } };
+#define X(name, long_) if (options.name) request[long_] = options.name;
+  QUERY_OPTIONS
+#undef X
+  if (!sendAll(fd, dumpLine(request))) {
+    fprintf(stderr, "Send to %s: %s\n", options.socket_path, strerrordesc_np(errno));
+    close(fd);
+    return false;
+  }
+
+  FILE *in = fdopen(fd, "r");
+  if (!in) {
+    fprintf(stderr, "Open %s: %s\n", options.socket_path, strerrordesc_np(errno));
+    close(fd);
+    return false;
+  }
+  char *line = nullptr;
+  size_t line_capacity = 0;
+  ssize_t line_size = getline(&line, &line_capacity, in);
+  nlohmann::json response = line_size > 0
+    ? nlohmann::json::parse(std::string_view(line, static_cast<size_t>(line_size)), nullptr, false)
+    : nlohmann::json(nlohmann::json::value_t::discarded);
+  free(line);
+  fclose(in);
+
+  if (response.is_discarded() || !response.is_object()) {
+    fprintf(stderr, "Server at %s did not answer properly\n", options.socket_path);
+    return false;
+  }
+  if (response.contains("log") && response["log"].is_string())
+    fputs(response["log"].get<std::string>().c_str(), stderr);
+  if (response.contains("error") && response["error"].is_string()) {
+    fprintf(stderr, "%s\n", response["error"].get<std::string>().c_str());
+    return false;
+  }
+  if (!response.contains("output") || !response["output"].is_string()) {
+    fprintf(stderr, "Server at %s did not send any output\n", options.socket_path);
+    return false;
+  }
+  output = response["output"].get<std::string>();
+  return true;
+}
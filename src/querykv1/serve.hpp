@@ -0,0 +1,65 @@
+// vim:set sw=2 ts=2 sts et:
+//
+// Copyright 2024 Rutger Broekhoff. Licensed under the EUPL.
+
+#ifndef OEUF_QUERYKV1_SERVE_HPP
+#define OEUF_QUERYKV1_SERVE_HPP
+
+#include <cstdio>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+
+#include <tmi8/kv1_columns.hpp>
+#include <tmi8/kv1_geometry.hpp>
+#include <tmi8/kv1_types.hpp>
+#include <tmi8/kv1_index.hpp>
+
+#include "cliopts.hpp"
+
+// The KV1 data that the query commands run on. What is derived from the
+// records is only built when a command first needs it, which is safe to do
+// from multiple threads at once, and is kept for the commands after it.
+struct QueryData {
+  Kv1Records &records;
+  Kv1Index &index;
+  // Held shared by queries, and exclusively while the records are changed
+  std::shared_mutex mutex;
+
+  QueryData(Kv1Records &records, Kv1Index &index) : records(records), index(index) {}
+
+  const Kv1JourneyPatternGeometry &geometry();
+  const Kv1JourneyPatternTimingLinkColumns &jopatiliColumns();
+
+  // Drops what has been derived from the records, so that it is built again
+  // on its next use. Must be called after the records have been changed, with
+  // mutex held exclusively.
+  void reset();
+
+ private:
+  std::once_flag geometry_built;
+  std::optional<Kv1JourneyPatternGeometry> geometry_;
+  std::once_flag jopatili_columns_built;
+  std::optional<Kv1JourneyPatternTimingLinkColumns> jopatili_columns_;
+};
+
+// Runs one of the commands that only query the KV1 data (joparoute,
+// journeyinfo, journeyroute, journeys and schedule), writing its output to
+// out and what it has to say about it to log. Returns why the command failed,
+// or an empty string if it did not. These commands may run on multiple
+// threads at once.
+std::string query(const Options &options, QueryData &data, FILE *out, FILE *log);
+
+// Answers requests on the Unix socket at options.socket_path. Does not return.
+// Besides the query commands, serve takes the command reload, which loads the
+// KV1 data again from where it was loaded from at first, and applies what has
+// changed to data.
+[[noreturn]] void serve(const Options &options, QueryData &data);
+
+// Sends the command in options to the server listening at options.socket_path,
+// and sets output to what the command wrote. What the command logged is
+// printed to stderr. Returns false if this failed, after printing why.
+bool queryServer(const Options &options, std::string &output);
+
+#endif // OEUF_QUERYKV1_SERVE_HPP